@@ -15,9 +15,13 @@
 #include "PDFBackend.h"
 
 #include <QApplication>
+#include <QCryptographicHash>
 #include <QElapsedTimer>
 #include <QPainter>
 #include <QPainterPath>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 namespace QtPDF {
 
@@ -91,7 +95,7 @@ QDateTime fromPDFDate(QString pdfDate)
 }
 
 #ifdef DEBUG
-void PDFPageProcessingThread::dumpWorkStack(const QStack<PageProcessingRequest*> & ws)
+void PDFPageProcessingThreadPool::dumpWorkStack(const QStack<PageProcessingRequest*> & ws)
 {
   QStringList strList;
   for (int i = 0; i < ws.size(); ++i) {
@@ -110,18 +114,108 @@ void PDFPageProcessingThread::dumpWorkStack(const QStack<PageProcessingRequest*>
 // Backend Rendering
 // =================
 
-PDFPageProcessingThread::~PDFPageProcessingThread()
+void PDFPageProcessingThread::run()
+{
+  Q_ASSERT(_pool);
+
+  PageProcessingRequest * workItem{nullptr};
+  while ((workItem = _pool->takeWorkItem())) {
+#ifdef DEBUG
+    qDebug() << "processing work item" << *workItem << "in thread" << QThread::currentThreadId();
+    QElapsedTimer timer;
+    timer.start();
+#endif
+    workItem->execute();
+#ifdef DEBUG
+    QString jobDesc;
+    switch (workItem->type()) {
+      case PageProcessingRequest::LoadLinks:
+        jobDesc = QString::fromUtf8("loading links");
+        break;
+      case PageProcessingRequest::PageRendering:
+        jobDesc = QString::fromUtf8("rendering page");
+        break;
+      case PageProcessingRequest::LowResRendering:
+        jobDesc = QString::fromUtf8("rendering page at low resolution");
+        break;
+      case PageProcessingRequest::PreviewLoading:
+        jobDesc = QString::fromUtf8("loading preview");
+        break;
+      case PageProcessingRequest::TextExtraction:
+        jobDesc = QString::fromUtf8("extracting text");
+        break;
+    }
+    qDebug() << "finished " << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << timer.elapsed() << " ms.";
+#endif
+
+    // Delete the work item as it has fulfilled its purpose
+    // Note that we can't delete it here or we might risk that some emitted
+    // signals are invalidated; to ensure they reach their destination, we
+    // need to call deleteLater().
+    // Note: workItem *must* live in the main (GUI) thread for this!
+    Q_ASSERT(workItem->thread() == QApplication::instance()->thread());
+    workItem->deleteLater();
+
+    _pool->finishWorkItem();
+  }
+}
+
+QAtomicInt PDFPageProcessingThreadPool::_defaultMaxThreadCount(0);
+
+PDFPageProcessingThreadPool::~PDFPageProcessingThreadPool()
 {
   _mutex.lock();
   _quit = true;
+  foreach(PageProcessingRequest * workItem, _workStack) {
+    if (workItem)
+      workItem->deleteLater();
+  }
+  _workStack.clear();
   _waitCondition.wakeAll();
   _mutex.unlock();
-  wait();
+
+  foreach(PDFPageProcessingThread * thread, _threads) {
+    thread->wait();
+    delete thread;
+  }
 }
 
-void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * request)
+//static
+int PDFPageProcessingThreadPool::defaultMaxThreadCount()
 {
+  int retVal = _defaultMaxThreadCount.loadAcquire();
+  if (retVal > 0)
+    return retVal;
+  return qMax(1, QThread::idealThreadCount());
+}
 
+//static
+void PDFPageProcessingThreadPool::setDefaultMaxThreadCount(const int numThreads)
+{
+  _defaultMaxThreadCount.storeRelease(qMax(0, numThreads));
+}
+
+int PDFPageProcessingThreadPool::maxThreadCount() const
+{
+  QMutexLocker locker(&_mutex);
+  return effectiveMaxThreadCount();
+}
+
+void PDFPageProcessingThreadPool::setMaxThreadCount(const int numThreads)
+{
+  QMutexLocker locker(&_mutex);
+  _maxThreadCount = qMax(0, numThreads);
+  // Threads that are currently throttled may be allowed to run now
+  _waitCondition.wakeAll();
+}
+
+int PDFPageProcessingThreadPool::effectiveMaxThreadCount() const
+{
+  return (_maxThreadCount > 0 ? _maxThreadCount : defaultMaxThreadCount());
+}
+
+void PDFPageProcessingThreadPool::addPageProcessingRequest(PageProcessingRequest * request)
+{
   if (!request)
     return;
 
@@ -129,98 +223,157 @@ void PDFPageProcessingThread::addPageProcessingRequest(PageProcessingRequest * r
   // on will fail
   Q_ASSERT(request->thread() == QApplication::instance()->thread());
 
-  QMutexLocker locker(&(this->_mutex));
-  // Note: Commenting the "remove identical requests in the stack" code for now.
-  // This should be handled by the caching routine elsewhere automatically. If
-  // in doubt, it's better to render a tile twice than to not render it at all
-  // (thereby leaving the dummy image in the cache indefinitely)
-/*
-  // remove any instances of the given request type before adding the new one to
-  // avoid processing it several times
-  // **TODO:** Could it be that we require several concurrent versions of the
-  //           same page?
-  int i;
-  for (i = _workStack.size() - 1; i >= 0; --i) {
-    if (*(_workStack[i]) == *request) {
-      // Using deleteLater() doesn't work because we have no event queue in this
-      // thread. However, since the object is still on the stack, it is still
-      // sleeping and directly deleting it should therefore be safe.
-      delete _workStack[i];
-      _workStack.remove(i);
-    }
+  QMutexLocker locker(&_mutex);
+
+  // Remove identical requests (for the same listener) that are still waiting
+  // on the stack to avoid processing them several times. The new request is
+  // pushed on top, so the work is still done (and done sooner), and requests
+  // that are already being processed are never touched. This way, a tile can
+  // be rendered twice at worst, but it is never left unrendered (which would
+  // leave the dummy image in the cache indefinitely).
+  for (int i = _workStack.size() - 1; i >= 0; --i) {
+    PageProcessingRequest * queued = _workStack[i];
+    if (!queued || queued->listener != request->listener || !(*queued == *request))
+      continue;
+    // The request is still sleeping on the stack (and lives in the calling
+    // thread), so deleting it directly is safe.
+    delete queued;
+    _workStack.remove(i);
   }
-*/
 
   _workStack.push(request);
 #ifdef DEBUG
   qDebug() << "new request:" << *request;
 #endif
 
-  locker.unlock();
-  if (!isRunning())
-    start();
+  // Start another worker if all existing ones are busy (or already have
+  // something to do) and the limit has not been reached yet
+  const int numSleeping = _threads.size() - _numActive;
+  if (numSleeping < _workStack.size() && _threads.size() < effectiveMaxThreadCount()) {
+    PDFPageProcessingThread * thread = new PDFPageProcessingThread(this);
+    _threads.append(thread);
+    thread->start();
+  }
   else
     _waitCondition.wakeOne();
 }
 
-void PDFPageProcessingThread::run()
+PageProcessingRequest * PDFPageProcessingThreadPool::takeWorkItem()
 {
-  _mutex.lock();
-  _idle = false;
-  while (!_quit) {
-    // mutex must be locked at start of loop
-    if (!_workStack.empty()) {
-      PageProcessingRequest * workItem = _workStack.pop();
-      _mutex.unlock();
-
+  QMutexLocker locker(&_mutex);
+  while (!_quit && (_workStack.empty() || _numActive >= effectiveMaxThreadCount())) {
 #ifdef DEBUG
-      qDebug() << "processing work item" << *workItem << "; remaining items:" << _workStack.size();
-      QElapsedTimer timer;
-      timer.start();
+    qDebug() << "going to sleep";
 #endif
-      workItem->execute();
+    _waitCondition.wait(&_mutex);
 #ifdef DEBUG
-      QString jobDesc;
-      switch (workItem->type()) {
-        case PageProcessingRequest::LoadLinks:
-          jobDesc = QString::fromUtf8("loading links");
-          break;
-        case PageProcessingRequest::PageRendering:
-          jobDesc = QString::fromUtf8("rendering page");
-          break;
-      }
-      qDebug() << "finished " << jobDesc << "for page" << workItem->page->pageNum() << ". Time elapsed: " << timer.elapsed() << " ms.";
+    qDebug() << "waking up";
 #endif
+  }
+  if (_quit)
+    return nullptr;
+  ++_numActive;
+
+  if (_viewport.isNull())
+    return _workStack.pop();
+
+  // Take the most recent request of the highest priority class
+  int best = _workStack.size() - 1;
+  Priority bestPriority = Priority_OffScreen;
+  for (int i = _workStack.size() - 1; i >= 0; --i) {
+    const Priority p = priority(_workStack[i]);
+    if (p < bestPriority) {
+      best = i;
+      bestPriority = p;
+      if (p == Priority_Visible)
+        break;
+    }
+  }
+  PageProcessingRequest * workItem = _workStack[best];
+  _workStack.remove(best);
+  return workItem;
+}
 
-      // Delete the work item as it has fulfilled its purpose
-      // Note that we can't delete it here or we might risk that some emitted
-      // signals are invalidated; to ensure they reach their destination, we
-      // need to call deleteLater().
-      // Note: workItem *must* live in the main (GUI) thread for this!
-      Q_ASSERT(workItem->thread() == QApplication::instance()->thread());
-      workItem->deleteLater();
+PDFPageProcessingThreadPool::Priority PDFPageProcessingThreadPool::priority(const PageProcessingRequest * request) const
+{
+  if (!request)
+    return Priority_OffScreen;
+  // Fingerprints and previews only pay off the next time the document is
+  // (re)loaded, so they must not get in the way of anything that is needed now.
+  // The same holds for the text index, which is only needed for searching.
+  if (request->type() == PageProcessingRequest::LowResRendering || request->type() == PageProcessingRequest::TextExtraction)
+    return Priority_OffScreen;
+
+  // Checks if the request touches the region of its page in `rects`
+  auto touches = [request](const QMap<int, QRectF> & rects) {
+    QMap<int, QRectF>::const_iterator it = rects.constFind(request->page_num);
+    if (it == rects.constEnd())
+      return false;
+    const QRectF r = request->pageRect();
+    return (r.isNull() || r.intersects(it.value()));
+  };
+
+  if (touches(_viewport.visible))
+    return Priority_Visible;
+  if (touches(_viewport.ahead))
+    return Priority_Ahead;
+  if (touches(_viewport.behind))
+    return Priority_Behind;
+  return Priority_OffScreen;
+}
+
+PDFPageProcessingThreadPool::Viewport PDFPageProcessingThreadPool::viewport() const
+{
+  QMutexLocker locker(&_mutex);
+  return _viewport;
+}
 
-      _mutex.lock();
+void PDFPageProcessingThreadPool::setViewport(const Viewport & viewport)
+{
+  QList<PageProcessingRequest*> dropped;
+  {
+    QMutexLocker locker(&_mutex);
+    _viewport = viewport;
+    if (_viewport.isNull())
+      return;
+
+    // Drop work that has scrolled out of view so it doesn't hold up the
+    // requests that matter now
+    for (int i = _workStack.size() - 1; i >= 0; --i) {
+      PageProcessingRequest * request = _workStack[i];
+      if (!request || !request->isDiscardable() || priority(request) != Priority_OffScreen)
+        continue;
+      dropped << request;
+      _workStack.remove(i);
     }
-    else {
-#ifdef DEBUG
-      qDebug() << "going to sleep";
-#endif
-      _idle = true;
-      _idleCondition.wakeAll();
-      _waitCondition.wait(&_mutex);
-      _idle = false;
+  }
+
+  // Note: discard() may need to acquire other locks (e.g., of the page cache),
+  // so call it without holding _mutex
+  foreach(PageProcessingRequest * request, dropped) {
+    Q_ASSERT(request->thread() == QApplication::instance()->thread());
 #ifdef DEBUG
-      qDebug() << "waking up";
+    qDebug() << "dropping request" << *request;
 #endif
-    }
+    request->discard();
+    request->deleteLater();
   }
-  _mutex.unlock();
 }
 
-void PDFPageProcessingThread::clearWorkStack()
+void PDFPageProcessingThreadPool::finishWorkItem()
 {
-  _mutex.lock();
+  QMutexLocker locker(&_mutex);
+  --_numActive;
+  if (_numActive == 0)
+    _idleCondition.wakeAll();
+  // If the thread limit was reached, another worker may be waiting for its turn
+  if (!_workStack.empty())
+    _waitCondition.wakeOne();
+}
+
+void PDFPageProcessingThreadPool::clearWorkStack()
+{
+  QMutexLocker locker(&_mutex);
 
   foreach(PageProcessingRequest * workItem, _workStack) {
     if (!workItem)
@@ -230,11 +383,9 @@ void PDFPageProcessingThread::clearWorkStack()
   }
   _workStack.clear();
 
-  if (!_idle) {
-    // Wait until the current operation finishes
+  // Wait until all current operations finish
+  while (_numActive > 0)
     _idleCondition.wait(&_mutex);
-  }
-  _mutex.unlock();
 }
 
 
@@ -248,6 +399,13 @@ void PDFPageProcessingThread::clearWorkStack()
 // `listener` will need a custom `event` function that is capable of picking up
 // on these events.
 
+PageProcessingRequest::PageProcessingRequest(Page *page, QObject *listener) :
+  page(page),
+  listener(listener),
+  page_num(page ? page->pageNum() : -1)
+{
+}
+
 bool PageProcessingRequest::operator==(const PageProcessingRequest & r) const
 {
   // TODO: Should we care about the listener here as well?
@@ -263,6 +421,13 @@ bool PageProcessingRenderPageRequest::operator==(const PageProcessingRequest & r
   return (qFuzzyCompare(xres, rr->xres) && qFuzzyCompare(yres, rr->yres) && render_box == rr->render_box && cache == rr->cache);
 }
 
+QRectF PageProcessingRenderPageRequest::pageRect() const
+{
+  if (render_box.isNull() || xres <= 0 || yres <= 0)
+    return QRectF();
+  return QRectF(render_box.x() * 72. / xres, render_box.y() * 72. / yres, render_box.width() * 72. / xres, render_box.height() * 72. / yres);
+}
+
 #ifdef DEBUG
 PageProcessingRenderPageRequest::operator QString() const
 {
@@ -277,19 +442,120 @@ const QEvent::Type PDFLinksLoadedEvent::LinksLoadedEvent = static_cast<QEvent::T
 
 bool PageProcessingRenderPageRequest::execute()
 {
-  // TODO: Aborting renders doesn't really work right now---the backend knows
-  // nothing about the PDF scenes.
-  //
-  // Idea: Perhaps allow page render requests to provide a pointer to a function
-  // that returns a `bool` value indicating if the request is still valid? Then
-  // the `PDFPageGraphicsItem` could have a function that indicates if the item
-  // is anywhere near a viewport.
+  // Note: Renders that are already running cannot be aborted. Requests that
+  // are still waiting are dropped by the thread pool if they are far away from
+  // the viewport (see PDFPageProcessingThreadPool::setViewport()).
+
+  if (cache) {
+    // After a reload, the tiles of pages that did not change are reused, so
+    // there may be nothing left to do. Checking this only involves extracting
+    // the page's text (which is needed for the text index anyway) and
+    // rendering it at low resolution (see Page::fingerprint()), which is much
+    // cheaper than rendering all its tiles.
+    page->reuseUnchangedTiles();
+    Document * doc = page->document();
+    const PDFPageTile tile(xres, yres, render_box, page_num);
+    if (doc && doc->pageCache().getStatus(tile) == PDFPageCache::CURRENT) {
+      PDFTileImage img = doc->pageCache().getImage(tile);
+      if (img) {
+        QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, img));
+        return true;
+      }
+    }
+  }
+
   QImage rendered_page = page->renderToImage(xres, yres, render_box, cache);
-  QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, rendered_page));
+  // If we didn't get an image, we most likely ran out of memory
+  if (rendered_page.isNull() && !render_box.isEmpty())
+    PDFTileCache::instance().handleMemoryPressure(PDFTileCache::MemoryPressure_Critical);
+  // Note: The backend put `rendered_page` into the cache (if requested); the
+  // event shares its pixel data
+  QCoreApplication::postEvent(listener, new PDFPageRenderedEvent(xres, yres, render_box, PDFTileImage(new QImage(rendered_page))));
+
+  return true;
+}
+
+void PageProcessingRenderPageRequest::discard()
+{
+  // The tile was (most likely) marked as a placeholder when this request was
+  // issued. Make sure it is rendered again the next time it is needed.
+  Document * doc = (page ? page->document() : nullptr);
+  if (doc && cache)
+    doc->pageCache().discardPlaceholder(PDFPageTile(xres, yres, render_box, page_num));
+}
+
+bool PageProcessingRenderLowResRequest::execute()
+{
+  const bool needFingerprint = page->fingerprint(false).isEmpty();
+  bool needPreview = (PDFPreviewCache::instance().isEnabled() && page->previewImage().isNull());
+  QByteArray docHash;
+  if (needPreview) {
+    Document * doc = page->document();
+    docHash = (doc ? doc->contentHash() : QByteArray());
+    needPreview = !docHash.isEmpty();
+  }
+  if (!needFingerprint && !needPreview)
+    return true;
+
+  // The fingerprint and the preview are computed from the same rendering
+  const QImage img = page->renderLowRes();
+  if (img.isNull())
+    return false;
+  if (needFingerprint)
+    page->updateFingerprint(img);
+  if (needPreview) {
+    const QImage preview = img.scaled(PDFPreviewCache::PreviewSize, PDFPreviewCache::PreviewSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    PDFPreviewCache::instance().storePreview(docHash, page_num, preview);
+    QMutexLocker previewLocker(&page->_previewMutex);
+    page->_previewImage = preview;
+  }
+  return true;
+}
+
+#ifdef DEBUG
+PageProcessingRenderLowResRequest::operator QString() const
+{
+  return QString::fromUtf8("LR:%1").arg(page->pageNum());
+}
+#endif
 
+bool PageProcessingLoadPreviewRequest::execute()
+{
+  Document * doc = page->document();
+  if (!doc || !PDFPreviewCache::instance().isEnabled())
+    return false;
+  const QImage preview = PDFPreviewCache::instance().preview(doc->contentHash(), page_num);
+  if (preview.isNull())
+    return false;
+  QMutexLocker previewLocker(&page->_previewMutex);
+  // Don't replace a preview that was rendered in the meantime
+  if (page->_previewImage.isNull())
+    page->_previewImage = preview;
   return true;
 }
 
+#ifdef DEBUG
+PageProcessingLoadPreviewRequest::operator QString() const
+{
+  return QString::fromUtf8("PV:%1").arg(page->pageNum());
+}
+#endif
+
+bool PageProcessingExtractTextRequest::execute()
+{
+  Document * doc = page->document();
+  if (!doc)
+    return false;
+  return !doc->pageText(page_num).isNull();
+}
+
+#ifdef DEBUG
+PageProcessingExtractTextRequest::operator QString() const
+{
+  return QString::fromUtf8("TX:%1").arg(page->pageNum());
+}
+#endif
+
 bool PageProcessingLoadLinksRequest::execute()
 {
   QCoreApplication::postEvent(listener, new PDFLinksLoadedEvent(page->loadLinks()));
@@ -303,77 +569,619 @@ PageProcessingLoadLinksRequest::operator QString() const
 }
 #endif
 
-QSharedPointer<QImage> PDFPageCache::getImage(const PDFPageTile & tile) const
+// ### Tile Cache
+
+//static
+PDFCompressedTileImage PDFCompressedTileImage::fromImage(const QImage & image)
 {
-  _lock.lockForRead();
-  QSharedPointer<QImage> * retVal = object(tile);
-  _lock.unlock();
-  if (retVal)
-    return *retVal;
-  return QSharedPointer<QImage>();
+  PDFCompressedTileImage retVal;
+  if (image.isNull() || image.depth() != 32)
+    return retVal;
+
+  const int w = image.width();
+  const int h = image.height();
+
+  // Try to map the image onto a palette of at most 256 colors. Rendered pages
+  // typically consist of long runs of the same color, so remember the last
+  // color to avoid most hash lookups.
+  QHash<QRgb, int> palette;
+  QByteArray indices(w * h, Qt::Uninitialized);
+  bool usePalette{true};
+  QRgb lastColor{0};
+  int lastIndex{-1};
+  for (int y = 0; y < h && usePalette; ++y) {
+    const QRgb * line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+    uchar * out = reinterpret_cast<uchar *>(indices.data()) + y * w;
+    for (int x = 0; x < w; ++x) {
+      if (lastIndex < 0 || line[x] != lastColor) {
+        lastColor = line[x];
+        lastIndex = palette.value(lastColor, -1);
+        if (lastIndex < 0) {
+          if (palette.size() >= 256) {
+            usePalette = false;
+            break;
+          }
+          lastIndex = palette.size();
+          palette.insert(lastColor, lastIndex);
+          retVal._colorTable.append(lastColor);
+        }
+      }
+      out[x] = static_cast<uchar>(lastIndex);
+    }
+  }
+
+  if (usePalette)
+    retVal._data = qCompress(indices, 1);
+  else {
+    retVal._colorTable.clear();
+    QByteArray raw;
+    raw.reserve(w * h * 4);
+    for (int y = 0; y < h; ++y)
+      raw.append(reinterpret_cast<const char *>(image.constScanLine(y)), w * 4);
+    retVal._data = qCompress(raw, 1);
+  }
+
+  retVal._size = image.size();
+  retVal._format = image.format();
+  retVal._devicePixelRatio = image.devicePixelRatio();
+  return retVal;
 }
 
-PDFPageCache::TileStatus PDFPageCache::getStatus(const PDFPageTile & tile) const
+QImage PDFCompressedTileImage::toImage() const
 {
-  PDFPageCache::TileStatus retVal = UNKNOWN;
-  _lock.lockForRead();
-  if (_tileStatus.contains(tile))
-    retVal = _tileStatus[tile];
-  _lock.unlock();
+  if (isNull())
+    return QImage();
+
+  const int w = _size.width();
+  const int h = _size.height();
+  const QByteArray raw = qUncompress(_data);
+  const bool usePalette = !_colorTable.isEmpty();
+  if (raw.size() != w * h * (usePalette ? 1 : 4))
+    return QImage();
+
+  QImage retVal(_size, _format);
+  if (retVal.isNull())
+    return retVal;
+  for (int y = 0; y < h; ++y) {
+    if (usePalette) {
+      const uchar * in = reinterpret_cast<const uchar *>(raw.constData()) + y * w;
+      QRgb * line = reinterpret_cast<QRgb *>(retVal.scanLine(y));
+      for (int x = 0; x < w; ++x)
+        line[x] = _colorTable[in[x]];
+    }
+    else
+      memcpy(retVal.scanLine(y), raw.constData() + y * w * 4, static_cast<size_t>(w) * 4);
+  }
+  retVal.setDevicePixelRatio(_devicePixelRatio);
   return retVal;
 }
 
-QSharedPointer<QImage> PDFPageCache::setImage(const PDFPageTile & tile, QImage * image, const TileStatus status, const bool overwrite /* = true */)
+qint64 PDFCompressedTileImage::byteSize() const
+{
+  return static_cast<qint64>(sizeof(*this)) + _data.size() + _colorTable.size() * static_cast<qint64>(sizeof(QRgb));
+}
+
+QAtomicInt PDFPageCache::_nextId(0);
+
+PDFPageCache::PDFPageCache() :
+  _id(_nextId.fetchAndAddOrdered(1))
 {
-  _lock.lockForWrite();
-  QSharedPointer<QImage> retVal;
-  if (contains(tile))
-    retVal = *object(tile);
-  // If the key is not in the cache yet add it. Otherwise overwrite the cached
-  // image but leave the pointer intact as that can be held/used elsewhere
-  if (!retVal) {
-    QSharedPointer<QImage> * toInsert = new QSharedPointer<QImage>(image);
+}
+
+PDFPageCache::~PDFPageCache()
+{
+  clear();
+  QWriteLocker l(&PDFTileCache::instance()._lock);
+  PDFTileCache::instance()._visibleRects.remove(_id);
+}
+
+PDFTileImage PDFPageCache::getImage(const PDFPageTile & tile, TileStatus * status /* = nullptr */) const
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  PDFCompressedTileImage compressed;
+  {
+    QWriteLocker l(&cache._lock);
+    PDFTileCache::Entry * entry = cache._entries.value({_id, tile}, nullptr);
+    if (status)
+      *status = (entry ? entry->status : UNKNOWN);
+    if (!entry || (!entry->image && entry->compressed.isNull())) {
+      ++cache._statistics.misses;
+      return PDFTileImage();
+    }
+    ++cache._statistics.hits;
+    cache.touch(entry);
+    if (entry->image)
+      return entry->image;
+    // Only (shallowly) copy the compressed data here; this is typically called
+    // while painting so we must not block other threads while decompressing
+    compressed = entry->compressed;
+  }
+
+  PDFTileImage img(new QImage(compressed.toImage()));
+  if (img->isNull())
+    return PDFTileImage();
+
+  QWriteLocker l(&cache._lock);
+  PDFTileCache::Entry * entry = cache._entries.value({_id, tile}, nullptr);
+  // If the entry was removed or changed in the meantime, don't store the
+  // decompressed image (it may be outdated); still, it can be painted
+  if (!entry)
+    return img;
+  if (entry->image)
+    return entry->image;
+  if (!entry->compressed.isSharedWith(compressed))
+    return img;
 #if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-    insert(tile, toInsert, (image ? image->byteCount() : 0));
+  const qint64 cost = img->byteCount();
 #else
-    // No image (1024x124x4 bytes by default) should ever come even close to the
-    // 2 GB mark corresponding to INT_MAX; note that Document::Document() sets
-    // the cache's max-size to 1 GB total
-    insert(tile, toInsert, (image ? static_cast<int>(image->sizeInBytes()) : 0));
+  const qint64 cost = img->sizeInBytes();
 #endif
-    _tileStatus.insert(tile, status);
-    retVal = *toInsert;
+  entry->image = img;
+  entry->compressed = PDFCompressedTileImage();
+  cache._statistics.size += cost - entry->cost;
+  entry->cost = cost;
+  ++cache._statistics.decompressions;
+  cache.evict(cache._maxSize, entry);
+  return img;
+}
+
+PDFPageCache::TileStatus PDFPageCache::getStatus(const PDFPageTile & tile) const
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QReadLocker l(&cache._lock);
+  PDFTileCache::Entry * entry = cache._entries.value({_id, tile}, nullptr);
+  return (entry ? entry->status : UNKNOWN);
+}
+
+PDFTileImage PDFPageCache::setImage(const PDFPageTile & tile, const PDFTileImage & image, const TileStatus status, const bool overwrite /* = true */)
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QWriteLocker l(&cache._lock);
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+  const qint64 cost = (image ? image->byteCount() : 0);
+#else
+  const qint64 cost = (image ? image->sizeInBytes() : 0);
+#endif
+
+  PDFTileCache::Entry * entry = cache._entries.value({_id, tile}, nullptr);
+  // Compressed images must not be replaced by placeholders (or lost if the
+  // new image is not supposed to overwrite the existing one)
+  if (entry && !overwrite)
+    cache.decompress(entry);
+  // If the key is not in the cache yet add it. Otherwise replace the cached
+  // image. Images are never changed in place as they can be held/used (e.g.,
+  // painted) elsewhere at the same time.
+  if (!entry || !entry->image) {
+    if (!entry) {
+      entry = new PDFTileCache::Entry({_id, tile});
+      cache._entries.insert(entry->key, entry);
+    }
+    entry->image = image;
+    entry->compressed = PDFCompressedTileImage();
+    entry->incompressible = false;
+    cache._statistics.size += cost - entry->cost;
+    entry->cost = cost;
+    entry->status = status;
+    entry->revision = (status == CURRENT ? _revision : -1);
+    ++cache._statistics.insertions;
   }
-  else if (retVal.data() == image) {
+  else if (entry->image == image) {
     // Trying to overwrite an image with itself - just update the status
-    _tileStatus.insert(tile, status);
+    entry->status = status;
+    if (status == CURRENT)
+      entry->revision = _revision;
   }
   else if (overwrite) {
-    // TODO: overwriting an image with a different one can change its size (and
-    // therefore its cost in the cache). There doesn't seem to be a method to
-    // hande that in QCache, though, and since we only use one tile size this
-    // shouldn't pose a problem.
-    if (image)
-      *retVal = *image;
-    else {
-      QSharedPointer<QImage> * toInsert = new QSharedPointer<QImage>;
-      insert(tile, toInsert, 0);
-      retVal = *toInsert;
-    }
-    _tileStatus.insert(tile, status);
+    entry->image = image;
+    entry->incompressible = false;
+    cache._statistics.size += cost - entry->cost;
+    entry->cost = cost;
+    entry->status = status;
+    entry->revision = (image && status == CURRENT ? _revision : -1);
   }
-  _lock.unlock();
+
+  if (image)
+    cache._nothingToCompress = false;
+  cache.touch(entry);
+  PDFTileImage retVal = entry->image;
+  cache.evict(cache._maxSize, entry);
   return retVal;
 }
 
+void PDFPageCache::clear()
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QWriteLocker l(&cache._lock);
+  foreach(PDFTileCache::Entry * entry, cache._entries) {
+    if (entry->key.cacheId == _id)
+      cache.remove(entry);
+  }
+}
+
 void PDFPageCache::markOutdated()
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QWriteLocker l(&cache._lock);
+  ++_revision;
+  foreach(PDFTileCache::Entry * entry, cache._entries) {
+    if (entry->key.cacheId == _id)
+      entry->status = OUTDATED;
+  }
+}
+
+int PDFPageCache::restorePage(const int page)
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QWriteLocker l(&cache._lock);
+  int retVal{0};
+  foreach(PDFTileCache::Entry * entry, cache._entries) {
+    if (entry->key.cacheId != _id || entry->key.tile.page_num != page)
+      continue;
+    // Only actual renderings of the previous revision can be restored (older
+    // ones may show a different version of the page); outdated tiles may also
+    // be in use as placeholders already
+    if (entry->revision < 0 || entry->revision != _revision - 1)
+      continue;
+    if (entry->status != OUTDATED && entry->status != PLACEHOLDER)
+      continue;
+    if (!entry->image && entry->compressed.isNull())
+      continue;
+    entry->status = CURRENT;
+    entry->revision = _revision;
+    ++retVal;
+  }
+  return retVal;
+}
+
+void PDFPageCache::discardPlaceholder(const PDFPageTile & tile)
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QWriteLocker l(&cache._lock);
+  PDFTileCache::Entry * entry = cache._entries.value({_id, tile}, nullptr);
+  if (entry && entry->status == PLACEHOLDER)
+    entry->status = OUTDATED;
+}
+
+void PDFPageCache::setVisibleRects(const QMap<int, QRectF> & rects)
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QWriteLocker l(&cache._lock);
+  if (rects.isEmpty())
+    cache._visibleRects.remove(_id);
+  else
+    cache._visibleRects.insert(_id, rects);
+  cache._nothingToCompress = false;
+}
+
+QList<PDFPageTile> PDFPageCache::tiles() const
+{
+  PDFTileCache & cache = PDFTileCache::instance();
+  QReadLocker l(&cache._lock);
+  QList<PDFPageTile> retVal;
+  foreach(const PDFTileCache::Key & key, cache._entries.keys()) {
+    if (key.cacheId == _id)
+      retVal << key.tile;
+  }
+  return retVal;
+}
+
+// Cold tiles are compressed once the cache is filled beyond 3/4 of its budget
+static qint64 compressionThreshold(const qint64 maxSize)
+{
+  return maxSize / 4 * 3;
+}
+
+//static
+PDFTileCache & PDFTileCache::instance()
+{
+  static PDFTileCache cache;
+  return cache;
+}
+
+PDFTileCache::~PDFTileCache()
+{
+  _compressionJob.waitForFinished();
+  qDeleteAll(_entries);
+}
+
+qint64 PDFTileCache::maxSize() const
+{
+  QReadLocker l(&_lock);
+  return _maxSize;
+}
+
+void PDFTileCache::setMaxSize(const qint64 maxSize)
 {
   QWriteLocker l(&_lock);
-  QMap<PDFPageTile, TileStatus>::iterator it;
-  for (it = _tileStatus.begin(); it != _tileStatus.end(); ++it)
-    it.value() = OUTDATED;
+  _maxSize = qMax(Q_INT64_C(0), maxSize);
+  evict(_maxSize);
+}
+
+bool PDFTileCache::isCompressionEnabled() const
+{
+  QReadLocker l(&_lock);
+  return _compressionEnabled;
 }
 
+void PDFTileCache::setCompressionEnabled(const bool enabled)
+{
+  QWriteLocker l(&_lock);
+  _compressionEnabled = enabled;
+}
+
+void PDFTileCache::waitForCompression() const
+{
+  QFuture<void> job;
+  {
+    QReadLocker l(&_lock);
+    job = _compressionJob;
+  }
+  job.waitForFinished();
+}
+
+PDFTileCache::Statistics PDFTileCache::statistics() const
+{
+  QReadLocker l(&_lock);
+  Statistics retVal = _statistics;
+  retVal.maxSize = _maxSize;
+  retVal.numTiles = _entries.size();
+  return retVal;
+}
+
+void PDFTileCache::resetStatistics()
+{
+  QWriteLocker l(&_lock);
+  _statistics.hits = 0;
+  _statistics.misses = 0;
+  _statistics.insertions = 0;
+  _statistics.evictions = 0;
+  _statistics.compressions = 0;
+  _statistics.decompressions = 0;
+}
+
+void PDFTileCache::handleMemoryPressure(const MemoryPressure level)
+{
+  QWriteLocker l(&_lock);
+#ifdef DEBUG
+  qDebug() << "memory pressure" << level << "- tile cache size:" << _statistics.size;
+#endif
+  switch (level) {
+    case MemoryPressure_Moderate:
+      evict(_maxSize / 2);
+      break;
+    case MemoryPressure_Critical:
+      evict(0, nullptr, false);
+      break;
+  }
+}
+
+void PDFTileCache::touch(Entry * entry)
+{
+  if (!entry || entry == _first)
+    return;
+  unlink(entry);
+  entry->next = _first;
+  if (_first)
+    _first->prev = entry;
+  _first = entry;
+  if (!_last)
+    _last = entry;
+}
+
+void PDFTileCache::unlink(Entry * entry)
+{
+  if (entry->prev)
+    entry->prev->next = entry->next;
+  if (entry->next)
+    entry->next->prev = entry->prev;
+  if (_first == entry)
+    _first = entry->next;
+  if (_last == entry)
+    _last = entry->prev;
+  entry->prev = entry->next = nullptr;
+}
+
+void PDFTileCache::remove(Entry * entry)
+{
+  unlink(entry);
+  _entries.remove(entry->key);
+  _statistics.size -= entry->cost;
+  delete entry;
+}
+
+bool PDFTileCache::isVisible(const Entry * entry) const
+{
+  QHash<int, QMap<int, QRectF> >::const_iterator rects = _visibleRects.constFind(entry->key.cacheId);
+  if (rects == _visibleRects.constEnd())
+    return false;
+  QMap<int, QRectF>::const_iterator rect = rects->constFind(entry->key.tile.page_num);
+  if (rect == rects->constEnd())
+    return false;
+  const PDFPageTile & tile = entry->key.tile;
+  if (tile.render_box.isNull() || tile.xres <= 0 || tile.yres <= 0)
+    return true;
+  QRectF tileRect(tile.render_box.x() * 72. / tile.xres, tile.render_box.y() * 72. / tile.yres, tile.render_box.width() * 72. / tile.xres, tile.render_box.height() * 72. / tile.yres);
+  return tileRect.intersects(rect.value());
+}
+
+void PDFTileCache::decompress(Entry * entry)
+{
+  Q_ASSERT(entry);
+  if (entry->image || entry->compressed.isNull())
+    return;
+
+  PDFTileImage img(new QImage(entry->compressed.toImage()));
+  entry->compressed = PDFCompressedTileImage();
+  if (img->isNull()) {
+    _statistics.size -= entry->cost;
+    entry->cost = 0;
+    return;
+  }
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+  const qint64 cost = img->byteCount();
+#else
+  const qint64 cost = img->sizeInBytes();
+#endif
+  entry->image = img;
+  _statistics.size += cost - entry->cost;
+  entry->cost = cost;
+  ++_statistics.decompressions;
+}
+
+void PDFTileCache::evict(const qint64 maxSize, const Entry * keep /* = nullptr */, const bool evictVisible /* = true */)
+{
+  // First pass: evict invisible tiles, starting with the least recently used
+  // Second pass (if necessary): evict visible tiles, too
+  for (int pass = 0; pass < (evictVisible ? 2 : 1) && _statistics.size > maxSize; ++pass) {
+    Entry * entry = _last;
+    while (entry && _statistics.size > maxSize) {
+      Entry * prev = entry->prev;
+      // Evicting entries without an image wouldn't free any memory
+      if (entry != keep && entry->cost > 0 && (pass > 0 || !isVisible(entry))) {
+        remove(entry);
+        ++_statistics.evictions;
+      }
+      entry = prev;
+    }
+  }
+
+  // Compress cold tiles in the background before the cache runs full (so they
+  // need not be evicted later). If everything has to go anyway (e.g., when
+  // clearing the cache), don't bother.
+  if (_compressionEnabled && maxSize > 0 && !_nothingToCompress && _statistics.size > compressionThreshold(_maxSize) && !_compressionJob.isRunning())
+    _compressionJob = QtConcurrent::run([this]() { compressColdTiles(); });
+}
+
+void PDFTileCache::compressColdTiles()
+{
+  struct Candidate {
+    Key key;
+    PDFTileImage image;
+  };
+  QVector<Candidate> candidates;
+
+  // Collect the least recently used tiles that are worth compressing.
+  // Placeholders are not compressed as they are about to be overwritten (in
+  // place) by the finished rendering.
+  {
+    QWriteLocker l(&_lock);
+    if (!_compressionEnabled)
+      return;
+    const qint64 excess = _statistics.size - compressionThreshold(_maxSize);
+    qint64 collected{0};
+    for (Entry * entry = _last; entry && collected < 2 * excess; entry = entry->prev) {
+      if (!entry->image || entry->incompressible || entry->status == PDFPageCache::PLACEHOLDER || isVisible(entry))
+        continue;
+      candidates.append({entry->key, entry->image});
+      collected += entry->cost;
+    }
+    if (excess > 0 && candidates.isEmpty())
+      _nothingToCompress = true;
+  }
+
+  foreach(const Candidate & candidate, candidates) {
+    PDFCompressedTileImage compressed = PDFCompressedTileImage::fromImage(*(candidate.image));
+    QWriteLocker l(&_lock);
+    Entry * entry = _entries.value(candidate.key, nullptr);
+    // Skip tiles that were removed, replaced, or decompressed again meanwhile
+    if (!entry || entry->image != candidate.image)
+      continue;
+    // Only keep the compressed image if it pays off
+    if (compressed.isNull() || compressed.byteSize() > entry->cost / 2) {
+      entry->incompressible = true;
+      continue;
+    }
+    if (entry->status == PDFPageCache::PLACEHOLDER || isVisible(entry))
+      continue;
+    entry->compressed = compressed;
+    entry->image.clear();
+    _statistics.size += compressed.byteSize() - entry->cost;
+    entry->cost = compressed.byteSize();
+    ++_statistics.compressions;
+  }
+}
+
+// PageText Class
+// --------------
+
+void PageText::addWord(const QString & word, const QRectF & boundingBox, const QVector<QRectF> & charBoxes, const bool hasSpaceAfter)
+{
+  if (word.isEmpty())
+    return;
+  if (_spaceAfterLastWord) {
+    _text += QLatin1Char(' ');
+    _normalizedText += QLatin1Char(' ');
+    _charExtents.append(qMakePair(qreal(0), qreal(0)));
+  }
+
+  Word w;
+  w.boundingBox = boundingBox;
+  w.start = _text.length();
+  w.length = word.length();
+  _words.append(w);
+  _text += word;
+  _normalizedText += normalized(word);
+  for (int i = 0; i < word.length(); ++i) {
+    const QRectF r = (i < charBoxes.size() ? charBoxes[i].normalized() : boundingBox);
+    _charExtents.append(qMakePair(r.left(), r.right()));
+  }
+  _spaceAfterLastWord = hasSpaceAfter;
+}
+
+QList<SearchResult> PageText::search(const QString & searchText, const SearchFlags & flags, const unsigned int pageNum) const
+{
+  QList<SearchResult> results;
+  // Words are separated by at most one space in _text
+  QString needle = searchText.simplified();
+  if (needle.isEmpty() || _text.isEmpty())
+    return results;
+
+  const QString & haystack = (flags.testFlag(Search_CaseInsensitive) ? _normalizedText : _text);
+  if (flags.testFlag(Search_CaseInsensitive))
+    needle = normalized(needle);
+
+  SearchResult result;
+  result.pageNum = pageNum;
+  for (int pos = haystack.indexOf(needle); pos >= 0; pos = haystack.indexOf(needle, pos + needle.length())) {
+    result.bbox = boundingBox(pos, needle.length());
+    results << result;
+  }
+  if (flags.testFlag(Search_Backwards))
+    std::reverse(results.begin(), results.end());
+  return results;
+}
+
+//static
+QString PageText::normalized(const QString & str)
+{
+  QString retVal(str);
+  for (int i = 0; i < retVal.length(); ++i)
+    retVal[i] = retVal[i].toCaseFolded();
+  return retVal;
+}
+
+QRectF PageText::boundingBox(const int start, const int length) const
+{
+  QRectF retVal;
+  const int end = start + length;
+  // The first word that ends after `start`
+  QVector<Word>::const_iterator it = std::upper_bound(_words.begin(), _words.end(), start, [](const int pos, const Word & w) {
+    return pos < w.start + w.length;
+  });
+  for (; it != _words.end() && it->start < end; ++it) {
+    const int first = qMax(start, it->start);
+    const int last = qMin(end, it->start + it->length) - 1;
+    QRectF r(it->boundingBox);
+    // Only cut the word box if the word is matched partially
+    if (first > it->start || last < it->start + it->length - 1) {
+      r.setLeft(qMin(_charExtents[first].first, _charExtents[last].first));
+      r.setRight(qMax(_charExtents[first].second, _charExtents[last].second));
+    }
+    retVal = retVal.united(r);
+  }
+  return retVal;
+}
 
 // PDF ABCs
 // ========
@@ -392,12 +1200,9 @@ Document::Document(QString fileName):
 //  qDebug() << "Document::Document(" << fileName << ")";
 #endif
 
-  // Set cache for rendered pages to be 1GB. This is enough for 256 RGBA tiles
-  // (1024 x 1024 pixels x 4 bytes per pixel).
-  //
-  // NOTE: The application seems to exceed 1 GB---usage plateaus at around 2GB. No idea why. Perhaps freed
-  // blocks are not garbage collected?? Perhaps my math is off??
-  _pageCache.setMaxSize(1024 * 1024 * 1024);
+  // Note: Rendered pages are stored in the process-wide PDFTileCache, which
+  // is limited to 1GB by default (enough for 256 RGBA tiles of 1024 x 1024
+  // pixels x 4 bytes per pixel) for all documents combined.
 }
 
 Document::~Document()
@@ -409,7 +1214,7 @@ Document::~Document()
 }
 
 int Document::numPages() { QReadLocker docLocker(_docLock.data()); return _numPages; }
-PDFPageProcessingThread &Document::processingThread() { QReadLocker docLocker(_docLock.data()); return _processingThread; }
+PDFPageProcessingThreadPool &Document::processingThreadPool() { QReadLocker docLocker(_docLock.data()); return _processingThreadPool; }
 PDFPageCache &Document::pageCache() { QReadLocker docLocker(_docLock.data()); return _pageCache; }
 
 QWeakPointer<Page> Document::page(int at)
@@ -429,36 +1234,169 @@ QList<SearchResult> Document::search(const QString & searchText, const SearchFla
   int end = (flags.testFlag(Search_Backwards) ? -1 : _numPages);
   int step = (flags.testFlag(Search_Backwards) ? -1 : +1);
 
-  for (int i = start; i != end; i += step) {
+  // Search the text index if possible and fall back to the backend otherwise
+  auto searchPage = [this, &searchText, &flags](const int i) -> QList<SearchResult> {
+    QSharedPointer<const PageText> text = pageText(i);
+    if (text)
+      return text->search(searchText, flags, static_cast<unsigned int>(i));
     QSharedPointer<Page> page(_pages[i]);
     if (!page)
-      continue;
-    results << page->search(searchText, flags);
-  }
+      return QList<SearchResult>();
+    return page->search(searchText, flags);
+  };
+
+  for (int i = start; i != end; i += step)
+    results << searchPage(i);
 
   if (flags.testFlag(Search_WrapAround)) {
     start = ((flags & Search_Backwards) ? _numPages - 1 : 0);
     end = startPage;
-    for (int i = start; i != end; i += step) {
-      QSharedPointer<Page> page(_pages[i]);
-      if (!page)
-        continue;
-      results << page->search(searchText, flags);
-    }
+    for (int i = start; i != end; i += step)
+      results << searchPage(i);
   }
 
   return results;
 }
 
+Document::ReloadStatistics Document::reloadStatistics() const
+{
+  QMutexLocker reloadLocker(&_reloadMutex);
+  return _reloadStatistics;
+}
+
+void Document::resetReloadStatistics()
+{
+  QMutexLocker reloadLocker(&_reloadMutex);
+  _reloadStatistics = ReloadStatistics();
+}
+
+void Document::rememberFingerprints()
+{
+  QMutexLocker reloadLocker(&_reloadMutex);
+  QMutexLocker textIndexLocker(&_textIndexMutex);
+  // Pages that were not checked since the last reload are forgotten; their
+  // tiles were rendered for an older revision and can't be restored anymore
+  // (see PDFPageCache::restorePage())
+  _previousFingerprints.clear();
+  _previousTextIndex.clear();
+  for (int i = 0; i < _pages.size(); ++i) {
+    if (_pages[i].isNull())
+      continue;
+    const QByteArray fingerprint = _pages[i]->fingerprint(false);
+    if (fingerprint.isEmpty())
+      continue;
+    _previousFingerprints.insert(i, fingerprint);
+    // The text can only be reused if we can tell whether the page changed
+    if (i < _textIndex.size() && _textIndex[i])
+      _previousTextIndex.insert(i, _textIndex[i]);
+  }
+  _textIndex.clear();
+  ++_reloadStatistics.reloads;
+}
+
+QByteArray Document::contentHash() const
+{
+  QReadLocker docLocker(_docLock.data());
+  QMutexLocker contentHashLocker(&_contentHashMutex);
+  if (!_contentHashKnown) {
+    _contentHash = computeContentHash();
+    _contentHashKnown = true;
+  }
+  return _contentHash;
+}
+
+void Document::resetContentHash()
+{
+  QMutexLocker contentHashLocker(&_contentHashMutex);
+  _contentHash.clear();
+  _contentHashKnown = false;
+}
+
+QByteArray Document::takePreviousFingerprint(const int page)
+{
+  QMutexLocker reloadLocker(&_reloadMutex);
+  return _previousFingerprints.take(page);
+}
+
+void Document::restorePageText(const int page)
+{
+  QMutexLocker textIndexLocker(&_textIndexMutex);
+  QSharedPointer<const PageText> text = _previousTextIndex.take(page);
+  if (!text || page < 0 || page >= _pages.size())
+    return;
+  if (_textIndex.size() != _pages.size())
+    _textIndex.resize(_pages.size());
+  if (!_textIndex[page])
+    _textIndex[page] = text;
+}
+
+QSharedPointer<const PageText> Document::pageText(const int page)
+{
+  QReadLocker docLocker(_docLock.data());
+  if (page < 0 || page >= _pages.size())
+    return QSharedPointer<const PageText>();
+  {
+    QMutexLocker textIndexLocker(&_textIndexMutex);
+    if (page < _textIndex.size() && _textIndex[page])
+      return _textIndex[page];
+  }
+
+  QSharedPointer<Page> p(_pages[page]);
+  if (!p)
+    return QSharedPointer<const PageText>();
+  // Don't hold _textIndexMutex while extracting so several pages can be
+  // processed in parallel
+  QSharedPointer<const PageText> text = p->extractText();
+  if (!text)
+    return text;
+
+  QMutexLocker textIndexLocker(&_textIndexMutex);
+  if (_textIndex.size() != _pages.size())
+    _textIndex.resize(_pages.size());
+  // Another thread may have been faster
+  if (!_textIndex[page])
+    _textIndex[page] = text;
+  return _textIndex[page];
+}
+
+void Document::buildTextIndex()
+{
+  QReadLocker docLocker(_docLock.data());
+  QVector< QSharedPointer<const PageText> > index;
+  {
+    QMutexLocker textIndexLocker(&_textIndexMutex);
+    index = _textIndex;
+  }
+  // Requests of the same priority are processed last-in-first-out, so add them
+  // back to front to index the document from the beginning
+  for (int i = _pages.size() - 1; i >= 0; --i) {
+    if (_pages[i].isNull() || (i < index.size() && index[i]))
+      continue;
+    _processingThreadPool.addPageProcessingRequest(new PageProcessingExtractTextRequest(_pages[i].data()));
+  }
+}
+
+int Document::numIndexedPages() const
+{
+  QReadLocker docLocker(_docLock.data());
+  QMutexLocker textIndexLocker(&_textIndexMutex);
+  int retVal{0};
+  foreach(const QSharedPointer<const PageText> & text, _textIndex) {
+    if (text)
+      ++retVal;
+  }
+  return retVal;
+}
+
 void Document::clearPages()
 {
-  // Clear the processing thread to ensure no task still needs the pages we are
+  // Clear the processing threads to ensure no task still needs the pages we are
   // about to destroy.
   // NB: Do this before acquiring _docLock. See clearWorkStack() documentation.
   // This should not cause any problems as we are supposed to currently be in
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
-  _processingThread.clearWorkStack();
+  _processingThreadPool.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
   foreach(QSharedPointer<Page> page, _pages) {
@@ -469,6 +1407,9 @@ void Document::clearPages()
   // Note: clear() releases all QSharedPointer to pages, thereby destroying them
   // (if they are not used elsewhere)
   _pages.clear();
+
+  QMutexLocker textIndexLocker(&_textIndexMutex);
+  _textIndex.clear();
 }
 
 void Document::clearMetaData()
@@ -587,19 +1528,17 @@ QRectF Page::getContentBoundingBox() const
   return QRectF(x0 * pageSize.width() / 100., y0 * pageSize.height() / 100., (x1 - x0 + 1) * pageSize.width() / 100., (y1 - y0 + 1) * pageSize.height() / 100.);
 }
 
-QSharedPointer<QImage> Page::getCachedImage(double xres, double yres, QRect render_box /* = QRect() */, PDFPageCache::TileStatus * status /* = nullptr */)
+PDFTileImage Page::getCachedImage(double xres, double yres, QRect render_box /* = QRect() */, PDFPageCache::TileStatus * status /* = nullptr */)
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
   if (!_parent) {
     if (status)
       *status = PDFPageCache::UNKNOWN;
-    return QSharedPointer<QImage>();
+    return PDFTileImage();
   }
   PDFPageTile tile(xres, yres, render_box, _n);
-  if (status)
-    *status = _parent->pageCache().getStatus(tile);
-  return _parent->pageCache().getImage(tile);
+  return _parent->pageCache().getImage(tile, status);
 }
 
 void Page::asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box, bool cache)
@@ -608,7 +1547,140 @@ void Page::asyncRenderToImage(QObject *listener, double xres, double yres, QRect
   QReadLocker pageLocker(_pageLock);
   if (!_parent)
     return;
-  _parent->processingThread().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, render_box, cache));
+  _parent->processingThreadPool().addPageProcessingRequest(new PageProcessingRenderPageRequest(this, listener, xres, yres, render_box, cache));
+}
+
+void Page::asyncRenderLowRes()
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
+    return;
+  {
+    QMutexLocker previewLocker(&_previewMutex);
+    if (_lowResRequested)
+      return;
+    _lowResRequested = true;
+  }
+  // Note: The request itself checks what actually needs to be done
+  _parent->processingThreadPool().addPageProcessingRequest(new PageProcessingRenderLowResRequest(this));
+}
+
+void Page::asyncLoadPreview()
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent || !PDFPreviewCache::instance().isEnabled())
+    return;
+  {
+    QMutexLocker previewLocker(&_previewMutex);
+    if (_previewRequested || !_previewImage.isNull())
+      return;
+    _previewRequested = true;
+  }
+  _parent->processingThreadPool().addPageProcessingRequest(new PageProcessingLoadPreviewRequest(this));
+}
+
+QImage Page::renderLowRes() const
+{
+  const QSizeF size = pageSizeF();
+  if (size.isEmpty())
+    return QImage();
+  const double res = PDFPreviewCache::PreviewSize * 72. / qMax(size.width(), size.height());
+  return renderToImage(res, res);
+}
+
+QByteArray Page::fingerprint(const bool compute /* = true */)
+{
+  {
+    QMutexLocker fingerprintLocker(&_fingerprintMutex);
+    if (!_fingerprint.isEmpty() || !compute)
+      return _fingerprint;
+  }
+  return updateFingerprint(renderLowRes());
+}
+
+QByteArray Page::updateFingerprint(const QImage & lowRes)
+{
+  // Note: Don't hold _fingerprintMutex while extracting the text; in the
+  // worst case, the fingerprint is computed twice. The text ends up in the text
+  // index, so it is not extracted again for searching.
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
+    return QByteArray();
+  QSharedPointer<const PageText> text = _parent->pageText(_n);
+  if (!text)
+    return QByteArray();
+  const QByteArray fingerprint = fingerprintOf(pageSizeF(), *text, lowRes);
+  QMutexLocker fingerprintLocker(&_fingerprintMutex);
+  if (_fingerprint.isEmpty())
+    _fingerprint = fingerprint;
+  return _fingerprint;
+}
+
+//static
+QByteArray Page::fingerprintOf(const QSizeF & pageSize, const PageText & text, const QImage & lowRes)
+{
+  if (lowRes.isNull())
+    return QByteArray();
+  // The text and its geometry catch small edits that may not even be visible
+  // at low resolution
+  QCryptographicHash textHash(QCryptographicHash::Sha1);
+  const double header[] = {pageSize.width(), pageSize.height()};
+  textHash.addData(reinterpret_cast<const char *>(header), sizeof(header));
+  textHash.addData(reinterpret_cast<const char *>(text.text().constData()), text.text().size() * static_cast<int>(sizeof(QChar)));
+  // Any change in the layout (e.g., a different font or spacing) moves some
+  // characters, even if the text stays the same
+  for (int i = 0; i < text.text().size(); ++i) {
+    const QRectF r = text.charBox(i);
+    const double box[] = {r.x(), r.y(), r.width(), r.height()};
+    textHash.addData(reinterpret_cast<const char *>(box), sizeof(box));
+  }
+
+  // The rendering catches changes in the graphics (e.g., colors or figures)
+  // that leave the text alone
+  QCryptographicHash graphicsHash(QCryptographicHash::Sha1);
+  const int imageHeader[] = {lowRes.width(), lowRes.height(), static_cast<int>(lowRes.format())};
+  graphicsHash.addData(reinterpret_cast<const char *>(imageHeader), sizeof(imageHeader));
+  // Note: Only hash the actual pixels of each scan line, not the padding
+  const int bytesPerLine = (lowRes.width() * lowRes.depth() + 7) / 8;
+  for (int y = 0; y < lowRes.height(); ++y)
+    graphicsHash.addData(reinterpret_cast<const char *>(lowRes.constScanLine(y)), bytesPerLine);
+
+  // Fingerprints only compare equal if both parts match
+  return textHash.result() + graphicsHash.result();
+}
+
+bool Page::reuseUnchangedTiles()
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
+    return false;
+  const QByteArray previous = _parent->takePreviousFingerprint(_n);
+  if (previous.isEmpty())
+    return false;
+
+  const bool unchanged = (fingerprint() == previous);
+  const int numTiles = (unchanged ? _parent->pageCache().restorePage(_n) : 0);
+  if (unchanged)
+    _parent->restorePageText(_n);
+
+  QMutexLocker reloadLocker(&_parent->_reloadMutex);
+  if (unchanged) {
+    ++_parent->_reloadStatistics.pagesReused;
+    _parent->_reloadStatistics.tilesReused += static_cast<quint64>(numTiles);
+  }
+  else
+    ++_parent->_reloadStatistics.pagesChanged;
+  return unchanged;
+}
+
+QImage Page::previewImage()
+{
+  QMutexLocker previewLocker(&_previewMutex);
+  return _previewImage;
 }
 
 bool higherResolutionThan(const PDFPageTile & t1, const PDFPageTile & t2)
@@ -617,7 +1689,7 @@ bool higherResolutionThan(const PDFPageTile & t1, const PDFPageTile & t2)
   return t1.xres > t2.xres;
 }
 
-QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */)
+PDFTileImage Page::getTileImage(QObject * listener, const double xres, const double yres, QRect render_box /* = QRect() */, const PDFColorTransform::Mode colorMode /* = PDFColorTransform::Mode_None */)
 {
   QReadLocker docLocker(_docLock.data());
   QReadLocker pageLocker(_pageLock);
@@ -626,12 +1698,31 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
   if (render_box.isNull())
     render_box = QRectF(0, 0, pageSizeF().width() * xres / 72., pageSizeF().height() * yres / 72.).toAlignedRect();
 
+  if (colorMode != PDFColorTransform::Mode_None && _parent) {
+    // Transformed tiles are cached as variants of the actual tiles
+    const PDFPageTile variant(xres, yres, render_box, _n, colorMode);
+    PDFPageCache::TileStatus status{PDFPageCache::UNKNOWN};
+    PDFTileImage retVal = _parent->pageCache().getImage(variant, &status);
+    if (retVal && status == PDFPageCache::CURRENT)
+      return retVal;
+
+    PDFTileImage source = getTileImage(listener, xres, yres, render_box);
+    if (!source)
+      return source;
+    retVal = PDFTileImage(new QImage(PDFColorTransform::transformed(*source, colorMode)));
+    // Placeholders are about to be replaced, so only cache the transformed
+    // image if `source` is the finished rendering
+    if (_parent->pageCache().getImage(PDFPageTile(xres, yres, render_box, _n), &status) == source && status == PDFPageCache::CURRENT)
+      _parent->pageCache().setImage(variant, retVal, PDFPageCache::CURRENT);
+    return retVal;
+  }
+
   // If the tile is cached, return it if
   // 1) it is current
   // 2) it is a placeholder (in this case, it is currently rendering in the
   // background and we don't need to do anything)
   PDFPageCache::TileStatus status{PDFPageCache::UNKNOWN};
-  QSharedPointer<QImage> retVal = getCachedImage(xres, yres, render_box, &status);
+  PDFTileImage retVal = getCachedImage(xres, yres, render_box, &status);
   if (retVal && (status == PDFPageCache::CURRENT || status == PDFPageCache::PLACEHOLDER))
     return retVal;
 
@@ -642,10 +1733,15 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
     // to take advantage of multi-core CPUs. Since we hold the write lock here
     // there's nothing to worry about
     asyncRenderToImage(listener, xres, yres, render_box, true);
+    // Previews are only available for later placeholders (loading them must
+    // not hold up painting)
+    asyncLoadPreview();
+    // Make sure we know the fingerprint and preview of pages that were shown
+    asyncRenderLowRes();
 
     if (retVal && status == PDFPageCache::OUTDATED) {
       // If we have an outdated image, use that as a placeholder
-      _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _n), retVal.data(), PDFPageCache::PLACEHOLDER, false);
+      _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _n), retVal, PDFPageCache::PLACEHOLDER, false);
     }
     else {
       // otherwise construct a dummy image
@@ -660,7 +1756,7 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
       if (_parent) {
         QList<PDFPageTile> tiles = _parent->pageCache().tiles();
         for (QList<PDFPageTile>::iterator it = tiles.begin(); it != tiles.end(); ) {
-          if (it->page_num != pageNum()) {
+          if (it->page_num != pageNum() || it->variant != PDFColorTransform::Mode_None) {
             it = tiles.erase(it);
             continue;
           }
@@ -679,7 +1775,7 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
         QPainterPath clipPath;
         clipPath.addRect(0, 0, render_box.width(), render_box.height());
         foreach (PDFPageTile tile, tiles) {
-          QSharedPointer<QImage> tileImg = _parent->pageCache().getImage(tile);
+          PDFTileImage tileImg = _parent->pageCache().getImage(tile);
           if (!tileImg)
             continue;
 
@@ -702,17 +1798,30 @@ QSharedPointer<QImage> Page::getTileImage(QObject * listener, const double xres,
           if (clipPath.isEmpty())
             break;
         }
+
+        // Fill whatever is left with the (scaled) preview of the whole page,
+        // if there is one
+        if (!clipPath.isEmpty()) {
+          const QImage preview = previewImage();
+          const QSizeF pageSize = QSizeF(pageSizeF().width() * xres / 72., pageSizeF().height() * yres / 72.);
+          if (!preview.isNull() && !pageSize.isEmpty()) {
+            const qreal sx = preview.width() / pageSize.width();
+            const qreal sy = preview.height() / pageSize.height();
+            p.setClipPath(clipPath);
+            p.setRenderHint(QPainter::SmoothPixmapTransform);
+            p.drawImage(QRectF(0, 0, render_box.width(), render_box.height()), preview, QRectF(render_box.x() * sx, render_box.y() * sy, render_box.width() * sx, render_box.height() * sy));
+          }
+        }
       }
-      // stop painting or else we couldn't (possibly) delete tmpImg below
+      // stop painting before handing tmpImg to the cache (which makes it
+      // immutable)
       p.end();
 
       // Add the dummy tile to the cache
       // Note: In the meantime the asynchronous rendering could have finished and
-      // insert the final image in the cache---we must handle that case and delete
-      // our temporary image
-      retVal = _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _n), tmpImg, PDFPageCache::PLACEHOLDER, false);
-      if (retVal != tmpImg)
-        delete tmpImg;
+      // insert the final image in the cache---in that case, setImage() returns
+      // the final image (and our temporary image is released)
+      retVal = _parent->pageCache().setImage(PDFPageTile(xres, yres, render_box, _n), PDFTileImage(tmpImg), PDFPageCache::PLACEHOLDER, false);
     }
     return retVal;
   }
@@ -726,7 +1835,7 @@ void Page::asyncLoadLinks(QObject *listener)
   QReadLocker pageLocker(_pageLock);
   if (!_parent)
     return;
-  _parent->processingThread().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener));
+  _parent->processingThreadPool().addPageProcessingRequest(new PageProcessingLoadLinksRequest(this, listener));
 }
 
 //static
@@ -735,6 +1844,9 @@ QList<SearchResult> Page::executeSearch(SearchRequest request)
   QSharedPointer<Document> doc(request.doc.toStrongRef());
   if (!doc)
     return QList<SearchResult>();
+  QSharedPointer<const PageText> text = doc->pageText(request.pageNum);
+  if (text)
+    return text->search(request.searchString, request.flags, static_cast<unsigned int>(request.pageNum));
   QSharedPointer<Page> page = doc->page(request.pageNum).toStrongRef();
   if (!page)
     return QList<SearchResult>();
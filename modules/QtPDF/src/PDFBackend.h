@@ -15,14 +15,18 @@
 #define PDFBackend_H
 
 #include "PDFAnnotations.h"
+#include "PDFColorTransform.h"
 #include "PDFFontDescriptor.h"
 #include "PDFPageTile.h"
+#include "PDFPreviewCache.h"
 #include "PDFToC.h"
 #include "PDFTransitions.h"
 
-#include <QCache>
+#include <QAtomicInt>
 #include <QEvent>
 #include <QFileInfo>
+#include <QFuture>
+#include <QHash>
 #include <QImage>
 #include <QMap>
 #include <QMutex>
@@ -31,6 +35,7 @@
 #include <QSharedPointer>
 #include <QStack>
 #include <QThread>
+#include <QVector>
 #include <QWaitCondition>
 #include <QWeakPointer>
 #include <QWriteLocker>
@@ -101,42 +106,206 @@ protected:
   FontProgramType _fontProgramType{ProgramType_None};
 };
 
+// Compact representation of a rendered tile for the cold tier of the
+// PDFTileCache. Images with at most 256 distinct colors (e.g., black text on
+// white background, including anti-aliasing) are stored as 8 bit palette
+// images. In either case, the pixel data is compressed with zlib (i.e., LZ77)
+// at the fastest level.
+class PDFCompressedTileImage
+{
+public:
+  PDFCompressedTileImage() = default;
+
+  // Only 32 bit images are supported; for other images, a null object is
+  // returned
+  static PDFCompressedTileImage fromImage(const QImage & image);
+  QImage toImage() const;
+
+  bool isNull() const { return _data.isEmpty(); }
+  // The memory occupied by the compressed image in bytes
+  qint64 byteSize() const;
+  // Returns true if both objects share the same (compressed) data, i.e., one
+  // is a copy of the other
+  bool isSharedWith(const PDFCompressedTileImage & other) const { return !isNull() && _data.constData() == other._data.constData(); }
+
+private:
+  QByteArray _data;
+  QVector<QRgb> _colorTable;
+  QSize _size;
+  // Format of the original image
+  QImage::Format _format{QImage::Format_Invalid};
+  qreal _devicePixelRatio{1};
+};
+
+// Rendered tiles are immutable once they were created. They are shared by
+// reference between the cache, the PDFPageRenderedEvent announcing them and
+// whoever paints them, so handing a tile from a render thread to the screen
+// never copies the pixel data. A QImage alone is not enough for that as any
+// non-const access (even setDevicePixelRatio()) detaches it. To change a tile,
+// a new image is stored in the cache instead.
+typedef QSharedPointer<const QImage> PDFTileImage;
+
+// Per-document interface to the process-wide PDFTileCache. All tiles of one
+// PDFPageCache are removed from the shared cache when it is destroyed.
 // This class is thread-safe
-class PDFPageCache : protected QCache<PDFPageTile, QSharedPointer<QImage> >
+class PDFPageCache
 {
-  typedef QCache<PDFPageTile, QSharedPointer<QImage> > Super;
 public:
   enum TileStatus { UNKNOWN, PLACEHOLDER, CURRENT, OUTDATED };
 
-  PDFPageCache() = default;
-  virtual ~PDFPageCache() = default;
-
-  // Note: Each image has a cost of 1
-  int maxSize() const { return maxCost(); }
-  void setMaxSize(const int num) { setMaxCost(num); }
+  PDFPageCache();
+  virtual ~PDFPageCache();
 
-  // Returns the image under the key `tile` or nullptr if it doesn't exist
-  QSharedPointer<QImage> getImage(const PDFPageTile & tile) const;
+  // Returns the image under the key `tile` or nullptr if it doesn't exist. If
+  // `status` is given, it receives the status of the image (obtained together
+  // with the image, so both are consistent).
+  PDFTileImage getImage(const PDFPageTile & tile, TileStatus * status = nullptr) const;
   TileStatus getStatus(const PDFPageTile & tile) const;
-  // Returns the pointer to the image in the cache under they key `tile` after
-  // the insertion. If overwrite == true, this will always be image, otherwise
-  // it can be different
-  QSharedPointer<QImage> setImage(const PDFPageTile & tile, QImage * image, const TileStatus status, const bool overwrite = true);
+  // Returns the image in the cache under they key `tile` after the insertion.
+  // If overwrite == true, this will always be image, otherwise it can be
+  // different. Images are never modified in place, so images obtained earlier
+  // stay valid (but may be outdated).
+  PDFTileImage setImage(const PDFPageTile & tile, const PDFTileImage & image, const TileStatus status, const bool overwrite = true);
+
+  void clear();
+  // Mark all tiles outdated (e.g., because the document was reloaded)
+  void markOutdated();
+  // Mark the outdated tiles of `page` that were rendered before the last call
+  // to markOutdated() as current again (e.g., because the page did not change
+  // when the document was reloaded). Returns the number of restored tiles.
+  int restorePage(const int page);
+  // Mark `tile` outdated if it is a placeholder (e.g., because the request to
+  // render it was dropped) so it gets rendered again when it is needed
+  void discardPlaceholder(const PDFPageTile & tile);
 
+  // Tiles intersecting these rects (in pt with the origin at the top left
+  // corner of the page, keyed by page index) are evicted last
+  void setVisibleRects(const QMap<int, QRectF> & rects);
 
-  void lock() const { _lock.lockForRead(); }
-  void unlock() const { _lock.unlock(); }
+  QList<PDFPageTile> tiles() const;
 
-  void clear() { QWriteLocker l(&_lock); Super::clear(); _tileStatus.clear(); }
-  // Mark all tiles outdated
-  void markOutdated();
+private:
+  Q_DISABLE_COPY(PDFPageCache)
+
+  // Identifies the tiles of this cache in the PDFTileCache
+  const int _id;
+  static QAtomicInt _nextId;
+  // Incremented by markOutdated(); guarded by the PDFTileCache lock
+  int _revision{0};
+};
+
+// Process-wide cache for the rendered tiles of all documents. Once the total
+// size of all images exceeds 3/4 of maxSize(), the least recently used tiles
+// that are not visible (across all documents) are compressed (see
+// PDFCompressedTileImage) in the background; the compressed images are only
+// swapped in under the lock. Once the size exceeds maxSize(), the least
+// recently used tiles are evicted, sparing tiles that are currently visible as
+// long as possible. Compressed tiles are decompressed transparently (outside
+// the lock) when they are requested.
+// This class is thread-safe
+class PDFTileCache
+{
+  friend class PDFPageCache;
+public:
+  enum MemoryPressure { MemoryPressure_Moderate, MemoryPressure_Critical };
+
+  struct Statistics {
+    quint64 hits{0};
+    quint64 misses{0};
+    quint64 insertions{0};
+    quint64 evictions{0};
+    quint64 compressions{0};
+    quint64 decompressions{0};
+    // total size of all images in bytes
+    qint64 size{0};
+    qint64 maxSize{0};
+    int numTiles{0};
+  };
+
+  static PDFTileCache & instance();
+
+  // in bytes
+  qint64 maxSize() const;
+  void setMaxSize(const qint64 maxSize);
+
+  // Whether cold tiles are compressed before they are evicted
+  bool isCompressionEnabled() const;
+  void setCompressionEnabled(const bool enabled);
+  // Blocks until the background compression pass (if any) has finished
+  void waitForCompression() const;
+
+  Statistics statistics() const;
+  void resetStatistics();
+
+  // Frees memory in response to a low-memory situation: at moderate pressure,
+  // the cache is shrunk to half its budget; at critical pressure, all tiles
+  // that are not visible are dropped.
+  // Note: The cache is not hooked up to any OS low-memory notification. It is
+  // only called with MemoryPressure_Critical when rendering a tile failed
+  // (most likely because an allocation failed), and by applications as they
+  // see fit (e.g., TeXworks uses MemoryPressure_Moderate when it is hidden or
+  // suspended, which Qt only reports on some platforms such as macOS).
+  void handleMemoryPressure(const MemoryPressure level);
+
+private:
+  PDFTileCache() = default;
+  ~PDFTileCache();
+  Q_DISABLE_COPY(PDFTileCache)
+
+  struct Key {
+    int cacheId;
+    PDFPageTile tile;
+    bool operator==(const Key & other) const { return (cacheId == other.cacheId && tile == other.tile); }
+  };
+  friend uint qHash(const Key & key) noexcept { return qHash(key.tile) ^ static_cast<uint>(key.cacheId); }
+
+  // Entries form a doubly linked list in the order of their last use
+  struct Entry {
+    explicit Entry(const Key & key) : key(key) { }
+    Key key;
+    PDFTileImage image;
+    // If the tile was compressed, `image` is null
+    PDFCompressedTileImage compressed;
+    // Set if compressing the image didn't pay off
+    bool incompressible{false};
+    PDFPageCache::TileStatus status{PDFPageCache::UNKNOWN};
+    // Revision of the PDFPageCache the image was rendered for; -1 if the image
+    // is not an actual rendering (e.g., a dummy placeholder)
+    int revision{-1};
+    qint64 cost{0};
+    Entry * prev{nullptr};
+    Entry * next{nullptr};
+  };
+
+  // The caller must hold a write lock for the following methods
+  void touch(Entry * entry);
+  void unlink(Entry * entry);
+  void remove(Entry * entry);
+  bool isVisible(const Entry * entry) const;
+  // Moves the entry's image from the compressed to the uncompressed tier
+  void decompress(Entry * entry);
+  // Evicts entries (except `keep`) until the cache holds at most `maxSize`
+  // bytes. Visible entries are only evicted if that is not possible otherwise
+  // (and evictVisible is true). Starts a compression pass if the cache is
+  // filled beyond the compression threshold.
+  void evict(const qint64 maxSize, const Entry * keep = nullptr, const bool evictVisible = true);
+
+  // Runs on a worker thread; must be called without holding the lock
+  void compressColdTiles();
 
-  QList<PDFPageTile> tiles() const { return keys(); }
-protected:
   mutable QReadWriteLock _lock;
-  // Map to keep track of the current status of tiles; note that the status
-  // information is not deleted when the QCache scraps images to save memory.
-  QMap<PDFPageTile, TileStatus> _tileStatus;
+  QHash<Key, Entry*> _entries;
+  // most and least recently used entry
+  Entry * _first{nullptr};
+  Entry * _last{nullptr};
+  QHash<int, QMap<int, QRectF> > _visibleRects;
+  qint64 _maxSize{1024 * 1024 * 1024};
+  bool _compressionEnabled{true};
+  // Set if the last compression pass found nothing to compress; reset when
+  // tiles are added or the visible rects change
+  bool _nothingToCompress{false};
+  QFuture<void> _compressionJob;
+  Statistics _statistics;
 };
 
 class PageProcessingRequest : public QObject
@@ -147,19 +316,30 @@ class PageProcessingRequest : public QObject
   // Protect c'tor and execute() so we can't access them except in derived
   // classes and friends
 protected:
-  PageProcessingRequest(Page *page, QObject *listener) : page(page), listener(listener) { }
+  PageProcessingRequest(Page *page, QObject *listener);
   // Should perform whatever processing it is designed to do
   // Returns true if finished successfully, false otherwise
   virtual bool execute() = 0;
+  // Called (in the main thread) instead of execute() if the request is dropped
+  // by the scheduler; see isDiscardable()
+  virtual void discard() { }
 
 public:
-  enum Type { PageRendering, LoadLinks };
+  enum Type { PageRendering, LoadLinks, LowResRendering, PreviewLoading, TextExtraction };
 
   ~PageProcessingRequest() override = default;
   virtual Type type() const = 0;
+  // The part of the page this request is about in pt (with the origin at the
+  // top left corner of the page); a null rect means the whole page
+  virtual QRectF pageRect() const { return QRectF(); }
+  // Whether the request may be dropped if it is far away from the part of the
+  // document that is on screen (see PDFPageProcessingThreadPool::setViewport())
+  virtual bool isDiscardable() const { return false; }
 
   Page *page;
   QObject *listener;
+  // Cached so the scheduler can use it without acquiring the page lock
+  const int page_num;
 
   virtual bool operator==(const PageProcessingRequest & r) const;
 #ifdef DEBUG
@@ -180,6 +360,10 @@ public:
     cache(cache)
   {}
   Type type() const override { return PageRendering; }
+  QRectF pageRect() const override;
+  // Only renderings that end up in the cache can be dropped; they are simply
+  // requested again once the tile becomes visible
+  bool isDiscardable() const override { return cache; }
 
   bool operator==(const PageProcessingRequest & r) const override;
 #ifdef DEBUG
@@ -188,6 +372,7 @@ public:
 
 protected:
   bool execute() override;
+  void discard() override;
 
   double xres, yres;
   QRect render_box;
@@ -199,7 +384,7 @@ class PDFPageRenderedEvent : public QEvent
 {
 
 public:
-  PDFPageRenderedEvent(double xres, double yres, QRect render_rect, QImage rendered_page):
+  PDFPageRenderedEvent(double xres, double yres, QRect render_rect, PDFTileImage rendered_page):
     QEvent(PageRenderedEvent),
     xres(xres), yres(yres),
     render_rect(render_rect),
@@ -210,8 +395,72 @@ public:
 
   const double xres, yres;
   const QRect render_rect;
-  const QImage rendered_page;
+  // Shared with the page cache (if the tile was rendered for the cache)
+  const PDFTileImage rendered_page;
+
+};
+
+
+// Renders the whole page at low resolution and uses that to compute the
+// fingerprint of the page (see Page::fingerprint()) and the preview for the
+// PDFPreviewCache (if necessary).
+// No event is posted.
+class PageProcessingRenderLowResRequest : public PageProcessingRequest
+{
+  Q_OBJECT
+  friend class PDFPageProcessingThread;
+
+public:
+  PageProcessingRenderLowResRequest(Page *page) : PageProcessingRequest(page, nullptr) { }
+  Type type() const override { return LowResRendering; }
+
+#ifdef DEBUG
+  operator QString() const override;
+#endif
+
+protected:
+  bool execute() override;
+};
+
+
+// Loads the preview of the page from the PDFPreviewCache (computing the
+// document's content hash first if necessary). The preview is handed to the
+// page (see Page::previewImage()); no event is posted.
+class PageProcessingLoadPreviewRequest : public PageProcessingRequest
+{
+  Q_OBJECT
+  friend class PDFPageProcessingThread;
+
+public:
+  PageProcessingLoadPreviewRequest(Page *page) : PageProcessingRequest(page, nullptr) { }
+  Type type() const override { return PreviewLoading; }
+
+#ifdef DEBUG
+  operator QString() const override;
+#endif
+
+protected:
+  bool execute() override;
+};
+
+
+// Adds the text of a page to the text index of its document (see
+// Document::buildTextIndex()). No event is posted.
+class PageProcessingExtractTextRequest : public PageProcessingRequest
+{
+  Q_OBJECT
+  friend class PDFPageProcessingThread;
+
+public:
+  PageProcessingExtractTextRequest(Page *page) : PageProcessingRequest(page, nullptr) { }
+  Type type() const override { return TextExtraction; }
+
+#ifdef DEBUG
+  operator QString() const override;
+#endif
 
+protected:
+  bool execute() override;
 };
 
 
@@ -249,24 +498,83 @@ public:
 };
 
 
+class PDFPageProcessingThreadPool;
+
 // Class to perform (possibly) lengthy operations on pages in the background
 // Modelled after the "Blocking Fortune Client Example" in the Qt docs
 // (http://doc.qt.nokia.com/stable/network-blockingfortuneclient.html)
 
-// The `PDFPageProcessingThread` is a thread that processes background jobs.
-// Each job is represented by a subclass of `PageProcessingRequest` and
-// contains an `execute` method that performs the actual work.
+// The `PDFPageProcessingThread` is one worker thread of a
+// `PDFPageProcessingThreadPool`. It repeatedly takes the most recent job off
+// the pool's work stack and processes it. Each job is represented by a
+// subclass of `PageProcessingRequest` and contains an `execute` method that
+// performs the actual work.
 class PDFPageProcessingThread : public QThread
 {
   Q_OBJECT
+  friend class PDFPageProcessingThreadPool;
+
+protected:
+  explicit PDFPageProcessingThread(PDFPageProcessingThreadPool * pool) : _pool(pool) { }
+  void run() override;
+
+private:
+  PDFPageProcessingThreadPool * _pool;
+};
+
+// The `PDFPageProcessingThreadPool` manages the background jobs of one
+// document. Jobs are kept on a work stack (i.e., the most recent request is
+// processed first, unless a viewport is set; see setViewport()) and are
+// executed concurrently by up to maxThreadCount() worker threads. Threads are
+// only started when there is work for them and are kept alive (sleeping) until
+// the pool is destroyed.
+// Note: Backends must therefore be able to process requests for (different
+// pages of) the same document concurrently.
+class PDFPageProcessingThreadPool
+{
+  friend class PDFPageProcessingThread;
 
 public:
-  PDFPageProcessingThread() = default;
-  ~PDFPageProcessingThread() override;
+  PDFPageProcessingThreadPool() = default;
+  ~PDFPageProcessingThreadPool();
+
+  // The maximum number of requests processed simultaneously. A value <= 0
+  // means that defaultMaxThreadCount() is used.
+  int maxThreadCount() const;
+  void setMaxThreadCount(const int numThreads);
+
+  // The thread count used by all pools that don't have an explicit
+  // maxThreadCount. A value <= 0 (the default) means
+  // QThread::idealThreadCount(), i.e., typically the number of CPU cores.
+  static int defaultMaxThreadCount();
+  static void setDefaultMaxThreadCount(const int numThreads);
+
+  // Describes which parts of the document are on screen, and which parts are
+  // likely to be on screen soon. Rects are in pt (with the origin at the top
+  // left corner of the page) and keyed by page index.
+  struct Viewport {
+    QMap<int, QRectF> visible;
+    // the next screenful in the scroll direction
+    QMap<int, QRectF> ahead;
+    // the previous screenful (i.e., against the scroll direction)
+    QMap<int, QRectF> behind;
+
+    bool isNull() const { return visible.isEmpty(); }
+  };
+
+  // If a (non-null) viewport is set, requests are processed in the order
+  // visible > ahead > behind > anything else (and LIFO within each class).
+  // Discardable requests that fall into the last class are dropped whenever
+  // the viewport changes.
+  // Note: This must only be called from the main (GUI) thread.
+  Viewport viewport() const;
+  void setViewport(const Viewport & viewport);
 
   // add a processing request to the work stack
   // Note: request must have been created on the heap and must be in the scope
   // of this thread; use requestRenderPage() and requestLoadLinks() for that
+  // Identical requests (for the same listener) that are still waiting on the
+  // stack are superseded by the new request.
   void addPageProcessingRequest(PageProcessingRequest * request);
 
   // drop all remaining processing requests
@@ -278,16 +586,28 @@ public:
   // finish. However, that lock is held by the caller of clearWorkStack().
   void clearWorkStack();
 
-protected:
-  void run() override;
-
 private:
+  // Called by the worker threads. takeWorkItem() blocks until a request is
+  // available and returns nullptr if the thread should quit.
+  PageProcessingRequest * takeWorkItem();
+  void finishWorkItem();
+  // The caller must hold _mutex
+  int effectiveMaxThreadCount() const;
+
+  enum Priority { Priority_Visible, Priority_Ahead, Priority_Behind, Priority_OffScreen };
+  // The caller must hold _mutex
+  Priority priority(const PageProcessingRequest * request) const;
+
   QStack<PageProcessingRequest*> _workStack;
-  QMutex _mutex;
+  QVector<PDFPageProcessingThread*> _threads;
+  mutable QMutex _mutex;
   QWaitCondition _waitCondition;
-  bool _idle{true};
+  int _numActive{0};
   QWaitCondition _idleCondition;
+  int _maxThreadCount{0};
   bool _quit{false};
+  Viewport _viewport;
+  static QAtomicInt _defaultMaxThreadCount;
 #ifdef DEBUG
   static void dumpWorkStack(const QStack<PageProcessingRequest*> & ws);
 #endif
@@ -316,6 +636,55 @@ struct SearchResult
   }
 };
 
+// Text of a page prepared for searching (see Document::pageText()). The words
+// of the page are concatenated (separated by single spaces) so that searching
+// boils down to QString::indexOf() on a string that is kept in memory.
+class PageText
+{
+public:
+  struct Word {
+    QRectF boundingBox;
+    // Position of the word in `text`
+    int start;
+    int length;
+  };
+
+  // Appends a word; `charBoxes` must contain one box for each character.
+  // `hasSpaceAfter` must be false if the next word continues this one (e.g.,
+  // because the word is split by a font change); otherwise, a space separates
+  // the two.
+  void addWord(const QString & word, const QRectF & boundingBox, const QVector<QRectF> & charBoxes, const bool hasSpaceAfter);
+  bool isEmpty() const { return _text.isEmpty(); }
+  const QString & text() const { return _text; }
+  const QVector<Word> & words() const { return _words; }
+  // Box of the character at position `pos` in `text` (empty for the
+  // separators between words)
+  QRectF charBox(const int pos) const { return boundingBox(pos, 1); }
+
+  // Returns all (non-overlapping) occurrences of `searchText` in the order
+  // given by `flags`. Whitespace in `searchText` matches the break between
+  // two words.
+  QList<SearchResult> search(const QString & searchText, const SearchFlags & flags, const unsigned int pageNum) const;
+
+  // Normalization applied for case-insensitive searches; it maps each
+  // character to exactly one character, so positions in the normalized text
+  // are the same as in the original one
+  static QString normalized(const QString & str);
+
+private:
+  QRectF boundingBox(const int start, const int length) const;
+
+  QString _text;
+  QString _normalizedText;
+  QVector<Word> _words;
+  // Whether the next word must be separated from the last one by a space
+  bool _spaceAfterLastWord{false};
+  // Horizontal extent of each character in `_text` (the separators between
+  // words are empty); together with the word boxes, this gives the box of
+  // each character
+  QVector< QPair<qreal, qreal> > _charExtents;
+};
+
 
 // PDF ABCs
 // ========
@@ -344,6 +713,18 @@ public:
                   };
   Q_DECLARE_FLAGS(Permissions, Permission)
 
+  // Pages whose fingerprint (see Page::fingerprint()) did not change in a
+  // reload keep the tiles rendered before the reload
+  struct ReloadStatistics {
+    quint64 reloads{0};
+    // Pages that were checked after a reload (i.e., when they were rendered
+    // for the first time)
+    quint64 pagesReused{0};
+    quint64 pagesChanged{0};
+    // Tiles that did not need to be rendered again
+    quint64 tilesReused{0};
+  };
+
   Document(const QString fileName);
   virtual ~Document();
 
@@ -351,8 +732,18 @@ public:
   int numPages();
   // Uses doc-read-lock
   QString fileName() const { QReadLocker docLocker(_docLock.data()); return _fileName; }
+  // Hash of the pdf data (e.g., for identifying the document in the
+  // PDFPreviewCache); empty if not supported by the backend. The hash is
+  // computed on first use, which involves reading the whole file, so this
+  // should not be called from the GUI thread (the page processing requests
+  // that need it call it from their worker threads).
   // Uses doc-read-lock
-  PDFPageProcessingThread& processingThread();
+  QByteArray contentHash() const;
+
+  ReloadStatistics reloadStatistics() const;
+  void resetReloadStatistics();
+  // Uses doc-read-lock
+  PDFPageProcessingThreadPool& processingThreadPool();
   // Uses doc-read-lock
   PDFPageCache& pageCache();
 
@@ -412,18 +803,67 @@ public:
   //   - See TODO list in `Page::search`
   virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags, const int startPage = 0);
 
+  // Returns the text of the given page for searching. The text of all pages is
+  // kept in memory once it was extracted, so later searches don't need to go
+  // through the backend again. Returns a null pointer if the backend does not
+  // support extracting text.
+  // Uses doc-read-lock
+  QSharedPointer<const PageText> pageText(const int page);
+  // Extracts the text of all pages that are not indexed yet in the background
+  // (with the lowest priority, i.e., after everything that is needed to
+  // display the document)
+  // Uses doc-read-lock
+  void buildTextIndex();
+  // Uses doc-read-lock
+  int numIndexedPages() const;
+
 protected:
   void clearPages();
   virtual void clearMetaData();
+  // Computes the hash returned by contentHash(); empty if not supported
+  // The caller must hold a doc-read-lock
+  virtual QByteArray computeContentHash() const { return QByteArray(); }
+  // Forgets the content hash (e.g., when the document is reloaded)
+  // The caller must hold a doc-write-lock
+  void resetContentHash();
+  // Backends must call this in reload() before the pages are cleared. It
+  // remembers the fingerprints and the text of all pages so they can be
+  // reused for pages that did not change.
+  // The caller must hold a doc-write-lock
+  void rememberFingerprints();
+  // Returns the fingerprint page `page` had before the last reload (if known)
+  // and forgets it, so each page is checked only once
+  QByteArray takePreviousFingerprint(const int page);
+  // Moves the text page `page` had before the last reload back into the text
+  // index; used for pages whose fingerprint did not change
+  void restorePageText(const int page);
 
   int _numPages{-1};
-  PDFPageProcessingThread _processingThread;
+  PDFPageProcessingThreadPool _processingThreadPool;
   PDFPageCache _pageCache;
   QVector< QSharedPointer<Page> > _pages;
   Permissions _permissions;
 
   QString _fileName;
 
+  // Guards the content hash (which is computed while holding only a
+  // doc-read-lock)
+  mutable QMutex _contentHashMutex;
+  mutable QByteArray _contentHash;
+  mutable bool _contentHashKnown{false};
+
+  // Guards the following members (which may change while holding only a
+  // doc-read-lock)
+  mutable QMutex _reloadMutex;
+  QHash<int, QByteArray> _previousFingerprints;
+  ReloadStatistics _reloadStatistics;
+
+  // Guards the text index (which may change while holding only a
+  // doc-read-lock)
+  mutable QMutex _textIndexMutex;
+  QVector< QSharedPointer<const PageText> > _textIndex;
+  QHash< int, QSharedPointer<const PageText> > _previousTextIndex;
+
   QString _meta_title;
   QString _meta_author;
   QString _meta_subject;
@@ -443,6 +883,9 @@ protected:
 class Page
 {
   friend class Document;
+  friend class PageProcessingLoadPreviewRequest;
+  friend class PageProcessingRenderLowResRequest;
+  friend class PageProcessingRenderPageRequest;
 
 protected:
   Document *_parent{nullptr};
@@ -459,10 +902,38 @@ protected:
   Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock);
 
   // Uses doc-read-lock and page-read-lock.
-  QSharedPointer<QImage> getCachedImage(double xres, double yres, QRect render_box = QRect(), PDFPageCache::TileStatus * status = nullptr);
+  PDFTileImage getCachedImage(double xres, double yres, QRect render_box = QRect(), PDFPageCache::TileStatus * status = nullptr);
 
   // Uses doc-read-lock and page-read-lock.
   virtual void asyncRenderToImage(QObject *listener, double xres, double yres, QRect render_box = QRect(), bool cache = false);
+  // Computes the fingerprint and renders the preview of the page in the
+  // background (unless that was requested already) if they are not known yet
+  // Uses doc-read-lock and page-read-lock.
+  void asyncRenderLowRes();
+  // Loads the preview from the PDFPreviewCache in the background (unless that
+  // was requested already)
+  // Uses doc-read-lock and page-read-lock.
+  void asyncLoadPreview();
+  // Renders the whole page for the preview and the fingerprint
+  // Uses page-read-lock and doc-read-lock.
+  QImage renderLowRes() const;
+  // Computes the fingerprint from the page's text and the given rendering
+  // of the page (see renderLowRes()) unless it is known already, and returns it
+  // Uses doc-read-lock and page-read-lock.
+  QByteArray updateFingerprint(const QImage & lowRes);
+  // If the page did not change since before the last reload of the document,
+  // restores the tiles rendered before. Returns true if the page is unchanged.
+  // Uses doc-read-lock and page-read-lock.
+  bool reuseUnchangedTiles();
+
+  // Low-resolution rendering of the whole page from the PDFPreviewCache
+  QMutex _previewMutex;
+  QImage _previewImage;
+  bool _previewRequested{false};
+  bool _lowResRequested{false};
+
+  QMutex _fingerprintMutex;
+  QByteArray _fingerprint;
 
 public:
   // Class to encapsulate boxes, e.g., for selecting
@@ -518,8 +989,27 @@ public:
   // returns a dummy image (which is added to the cache to speed up future
   // requests). Otherwise, the method renders the page synchronously and returns
   // the result.
+  // If a `colorMode` is given, the returned image is transformed accordingly.
+  // Transformed images of finished renderings are cached, too.
+  // Uses page-read-lock and doc-read-lock.
+  PDFTileImage getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect(), const PDFColorTransform::Mode colorMode = PDFColorTransform::Mode_None);
+  // Returns a low-resolution rendering of the whole page from the persistent
+  // PDFPreviewCache, or a null image if there is none (yet). This never
+  // touches the disk; getTileImage() uses this to construct placeholders and
+  // requests previews to be loaded (or rendered) in the background as
+  // necessary.
+  QImage previewImage();
+  // Returns a hash of the page's content, i.e., its size, its text including
+  // the exact position of each character, and its low-resolution rendering
+  // (see fingerprintOf()). It is used to find pages that did not change when
+  // the document is reloaded. If `compute` is false and the fingerprint was not
+  // computed yet, an empty QByteArray is returned.
   // Uses page-read-lock and doc-read-lock.
-  QSharedPointer<QImage> getTileImage(QObject * listener, const double xres, const double yres, QRect render_box = QRect());
+  QByteArray fingerprint(const bool compute = true);
+  // The fingerprint consists of separate hashes of the text (and its
+  // geometry) and of the graphics (i.e., `lowRes`), so it only stays the same
+  // if neither changed. Returns an empty QByteArray if `lowRes` is null.
+  static QByteArray fingerprintOf(const QSizeF & pageSize, const PageText & text, const QImage & lowRes);
 
   virtual QList< QSharedPointer<Annotation::AbstractAnnotation> > loadAnnotations() { return QList< QSharedPointer<Annotation::AbstractAnnotation> >(); }
 
@@ -537,7 +1027,14 @@ public:
   // This is very tricky to do in C++. God I miss Python and its `itertools`
   // library.
   virtual QList<SearchResult> search(const QString & searchText, const SearchFlags & flags) = 0;
+  // Uses the text index of the document (see Document::pageText()) if
+  // possible and falls back to search() otherwise
   static QList<SearchResult> executeSearch(SearchRequest request);
+
+  // Extracts the text of the page along with the boxes of all words and
+  // characters. Returns a null pointer if the backend does not support this.
+  // Use Document::pageText() instead, which caches the result.
+  virtual QSharedPointer<PageText> extractText() { return QSharedPointer<PageText>(); }
 };
 
 } // namespace Backend
@@ -0,0 +1,312 @@
+/**
+ * Copyright (C) 2026  The TeXworks developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFColorTransform.h"
+
+#include <QtGlobal>
+
+// SSE2 is part of every x86-64 CPU, so it can be used unconditionally if the
+// compiler targets it. AVX2 kernels are compiled for the respective target
+// only (which requires gcc or clang) and are chosen at runtime if the CPU
+// supports them.
+#if defined(Q_PROCESSOR_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#  define QTPDF_COLOR_TRANSFORM_SSE2
+#  include <emmintrin.h>
+#  if defined(Q_CC_GNU)
+#    define QTPDF_COLOR_TRANSFORM_AVX2
+#    define QTPDF_TARGET_AVX2 __attribute__((target("avx2")))
+#    include <immintrin.h>
+#  endif
+#endif
+
+namespace QtPDF {
+
+namespace Backend {
+
+namespace {
+
+typedef void (*RowFunction)(const quint32 * src, quint32 * dst, const int n, const bool premultiplied);
+
+// Weights (in 1/32) used by qGray()
+const int GrayR = 11, GrayG = 16, GrayB = 5;
+// Weights (in 1/128) of the usual sepia matrix
+const int SepiaRR = 50, SepiaRG = 98, SepiaRB = 24;
+const int SepiaGR = 45, SepiaGG = 88, SepiaGB = 22;
+const int SepiaBR = 35, SepiaBG = 68, SepiaBB = 17;
+
+bool isSupportedFormat(const QImage::Format format)
+{
+  return (format == QImage::Format_RGB32 || format == QImage::Format_ARGB32 || format == QImage::Format_ARGB32_Premultiplied);
+}
+
+// Note: In premultiplied images, color components range from 0 to alpha
+// (instead of 255)
+template <PDFColorTransform::Mode mode>
+inline quint32 transformPixel(const quint32 p, const bool premultiplied)
+{
+  const quint32 a = p >> 24;
+  const quint32 r = (p >> 16) & 0xff;
+  const quint32 g = (p >> 8) & 0xff;
+  const quint32 b = p & 0xff;
+  switch (mode) {
+    case PDFColorTransform::Mode_GrayScale:
+    {
+      const quint32 y = (r * GrayR + g * GrayG + b * GrayB) >> 5;
+      return (p & 0xff000000u) | (y * 0x010101u);
+    }
+    case PDFColorTransform::Mode_Inverted:
+    {
+      const quint32 max = (premultiplied ? a * 0x010101u : 0xffffffu);
+      return (p & 0xff000000u) | (max - (p & 0xffffffu));
+    }
+    case PDFColorTransform::Mode_Sepia:
+    {
+      const quint32 limit = (premultiplied ? a : 0xffu);
+      const quint32 rs = qMin(limit, (r * SepiaRR + g * SepiaRG + b * SepiaRB) >> 7);
+      const quint32 gs = qMin(limit, (r * SepiaGR + g * SepiaGG + b * SepiaGB) >> 7);
+      const quint32 bs = qMin(limit, (r * SepiaBR + g * SepiaBG + b * SepiaBB) >> 7);
+      return (p & 0xff000000u) | (rs << 16) | (gs << 8) | bs;
+    }
+    case PDFColorTransform::Mode_None:
+      break;
+  }
+  return p;
+}
+
+template <PDFColorTransform::Mode mode>
+void transformRowScalar(const quint32 * src, quint32 * dst, const int n, const bool premultiplied)
+{
+  for (int i = 0; i < n; ++i)
+    dst[i] = transformPixel<mode>(src[i], premultiplied);
+}
+
+#ifdef QTPDF_COLOR_TRANSFORM_SSE2
+// Processes 4 pixels at a time. Each pixel is held in a 32 bit lane and all
+// intermediate products fit into its lower 16 bits, so _mm_mullo_epi16 and
+// _mm_min_epi16 (SSE2) can be used instead of their 32 bit counterparts
+// (SSE4.1).
+template <PDFColorTransform::Mode mode>
+void transformRowSSE2(const quint32 * src, quint32 * dst, const int n, const bool premultiplied)
+{
+  const __m128i channelMask = _mm_set1_epi32(0xff);
+  const __m128i colorMask = _mm_set1_epi32(0xffffff);
+  const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xff000000u));
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    const __m128i a = _mm_srli_epi32(p, 24);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), channelMask);
+    const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), channelMask);
+    const __m128i b = _mm_and_si128(p, channelMask);
+    __m128i color = _mm_and_si128(p, colorMask);
+    switch (mode) {
+      case PDFColorTransform::Mode_GrayScale:
+      {
+        __m128i y = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(GrayR)), _mm_mullo_epi16(g, _mm_set1_epi32(GrayG))), _mm_mullo_epi16(b, _mm_set1_epi32(GrayB)));
+        y = _mm_srli_epi32(y, 5);
+        color = _mm_or_si128(_mm_or_si128(y, _mm_slli_epi32(y, 8)), _mm_slli_epi32(y, 16));
+        break;
+      }
+      case PDFColorTransform::Mode_Inverted:
+      {
+        const __m128i max = (premultiplied ? _mm_or_si128(_mm_or_si128(a, _mm_slli_epi32(a, 8)), _mm_slli_epi32(a, 16)) : colorMask);
+        color = _mm_sub_epi32(max, color);
+        break;
+      }
+      case PDFColorTransform::Mode_Sepia:
+      {
+        const __m128i limit = (premultiplied ? a : channelMask);
+        __m128i rs = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(SepiaRR)), _mm_mullo_epi16(g, _mm_set1_epi32(SepiaRG))), _mm_mullo_epi16(b, _mm_set1_epi32(SepiaRB)));
+        __m128i gs = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(SepiaGR)), _mm_mullo_epi16(g, _mm_set1_epi32(SepiaGG))), _mm_mullo_epi16(b, _mm_set1_epi32(SepiaGB)));
+        __m128i bs = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi16(r, _mm_set1_epi32(SepiaBR)), _mm_mullo_epi16(g, _mm_set1_epi32(SepiaBG))), _mm_mullo_epi16(b, _mm_set1_epi32(SepiaBB)));
+        rs = _mm_min_epi16(_mm_srli_epi32(rs, 7), limit);
+        gs = _mm_min_epi16(_mm_srli_epi32(gs, 7), limit);
+        bs = _mm_min_epi16(_mm_srli_epi32(bs, 7), limit);
+        color = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(rs, 16), _mm_slli_epi32(gs, 8)), bs);
+        break;
+      }
+      case PDFColorTransform::Mode_None:
+        break;
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(_mm_and_si128(p, alphaMask), color));
+  }
+  transformRowScalar<mode>(src + i, dst + i, n - i, premultiplied);
+}
+#endif // defined(QTPDF_COLOR_TRANSFORM_SSE2)
+
+#ifdef QTPDF_COLOR_TRANSFORM_AVX2
+// Same as transformRowSSE2(), but processes 8 pixels at a time
+template <PDFColorTransform::Mode mode>
+QTPDF_TARGET_AVX2 void transformRowAVX2(const quint32 * src, quint32 * dst, const int n, const bool premultiplied)
+{
+  const __m256i channelMask = _mm256_set1_epi32(0xff);
+  const __m256i colorMask = _mm256_set1_epi32(0xffffff);
+  const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+    const __m256i a = _mm256_srli_epi32(p, 24);
+    const __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 16), channelMask);
+    const __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), channelMask);
+    const __m256i b = _mm256_and_si256(p, channelMask);
+    __m256i color = _mm256_and_si256(p, colorMask);
+    switch (mode) {
+      case PDFColorTransform::Mode_GrayScale:
+      {
+        __m256i y = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(GrayR)), _mm256_mullo_epi16(g, _mm256_set1_epi32(GrayG))), _mm256_mullo_epi16(b, _mm256_set1_epi32(GrayB)));
+        y = _mm256_srli_epi32(y, 5);
+        color = _mm256_or_si256(_mm256_or_si256(y, _mm256_slli_epi32(y, 8)), _mm256_slli_epi32(y, 16));
+        break;
+      }
+      case PDFColorTransform::Mode_Inverted:
+      {
+        const __m256i max = (premultiplied ? _mm256_or_si256(_mm256_or_si256(a, _mm256_slli_epi32(a, 8)), _mm256_slli_epi32(a, 16)) : colorMask);
+        color = _mm256_sub_epi32(max, color);
+        break;
+      }
+      case PDFColorTransform::Mode_Sepia:
+      {
+        const __m256i limit = (premultiplied ? a : channelMask);
+        __m256i rs = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(SepiaRR)), _mm256_mullo_epi16(g, _mm256_set1_epi32(SepiaRG))), _mm256_mullo_epi16(b, _mm256_set1_epi32(SepiaRB)));
+        __m256i gs = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(SepiaGR)), _mm256_mullo_epi16(g, _mm256_set1_epi32(SepiaGG))), _mm256_mullo_epi16(b, _mm256_set1_epi32(SepiaGB)));
+        __m256i bs = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi16(r, _mm256_set1_epi32(SepiaBR)), _mm256_mullo_epi16(g, _mm256_set1_epi32(SepiaBG))), _mm256_mullo_epi16(b, _mm256_set1_epi32(SepiaBB)));
+        rs = _mm256_min_epi16(_mm256_srli_epi32(rs, 7), limit);
+        gs = _mm256_min_epi16(_mm256_srli_epi32(gs, 7), limit);
+        bs = _mm256_min_epi16(_mm256_srli_epi32(bs, 7), limit);
+        color = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(rs, 16), _mm256_slli_epi32(gs, 8)), bs);
+        break;
+      }
+      case PDFColorTransform::Mode_None:
+        break;
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(_mm256_and_si256(p, alphaMask), color));
+  }
+  transformRowScalar<mode>(src + i, dst + i, n - i, premultiplied);
+}
+
+bool cpuHasAVX2()
+{
+  static const bool hasAVX2 = (__builtin_cpu_supports("avx2") != 0);
+  return hasAVX2;
+}
+#endif // defined(QTPDF_COLOR_TRANSFORM_AVX2)
+
+template <PDFColorTransform::Mode mode>
+RowFunction rowFunction(const PDFColorTransform::Kernel kernel)
+{
+  switch (kernel) {
+#ifdef QTPDF_COLOR_TRANSFORM_AVX2
+    case PDFColorTransform::Kernel_AVX2:
+      return &transformRowAVX2<mode>;
+#endif
+#ifdef QTPDF_COLOR_TRANSFORM_SSE2
+    case PDFColorTransform::Kernel_SSE2:
+      return &transformRowSSE2<mode>;
+#endif
+    default:
+      return &transformRowScalar<mode>;
+  }
+}
+
+RowFunction rowFunction(const PDFColorTransform::Mode mode, PDFColorTransform::Kernel kernel)
+{
+  if (kernel == PDFColorTransform::Kernel_Auto || !PDFColorTransform::isSupported(kernel))
+    kernel = PDFColorTransform::bestKernel();
+  switch (mode) {
+    case PDFColorTransform::Mode_GrayScale:
+      return rowFunction<PDFColorTransform::Mode_GrayScale>(kernel);
+    case PDFColorTransform::Mode_Inverted:
+      return rowFunction<PDFColorTransform::Mode_Inverted>(kernel);
+    case PDFColorTransform::Mode_Sepia:
+      return rowFunction<PDFColorTransform::Mode_Sepia>(kernel);
+    case PDFColorTransform::Mode_None:
+      break;
+  }
+  return nullptr;
+}
+
+} // anonymous namespace
+
+//static
+QImage PDFColorTransform::transformed(const QImage & img, const Mode mode, const Kernel kernel /* = Kernel_Auto */)
+{
+  const RowFunction f = rowFunction(mode, kernel);
+  if (img.isNull() || !f)
+    return img;
+
+  const QImage src = (isSupportedFormat(img.format()) ? img : img.convertToFormat(QImage::Format_ARGB32_Premultiplied));
+  // Write the result directly to the new image (rather than copying `src`
+  // and transforming the copy in place) so each pixel is touched only once
+  QImage dst(src.size(), src.format());
+  if (dst.isNull())
+    return dst;
+  dst.setDevicePixelRatio(src.devicePixelRatio());
+  const bool premultiplied = (src.format() == QImage::Format_ARGB32_Premultiplied);
+  for (int y = 0; y < src.height(); ++y)
+    f(reinterpret_cast<const quint32 *>(src.constScanLine(y)), reinterpret_cast<quint32 *>(dst.scanLine(y)), src.width(), premultiplied);
+  return dst;
+}
+
+//static
+void PDFColorTransform::apply(QImage & img, const Mode mode, const Kernel kernel /* = Kernel_Auto */)
+{
+  const RowFunction f = rowFunction(mode, kernel);
+  if (img.isNull() || !f)
+    return;
+
+  if (!isSupportedFormat(img.format()))
+    img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+  const bool premultiplied = (img.format() == QImage::Format_ARGB32_Premultiplied);
+  for (int y = 0; y < img.height(); ++y) {
+    quint32 * line = reinterpret_cast<quint32 *>(img.scanLine(y));
+    f(line, line, img.width(), premultiplied);
+  }
+}
+
+//static
+bool PDFColorTransform::isSupported(const Kernel kernel)
+{
+  switch (kernel) {
+    case Kernel_Auto:
+    case Kernel_Scalar:
+      return true;
+    case Kernel_SSE2:
+#ifdef QTPDF_COLOR_TRANSFORM_SSE2
+      return true;
+#else
+      return false;
+#endif
+    case Kernel_AVX2:
+#ifdef QTPDF_COLOR_TRANSFORM_AVX2
+      return cpuHasAVX2();
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+//static
+PDFColorTransform::Kernel PDFColorTransform::bestKernel()
+{
+  if (isSupported(Kernel_AVX2))
+    return Kernel_AVX2;
+  if (isSupported(Kernel_SSE2))
+    return Kernel_SSE2;
+  return Kernel_Scalar;
+}
+
+} // namespace Backend
+
+} // namespace QtPDF
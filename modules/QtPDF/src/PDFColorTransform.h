@@ -0,0 +1,53 @@
+/**
+ * Copyright (C) 2026  The TeXworks developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFColorTransform_H
+#define PDFColorTransform_H
+
+#include <QImage>
+
+namespace QtPDF {
+
+namespace Backend {
+
+// Color transformations applied to rendered tiles before they are displayed
+// (e.g., gray scale for previewing black & white prints, or inverted colors
+// for reading in the dark). The transformed tiles are cached as variants of
+// their own in the PDFPageCache (see Page::getTileImage()).
+// The kernels work on 32 bit images and use SSE2 or AVX2 if the compiler and
+// the CPU support it; otherwise, plain C++ is used. All kernels give exactly
+// the same results.
+class PDFColorTransform
+{
+public:
+  // Note: The values are used to distinguish tile variants in the cache (see
+  // PDFPageTile::variant), so Mode_None must be 0
+  enum Mode { Mode_None = 0, Mode_GrayScale, Mode_Inverted, Mode_Sepia };
+  enum Kernel { Kernel_Auto, Kernel_Scalar, Kernel_SSE2, Kernel_AVX2 };
+
+  // Returns a transformed copy of `img`. Images that are not 32 bit are
+  // converted to Format_ARGB32_Premultiplied.
+  static QImage transformed(const QImage & img, const Mode mode, const Kernel kernel = Kernel_Auto);
+  // Transforms `img` in place
+  static void apply(QImage & img, const Mode mode, const Kernel kernel = Kernel_Auto);
+
+  static bool isSupported(const Kernel kernel);
+  // The fastest kernel supported by the CPU; used for Kernel_Auto
+  static Kernel bestKernel();
+};
+
+} // namespace Backend
+
+} // namespace QtPDF
+
+#endif // !defined(PDFColorTransform_H)
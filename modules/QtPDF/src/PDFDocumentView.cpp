@@ -98,12 +98,26 @@ PDFDocumentView::PDFDocumentView(QWidget *parent /* = nullptr */):
 
   connect(&_searchResultWatcher, SIGNAL(resultReadyAt(int)), this, SLOT(searchResultReady(int)));
   connect(&_searchResultWatcher, SIGNAL(progressValueChanged(int)), this, SLOT(searchProgressValueChanged(int)));
+
+  // Only prefetch once the view has settled for a moment so that we don't
+  // issue (and later drop) lots of requests while scrolling quickly
+  _prefetchTimer.setSingleShot(true);
+  _prefetchTimer.setInterval(100);
+  connect(&_prefetchTimer, SIGNAL(timeout()), this, SLOT(prefetchTiles()));
 }
 
 PDFDocumentView::~PDFDocumentView()
 {
   if (!_searchResultWatcher.isFinished())
     _searchResultWatcher.cancel();
+  // Don't let the (shared) document favor a region we no longer display
+  if (_pdf_scene) {
+    QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+    if (doc) {
+      doc->processingThreadPool().setViewport(Backend::PDFPageProcessingThreadPool::Viewport());
+      doc->pageCache().setVisibleRects(QMap<int, QRectF>());
+    }
+  }
 }
 
 // Accessors
@@ -775,6 +789,14 @@ void PDFDocumentView::setMagnifierSize(const int size)
     magnifier->setMagnifierSize(size);
 }
 
+void PDFDocumentView::setColorMode(const Backend::PDFColorTransform::Mode mode)
+{
+  if (mode == _colorMode)
+    return;
+  _colorMode = mode;
+  viewport()->update();
+}
+
 void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* = Backend::Search_CaseInsensitive */)
 {
   if ( not _pdf_scene )
@@ -790,31 +812,38 @@ void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* =
   // change the search text in that case (e.g., to something meaningless and
   // then back again to abort the previous search and restart at the new
   // location).
-  if (searchText == _searchString) {
-    // FIXME: If flags changed we need to do a full search!
+  if (searchText == _searchString && flags == _searchFlags) {
     nextSearchResult();
     return;
   }
 
   clearSearchResults();
 
-  // Construct a list of requests that can be passed to QtConcurrent::mapped()
+  // Construct a list of requests that can be passed to QtConcurrent::mapped(),
+  // starting at the current page and wrapping around at the end (or the
+  // beginning for backward searches) of the document. The pages are searched
+  // in the text index of the document (which is built in the background after
+  // loading), so this is cheap even if it is repeated for every keystroke.
   QList<Backend::SearchRequest> requests;
-  for (int i = _currentPage; i < _lastPage; ++i) {
+  auto addRequest = [&](const int i) {
     Backend::SearchRequest request;
     request.doc = _pdf_scene->document();
     request.pageNum = i;
     request.searchString = searchText;
     request.flags = flags;
     requests << request;
+  };
+  if (flags.testFlag(Backend::Search_Backwards)) {
+    for (int i = _currentPage; i >= 0; --i)
+      addRequest(i);
+    for (int i = _lastPage - 1; i > _currentPage; --i)
+      addRequest(i);
   }
-  for (int i = 0; i < _currentPage; ++i) {
-    Backend::SearchRequest request;
-    request.doc = _pdf_scene->document();
-    request.pageNum = i;
-    request.searchString = searchText;
-    request.flags = flags;
-    requests << request;
+  else {
+    for (int i = _currentPage; i < _lastPage; ++i)
+      addRequest(i);
+    for (int i = 0; i < _currentPage; ++i)
+      addRequest(i);
   }
 
   // If another search is still running, cancel it---after all, the user wants
@@ -825,7 +854,9 @@ void PDFDocumentView::search(QString searchText, Backend::SearchFlags flags /* =
   }
 
   _currentSearchResult = -1;
+  _nextSearchRequest = 0;
   _searchString = searchText;
+  _searchFlags = flags;
   _searchResultWatcher.setFuture(QtConcurrent::mapped(requests, Backend::Page::executeSearch));
 }
 
@@ -929,9 +960,18 @@ void PDFDocumentView::setCurrentSearchResultHighlightBrush(const QBrush & brush)
 // --------------
 void PDFDocumentView::searchResultReady(int index)
 {
-  // Convert the search result to highlight boxes
-  foreach( Backend::SearchResult result, _searchResultWatcher.future().resultAt(index) )
-    _searchResults << addHighlightPath(result.pageNum, result.bbox, _searchResultHighlightBrush);
+  Q_UNUSED(index)
+  // Results can become available out of order (pages are searched in
+  // parallel). Only add them in the order of the requests so that
+  // _searchResults is always sorted by page, starting at the page the search
+  // was started from.
+  QFuture< QList<Backend::SearchResult> > future = _searchResultWatcher.future();
+  while (future.isResultReadyAt(_nextSearchRequest)) {
+    // Convert the search result to highlight boxes
+    foreach( Backend::SearchResult result, future.resultAt(_nextSearchRequest) )
+      _searchResults << addHighlightPath(result.pageNum, result.bbox, _searchResultHighlightBrush);
+    ++_nextSearchRequest;
+  }
 
   // If this is the first result that becomes available in a new search, center
   // on the first result
@@ -1277,6 +1317,9 @@ void PDFDocumentView::reinitializeFromScene()
     _lastPage = -1;
     _currentPage = -1;
   }
+  // Force the render viewport to be sent to the (new) document on the next
+  // paint event
+  _lastVisibleSceneRect = QRectF();
   // Ensure the text selection marker is reset (if any) as it holds pointers to
   // page items (highlight path, boxes) that are now changed and/or destroyed.
   DocumentTool::Select * selectTool = dynamic_cast<DocumentTool::Select*>(getToolByType(DocumentTool::AbstractTool::Tool_Select));
@@ -1352,10 +1395,89 @@ void PDFDocumentView::paintEvent(QPaintEvent *event)
     }
   }
 
+  updateRenderViewport();
+
   if (_armedTool)
     _armedTool->paintEvent(event);
 }
 
+void PDFDocumentView::updateRenderViewport()
+{
+  if (!_pdf_scene)
+    return;
+  QSharedPointer<Backend::Document> doc(_pdf_scene->document().toStrongRef());
+  if (!doc)
+    return;
+
+  // paintEvent() is also called whenever a tile has finished rendering, so
+  // only do something if the view has actually changed
+  const QRectF visibleRect = mapToScene(viewport()->rect()).boundingRect();
+  if (visibleRect == _lastVisibleSceneRect)
+    return;
+
+  // Determine the scroll direction (this does not change if we merely zoom)
+  if (!_lastVisibleSceneRect.isNull() && visibleRect.size() == _lastVisibleSceneRect.size()) {
+    if (visibleRect.top() > _lastVisibleSceneRect.top() || (visibleRect.top() == _lastVisibleSceneRect.top() && visibleRect.left() > _lastVisibleSceneRect.left()))
+      _scrollDirection = 1;
+    else if (visibleRect.top() < _lastVisibleSceneRect.top() || visibleRect.left() < _lastVisibleSceneRect.left())
+      _scrollDirection = -1;
+  }
+  _lastVisibleSceneRect = visibleRect;
+
+  Backend::PDFPageProcessingThreadPool::Viewport renderViewport;
+  // In presentation mode, pages are rendered synchronously as a whole
+  if (_pageMode != PageMode_Presentation) {
+    collectPageRects(visibleRect, renderViewport.visible);
+    collectPageRects(visibleRect.translated(0, _scrollDirection * visibleRect.height()), renderViewport.ahead);
+    collectPageRects(visibleRect.translated(0, -_scrollDirection * visibleRect.height()), renderViewport.behind);
+  }
+  doc->processingThreadPool().setViewport(renderViewport);
+  doc->pageCache().setVisibleRects(renderViewport.visible);
+
+  if (renderViewport.isNull())
+    _prefetchTimer.stop();
+  else
+    _prefetchTimer.start();
+}
+
+void PDFDocumentView::collectPageRects(const QRectF & sceneRect, QMap<int, QRectF> & pageRects) const
+{
+  if (!_pdf_scene)
+    return;
+  foreach(QGraphicsItem * item, _pdf_scene->items(sceneRect)) {
+    if (!item->isVisible() || item->type() != PDFPageGraphicsItem::Type)
+      continue;
+    PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+    QRectF r = pageItem->mapRectFromScene(sceneRect).intersected(pageItem->boundingRect());
+    if (r.isEmpty())
+      continue;
+    // Convert from item coordinates to pt (origin at the top left corner)
+    pageRects.insert(pageItem->pageNum(), pageItem->pointScale().inverted().mapRect(r));
+  }
+}
+
+void PDFDocumentView::prefetchTiles()
+{
+  if (!_pdf_scene || _pageMode == PageMode_Presentation)
+    return;
+
+  const QRectF visibleRect = mapToScene(viewport()->rect()).boundingRect();
+  // Request the screenful behind us first so that the one ahead of us ends up
+  // on top of the work stack
+  QList<QRectF> rects;
+  rects << visibleRect.translated(0, -_scrollDirection * visibleRect.height());
+  rects << visibleRect.translated(0, _scrollDirection * visibleRect.height());
+
+  foreach(const QRectF & rect, rects) {
+    foreach(QGraphicsItem * item, _pdf_scene->items(rect)) {
+      if (!item->isVisible() || item->type() != PDFPageGraphicsItem::Type)
+        continue;
+      PDFPageGraphicsItem * pageItem = static_cast<PDFPageGraphicsItem*>(item);
+      pageItem->prefetchTiles(pageItem->mapRectFromScene(rect), transform().m11(), viewport()->devicePixelRatio());
+    }
+  }
+}
+
 void PDFDocumentView::keyPressEvent(QKeyEvent *event)
 {
   // FIXME: No moving while tools are active?
@@ -2063,6 +2185,8 @@ void PDFDocumentScene::reinitializeScene()
       _pageLayout.addPage(pagePtr);
     }
     _pageLayout.relayout();
+    // Prepare for searching once everything else is done
+    _doc->buildTextIndex();
   }
 }
 
@@ -2079,10 +2203,39 @@ void PDFDocumentScene::reloadDocument()
     return;
 
   _doc->reload();
-  reinitializeScene();
+  // Keep the page items if possible; that way, the view doesn't change and
+  // unchanged pages keep showing their tiles (see Backend::Page::fingerprint())
+  if (!updatePages())
+    reinitializeScene();
+  else
+    _doc->buildTextIndex();
   emit documentChanged(_doc.toWeakRef());
 }
 
+bool PDFDocumentScene::updatePages()
+{
+  if (!_doc->isValid() || _doc->isLocked() || _unlockProxy->scene() == this)
+    return false;
+  if (_doc->numPages() != _pages.size())
+    return false;
+
+  QList< QSharedPointer<Backend::Page> > newPages;
+  for (int i = 0; i < _pages.size(); ++i) {
+    PDFPageGraphicsItem * pageItem = dynamic_cast<PDFPageGraphicsItem*>(_pages[i]);
+    QSharedPointer<Backend::Page> page(_doc->page(i).toStrongRef());
+    if (!pageItem || !page)
+      return false;
+    const QSizeF size(page->pageSizeF().width() * _dpiX / 72.0, page->pageSizeF().height() * _dpiY / 72.0);
+    if (!qFuzzyCompare(size.width(), pageItem->pageSizeF().width()) || !qFuzzyCompare(size.height(), pageItem->pageSizeF().height()))
+      return false;
+    newPages << page;
+  }
+
+  for (int i = 0; i < _pages.size(); ++i)
+    static_cast<PDFPageGraphicsItem*>(_pages[i])->setPage(newPages[i]);
+  return true;
+}
+
 
 // Other
 // -----
@@ -2191,6 +2344,18 @@ PDFPageGraphicsItem::PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, con
   }
 }
 
+void PDFPageGraphicsItem::setPage(QWeakPointer<Backend::Page> a_page)
+{
+  // Links, annotations, and highlights belong to the old page; links and
+  // annotations are loaded again on the next paint
+  foreach(QGraphicsItem * child, childItems())
+    delete child;
+  _linksLoaded = false;
+  _annotationsLoaded = false;
+  _page = a_page;
+  update();
+}
+
 QRectF PDFPageGraphicsItem::boundingRect() const { return QRectF(QPointF(0.0, 0.0), _pageSize); }
 int PDFPageGraphicsItem::type() const { return Type; }
 
@@ -2224,7 +2389,7 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   QTransform scaleT = QTransform::fromScale(scaleFactor, scaleFactor);
   QRect pageRect = scaleT.mapRect(boundingRect()).toAlignedRect();
   QSharedPointer<Backend::Page> page(_page.toStrongRef());
-  QSharedPointer<QImage> renderedPage;
+  Backend::PDFTileImage renderedPage;
 
   if (!page)
     return;
@@ -2249,6 +2414,18 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   // get a pointer to the parent view (if any)
   PDFDocumentView * view = (widget ? qobject_cast<PDFDocumentView*>(widget->parent()) : nullptr);
 
+  // If we are rendering a PDFDocumentView, respect its color mode. If we are
+  // rendering a PDFDocumentMagnifierView, respect the color mode of its parent
+  // PDFDocumentView.
+  Backend::PDFColorTransform::Mode colorMode = Backend::PDFColorTransform::Mode_None;
+  if (view)
+    colorMode = view->colorMode();
+  else if (widget && widget->parent() && widget->parent()->parent()) {
+    PDFDocumentView * parentView = qobject_cast<PDFDocumentView*>(widget->parent()->parent());
+    if (parentView)
+      colorMode = parentView->colorMode();
+  }
+
   painter->save();
 
   if (view && view->pageMode() == PDFDocumentView::PageMode_Presentation) {
@@ -2286,7 +2463,7 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
       // render the whole page synchronously (we don't want "rendering" to show
       // up during presentations, and we don't need tiles as we always display
       // the full page, anyway).
-      renderedPage = page->getTileImage(nullptr, _dpiX * scaleFactor, _dpiY * scaleFactor);
+      renderedPage = page->getTileImage(nullptr, _dpiX * scaleFactor, _dpiY * scaleFactor, QRect(), colorMode);
       if (renderedPage)
         painter->drawImage(QPoint(0, 0), *renderedPage);
     }
@@ -2339,40 +2516,16 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
         // settings into account (e.g. its devicePixelRatio)
         QRect displayTile(i * effectiveTileSize, j * effectiveTileSize, effectiveTileSize, effectiveTileSize);
 
-        bool useGrayScale = false;
-        // If we are rendering a PDFDocumentView that has `useGrayScale` set
-        // respect that setting.
-        if (view && view->useGrayScale())
-          useGrayScale = true;
-        // If we are rendering a PDFDocumentMagnifierView who's parent
-        // PDFDocumentView has `useGrayScale` set respect that setting.
-        else if (widget && widget->parent() && widget->parent()->parent()) {
-          PDFDocumentView * view = (widget ? qobject_cast<PDFDocumentView*>(widget->parent()->parent()) : nullptr);
-          if (view && view->useGrayScale())
-            useGrayScale = true;
-        }
-
-        renderedPage = page->getTileImage(this, _dpiX * scaleFactor * painter->device()->devicePixelRatio(), _dpiY * scaleFactor * painter->device()->devicePixelRatio(), renderTile);
-        // we don't want a finished render thread to change our image while we
-        // draw it
-        page->document()->pageCache().lock();
+        // Note: Finished render threads replace the image in the cache rather
+        // than changing it, so we can hold on to renderedPage without locking
+        // the cache while drawing it. Color transformed tiles are cached, too.
+        renderedPage = page->getTileImage(this, _dpiX * scaleFactor * painter->device()->devicePixelRatio(), _dpiY * scaleFactor * painter->device()->devicePixelRatio(), renderTile, colorMode);
         // renderedPage as returned from getTileImage _should_ always be valid
         if ( renderedPage ) {
-          if (useGrayScale) {
-            // In gray scale mode, we need to obtain a deep copy of the rendered
-            // page image to avoid altering the cached (color) image
-            QImage postProcessed = renderedPage->copy();
-            imageToGrayScale(postProcessed);
-            postProcessed.setDevicePixelRatio(painter->device()->devicePixelRatio());
-            painter->drawImage(displayTile.topLeft(), postProcessed);
-          }
-          else {
-            QImage img = *renderedPage;
-            img.setDevicePixelRatio(painter->device()->devicePixelRatio());
-            painter->drawImage(displayTile.topLeft(), img);
-          }
+          // Draw the image to a rect of the effective size instead of setting
+          // its devicePixelRatio, which would detach (i.e., copy) it
+          painter->drawImage(QRectF(displayTile.topLeft(), QSizeF(renderedPage->size()) / painter->device()->devicePixelRatio()), *renderedPage);
         }
-        page->document()->pageCache().unlock();
 #ifdef DEBUG
         painter->drawRect(displayTile);
 #endif
@@ -2382,24 +2535,35 @@ void PDFPageGraphicsItem::paint(QPainter *painter, const QStyleOptionGraphicsIte
   painter->restore();
 }
 
-//static
-void PDFPageGraphicsItem::imageToGrayScale(QImage & img)
+void PDFPageGraphicsItem::prefetchTiles(const QRectF & rect, const qreal zoomLevel, const qreal devicePixelRatio)
 {
-  // Casting to QRgb* only works for 32bit images
-  Q_ASSERT(img.depth() == 32);
-  QRgb * data = reinterpret_cast<QRgb*>(img.scanLine(0));
-#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
-  for (int i = 0; i < img.byteCount() / 4; ++i) {
-#else
-  for (qsizetype i = 0; i < img.sizeInBytes() / 4; ++i) {
-#endif
-    // Qt formula (qGray()): 0.34375 * r + 0.5 * g + 0.15625 * b
-    // MuPDF formula (rgb_to_gray()): r * 0.3f + g * 0.59f + b * 0.11f;
-    int gray = qGray(data[i]);
-    data[i] = qRgba(gray, gray, gray, qAlpha(data[i]));
+  QSharedPointer<Backend::Page> page(_page.toStrongRef());
+  if (!page || zoomLevel <= 0 || devicePixelRatio <= 0)
+    return;
+
+  // Use the same tiling as paint() so the tiles can be reused from the cache
+  QTransform scaleT = QTransform::fromScale(zoomLevel, zoomLevel);
+  QRect pageRect = scaleT.mapRect(boundingRect()).toAlignedRect();
+  QRect prefetchRect = scaleT.mapRect(rect.intersected(boundingRect())).toAlignedRect();
+  if (prefetchRect.isEmpty())
+    return;
+
+  int effectiveTileSize = qRound(TILE_SIZE / devicePixelRatio);
+  int imin = (prefetchRect.left() - pageRect.left()) / effectiveTileSize;
+  int imax = (prefetchRect.right() - pageRect.left()) / effectiveTileSize + 1;
+  int jmin = (prefetchRect.top() - pageRect.top()) / effectiveTileSize;
+  int jmax = (prefetchRect.bottom() - pageRect.top()) / effectiveTileSize + 1;
+
+  for (int j = jmin; j < jmax; ++j) {
+    for (int i = imin; i < imax; ++i) {
+      // getTileImage() doesn't do anything if the tile is already cached or
+      // being rendered
+      page->getTileImage(this, _dpiX * zoomLevel * devicePixelRatio, _dpiY * zoomLevel * devicePixelRatio, QRect(i * TILE_SIZE, j * TILE_SIZE, TILE_SIZE, TILE_SIZE));
+    }
   }
 }
 
+//static
 // Event Handlers
 // --------------
 bool PDFPageGraphicsItem::event(QEvent *event)
@@ -2418,10 +2582,10 @@ bool PDFPageGraphicsItem::event(QEvent *event)
   if( event->type() == Backend::PDFPageRenderedEvent::PageRenderedEvent ) {
     event->accept();
 
-    // FIXME: We're sort of misusing the render event here---it contains a copy
-    // of the image data that we never touch. The assumption is that the page
-    // cache now has new data, so we call `update` to trigger a repaint which
-    // fetches stuff from the cache.
+    // FIXME: We're sort of misusing the render event here---it contains the
+    // image (shared with the page cache) that we never touch. The assumption
+    // is that the page cache now has new data, so we call `update` to trigger a
+    // repaint which fetches stuff from the cache.
     //
     // Perhaps there should be a separate event for when the cache is updated.
     update();
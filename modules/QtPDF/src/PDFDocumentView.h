@@ -42,12 +42,16 @@ class PDFDocumentView : public QGraphicsView {
   int _currentPage{-1}, _lastPage{-1};
 
   QString _searchString;
+  Backend::SearchFlags _searchFlags;
   QList<QGraphicsItem *> _searchResults;
   QFutureWatcher< QList<Backend::SearchResult> > _searchResultWatcher;
+  // Index of the first request whose results were not added to _searchResults
+  // yet (see searchResultReady())
+  int _nextSearchRequest{0};
   int _currentSearchResult{-1};
   QBrush _searchResultHighlightBrush;
   QBrush _currentSearchResultHighlightBrush;
-  bool _useGrayScale{false};
+  Backend::PDFColorTransform::Mode _colorMode{Backend::PDFColorTransform::Mode_None};
 
   friend class DocumentTool::AbstractTool;
   friend class DocumentTool::Select;
@@ -64,7 +68,8 @@ public:
   int lastPage();
   PageMode pageMode() const { return _pageMode; }
   qreal zoomLevel() const { return _zoomLevel; }
-  bool useGrayScale() const { return _useGrayScale; }
+  bool useGrayScale() const { return _colorMode == Backend::PDFColorTransform::Mode_GrayScale; }
+  Backend::PDFColorTransform::Mode colorMode() const { return _colorMode; }
   void fitInView(const QRectF & rect, Qt::AspectRatioMode aspectRatioMode = Qt::IgnoreAspectRatio);
   const QWeakPointer<QtPDF::Backend::Document> document() const;
   QString selectedText() const;
@@ -125,7 +130,8 @@ public slots:
   void setMouseModeSelect() { setMouseMode(MouseMode_Select); }
   void setMagnifierShape(const DocumentTool::MagnifyingGlass::MagnifierShape shape);
   void setMagnifierSize(const int size);
-  void setUseGrayScale(const bool grayScale = true) { _useGrayScale = grayScale; }
+  void setUseGrayScale(const bool grayScale = true) { setColorMode(grayScale ? Backend::PDFColorTransform::Mode_GrayScale : Backend::PDFColorTransform::Mode_None); }
+  void setColorMode(const Backend::PDFColorTransform::Mode mode);
 
   void zoomBy(const qreal zoomFactor, const QGraphicsView::ViewportAnchor anchor = QGraphicsView::AnchorViewCenter);
   void zoomIn(const QGraphicsView::ViewportAnchor anchor = QGraphicsView::AnchorViewCenter);
@@ -195,8 +201,15 @@ protected slots:
   void switchInterfaceLocale(const QLocale & newLocale);
   void reinitializeFromScene();
   void notifyTextSelectionChanged();
+  // Speculatively requests the tiles of the next and previous screenful
+  void prefetchTiles();
 
 private:
+  // Informs the document's processing thread pool about the visible region
+  // (and where we are heading) so it can render the tiles that matter first
+  void updateRenderViewport();
+  void collectPageRects(const QRectF & sceneRect, QMap<int, QRectF> & pageRects) const;
+
   PageMode _pageMode{PageMode_OneColumnContinuous};
   MouseMode _mouseMode{MouseMode_Move};
   QCursor _hiddenCursor;
@@ -206,6 +219,11 @@ private:
 
   QStack<PDFDestination> _oldViewRects;
 
+  QRectF _lastVisibleSceneRect;
+  // 1 when scrolling down/right, -1 when scrolling up/left
+  int _scrollDirection{1};
+  QTimer _prefetchTimer;
+
   static QTranslator * _translator;
   static QString _translatorLanguage;
 
@@ -500,6 +518,10 @@ protected slots:
   void finishUnlock();
 
 protected:
+  // Hands the (reloaded) pages of _doc to the existing page items. Fails (and
+  // does nothing) if the number or sizes of pages changed.
+  bool updatePages();
+
   // Used in non-continuous mode to keep track of currently shown page across
   // reloads. -2 is used in continuous mode. -1 indicates an invalid value.
   int _shownPageIdx;
@@ -545,8 +567,6 @@ class PDFPageGraphicsItem : public QGraphicsObject
   friend class PageProcessingLoadLinksRequest;
 //  friend class PDFPageLayout;
 
-  static void imageToGrayScale(QImage & img);
-
 public:
   PDFPageGraphicsItem(QWeakPointer<Backend::Page> a_page, const double dpiX, const double dpiY, QGraphicsItem *parent = nullptr);
 
@@ -562,6 +582,10 @@ public:
   QRectF boundingRect() const override;
 
   QWeakPointer<Backend::Page> page() const { return _page; }
+  // Replaces the page (e.g., after the document was reloaded); the new page
+  // must have the same size. Child items (links, annotations, highlights,
+  // etc.) are destroyed.
+  void setPage(QWeakPointer<Backend::Page> a_page);
 
   // Maps the point _point_ from the page's coordinate system (in pt) to this
   // item's coordinate system - chain with mapToScene and related methods to get
@@ -572,6 +596,10 @@ public:
   // convert from coordinates in other systems
   QPointF mapToPage(const QPointF & point) const;
 
+  // Requests (but doesn't paint) the tiles covering `rect` (in item
+  // coordinates) as paint() would at the given zoom level
+  void prefetchTiles(const QRectF & rect, const qreal zoomLevel, const qreal devicePixelRatio);
+
   QTransform pageScale() { return _pageScale; }
   QTransform pointScale() { return _pointScale; }
 
@@ -74,7 +74,7 @@ bool PDFPageTile::operator <(const PDFPageTile &other) const
 #ifdef DEBUG
 PDFPageTile::operator QString() const
 {
-  return QString::fromUtf8("p%1,%2x%3,r%4|%5x%6|%7").arg(page_num).arg(xres).arg(yres).arg(render_box.x()).arg(render_box.y()).arg(render_box.width()).arg(render_box.height());
+  return QString::fromUtf8("p%1,%2x%3,r%4|%5x%6|%7,v%8").arg(page_num).arg(xres).arg(yres).arg(render_box.x()).arg(render_box.y()).arg(render_box.width()).arg(render_box.height()).arg(variant);
 }
 #endif
 
@@ -82,7 +82,7 @@ PDFPageTile::operator QString() const
 uint qHash(const PDFPageTile &tile) noexcept
 {
   uint h1 = ::qHash(QPair<uint, uint>(::qHash(tile.xres), ::qHash(tile.yres)));
-  uint h2 = ::qHash(QPair<uint,int>(::qHash(tile.render_box), tile.page_num));
+  uint h2 = ::qHash(QPair<uint,int>(::qHash(tile.render_box), tile.page_num ^ (tile.variant << 24)));
   return ::qHash(QPair<uint, uint>(h1, h2));
 }
 
@@ -28,23 +28,25 @@ namespace Backend {
 class PDFPageTile
 {
 public:
-  // TODO:
-  // We may want an application-wide cache instead of a document-specific cache
-  // to keep memory usage down. This may require an additional piece of
-  // information---the document that the page belongs to.
-  PDFPageTile(double xres, double yres, QRect render_box, int page_num):
+  // Note: Tiles are only unique within one document; the application-wide
+  // PDFTileCache additionally keys them by the PDFPageCache of their document.
+  PDFPageTile(double xres, double yres, QRect render_box, int page_num, int variant = 0):
     xres(xres), yres(yres),
     render_box(render_box),
-    page_num(page_num)
+    page_num(page_num),
+    variant(variant)
   {}
 
   double xres, yres;
   QRect render_box;
   int page_num;
+  // Post-processed variants of a tile (see PDFColorTransform::Mode) are cached
+  // alongside the actual rendering (variant 0)
+  int variant;
 
   bool operator==(const PDFPageTile &other) const
   {
-    return (xres == other.xres && yres == other.yres && render_box == other.render_box && page_num == other.page_num);
+    return (xres == other.xres && yres == other.yres && render_box == other.render_box && page_num == other.page_num && variant == other.variant);
   }
 
   bool operator <(const PDFPageTile &other) const;
@@ -0,0 +1,339 @@
+/**
+ * Copyright (C) 2026  The TeXworks developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include "PDFPreviewCache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+
+namespace QtPDF {
+
+namespace Backend {
+
+namespace {
+
+// On-disk layout of a preview: this header, followed by the pixel data of a
+// 32 bit QImage (without padding). Previews are only meant to be read by the
+// machine that wrote them, so everything is stored in native byte order.
+struct PreviewHeader
+{
+  char magic[8];
+  quint32 width;
+  quint32 height;
+  quint32 bytesPerLine;
+  quint32 format;
+  quint32 reserved[2];
+};
+static_assert(sizeof(PreviewHeader) == 32, "Unexpected size of PreviewHeader");
+
+const char previewMagic[8] = {'Q', 'P', 'D', 'F', 'P', 'V', '0', '1'};
+
+bool isSupportedFormat(const QImage::Format format)
+{
+  return (format == QImage::Format_RGB32 || format == QImage::Format_ARGB32 || format == QImage::Format_ARGB32_Premultiplied);
+}
+
+// Cleanup function for memory-mapped QImages; closing the file also unmaps
+// the memory
+void closePreviewFile(void * info)
+{
+  delete static_cast<QFile *>(info);
+}
+
+} // anonymous namespace
+
+//static
+PDFPreviewCache & PDFPreviewCache::instance()
+{
+  static PDFPreviewCache cache;
+  return cache;
+}
+
+PDFPreviewCache::PDFPreviewCache()
+{
+  const QString baseDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (!baseDir.isEmpty())
+    _cacheDir = QDir(baseDir).filePath(QString::fromLatin1("QtPDF/previews"));
+}
+
+QString PDFPreviewCache::cacheDir() const
+{
+  QMutexLocker l(&_mutex);
+  return _cacheDir;
+}
+
+void PDFPreviewCache::setCacheDir(const QString & dir)
+{
+  QMutexLocker l(&_mutex);
+  _cacheDir = dir;
+  _size = -1;
+  _usedDocuments.clear();
+}
+
+qint64 PDFPreviewCache::maxSize() const
+{
+  QMutexLocker l(&_mutex);
+  return _maxSize;
+}
+
+void PDFPreviewCache::setMaxSize(const qint64 maxSize)
+{
+  QMutexLocker l(&_mutex);
+  _maxSize = qMax(Q_INT64_C(0), maxSize);
+  // Only trim if we know the size already; there is no point in scanning the
+  // cache (e.g., at startup) just to find out it is small enough
+  if (_maxSize > 0 && _size > _maxSize)
+    trim();
+}
+
+bool PDFPreviewCache::isEnabled() const
+{
+  QMutexLocker l(&_mutex);
+  return (_maxSize > 0 && !_cacheDir.isEmpty());
+}
+
+//static
+QByteArray PDFPreviewCache::hashData(const QByteArray & data)
+{
+  return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+//static
+QByteArray PDFPreviewCache::hashFile(const QString & filename)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly))
+    return QByteArray();
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  if (!hash.addData(&file))
+    return QByteArray();
+  return hash.result();
+}
+
+QImage PDFPreviewCache::preview(const QByteArray & docHash, const int page)
+{
+  QString path;
+  {
+    QMutexLocker l(&_mutex);
+    if (_maxSize <= 0 || _cacheDir.isEmpty() || docHash.isEmpty() || page < 0)
+      return QImage();
+    path = previewFile(docHash, page);
+  }
+
+  QFile * file = new QFile(path);
+  if (!file->open(QIODevice::ReadOnly)) {
+    delete file;
+    return QImage();
+  }
+
+  PreviewHeader header;
+  const bool headerValid = (file->read(reinterpret_cast<char *>(&header), sizeof(header)) == static_cast<qint64>(sizeof(header)) &&
+                            memcmp(header.magic, previewMagic, sizeof(previewMagic)) == 0 &&
+                            header.width > 0 && header.width <= 4 * PreviewSize &&
+                            header.height > 0 && header.height <= 4 * PreviewSize &&
+                            header.bytesPerLine == 4 * header.width &&
+                            isSupportedFormat(static_cast<QImage::Format>(header.format)));
+  const qint64 dataSize = static_cast<qint64>(header.bytesPerLine) * header.height;
+  if (!headerValid || file->size() != static_cast<qint64>(sizeof(header)) + dataSize) {
+    // Most likely written by an incompatible version; get rid of it
+    delete file;
+    QFile::remove(path);
+    return QImage();
+  }
+
+  const int w = static_cast<int>(header.width);
+  const int h = static_cast<int>(header.height);
+  const int bpl = static_cast<int>(header.bytesPerLine);
+  const QImage::Format format = static_cast<QImage::Format>(header.format);
+
+  QImage retVal;
+  // Map the file (copy-on-write so changes to the image never end up on disk);
+  // the QImage takes ownership of the file
+  uchar * data = file->map(sizeof(header), dataSize, QFileDevice::MapPrivateOption);
+  if (data)
+    retVal = QImage(data, w, h, bpl, format, closePreviewFile, file);
+  else {
+    // Fall back to reading the data if mapping is not supported
+    retVal = QImage(w, h, format);
+    for (int y = 0; y < h && !retVal.isNull(); ++y) {
+      if (file->read(reinterpret_cast<char *>(retVal.scanLine(y)), bpl) != bpl)
+        retVal = QImage();
+    }
+    delete file;
+  }
+
+  if (!retVal.isNull()) {
+    QMutexLocker l(&_mutex);
+    markUsed(docHash);
+  }
+  return retVal;
+}
+
+void PDFPreviewCache::storePreview(const QByteArray & docHash, const int page, const QImage & image)
+{
+  if (image.isNull() || docHash.isEmpty() || page < 0)
+    return;
+
+  QImage img = image;
+  if (!isSupportedFormat(img.format()))
+    img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+  PreviewHeader header;
+  memcpy(header.magic, previewMagic, sizeof(previewMagic));
+  header.width = static_cast<quint32>(img.width());
+  header.height = static_cast<quint32>(img.height());
+  header.bytesPerLine = 4 * header.width;
+  header.format = static_cast<quint32>(img.format());
+  header.reserved[0] = header.reserved[1] = 0;
+
+  QMutexLocker l(&_mutex);
+  if (_maxSize <= 0 || _cacheDir.isEmpty())
+    return;
+
+  if (!QDir().mkpath(documentDir(docHash)))
+    return;
+
+  // Write to a temporary file first so concurrent readers (possibly in other
+  // instances) never see partial previews
+  QSaveFile file(previewFile(docHash, page));
+  if (!file.open(QIODevice::WriteOnly))
+    return;
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (int y = 0; y < img.height(); ++y)
+    file.write(reinterpret_cast<const char *>(img.constScanLine(y)), header.bytesPerLine);
+  if (!file.commit())
+    return;
+
+  markUsed(docHash);
+  if (_size < 0)
+    _size = scanSize();
+  else
+    _size += static_cast<qint64>(sizeof(header)) + static_cast<qint64>(header.bytesPerLine) * header.height;
+  if (_size > _maxSize)
+    trim();
+}
+
+void PDFPreviewCache::removeDocument(const QByteArray & docHash)
+{
+  QMutexLocker l(&_mutex);
+  if (_cacheDir.isEmpty() || docHash.isEmpty())
+    return;
+  QDir(documentDir(docHash)).removeRecursively();
+  _usedDocuments.remove(docHash);
+  _size = -1;
+}
+
+void PDFPreviewCache::clear()
+{
+  QMutexLocker l(&_mutex);
+  if (_cacheDir.isEmpty())
+    return;
+  QDir(_cacheDir).removeRecursively();
+  _usedDocuments.clear();
+  _size = 0;
+}
+
+qint64 PDFPreviewCache::size() const
+{
+  QMutexLocker l(&_mutex);
+  if (_size < 0)
+    _size = scanSize();
+  return _size;
+}
+
+QString PDFPreviewCache::documentDir(const QByteArray & docHash) const
+{
+  return QDir(_cacheDir).filePath(QString::fromLatin1(docHash.toHex()));
+}
+
+QString PDFPreviewCache::previewFile(const QByteArray & docHash, const int page) const
+{
+  return QDir(documentDir(docHash)).filePath(QString::fromLatin1("%1.preview").arg(page));
+}
+
+void PDFPreviewCache::markUsed(const QByteArray & docHash)
+{
+  // The modification time of the stamp file tells trim() which documents were
+  // used least recently. Only update it once per session to keep disk
+  // accesses to a minimum.
+  if (_usedDocuments.contains(docHash))
+    return;
+  QFile stamp(QDir(documentDir(docHash)).filePath(QString::fromLatin1("stamp")));
+  if (stamp.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    stamp.write(QDateTime::currentDateTimeUtc().toString(Qt::ISODate).toLatin1());
+    _usedDocuments.insert(docHash);
+  }
+}
+
+qint64 PDFPreviewCache::scanSize() const
+{
+  qint64 retVal{0};
+  const QDir dir(_cacheDir);
+  foreach(const QFileInfo & docDir, dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    foreach(const QFileInfo & fi, QDir(docDir.absoluteFilePath()).entryInfoList(QDir::Files))
+      retVal += fi.size();
+  }
+  return retVal;
+}
+
+void PDFPreviewCache::trim()
+{
+  struct DocumentInfo {
+    QString path;
+    QDateTime lastUsed;
+    qint64 size;
+  };
+
+  QVector<DocumentInfo> docs;
+  qint64 total{0};
+  const QDir dir(_cacheDir);
+  foreach(const QFileInfo & docDir, dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+    DocumentInfo info{docDir.absoluteFilePath(), docDir.lastModified(), 0};
+    foreach(const QFileInfo & fi, QDir(info.path).entryInfoList(QDir::Files)) {
+      info.size += fi.size();
+      if (fi.fileName() == QString::fromLatin1("stamp"))
+        info.lastUsed = fi.lastModified();
+    }
+    total += info.size;
+    docs.append(info);
+  }
+
+  std::sort(docs.begin(), docs.end(), [](const DocumentInfo & a, const DocumentInfo & b) { return a.lastUsed < b.lastUsed; });
+
+  // Remove whole documents (least recently used first) until there is some
+  // headroom so we don't have to do this again for the next preview. The
+  // most recently used document is always kept, even if it exceeds the limit
+  // all by itself.
+  const qint64 target = _maxSize - _maxSize / 4;
+  for (int i = 0; i < docs.size() - 1 && total > target; ++i) {
+    if (!QDir(docs[i].path).removeRecursively())
+      continue;
+    total -= docs[i].size;
+    _usedDocuments.remove(QByteArray::fromHex(QFileInfo(docs[i].path).fileName().toLatin1()));
+  }
+  _size = total;
+}
+
+} // namespace Backend
+
+} // namespace QtPDF
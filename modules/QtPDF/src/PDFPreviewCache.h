@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2026  The TeXworks developers
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+#ifndef PDFPreviewCache_H
+#define PDFPreviewCache_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+
+namespace QtPDF {
+
+namespace Backend {
+
+// Persistent cache of low-resolution renderings of whole pages (previews),
+// shared by all documents and kept across sessions. It allows to show
+// something meaningful immediately when a (large) pdf is opened again while
+// the actual tiles are still rendering.
+// Previews are keyed by a hash of the pdf's content (so a modified file never
+// picks up stale previews) and the page index. Each preview is stored in a
+// file of its own that consists of a small header followed by the raw pixel
+// data, so it can be mapped into memory instead of being decoded. When the
+// cache grows beyond its size limit, the previews of the documents that were
+// used least recently are removed.
+// This class is thread-safe.
+class PDFPreviewCache
+{
+public:
+  // Length of the longer side of previews (in pixels)
+  static const int PreviewSize = 256;
+
+  static PDFPreviewCache & instance();
+
+  // Directory the previews are stored in. Defaults to a subdirectory of the
+  // user's cache location.
+  QString cacheDir() const;
+  void setCacheDir(const QString & dir);
+  // Maximum size of all previews on disk (in bytes); 0 disables the cache
+  qint64 maxSize() const;
+  void setMaxSize(const qint64 maxSize);
+  bool isEnabled() const;
+
+  // Keys for documents
+  static QByteArray hashData(const QByteArray & data);
+  static QByteArray hashFile(const QString & filename);
+
+  // Returns the preview of the given page or a null image if none is stored.
+  // The returned image is memory-mapped from disk (if supported).
+  QImage preview(const QByteArray & docHash, const int page);
+  void storePreview(const QByteArray & docHash, const int page, const QImage & image);
+  // Removes all previews of the given document
+  void removeDocument(const QByteArray & docHash);
+  // Removes all previews
+  void clear();
+  // Total size of all previews on disk (in bytes)
+  qint64 size() const;
+
+private:
+  PDFPreviewCache();
+
+  // The caller must hold _mutex
+  QString documentDir(const QByteArray & docHash) const;
+  QString previewFile(const QByteArray & docHash, const int page) const;
+  void markUsed(const QByteArray & docHash);
+  qint64 scanSize() const;
+  void trim();
+
+  mutable QMutex _mutex;
+  QString _cacheDir;
+  qint64 _maxSize{64 * 1024 * 1024};
+  // Total size of the cache on disk; -1 if it has not been determined yet
+  mutable qint64 _size{-1};
+  // Documents whose time stamp was updated in this session
+  QSet<QByteArray> _usedDocuments;
+};
+
+} // namespace Backend
+
+} // namespace QtPDF
+
+#endif // !defined(PDFPreviewCache_H)
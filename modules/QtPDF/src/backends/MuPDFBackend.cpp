@@ -371,8 +371,7 @@ public:
 // ==============
 Document::Document(QString fileName):
   Super(fileName),
-  _mupdf_data(NULL),
-  _glyph_cache(fz_new_glyph_cache())
+  _mupdf_data(NULL)
 {
 #ifdef DEBUG
 //  qDebug() << "MuPDF::Document::Document(" << fileName << ")";
@@ -395,17 +394,36 @@ Document::~Document()
     _mupdf_data = NULL;
   }
 
-  fz_free_glyph_cache(_glyph_cache);
+  QMutexLocker glyphCacheLocker(&_glyph_cache_mutex);
+  foreach (fz_glyph_cache * cache, _glyph_caches)
+    fz_free_glyph_cache(cache);
+  _glyph_caches.clear();
+}
+
+fz_glyph_cache * Document::acquireGlyphCache() const
+{
+  QMutexLocker glyphCacheLocker(&_glyph_cache_mutex);
+  if (_glyph_caches.isEmpty())
+    return fz_new_glyph_cache();
+  return _glyph_caches.takeLast();
+}
+
+void Document::releaseGlyphCache(fz_glyph_cache * cache) const
+{
+  if (!cache)
+    return;
+  QMutexLocker glyphCacheLocker(&_glyph_cache_mutex);
+  _glyph_caches.append(cache);
 }
 
 void Document::reload()
 {
-  // Clear the processing thread
+  // Clear the processing threads
   // NB: Do this before acquiring _docLock. See clearWorkStack() documentation.
   // This should not cause any problems as we are supposed to currently be in
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
-  _processingThread.clearWorkStack();
+  _processingThreadPool.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
   MuPDFLocaleResetter lr;
@@ -921,7 +939,8 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   fz_pixmap *mu_image = fz_new_pixmap_with_rect(fz_device_bgr, render_bbox);
   // Flush to white.
   fz_clear_pixmap_with_color(mu_image, 255);
-  fz_device *renderer = fz_new_draw_device(static_cast<Document *>(_parent)->_glyph_cache, mu_image);
+  fz_glyph_cache *glyph_cache = static_cast<Document *>(_parent)->acquireGlyphCache();
+  fz_device *renderer = fz_new_draw_device(glyph_cache, mu_image);
 
   // Actually render the page.
   fz_execute_display_list(_mupdf_page, renderer, render_trans, render_bbox);
@@ -935,12 +954,13 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   // Dispose of unneeded items.
   fz_free_device(renderer);
   fz_drop_pixmap(mu_image);
+  static_cast<Document *>(_parent)->releaseGlyphCache(glyph_cache);
 
   if( cache ) {
+    // The cache shares the pixel data with the returned image; as cached
+    // images are never modified, there is no need for a deep copy
     PDFPageTile key(xres, yres, render_box, _n);
-    QImage * img = new QImage(renderedPage.copy());
-    if (img != _parent->pageCache().setImage(key, img, PDFPageCache::CURRENT))
-      delete img;
+    _parent->pageCache().setImage(key, PDFTileImage(new QImage(renderedPage)), PDFPageCache::CURRENT);
   }
 
   return renderedPage;
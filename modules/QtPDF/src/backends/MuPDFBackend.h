@@ -49,7 +49,13 @@ protected:
   // The pdf_xref is the main MuPDF object that represents a Document. Calls
   // that use it may have to be protected by a mutex.
   pdf_xref *_mupdf_data;
-  fz_glyph_cache *_glyph_cache;
+  // Glyph caches are not thread-safe. To render several pages concurrently,
+  // each rendering operation borrows a cache that is not in use by another
+  // thread (new caches are created as needed).
+  mutable QList<fz_glyph_cache*> _glyph_caches;
+  mutable QMutex _glyph_cache_mutex;
+  fz_glyph_cache * acquireGlyphCache() const;
+  void releaseGlyphCache(fz_glyph_cache * cache) const;
 
   void loadMetaData();
 
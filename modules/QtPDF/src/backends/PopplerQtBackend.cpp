@@ -16,6 +16,7 @@
 #include "PDFBackend.h"
 
 #include <QBitArray>
+#include <QElapsedTimer>
 
 #if defined(HAVE_POPPLER_XPDF_HEADERS) && defined(Q_OS_DARWIN)
 #include "poppler-config.h"
@@ -142,13 +143,16 @@ void convertAnnotation(Annotation::AbstractAnnotation * dest, const ::Poppler::A
 
 // Document Class
 // ==============
+//static
+QAtomicInt Document::_defaultMaxHandleCount{0};
+
 Document::Document(const QString & fileName):
-  Super(fileName),
-  _poppler_doc(::Poppler::Document::load(fileName))
+  Super(fileName)
 {
 #ifdef DEBUG
 //  qDebug() << "PopplerQt::Document::Document(" << fileName << ")";
 #endif
+  loadPopplerDocument();
   parseDocument();
 }
 
@@ -158,32 +162,235 @@ Document::~Document()
 //  qDebug() << "PopplerQt::Document::~Document()";
 #endif
   clearPages();
-  delete _poppler_docLock;
 }
 
 void Document::reload()
 {
-  // Clear the processing thread
+  // Clear the processing threads
   // NB: Do this before acquiring _docLock. See clearWorkStack() documentation.
   // This should not cause any problems as we are supposed to currently be in
   // the main (GUI) thread, and only this thread is supposed to add items to the
   // work stack.
-  _processingThread.clearWorkStack();
+  _processingThreadPool.clearWorkStack();
 
   QWriteLocker docLocker(_docLock.data());
 
+  rememberFingerprints();
   clearPages();
   _pageCache.markOutdated();
 
+  // Note: if the document was unlocked before, loadPopplerDocument() tries to
+  // unlock it again with the same password
+  loadPopplerDocument();
+
+  parseDocument();
+}
+
+//static
+int Document::defaultMaxHandleCount()
+{
+  const int numHandles = _defaultMaxHandleCount.loadAcquire();
+  if (numHandles > 0)
+    return numHandles;
+  // Each handle holds its own copy of Poppler's internal data structures (but
+  // shares the raw file data), so don't go overboard on many-core machines
+  return qBound(1, QThread::idealThreadCount(), 4);
+}
+
+//static
+void Document::setDefaultMaxHandleCount(const int numHandles)
+{
+  _defaultMaxHandleCount.storeRelease(numHandles);
+}
+
+int Document::maxHandleCount() const
+{
+  QMutexLocker locker(&_poppler_handlesMutex);
+  return _poppler_maxHandles;
+}
+
+void Document::setMaxHandleCount(const int numHandles)
+{
+  QMutexLocker locker(&_poppler_handlesMutex);
+  _poppler_maxHandles = (numHandles > 0 ? numHandles : defaultMaxHandleCount());
+  // Superfluous handles are discarded in releasePopplerHandle(). Note that
+  // switching from 1 to more handles only takes effect after the next
+  // reload() as the file data is not kept in memory otherwise.
+}
+
+Document::ContentionStatistics Document::contentionStatistics(const HandleUsage usage) const
+{
+  QMutexLocker locker(&_poppler_handlesMutex);
+  if (usage < 0 || usage >= NumHandleUsages)
+    return ContentionStatistics();
+  return _contentionStatistics[usage];
+}
+
+void Document::resetContentionStatistics()
+{
+  QMutexLocker locker(&_poppler_handlesMutex);
+  for (ContentionStatistics & stats : _contentionStatistics)
+    stats = ContentionStatistics();
+}
+
+//static
+void Document::setupPopplerDocument(::Poppler::Document * doc)
+{
+  if (!doc)
+    return;
+  // **TODO:**
+  //
+  // _Make these configurable._
+  doc->setRenderBackend(::Poppler::Document::SplashBackend);
+  // Make things look pretty.
+  doc->setRenderHint(::Poppler::Document::Antialiasing);
+  doc->setRenderHint(::Poppler::Document::TextAntialiasing);
+}
+
+//static
+QSharedPointer< ::Poppler::Document > Document::newPopplerHandle(const QByteArray & data, const QByteArray & password)
+{
+  QSharedPointer< ::Poppler::Document > handle(::Poppler::Document::loadFromData(data, password, password));
+  setupPopplerDocument(handle.data());
+  return handle;
+}
+
+void Document::loadPopplerDocument()
+{
+  QMutexLocker locker(&_poppler_handlesMutex);
+
+  // Wait until all handles are returned (e.g., from Page::boxes() which does
+  // not hold the docLock) before discarding them
+  while (_poppler_freeHandles.size() < _poppler_numHandles)
+    _poppler_handleReleased.wait(&_poppler_handlesMutex);
+  _poppler_freeHandles.clear();
+  _poppler_numHandles = 0;
+  _poppler_doc.clear();
+  _poppler_data.clear();
+  resetContentHash();
+
+  if (_poppler_maxHandles > 1) {
+    // Load all handles from the same data so they are guaranteed to be
+    // consistent even if the file on disk changes in the meantime
+    QFile file(_fileName);
+    if (file.open(QIODevice::ReadOnly))
+      _poppler_data = file.readAll();
+    if (!_poppler_data.isEmpty())
+      _poppler_doc = newPopplerHandle(_poppler_data, _password);
+  }
+  else {
+    _poppler_doc = QSharedPointer< ::Poppler::Document >(::Poppler::Document::load(_fileName, _password, _password));
+    setupPopplerDocument(_poppler_doc.data());
+  }
+
+  if (_poppler_doc) {
+    _poppler_freeHandles << _poppler_doc;
+    _poppler_numHandles = 1;
+  }
+}
+
+QByteArray Document::computeContentHash() const
+{
+  // Identify the document in the persistent preview cache by its content
+  // (rather than its name) so previews of previous versions are never used
+  if (!_poppler_doc)
+    return QByteArray();
+  return (_poppler_data.isEmpty() ? PDFPreviewCache::hashFile(_fileName) : PDFPreviewCache::hashData(_poppler_data));
+}
+
+void Document::resetPopplerHandles()
+{
+  QMutexLocker locker(&_poppler_handlesMutex);
+
+  while (_poppler_freeHandles.size() < _poppler_numHandles)
+    _poppler_handleReleased.wait(&_poppler_handlesMutex);
+  _poppler_freeHandles.clear();
+  _poppler_numHandles = 0;
+
+  if (_poppler_doc) {
+    _poppler_freeHandles << _poppler_doc;
+    _poppler_numHandles = 1;
+  }
+}
+
+QSharedPointer< ::Poppler::Document > Document::acquirePopplerHandle(const HandleUsage usage, const bool requirePrimary) const
+{
+  QSharedPointer< ::Poppler::Document > handle;
+  QElapsedTimer timer;
+  bool blocked{false};
+
+  timer.start();
+  QMutexLocker locker(&_poppler_handlesMutex);
+  while (_poppler_doc) {
+    if (requirePrimary) {
+      if (_poppler_freeHandles.removeOne(_poppler_doc)) {
+        handle = _poppler_doc;
+        break;
+      }
+    }
+    else if (!_poppler_freeHandles.isEmpty()) {
+      // Prefer the most recently used handle as its caches are likely warm
+      handle = _poppler_freeHandles.takeLast();
+      break;
+    }
+    else if (_poppler_numHandles < _poppler_maxHandles && !_poppler_data.isEmpty()) {
+      // Loading a document can take a while, so don't block other threads
+      // (that may want to return their handles) in the meantime. Reserving
+      // the slot ensures that loadPopplerDocument() & co. wait for us.
+      ++_poppler_numHandles;
+      const QByteArray data = _poppler_data;
+      const QByteArray password = _password;
+      locker.unlock();
+      handle = newPopplerHandle(data, password);
+      locker.relock();
+      if (handle)
+        break;
+      // Loading failed (e.g., because we ran out of memory); don't try again
+      --_poppler_numHandles;
+      _poppler_maxHandles = qMax(1, _poppler_numHandles);
+      continue;
+    }
+    blocked = true;
+    _poppler_handleReleased.wait(&_poppler_handlesMutex);
+  }
+
+  ContentionStatistics & stats = _contentionStatistics[usage];
+  const qint64 waitNs = timer.nsecsElapsed();
+  ++stats.numRequests;
+  if (blocked) {
+    ++stats.numBlocked;
+    stats.totalWaitNs += waitNs;
+    stats.maxWaitNs = qMax(stats.maxWaitNs, waitNs);
+  }
+  return handle;
+}
+
+void Document::releasePopplerHandle(const QSharedPointer< ::Poppler::Document > & handle) const
+{
+  if (!handle)
+    return;
   {
-    QMutexLocker l(_poppler_docLock);
-    _poppler_doc = QSharedPointer< ::Poppler::Document >(::Poppler::Document::load(_fileName));
+    QMutexLocker locker(&_poppler_handlesMutex);
+    if (handle != _poppler_doc && _poppler_numHandles > _poppler_maxHandles)
+      --_poppler_numHandles;
+    else
+      _poppler_freeHandles << handle;
   }
+  // Wake all waiting threads as some of them may need a particular handle
+  _poppler_handleReleased.wakeAll();
+}
 
-  // TODO: possibly unlock the new document again if it was previously unlocked
-  // and the password is still the same
+Document::PopplerDocLocker::PopplerDocLocker(const Document * doc, const HandleUsage usage, const bool requirePrimary /* = false */) :
+  _doc(doc)
+{
+  if (_doc)
+    _handle = _doc->acquirePopplerHandle(usage, requirePrimary);
+}
 
-  parseDocument();
+Document::PopplerDocLocker::~PopplerDocLocker()
+{
+  if (_doc)
+    _doc->releasePopplerHandle(_handle);
 }
 
 void Document::parseDocument()
@@ -220,13 +427,7 @@ void Document::parseDocument()
   if (_poppler_doc->okToPrintHighRes())
     _permissions |= Permission_PrintHighRes;
 
-  // **TODO:**
-  //
-  // _Make these configurable._
-  _poppler_doc->setRenderBackend(::Poppler::Document::SplashBackend);
-  // Make things look pretty.
-  _poppler_doc->setRenderHint(::Poppler::Document::Antialiasing);
-  _poppler_doc->setRenderHint(::Poppler::Document::TextAntialiasing);
+  setupPopplerDocument(_poppler_doc.data());
 
   // Load meta data
   QStringList metaKeys = _poppler_doc->infoKeys();
@@ -314,10 +515,11 @@ QWeakPointer<Backend::Page> Document::page(int at)
     _pages.resize(_numPages);
 
   // If we got here, we don't have the page cached. As we need to create a new
-  // page, we need to make sure the Poppler document is valid and does not go
-  // out of scope
-  QMutexLocker popplerLocker(_poppler_docLock);
-  if (!_poppler_doc)
+  // page, we need to make sure the Poppler document is valid and not used by
+  // any other thread. The ::Poppler::Page objects of our pages always belong
+  // to the primary handle.
+  PopplerDocLocker popplerDoc(this, Usage_Other, true);
+  if (!popplerDoc)
     return QWeakPointer<Backend::Page>();
 
   _pages[at] = QSharedPointer<Backend::Page>(new Page(this, at, _docLock));
@@ -335,10 +537,13 @@ PDFDestination Document::resolveDestination(const PDFDestination & namedDestinat
 
   // If the destination could not be resolved (a nullptr or an invalid page
   // number is returned), return an invalid object
-  ::Poppler::LinkDestination * dest = _poppler_doc->linkDestination(namedDestination.destinationName());
+  PopplerDocLocker popplerDoc(this, Usage_Links);
+  if (!popplerDoc)
+    return PDFDestination();
+  ::Poppler::LinkDestination * dest = popplerDoc->linkDestination(namedDestination.destinationName());
   if (dest == nullptr || dest->pageNumber() < 1)
     return PDFDestination();
-  return toPDFDestination(_poppler_doc.data(), *dest);
+  return toPDFDestination(popplerDoc.document(), *dest);
 }
 
 #if POPPLER_HAS_OUTLINE
@@ -413,6 +618,8 @@ PDFToC Document::toc() const
   if (!_poppler_doc || _isLocked())
     return retVal;
 
+  // recursiveConvertToC() operates on _poppler_doc
+  PopplerDocLocker popplerDoc(this, Usage_Other, true);
 #if POPPLER_HAS_OUTLINE
   recursiveConvertToC(retVal, _poppler_doc->outline());
 #else // POPPLER_HAS_OUTLINE
@@ -437,7 +644,14 @@ QList<PDFFontInfo> Document::fonts() const
 
   _fontsLoaded = true;
 
-  foreach(::Poppler::FontInfo popplerFontInfo, _poppler_doc->fonts()) {
+  QList< ::Poppler::FontInfo > popplerFonts;
+  {
+    PopplerDocLocker popplerDoc(this, Usage_Other);
+    if (popplerDoc)
+      popplerFonts = popplerDoc->fonts();
+  }
+
+  foreach(::Poppler::FontInfo popplerFontInfo, popplerFonts) {
     PDFFontInfo fi;
     if (popplerFontInfo.isEmbedded())
       fi.setSource(PDFFontInfo::Source_Embedded);
@@ -519,13 +733,23 @@ bool Document::unlock(const QString password)
   // Note: we try unlocking regardless of what isLocked() returns as the user
   // might want to unlock a document with the owner's password when user level
   // access is already granted.
-  bool success = !_poppler_doc->unlock(password.toLatin1(), password.toLatin1());
+  bool success{false};
+  {
+    PopplerDocLocker popplerDoc(this, Usage_Other, true);
+    success = (popplerDoc && !popplerDoc->unlock(password.toLatin1(), password.toLatin1()));
+  }
 
-  if (success)
+  if (success) {
+    // Store the password for this session so additional handles and reloaded
+    // documents (e.g., if the file has changed on the disk) can be unlocked
+    {
+      QMutexLocker locker(&_poppler_handlesMutex);
+      _password = password.toLatin1();
+    }
+    // Discard any additional handles that were loaded before unlocking
+    resetPopplerHandles();
     parseDocument();
-
-  // FIXME: Store password for this session in case we need to reload the
-  // document later on (e.g., if it has changed on the disk)
+  }
 
   return success;
 }
@@ -545,6 +769,16 @@ Page::~Page()
   QWriteLocker pageLocker(_pageLock);
 }
 
+QSharedPointer< ::Poppler::Page > Page::popplerPageFor(const Document::PopplerDocLocker & popplerDoc) const
+{
+  if (!popplerDoc)
+    return QSharedPointer< ::Poppler::Page >();
+  if (popplerDoc.isPrimary())
+    return _poppler_page;
+  // The returned page must not outlive popplerDoc
+  return QSharedPointer< ::Poppler::Page >(popplerDoc->page(_n));
+}
+
 // TODO: Does this operation require obtaining the Poppler document mutex? If
 // so, it would be better to store the value in a member variable during
 // initialization.
@@ -566,23 +800,27 @@ QImage Page::renderToImage(double xres, double yres, QRect render_box, bool cach
   QImage renderedPage;
 
   {
-    // Rendering pages is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+    // Rendering pages is not thread safe, but we can render concurrently using
+    // different Poppler documents.
+    Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Render);
+    QSharedPointer< ::Poppler::Page > popplerPage = popplerPageFor(popplerDoc);
+    if (!popplerPage)
+      return QImage();
     if( render_box.isNull() ) {
       // A null QRect has a width and height of 0 --- we will tell Poppler to render the whole
       // page.
-      renderedPage = _poppler_page->renderToImage(xres, yres);
+      renderedPage = popplerPage->renderToImage(xres, yres);
     } else {
-      renderedPage = _poppler_page->renderToImage(xres, yres,
+      renderedPage = popplerPage->renderToImage(xres, yres,
           render_box.x(), render_box.y(), render_box.width(), render_box.height());
     }
   }
 
   if( cache ) {
+    // The cache shares the pixel data with the returned image; as cached
+    // images are never modified, there is no need for a deep copy
     PDFPageTile key(xres, yres, render_box, _n);
-    QImage * img = new QImage(renderedPage.copy());
-    if (img != _parent->pageCache().setImage(key, img, PDFPageCache::CURRENT))
-      delete img;
+    _parent->pageCache().setImage(key, PDFTileImage(new QImage(renderedPage)), PDFPageCache::CURRENT);
   }
 
   return renderedPage;
@@ -609,9 +847,11 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
   _linksLoaded = true;
   QList< ::Poppler::Link *> popplerLinks;
   QList< ::Poppler::Annotation *> popplerAnnots;
-  {
-    // Loading links is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Backend::PopplerQt::Document *>(_parent)->_poppler_docLock);
+  // Loading links is not thread safe. The returned objects refer to the
+  // Poppler document of _poppler_page, so we need the primary handle and keep
+  // it until we are done with them.
+  Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Links, true);
+  if (popplerDoc) {
     popplerLinks = _poppler_page->links();
     popplerAnnots = _poppler_page->annotations();
   }
@@ -655,7 +895,7 @@ QList< QSharedPointer<Annotation::Link> > Page::loadLinks()
       case ::Poppler::Link::Goto:
         {
           ::Poppler::LinkGoto * popplerGoto = dynamic_cast< ::Poppler::LinkGoto *>(popplerLink);
-          PDFGotoAction * action = new PDFGotoAction(toPDFDestination(dynamic_cast<Document *>(_parent)->_poppler_doc.data(), popplerGoto->destination()));
+          PDFGotoAction * action = new PDFGotoAction(toPDFDestination(popplerDoc.document(), popplerGoto->destination()));
           if (popplerGoto->isExternal()) {
             // TODO: Verify that ::Poppler::LinkGoto only refers to pdf files
             // (for other file types we would need PDFLaunchAction)
@@ -717,8 +957,11 @@ QList< QSharedPointer<Annotation::AbstractAnnotation> > Page::loadAnnotations()
   QList< ::Poppler::Annotation *> popplerAnnots;
   {
     // Loading annotations is not thread safe.
-    QMutexLocker popplerDocLock(dynamic_cast<Document *>(_parent)->_poppler_docLock);
-    popplerAnnots = _poppler_page->annotations();
+    // The returned objects refer to the Poppler document of _poppler_page, so
+    // we need the primary handle
+    Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Annotations, true);
+    if (popplerDoc)
+      popplerAnnots = _poppler_page->annotations();
   }
 
   // we don't need the docLock anymore
@@ -820,7 +1063,10 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
 
   result.pageNum = static_cast<unsigned int>(_n);
 
-  QMutexLocker popplerDocLock(dynamic_cast<Document *>(_parent)->_poppler_docLock);
+  Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Search);
+  QSharedPointer< ::Poppler::Page > popplerPage = popplerPageFor(popplerDoc);
+  if (!popplerPage)
+    return results;
 
   if (flags & Search_Backwards) {
     left = right = pageSizeF().width();
@@ -831,7 +1077,7 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
   // depreciated---something to do with float <-> double conversion causing
   // infinite loops on some architectures. So, we explicitly use doubles and
   // avoid the depreciated function.
-  while ( _poppler_page->search(searchText, left, top, right, bottom, searchDir, searchFlags) ) {
+  while ( popplerPage->search(searchText, left, top, right, bottom, searchDir, searchFlags) ) {
     result.bbox = QRectF(qreal(left), qreal(top), qAbs(qreal(right) - qreal(left)), qAbs(qreal(bottom) - qreal(top)));
     results << result;
   }
@@ -839,6 +1085,42 @@ QList<SearchResult> Page::search(const QString & searchText, const SearchFlags &
   return results;
 }
 
+QSharedPointer<Backend::PageText> Page::extractText()
+{
+  QReadLocker docLocker(_docLock.data());
+  QReadLocker pageLocker(_pageLock);
+  if (!_parent)
+    return QSharedPointer<Backend::PageText>();
+
+  QList< ::Poppler::TextBox * > popplerBoxes;
+  {
+    Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Search);
+    QSharedPointer< ::Poppler::Page > popplerPage = popplerPageFor(popplerDoc);
+    if (!popplerPage)
+      return QSharedPointer<Backend::PageText>();
+    popplerBoxes = popplerPage->textList();
+  }
+
+  QSharedPointer<Backend::PageText> retVal(new Backend::PageText());
+  QVector<QRectF> charBoxes;
+  foreach (::Poppler::TextBox * popplerTextBox, popplerBoxes) {
+    if (!popplerTextBox)
+      continue;
+    const QString text = popplerTextBox->text();
+    charBoxes.resize(text.length());
+    for (int i = 0; i < text.length(); ++i)
+      charBoxes[i] = popplerTextBox->charBoundingBox(i);
+    // Words split by a font change (e.g., for ligatures or accents) have no
+    // space after them; the last word of a line has none either, but still
+    // needs one to separate it from the next line
+    const bool spaceAfter = (popplerTextBox->hasSpaceAfter() || !popplerTextBox->nextWord());
+    retVal->addWord(text, popplerTextBox->boundingBox(), charBoxes, spaceAfter);
+  }
+  // We own the boxes returned by textList()
+  qDeleteAll(popplerBoxes);
+  return retVal;
+}
+
 void Page::loadTransitionData()
 {
   QWriteLocker pageLocker(_pageLock);
@@ -932,7 +1214,12 @@ QList< Backend::Page::Box > Page::boxes()
   Q_ASSERT(_poppler_page != nullptr);
   QList< Backend::Page::Box > retVal;
 
-  foreach (::Poppler::TextBox * popplerTextBox, _poppler_page->textList()) {
+  Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Text);
+  QSharedPointer< ::Poppler::Page > popplerPage = popplerPageFor(popplerDoc);
+  if (!popplerPage)
+    return retVal;
+
+  foreach (::Poppler::TextBox * popplerTextBox, popplerPage->textList()) {
     if (!popplerTextBox)
       continue;
     Backend::Page::Box box;
@@ -961,7 +1248,13 @@ QString Page::selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF>
   bool insertSpace = false;
 
   // Get a list of all boxes
-  QList<Poppler::TextBox*> poppler_boxes = _poppler_page->textList();
+  QList<Poppler::TextBox*> poppler_boxes;
+  {
+    Document::PopplerDocLocker popplerDoc(dynamic_cast<Document *>(_parent), Document::Usage_Text);
+    QSharedPointer< ::Poppler::Page > popplerPage = popplerPageFor(popplerDoc);
+    if (popplerPage)
+      poppler_boxes = popplerPage->textList();
+  }
   Poppler::TextBox * lastPopplerBox = nullptr;
 
   // Filter boxes by selection
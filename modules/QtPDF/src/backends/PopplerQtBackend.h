@@ -51,10 +51,65 @@ class Document: public Backend::Document
   void recursiveConvertToC(QList<PDFToCItem> & items, QDomNode node) const;
 #endif
 
+public:
+  // Kinds of operations that need exclusive access to a Poppler document; used
+  // to break down the contention statistics
+  enum HandleUsage { Usage_Render, Usage_Links, Usage_Annotations, Usage_Search, Usage_Text, Usage_Other, NumHandleUsages };
+
+  struct ContentionStatistics {
+    quint64 numRequests{0};
+    // number of requests that had to wait for another thread to finish
+    quint64 numBlocked{0};
+    qint64 totalWaitNs{0};
+    qint64 maxWaitNs{0};
+  };
+
 protected:
-  // Poppler is not threadsafe, so some operations need to be serialized with a
-  // mutex.
-  QMutex * _poppler_docLock{new QMutex};
+  // Poppler is not threadsafe, so a ::Poppler::Document must never be used by
+  // two threads at the same time. To still process requests concurrently, we
+  // keep a pool of independently loaded ::Poppler::Document instances
+  // ("handles") of the same file. _poppler_doc is the primary handle (which
+  // also owns the ::Poppler::Page objects of our pages); additional handles
+  // are only created on demand when all existing ones are in use. Use
+  // PopplerDocLocker to borrow a handle.
+  class PopplerDocLocker
+  {
+  public:
+    PopplerDocLocker(const Document * doc, const HandleUsage usage, const bool requirePrimary = false);
+    ~PopplerDocLocker();
+    ::Poppler::Document * document() const { return _handle.data(); }
+    bool isPrimary() const { return (_handle && _handle == _doc->_poppler_doc); }
+    ::Poppler::Document * operator->() const { return _handle.data(); }
+    explicit operator bool() const { return !_handle.isNull(); }
+  private:
+    Q_DISABLE_COPY(PopplerDocLocker)
+    const Document * _doc;
+    QSharedPointer< ::Poppler::Document > _handle;
+  };
+
+  // The raw file contents. Used to load additional handles (to make sure they
+  // are consistent with _poppler_doc even if the file changes on disk). Only
+  // kept if more than one handle is allowed.
+  QByteArray _poppler_data;
+  QByteArray _password;
+  mutable QMutex _poppler_handlesMutex;
+  mutable QWaitCondition _poppler_handleReleased;
+  mutable QList< QSharedPointer< ::Poppler::Document > > _poppler_freeHandles;
+  mutable int _poppler_numHandles{0};
+  mutable int _poppler_maxHandles{defaultMaxHandleCount()};
+  mutable ContentionStatistics _contentionStatistics[NumHandleUsages];
+
+  // The caller must hold a doc-write-lock
+  void loadPopplerDocument();
+  QByteArray computeContentHash() const override;
+  // Waits until all handles are returned, discards all but the primary one
+  // The caller must hold a doc-write-lock
+  void resetPopplerHandles();
+  QSharedPointer< ::Poppler::Document > acquirePopplerHandle(const HandleUsage usage, const bool requirePrimary) const;
+  void releasePopplerHandle(const QSharedPointer< ::Poppler::Document > & handle) const;
+  static QSharedPointer< ::Poppler::Document > newPopplerHandle(const QByteArray & data, const QByteArray & password);
+  static void setupPopplerDocument(::Poppler::Document * doc);
+
   // Since ::Poppler::Document::fonts() is extremely slow, we need to cache the
   // result.
   mutable QList<PDFFontInfo> _fonts;
@@ -81,8 +136,21 @@ public:
   PDFToC toc() const override;
   QList<PDFFontInfo> fonts() const override;
 
+  // Maximum number of Poppler documents used to serve requests concurrently.
+  // A value of 1 serializes all requests (at the lowest memory cost).
+  int maxHandleCount() const;
+  void setMaxHandleCount(const int numHandles);
+  static int defaultMaxHandleCount();
+  static void setDefaultMaxHandleCount(const int numHandles);
+
+  // Statistics about how long requests had to wait for a Poppler document
+  ContentionStatistics contentionStatistics(const HandleUsage usage) const;
+  void resetContentionStatistics();
+
 private:
   void parseDocument();
+
+  static QAtomicInt _defaultMaxHandleCount;
 };
 
 
@@ -98,6 +166,9 @@ class Page: public Backend::Page
   bool _linksLoaded{false};
 
   void loadTransitionData();
+  // Returns _poppler_page or (for secondary handles) a temporary equivalent
+  // that must not outlive popplerDoc
+  QSharedPointer< ::Poppler::Page > popplerPageFor(const Document::PopplerDocLocker & popplerDoc) const;
 
 protected:
   Page(Document *parent, int at, QSharedPointer<QReadWriteLock> docLock);
@@ -115,6 +186,7 @@ public:
   QString selectedText(const QList<QPolygonF> & selection, QMap<int, QRectF> * wordBoxes = nullptr, QMap<int, QRectF> * charBoxes = nullptr, const bool onlyFullyEnclosed = false) override;
 
   QList<Backend::SearchResult> search(const QString & searchText, const SearchFlags & flags) override;
+  QSharedPointer<Backend::PageText> extractText() override;
 };
 
 } // namespace PopplerQt
@@ -21,6 +21,10 @@
 #include "TestQtPDF.h"
 #include "PaperSizes.h"
 
+#include <QPainter>
+
+#include <algorithm>
+
 #ifdef USE_MUPDF
   typedef QtPDF::MuPDFBackend Backend;
 #elif USE_POPPLERQT
@@ -126,6 +130,43 @@ public:
 
 GenericPage::GenericPage(GenericDocument * parent, int at, QSharedPointer<QReadWriteLock> docLock) : QtPDF::Backend::Page(parent, at, docLock) { }
 
+// Listener that simply counts the pages rendered in the background
+class RenderEventCounter : public QObject
+{
+public:
+  int count{0};
+
+  bool event(QEvent * event) override {
+    if (event->type() == QtPDF::Backend::PDFPageRenderedEvent::PageRenderedEvent) {
+      ++count;
+      return true;
+    }
+    return QObject::event(event);
+  }
+
+  // Processes events until `num` pages were rendered or `timeout` ms passed
+  bool waitForRenderedPages(const int num, const int timeout = 60000) {
+    QElapsedTimer timer;
+    timer.start();
+    while (count < num && timer.elapsed() < timeout)
+      QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents, 100);
+    return (count >= num);
+  }
+};
+
+// Keeps the image of the last render event it received
+class RenderedImageCollector : public RenderEventCounter
+{
+public:
+  QtPDF::Backend::PDFTileImage image;
+
+  bool event(QEvent * event) override {
+    if (event->type() == QtPDF::Backend::PDFPageRenderedEvent::PageRenderedEvent)
+      image = static_cast<QtPDF::Backend::PDFPageRenderedEvent *>(event)->rendered_page;
+    return RenderEventCounter::event(event);
+  }
+};
+
 inline void sleep(int ms)
 {
 #ifdef Q_OS_MACOS
@@ -231,6 +272,9 @@ void TestQtPDF::abstractBaseClasses()
 
 void TestQtPDF::loadDocs()
 {
+  // Keep page previews out of the user's cache directory
+  QStandardPaths::setTestModeEnabled(true);
+
   Backend backend;
 
   // Don't run documents that may produce error messages in QBENCHMARK as
@@ -1627,6 +1671,91 @@ void TestQtPDF::page_search()
   }
 }
 
+void TestQtPDF::textIndex_data()
+{
+  // The text index must give the same results as the backend
+  page_search_data();
+}
+
+void TestQtPDF::textIndex()
+{
+  QFETCH(pPage, page);
+  QFETCH(QString, needle);
+  QFETCH(QList<QtPDF::Backend::SearchResult>, results);
+  QFETCH(QtPDF::Backend::SearchFlags, flags);
+
+  QtPDF::Backend::Document * doc = page->document();
+  QVERIFY(doc != nullptr);
+  QSharedPointer<const QtPDF::Backend::PageText> text = doc->pageText(page->pageNum());
+  if (!text)
+    QSKIP("Extracting text is not supported by the backend");
+  // The text is only extracted once
+  QCOMPARE(doc->pageText(page->pageNum()), text);
+
+  QList<QtPDF::Backend::SearchResult> actual = text->search(needle, flags, static_cast<unsigned int>(page->pageNum()));
+  compareSearchResults(actual, results);
+
+  // Backward searches give the same results in reverse order
+  QList<QtPDF::Backend::SearchResult> backwards = text->search(needle, flags | QtPDF::Backend::Search_Backwards, static_cast<unsigned int>(page->pageNum()));
+  std::reverse(backwards.begin(), backwards.end());
+  compareSearchResults(backwards, results);
+}
+
+void TestQtPDF::textIndexWordBreaks()
+{
+  using QtPDF::Backend::PageText;
+  using QtPDF::Backend::SearchResult;
+
+  // "Hello" is split by a font change (e.g., for an emphasized "lo"), so the
+  // two parts must not be separated by a space
+  PageText text;
+  text.addWord(QStringLiteral("Hel"), QRectF(10, 10, 15, 10), QVector<QRectF>(), false);
+  text.addWord(QStringLiteral("lo"), QRectF(25, 10, 10, 10), QVector<QRectF>(), true);
+  text.addWord(QStringLiteral("world"), QRectF(40, 10, 25, 10), QVector<QRectF>(), true);
+  QCOMPARE(text.text(), QStringLiteral("Hello world"));
+  QCOMPARE(text.words().size(), 3);
+
+  QList<SearchResult> results = text.search(QStringLiteral("hello"), QtPDF::Backend::SearchFlags(QtPDF::Backend::Search_CaseInsensitive), 0);
+  QCOMPARE(results.size(), 1);
+  QCOMPARE(results[0].bbox, QRectF(10, 10, 25, 10));
+  QVERIFY(text.search(QStringLiteral("Hel lo"), QtPDF::Backend::SearchFlags(), 0).isEmpty());
+
+  results = text.search(QStringLiteral("lo world"), QtPDF::Backend::SearchFlags(), 0);
+  QCOMPARE(results.size(), 1);
+  QCOMPARE(results[0].bbox, QRectF(25, 10, 40, 10));
+}
+
+void TestQtPDF::buildTextIndex()
+{
+  Backend backend;
+  pDoc doc = backend.newDocument(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(doc);
+  QVERIFY(doc->isValid());
+  const int numPages = doc->numPages();
+  QCOMPARE(doc->numIndexedPages(), 0);
+  if (!doc->page(0).toStrongRef()->extractText())
+    QSKIP("Extracting text is not supported by the backend");
+
+  doc->buildTextIndex();
+  QElapsedTimer timer;
+  timer.start();
+  while (doc->numIndexedPages() < numPages && timer.elapsed() < 60000)
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+  QCOMPARE(doc->numIndexedPages(), numPages);
+
+  const QString needle = QString::fromLatin1("times-roman");
+  const QtPDF::Backend::SearchFlags flags(QtPDF::Backend::Search_CaseInsensitive);
+  QList<QtPDF::Backend::SearchResult> expected;
+  for (int i = 0; i < numPages; ++i)
+    expected << doc->page(i).toStrongRef()->search(needle, flags);
+  QVERIFY(!expected.isEmpty());
+  compareSearchResults(doc->search(needle, flags), expected);
+
+  QBENCHMARK {
+    doc->search(needle, flags);
+  }
+}
+
 void TestQtPDF::paperSize_data()
 {
   QTest::addColumn<QSizeF>("requestSize");
@@ -1849,6 +1978,876 @@ void TestQtPDF::pageTile()
 #endif
 }
 
+void TestQtPDF::processingThreadPool()
+{
+  using QtPDF::Backend::PDFPageProcessingThreadPool;
+
+  int idealThreadCount = qMax(1, QThread::idealThreadCount());
+  QCOMPARE(PDFPageProcessingThreadPool::defaultMaxThreadCount(), idealThreadCount);
+
+  PDFPageProcessingThreadPool pool;
+  QCOMPARE(pool.maxThreadCount(), idealThreadCount);
+  pool.setMaxThreadCount(3);
+  QCOMPARE(pool.maxThreadCount(), 3);
+  pool.setMaxThreadCount(-1);
+  QCOMPARE(pool.maxThreadCount(), idealThreadCount);
+
+  PDFPageProcessingThreadPool::setDefaultMaxThreadCount(2);
+  QCOMPARE(PDFPageProcessingThreadPool::defaultMaxThreadCount(), 2);
+  QCOMPARE(pool.maxThreadCount(), 2);
+  PDFPageProcessingThreadPool::setDefaultMaxThreadCount(0);
+  QCOMPARE(pool.maxThreadCount(), idealThreadCount);
+
+  // Clearing an idle pool must not block
+  pool.clearWorkStack();
+}
+
+void TestQtPDF::renderViewport()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageProcessingThreadPool;
+  using QtPDF::Backend::PDFPageTile;
+
+  // Discarding placeholders only affects placeholders
+  {
+    PDFPageCache cache;
+    PDFPageTile placeholder(72, 72, QRect(0, 0, 1, 1), 0);
+    PDFPageTile current(72, 72, QRect(0, 0, 1, 1), 1);
+    cache.setImage(placeholder, QtPDF::Backend::PDFTileImage(new QImage(1, 1, QImage::Format_ARGB32)), PDFPageCache::PLACEHOLDER);
+    cache.setImage(current, QtPDF::Backend::PDFTileImage(new QImage(1, 1, QImage::Format_ARGB32)), PDFPageCache::CURRENT);
+    cache.discardPlaceholder(placeholder);
+    cache.discardPlaceholder(current);
+    QCOMPARE(cache.getStatus(placeholder), PDFPageCache::OUTDATED);
+    QCOMPARE(cache.getStatus(current), PDFPageCache::CURRENT);
+  }
+
+  pDoc doc = _docs[QStringLiteral("page-rotation")];
+  QVERIFY(doc);
+  QVERIFY(doc->isValid());
+  PDFPageProcessingThreadPool & pool = doc->processingThreadPool();
+
+  PDFPageProcessingThreadPool::Viewport viewport;
+  QVERIFY(viewport.isNull());
+  viewport.visible.insert(0, QRectF(0, 0, 100, 100));
+  viewport.ahead.insert(1, QRectF(0, 0, 100, 100));
+  QVERIFY(!viewport.isNull());
+
+  // Request all pages with only page 1 being visible. Requests for pages that
+  // are neither visible nor ahead may be dropped, but their tiles must never
+  // be left as placeholders (or they would never be rendered).
+  const double res = 36;
+  doc->pageCache().clear();
+  pool.setMaxThreadCount(1);
+  pool.setViewport(viewport);
+  RenderEventCounter listener;
+  QList<PDFPageTile> tiles;
+  for (int i = 0; i < doc->numPages(); ++i) {
+    pPage page = doc->page(i).toStrongRef();
+    QVERIFY(page);
+    QRect box = QRectF(QPointF(0, 0), page->pageSizeF() * res / 72.).toAlignedRect();
+    page->getTileImage(&listener, res, res, box);
+    tiles << PDFPageTile(res, res, box, i);
+  }
+  // Changing the viewport drops queued requests for pages 3 and 4
+  pool.setViewport(viewport);
+  QVERIFY(listener.waitForRenderedPages(2));
+
+  QElapsedTimer timer;
+  timer.start();
+  bool placeholdersLeft{true};
+  while (placeholdersLeft && timer.elapsed() < 60000) {
+    QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    placeholdersLeft = false;
+    foreach (const PDFPageTile & tile, tiles)
+      placeholdersLeft = placeholdersLeft || (doc->pageCache().getStatus(tile) == PDFPageCache::PLACEHOLDER);
+  }
+  QVERIFY(!placeholdersLeft);
+  QCOMPARE(doc->pageCache().getStatus(tiles[0]), PDFPageCache::CURRENT);
+  QCOMPARE(doc->pageCache().getStatus(tiles[1]), PDFPageCache::CURRENT);
+
+  pool.setViewport(PDFPageProcessingThreadPool::Viewport());
+  QVERIFY(pool.viewport().isNull());
+  pool.setMaxThreadCount(0);
+  doc->pageCache().clear();
+}
+
+void TestQtPDF::tileCache()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+  using QtPDF::Backend::PDFTileCache;
+
+  PDFTileCache & tileCache = PDFTileCache::instance();
+  const qint64 oldMaxSize = tileCache.maxSize();
+  const bool oldCompressionEnabled = tileCache.isCompressionEnabled();
+  // Test the eviction strategy only (compression is tested separately)
+  tileCache.setCompressionEnabled(false);
+  // Start from an empty cache
+  tileCache.setMaxSize(0);
+  QCOMPARE(tileCache.statistics().size, Q_INT64_C(0));
+
+  // 10x10 ARGB32 images take up 400 bytes each
+  auto newImage = []() { return QtPDF::Backend::PDFTileImage(new QImage(10, 10, QImage::Format_ARGB32)); };
+  const qint64 imgSize = 400;
+  tileCache.setMaxSize(3 * imgSize);
+  tileCache.resetStatistics();
+
+  {
+    PDFPageCache cache1, cache2;
+    PDFPageTile t0(72, 72, QRect(0, 0, 10, 10), 0);
+    PDFPageTile t1(72, 72, QRect(0, 0, 10, 10), 1);
+    PDFPageTile t2(72, 72, QRect(0, 0, 10, 10), 2);
+
+    // Identical tiles of different documents are different cache entries
+    cache1.setImage(t0, newImage(), PDFPageCache::CURRENT);
+    cache2.setImage(t0, newImage(), PDFPageCache::CURRENT);
+    QVERIFY(cache1.getImage(t0) != cache2.getImage(t0));
+    QCOMPARE(cache1.tiles().size(), 1);
+    QCOMPARE(cache2.tiles().size(), 1);
+
+    // Least recently used tiles are evicted first (across documents)
+    cache1.setImage(t1, newImage(), PDFPageCache::CURRENT);
+    QVERIFY(cache1.getImage(t0));
+    cache1.setImage(t2, newImage(), PDFPageCache::CURRENT);
+    QVERIFY(!cache2.getImage(t0));
+    QVERIFY(cache1.getImage(t0));
+    QVERIFY(cache1.getImage(t1));
+    QVERIFY(cache1.getImage(t2));
+
+    PDFTileCache::Statistics stats = tileCache.statistics();
+    QCOMPARE(stats.size, 3 * imgSize);
+    QCOMPARE(stats.numTiles, 3);
+    QCOMPARE(stats.insertions, static_cast<quint64>(4));
+    QCOMPARE(stats.evictions, static_cast<quint64>(1));
+    QCOMPARE(stats.misses, static_cast<quint64>(1));
+    QCOMPARE(stats.hits, static_cast<quint64>(6));
+
+    // Visible tiles are evicted last (t0 is the least recently used one now)
+    cache1.setVisibleRects({{0, QRectF(0, 0, 5, 5)}});
+    cache2.setImage(t1, newImage(), PDFPageCache::CURRENT);
+    QVERIFY(cache1.getImage(t0));
+    QVERIFY(!cache1.getImage(t1));
+
+    // Moderate memory pressure halves the cache, critical pressure only leaves
+    // visible tiles
+    tileCache.handleMemoryPressure(PDFTileCache::MemoryPressure_Moderate);
+    QVERIFY(tileCache.statistics().size <= 3 * imgSize / 2);
+    QVERIFY(cache1.getImage(t0));
+    cache2.setImage(t2, newImage(), PDFPageCache::CURRENT);
+    tileCache.handleMemoryPressure(PDFTileCache::MemoryPressure_Critical);
+    QCOMPARE(tileCache.statistics().numTiles, 1);
+    QVERIFY(cache1.getImage(t0));
+
+    cache1.setVisibleRects(QMap<int, QRectF>());
+  }
+  // Destroying a PDFPageCache removes its tiles
+  QCOMPARE(tileCache.statistics().numTiles, 0);
+  QCOMPARE(tileCache.statistics().size, Q_INT64_C(0));
+
+  tileCache.setMaxSize(oldMaxSize);
+  tileCache.setCompressionEnabled(oldCompressionEnabled);
+}
+
+void TestQtPDF::tileCompression_data()
+{
+  QTest::addColumn<pDoc>("doc");
+  newDocTest("base14-fonts");
+  newDocTest("page-rotation");
+  newDocTest("annotations");
+  if (_docs[QString::fromLatin1("pgfmanual")]->isValid())
+    newDocTest("pgfmanual");
+}
+
+void TestQtPDF::tileCompression()
+{
+  using QtPDF::Backend::PDFCompressedTileImage;
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+  using QtPDF::Backend::PDFTileCache;
+
+  QFETCH(pDoc, doc);
+
+  QSharedPointer<QtPDF::Backend::Page> page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+  QImage img = page->renderToImage(150, 150, QRect(0, 0, 1024, 1024));
+  QVERIFY(!img.isNull());
+  if (img.depth() != 32)
+    img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+  PDFCompressedTileImage compressed = PDFCompressedTileImage::fromImage(img);
+  QVERIFY(!compressed.isNull());
+  QCOMPARE(compressed.toImage(), img);
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 10, 0)
+  const qint64 imgSize = img.byteCount();
+#else
+  const qint64 imgSize = img.sizeInBytes();
+#endif
+  QTest::setBenchmarkResult(compressed.byteSize(), QTest::BytesAllocated);
+
+  // Cold tiles are compressed in the background (rather than evicted) and
+  // transparently decompressed when they are requested again
+  PDFTileCache & tileCache = PDFTileCache::instance();
+  const qint64 oldMaxSize = tileCache.maxSize();
+  const bool oldCompressionEnabled = tileCache.isCompressionEnabled();
+  tileCache.setCompressionEnabled(true);
+  tileCache.setMaxSize(0);
+  tileCache.setMaxSize(3 * imgSize);
+  tileCache.waitForCompression();
+  tileCache.resetStatistics();
+  {
+    PDFPageCache cache;
+    PDFPageTile t0(150, 150, QRect(0, 0, 1024, 1024), 0);
+    PDFPageTile t1(150, 150, QRect(0, 0, 1024, 1024), 1);
+    PDFPageTile t2(150, 150, QRect(0, 0, 1024, 1024), 2);
+    cache.setImage(t0, QtPDF::Backend::PDFTileImage(new QImage(img)), PDFPageCache::CURRENT);
+    cache.setImage(t1, QtPDF::Backend::PDFTileImage(new QImage(img)), PDFPageCache::CURRENT);
+    // Below the compression threshold, nothing is compressed
+    tileCache.waitForCompression();
+    QCOMPARE(tileCache.statistics().compressions, static_cast<quint64>(0));
+
+    // Exceeding the threshold triggers a compression pass that compresses the
+    // least recently used tiles (but never touches the cache's size limit)
+    cache.setImage(t2, QtPDF::Backend::PDFTileImage(new QImage(img)), PDFPageCache::CURRENT);
+    tileCache.waitForCompression();
+    PDFTileCache::Statistics stats = tileCache.statistics();
+    QCOMPARE(stats.numTiles, 3);
+    QCOMPARE(stats.evictions, static_cast<quint64>(0));
+    QCOMPARE(stats.compressions, static_cast<quint64>(2));
+    QVERIFY(stats.size < 2 * imgSize);
+
+    QtPDF::Backend::PDFTileImage cached = cache.getImage(t0);
+    QVERIFY(cached);
+    QCOMPARE(*cached, img);
+    tileCache.waitForCompression();
+    stats = tileCache.statistics();
+    QCOMPARE(stats.decompressions, static_cast<quint64>(1));
+    QCOMPARE(stats.evictions, static_cast<quint64>(0));
+  }
+  tileCache.setMaxSize(oldMaxSize);
+  tileCache.setCompressionEnabled(oldCompressionEnabled);
+}
+
+void TestQtPDF::tileDecompression()
+{
+  using QtPDF::Backend::PDFCompressedTileImage;
+
+  QSharedPointer<QtPDF::Backend::Page> page = _docs[QString::fromLatin1("base14-fonts")]->page(0).toStrongRef();
+  QVERIFY(page);
+  QImage img = page->renderToImage(150, 150, QRect(0, 0, 1024, 1024));
+  if (img.depth() != 32)
+    img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+  PDFCompressedTileImage compressed = PDFCompressedTileImage::fromImage(img);
+  QVERIFY(!compressed.isNull());
+
+  QImage decompressed;
+  QBENCHMARK {
+    decompressed = compressed.toImage();
+  }
+  QCOMPARE(decompressed, img);
+}
+
+void TestQtPDF::tileHandOff()
+{
+  using QtPDF::Backend::PDFPageTile;
+  using QtPDF::Backend::PDFTileImage;
+
+  Backend backend;
+  pDoc doc = backend.newDocument(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(doc);
+  pPage page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+
+  const double res = 150;
+  const QRect box(0, 0, 256, 256);
+  const PDFPageTile tile(res, res, box, 0);
+  // Painting on a high-dpi screen (see PDFPageGraphicsItem::paint())
+  const qreal devicePixelRatio = 2;
+
+  RenderedImageCollector listener;
+  page->getTileImage(&listener, res, res, box);
+  QVERIFY(listener.waitForRenderedPages(1));
+  QVERIFY(listener.image);
+
+  // The event, the cache and the painter share the same pixel data
+  PDFTileImage cached = doc->pageCache().getImage(tile);
+  QVERIFY(cached);
+  QCOMPARE(listener.image->constBits(), cached->constBits());
+  PDFTileImage painted = page->getTileImage(&listener, res, res, box);
+  QCOMPARE(painted, cached);
+
+  auto bytesCopied = [](const QImage & img, const QImage & original) -> qint64 {
+    return (img.constBits() == original.constBits() ? 0 : static_cast<qint64>(img.bytesPerLine()) * img.height());
+  };
+
+  // Painting used to go through a shallow copy with an adjusted
+  // devicePixelRatio, which detaches (i.e., copies) the image
+  QImage detached = *cached;
+  detached.setDevicePixelRatio(devicePixelRatio);
+  const qint64 copiedBefore = bytesCopied(detached, *cached);
+
+  QImage screen(box.size(), QImage::Format_ARGB32_Premultiplied);
+  screen.setDevicePixelRatio(devicePixelRatio);
+  QPainter painter(&screen);
+  const QRectF targetRect(QPointF(0, 0), QSizeF(painted->size()) / devicePixelRatio);
+  painter.drawImage(targetRect, *painted);
+  const qint64 copiedAfter = bytesCopied(*painted, *cached) + bytesCopied(*listener.image, *cached);
+
+  QVERIFY(copiedBefore > 0);
+  QCOMPARE(copiedAfter, Q_INT64_C(0));
+
+  QBENCHMARK {
+    PDFTileImage img = page->getTileImage(&listener, res, res, box);
+    painter.drawImage(targetRect, *img);
+  }
+}
+
+void TestQtPDF::colorTransform_data()
+{
+  using QtPDF::Backend::PDFColorTransform;
+
+  QTest::addColumn<int>("mode");
+  QTest::addColumn<int>("kernel");
+
+  const QList< QPair<const char *, int> > modes = {
+    {"grayscale", PDFColorTransform::Mode_GrayScale},
+    {"inverted", PDFColorTransform::Mode_Inverted},
+    {"sepia", PDFColorTransform::Mode_Sepia}
+  };
+  const QList< QPair<const char *, int> > kernels = {
+    {"scalar", PDFColorTransform::Kernel_Scalar},
+    {"sse2", PDFColorTransform::Kernel_SSE2},
+    {"avx2", PDFColorTransform::Kernel_AVX2}
+  };
+  // The per-pixel loop that was used for the gray scale mode before
+  QTest::newRow("grayscale-qGray") << static_cast<int>(PDFColorTransform::Mode_GrayScale) << -1;
+  for (const auto & mode : modes) {
+    for (const auto & kernel : kernels)
+      QTest::newRow(qPrintable(QString::fromLatin1("%1-%2").arg(QString::fromLatin1(mode.first), QString::fromLatin1(kernel.first)))) << mode.second << kernel.second;
+  }
+}
+
+void TestQtPDF::colorTransform()
+{
+  using QtPDF::Backend::PDFColorTransform;
+
+  QFETCH(int, mode);
+  QFETCH(int, kernel);
+
+  // Previous implementation of the gray scale mode, for reference
+  auto qGrayLoop = [](QImage & img) {
+    QRgb * data = reinterpret_cast<QRgb*>(img.bits());
+    for (int i = 0; i < img.width() * img.height(); ++i) {
+      int gray = qGray(data[i]);
+      data[i] = qRgba(gray, gray, gray, qAlpha(data[i]));
+    }
+  };
+
+  if (kernel >= 0 && !PDFColorTransform::isSupported(static_cast<PDFColorTransform::Kernel>(kernel)))
+    QSKIP("Kernel is not supported on this system");
+
+  // A tile of a typical size with random (premultiplied) pixels; the width is
+  // not a multiple of the vector size to exercise the scalar tail, too
+  QImage tile(1021, 1024, QImage::Format_ARGB32_Premultiplied);
+  qsrand(42);
+  for (int y = 0; y < tile.height(); ++y) {
+    QRgb * line = reinterpret_cast<QRgb *>(tile.scanLine(y));
+    for (int x = 0; x < tile.width(); ++x) {
+      const int a = (x % 7 == 0 ? qrand() % 256 : 255);
+      line[x] = qRgba(qrand() % (a + 1), qrand() % (a + 1), qrand() % (a + 1), a);
+    }
+  }
+
+  QImage expected = tile.copy();
+  if (kernel < 0)
+    qGrayLoop(expected);
+  else
+    PDFColorTransform::apply(expected, static_cast<PDFColorTransform::Mode>(mode), PDFColorTransform::Kernel_Scalar);
+
+  if (kernel < 0) {
+    QImage img = tile.copy();
+    QBENCHMARK {
+      qGrayLoop(img);
+    }
+    return;
+  }
+
+  // All kernels give the same results; the gray scale mode is the same as
+  // before
+  const QImage actual = PDFColorTransform::transformed(tile, static_cast<PDFColorTransform::Mode>(mode), static_cast<PDFColorTransform::Kernel>(kernel));
+  QCOMPARE(actual, expected);
+  if (mode == PDFColorTransform::Mode_GrayScale) {
+    QImage reference = tile.copy();
+    qGrayLoop(reference);
+    QCOMPARE(actual, reference);
+  }
+
+  QImage img = tile.copy();
+  QBENCHMARK {
+    PDFColorTransform::apply(img, static_cast<PDFColorTransform::Mode>(mode), static_cast<PDFColorTransform::Kernel>(kernel));
+  }
+}
+
+void TestQtPDF::colorTransformCache()
+{
+  using QtPDF::Backend::PDFColorTransform;
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+  using QtPDF::Backend::PDFTileImage;
+
+  Backend backend;
+  pDoc doc = backend.newDocument(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(doc);
+  pPage page = doc->page(0).toStrongRef();
+  QVERIFY(page);
+
+  const double res = 72;
+  const QRect box(0, 0, 256, 256);
+
+  RenderEventCounter listener;
+  page->getTileImage(&listener, res, res, box, PDFColorTransform::Mode_Inverted);
+  QVERIFY(listener.waitForRenderedPages(1));
+
+  const PDFTileImage plain = page->getTileImage(&listener, res, res, box);
+  const PDFTileImage inverted = page->getTileImage(&listener, res, res, box, PDFColorTransform::Mode_Inverted);
+  QVERIFY(plain);
+  QVERIFY(inverted);
+  QCOMPARE(*inverted, PDFColorTransform::transformed(*plain, PDFColorTransform::Mode_Inverted));
+
+  // The transformed tile is cached as a variant of its own and not computed
+  // again for the next paint
+  PDFPageCache::TileStatus status{PDFPageCache::UNKNOWN};
+  QCOMPARE(doc->pageCache().getImage(PDFPageTile(res, res, box, 0, PDFColorTransform::Mode_Inverted), &status), inverted);
+  QCOMPARE(status, PDFPageCache::CURRENT);
+  QCOMPARE(page->getTileImage(&listener, res, res, box, PDFColorTransform::Mode_Inverted), inverted);
+  // The plain tile is unaffected
+  QCOMPARE(page->getTileImage(&listener, res, res, box), plain);
+}
+
+void TestQtPDF::previewCache()
+{
+  using QtPDF::Backend::PDFPreviewCache;
+
+  PDFPreviewCache & cache = PDFPreviewCache::instance();
+  const QString oldCacheDir = cache.cacheDir();
+  const qint64 oldMaxSize = cache.maxSize();
+  QTemporaryDir tmpDir;
+  QVERIFY(tmpDir.isValid());
+  cache.setCacheDir(tmpDir.path());
+  cache.setMaxSize(1024 * 1024);
+  QVERIFY(cache.isEnabled());
+  QCOMPARE(cache.size(), Q_INT64_C(0));
+
+  QFile pdf(QString::fromLatin1("base14-fonts.pdf"));
+  QVERIFY(pdf.open(QIODevice::ReadOnly));
+  QCOMPARE(PDFPreviewCache::hashFile(pdf.fileName()), PDFPreviewCache::hashData(pdf.readAll()));
+
+  QList<QByteArray> hashes;
+  for (int i = 0; i < 4; ++i)
+    hashes << PDFPreviewCache::hashData(QByteArray::number(i));
+  QVERIFY(hashes[0] != hashes[1]);
+
+  QImage img(100, 150, QImage::Format_ARGB32_Premultiplied);
+  img.fill(Qt::red);
+  const qint64 previewSize = 32 + img.width() * img.height() * 4;
+
+  // Previews are keyed by document and page
+  QVERIFY(cache.preview(hashes[0], 0).isNull());
+  cache.storePreview(hashes[0], 0, img);
+  QCOMPARE(cache.preview(hashes[0], 0), img);
+  QVERIFY(cache.preview(hashes[0], 1).isNull());
+  QVERIFY(cache.preview(hashes[1], 0).isNull());
+
+  // Modifying a (memory-mapped) preview must not affect the cache
+  QImage preview = cache.preview(hashes[0], 0);
+  preview.fill(Qt::blue);
+  QCOMPARE(cache.preview(hashes[0], 0), img);
+
+  // Corrupt previews are ignored
+  cache.storePreview(hashes[0], 1, img);
+  {
+    QFile f(QDir(tmpDir.path()).filePath(QString::fromLatin1(hashes[0].toHex() + "/1.preview")));
+    QVERIFY(f.open(QIODevice::ReadWrite));
+    QVERIFY(f.resize(f.size() - 1));
+  }
+  QVERIFY(cache.preview(hashes[0], 1).isNull());
+
+  // The cache is trimmed to its size limit, keeping the most recent document
+  cache.setMaxSize(2 * previewSize + previewSize / 2);
+  for (int i = 1; i < hashes.size(); ++i)
+    cache.storePreview(hashes[i], 0, img);
+  QVERIFY(cache.size() <= cache.maxSize());
+  QCOMPARE(cache.preview(hashes.last(), 0), img);
+
+  cache.removeDocument(hashes.last());
+  QVERIFY(cache.preview(hashes.last(), 0).isNull());
+  cache.clear();
+  QCOMPARE(cache.size(), Q_INT64_C(0));
+
+  // Pages have their previews rendered in the background
+  cache.setMaxSize(1024 * 1024);
+  {
+    Backend backend;
+    pDoc doc = backend.newDocument(QString::fromLatin1("base14-fonts.pdf"));
+    QVERIFY(doc);
+    QVERIFY(!doc->contentHash().isEmpty());
+    pPage page = doc->page(0).toStrongRef();
+    QVERIFY(page);
+    QVERIFY(page->previewImage().isNull());
+
+    RenderEventCounter listener;
+    page->getTileImage(&listener, 72, 72);
+    QVERIFY(listener.waitForRenderedPages(1));
+    QElapsedTimer timer;
+    timer.start();
+    while (page->previewImage().isNull() && timer.elapsed() < 60000)
+      QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    const QImage pagePreview = page->previewImage();
+    QVERIFY(!pagePreview.isNull());
+    QVERIFY(qAbs(qMax(pagePreview.width(), pagePreview.height()) - PDFPreviewCache::PreviewSize) <= 1);
+    QCOMPARE(cache.preview(doc->contentHash(), 0).size(), pagePreview.size());
+  }
+
+  // When the document is opened again, its previews are loaded from disk in
+  // the background (never while painting)
+  {
+    Backend backend;
+    pDoc doc = backend.newDocument(QString::fromLatin1("base14-fonts.pdf"));
+    QVERIFY(doc);
+    pPage page = doc->page(0).toStrongRef();
+    QVERIFY(page);
+    QVERIFY(page->previewImage().isNull());
+
+    RenderEventCounter listener;
+    page->getTileImage(&listener, 72, 72);
+    QElapsedTimer timer;
+    timer.start();
+    while (page->previewImage().isNull() && timer.elapsed() < 60000)
+      QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    QCOMPARE(page->previewImage(), cache.preview(doc->contentHash(), 0));
+    QVERIFY(listener.waitForRenderedPages(1));
+  }
+
+  cache.setCacheDir(oldCacheDir);
+  cache.setMaxSize(oldMaxSize);
+}
+
+void TestQtPDF::pageFingerprint()
+{
+  using QtPDF::Backend::Page;
+  using QtPDF::Backend::PageText;
+
+  const QSizeF pageSize(612, 792);
+  auto makeText = [](const QString & word, const QPointF & pos) -> PageText {
+    PageText text;
+    QVector<QRectF> charBoxes;
+    for (int i = 0; i < word.length(); ++i)
+      charBoxes << QRectF(pos.x() + 5 * i, pos.y(), 5, 10);
+    text.addWord(word, QRectF(pos, QSizeF(5 * word.length(), 10)), charBoxes, true);
+    text.addWord(QStringLiteral("world"), QRectF(100, 100, 25, 10), QVector<QRectF>(), true);
+    return text;
+  };
+
+  auto makeImage = [](const QRgb color) -> QImage {
+    QImage img(198, 256, QImage::Format_ARGB32_Premultiplied);
+    img.fill(Qt::white);
+    img.setPixel(50, 50, color);
+    return img;
+  };
+  const QImage lowRes = makeImage(qRgb(0, 0, 0));
+
+  const QByteArray fingerprint = Page::fingerprintOf(pageSize, makeText(QStringLiteral("Hello"), QPointF(10, 10)), lowRes);
+  QVERIFY(!fingerprint.isEmpty());
+  QCOMPARE(Page::fingerprintOf(pageSize, makeText(QStringLiteral("Hello"), QPointF(10, 10)), makeImage(qRgb(0, 0, 0))), fingerprint);
+  // Small edits (that may not even be visible at low resolution) change the
+  // fingerprint
+  QVERIFY(Page::fingerprintOf(pageSize, makeText(QStringLiteral("Hellp"), QPointF(10, 10)), lowRes) != fingerprint);
+  QVERIFY(Page::fingerprintOf(pageSize, makeText(QStringLiteral("Hello"), QPointF(10.5, 10)), lowRes) != fingerprint);
+  QVERIFY(Page::fingerprintOf(pageSize.transposed(), makeText(QStringLiteral("Hello"), QPointF(10, 10)), lowRes) != fingerprint);
+  // So do changes that only affect the graphics
+  QVERIFY(Page::fingerprintOf(pageSize, makeText(QStringLiteral("Hello"), QPointF(10, 10)), makeImage(qRgb(255, 0, 0))) != fingerprint);
+  // Pages without text are fingerprinted by their graphics alone
+  QVERIFY(!Page::fingerprintOf(pageSize, PageText(), lowRes).isEmpty());
+  QVERIFY(Page::fingerprintOf(pageSize, PageText(), lowRes) != Page::fingerprintOf(pageSize, PageText(), makeImage(qRgb(255, 0, 0))));
+  // Pages that can't be rendered can't be fingerprinted
+  QVERIFY(Page::fingerprintOf(pageSize, makeText(QStringLiteral("Hello"), QPointF(10, 10)), QImage()).isEmpty());
+}
+
+void TestQtPDF::reloadUnchangedPages()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+
+  QTemporaryDir tmpDir;
+  QVERIFY(tmpDir.isValid());
+  const QString filename = QDir(tmpDir.path()).filePath(QString::fromLatin1("reload.pdf"));
+  QVERIFY(QFile::copy(QString::fromLatin1("page-rotation.pdf"), filename));
+
+  Backend backend;
+  pDoc doc = backend.newDocument(filename);
+  QVERIFY(doc);
+  QVERIFY(doc->isValid());
+  const int numPages = doc->numPages();
+  const double res = 36;
+
+  auto tileFor = [&](const int i) {
+    pPage page = doc->page(i).toStrongRef();
+    return PDFPageTile(res, res, QRectF(QPointF(0, 0), page->pageSizeF() * res / 72.).toAlignedRect(), i);
+  };
+
+  // Rendering pages also computes their fingerprints in the background
+  {
+    RenderEventCounter listener;
+    for (int i = 0; i < numPages; ++i)
+      doc->page(i).toStrongRef()->getTileImage(&listener, res, res);
+    QVERIFY(listener.waitForRenderedPages(numPages));
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < numPages; ++i) {
+      while (doc->page(i).toStrongRef()->fingerprint(false).isEmpty() && timer.elapsed() < 60000)
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+      QVERIFY(!doc->page(i).toStrongRef()->fingerprint(false).isEmpty());
+    }
+  }
+
+  // Reloading an unchanged file restores all tiles instead of rendering them
+  doc->resetReloadStatistics();
+  doc->reload();
+  QCOMPARE(doc->numPages(), numPages);
+  for (int i = 0; i < numPages; ++i)
+    QCOMPARE(doc->pageCache().getStatus(tileFor(i)), PDFPageCache::OUTDATED);
+  {
+    RenderEventCounter listener;
+    for (int i = 0; i < numPages; ++i)
+      doc->page(i).toStrongRef()->getTileImage(&listener, res, res);
+    QVERIFY(listener.waitForRenderedPages(numPages));
+  }
+  for (int i = 0; i < numPages; ++i)
+    QCOMPARE(doc->pageCache().getStatus(tileFor(i)), PDFPageCache::CURRENT);
+  QtPDF::Backend::Document::ReloadStatistics stats = doc->reloadStatistics();
+  QCOMPARE(stats.reloads, static_cast<quint64>(1));
+  QCOMPARE(stats.pagesReused, static_cast<quint64>(numPages));
+  QCOMPARE(stats.pagesChanged, static_cast<quint64>(0));
+  QVERIFY(stats.tilesReused >= static_cast<quint64>(numPages));
+
+  // Pages that changed are rendered again
+  QVERIFY(QFile::remove(filename));
+  QVERIFY(QFile::copy(QString::fromLatin1("base14-fonts.pdf"), filename));
+  doc->resetReloadStatistics();
+  doc->reload();
+  {
+    RenderEventCounter listener;
+    doc->page(0).toStrongRef()->getTileImage(&listener, res, res);
+    QVERIFY(listener.waitForRenderedPages(1));
+  }
+  stats = doc->reloadStatistics();
+  QCOMPARE(stats.pagesReused, static_cast<quint64>(0));
+  QCOMPARE(stats.pagesChanged, static_cast<quint64>(1));
+  QCOMPARE(doc->pageCache().getStatus(tileFor(0)), PDFPageCache::CURRENT);
+}
+
+// Returns a single-page PDF (200x200bp) with the given content stream; font
+// /F1 is Helvetica
+static QByteArray singlePagePDF(const QByteArray & content)
+{
+  const QList<QByteArray> objects({
+    QByteArrayLiteral("<< /Type /Catalog /Pages 2 0 R >>"),
+    QByteArrayLiteral("<< /Type /Pages /Kids [3 0 R] /Count 1 >>"),
+    QByteArrayLiteral("<< /Type /Page /Parent 2 0 R /MediaBox [0 0 200 200] /Resources << /Font << /F1 4 0 R >> >> /Contents 5 0 R >>"),
+    QByteArrayLiteral("<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"),
+    "<< /Length " + QByteArray::number(content.size()) + " >>\nstream\n" + content + "\nendstream"
+  });
+
+  QByteArray pdf("%PDF-1.4\n");
+  QList<int> offsets;
+  for (int i = 0; i < objects.size(); ++i) {
+    offsets << pdf.size();
+    pdf += QByteArray::number(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+  }
+  const int xrefOffset = pdf.size();
+  pdf += "xref\n0 " + QByteArray::number(objects.size() + 1) + "\n0000000000 65535 f \n";
+  foreach (const int offset, offsets)
+    pdf += QByteArray::number(offset).rightJustified(10, '0') + " 00000 n \n";
+  pdf += "trailer\n<< /Size " + QByteArray::number(objects.size() + 1) + " /Root 1 0 R >>\nstartxref\n" + QByteArray::number(xrefOffset) + "\n%%EOF\n";
+  return pdf;
+}
+
+void TestQtPDF::reloadChangedGraphics()
+{
+  using QtPDF::Backend::PDFPageCache;
+  using QtPDF::Backend::PDFPageTile;
+
+  // Both revisions have exactly the same text; only the color of the figure
+  // differs
+  auto writeRevision = [](const QString & filename, const QByteArray & color) -> bool {
+    QFile file(filename);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+      return false;
+    const QByteArray pdf = singlePagePDF("BT /F1 24 Tf 20 150 Td (Hello) Tj ET\n" + color + " rg 20 20 160 100 re f");
+    return (file.write(pdf) == pdf.size());
+  };
+
+  QTemporaryDir tmpDir;
+  QVERIFY(tmpDir.isValid());
+  const QString filename = QDir(tmpDir.path()).filePath(QString::fromLatin1("graphics.pdf"));
+  QVERIFY(writeRevision(filename, "1 0 0"));
+
+  Backend backend;
+  pDoc doc = backend.newDocument(filename);
+  QVERIFY(doc);
+  QVERIFY(doc->isValid());
+  QCOMPARE(doc->numPages(), 1);
+  const double res = 72;
+  const PDFPageTile tile(res, res, QRect(0, 0, 200, 200), 0);
+
+  {
+    RenderedImageCollector listener;
+    doc->page(0).toStrongRef()->getTileImage(&listener, res, res);
+    QVERIFY(listener.waitForRenderedPages(1));
+    QVERIFY(listener.image);
+    QCOMPARE(listener.image->pixel(100, 150), qRgb(255, 0, 0));
+    QElapsedTimer timer;
+    timer.start();
+    while (doc->page(0).toStrongRef()->fingerprint(false).isEmpty() && timer.elapsed() < 60000)
+      QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
+    QVERIFY(!doc->page(0).toStrongRef()->fingerprint(false).isEmpty());
+  }
+  const QString text = doc->page(0).toStrongRef()->selectedText({QPolygonF(QRectF(0, 0, 200, 200))});
+
+  // Changing only the graphics renders the page again
+  QVERIFY(writeRevision(filename, "0 0 1"));
+  doc->resetReloadStatistics();
+  doc->reload();
+  QCOMPARE(doc->page(0).toStrongRef()->selectedText({QPolygonF(QRectF(0, 0, 200, 200))}), text);
+  {
+    RenderedImageCollector listener;
+    doc->page(0).toStrongRef()->getTileImage(&listener, res, res);
+    QVERIFY(listener.waitForRenderedPages(1));
+    QVERIFY(listener.image);
+    QCOMPARE(listener.image->pixel(100, 150), qRgb(0, 0, 255));
+  }
+  const QtPDF::Backend::Document::ReloadStatistics stats = doc->reloadStatistics();
+  QCOMPARE(stats.pagesReused, static_cast<quint64>(0));
+  QCOMPARE(stats.pagesChanged, static_cast<quint64>(1));
+  QCOMPARE(stats.tilesReused, static_cast<quint64>(0));
+  QCOMPARE(doc->pageCache().getStatus(tile), PDFPageCache::CURRENT);
+}
+
+void TestQtPDF::renderThreadPool_data()
+{
+  QTest::addColumn<pDoc>("doc");
+  QTest::addColumn<bool>("firstScreenOnly");
+  QTest::addColumn<int>("numThreads");
+
+  // Prefer a long document, but fall back to one that is always available
+  pDoc doc = _docs[QStringLiteral("pgfmanual")];
+  if (!doc || !doc->isValid())
+    doc = _docs[QStringLiteral("page-rotation")];
+
+  QList<int> threadCounts({1, 2, 4});
+  if (!threadCounts.contains(QThread::idealThreadCount()))
+    threadCounts << QThread::idealThreadCount();
+
+  foreach (int n, threadCounts) {
+    QTest::newRow(qPrintable(QStringLiteral("first screen, %1 thread(s)").arg(n))) << doc << true << n;
+    QTest::newRow(qPrintable(QStringLiteral("full prerender, %1 thread(s)").arg(n))) << doc << false << n;
+  }
+}
+
+void TestQtPDF::renderThreadPool()
+{
+  QFETCH(pDoc, doc);
+  QFETCH(bool, firstScreenOnly);
+  QFETCH(int, numThreads);
+
+  if (!doc || !doc->isValid())
+    QSKIP("Test document is not available");
+
+  // Render at 200% (on a 96 dpi screen), split into tiles as PDFPageGraphicsItem
+  // does
+  const double res = 192;
+  const int tileSize = 1024;
+  const int numPages = (firstScreenOnly ? qMin(2, doc->numPages()) : doc->numPages());
+
+  QList<QPair<pPage, QRect> > tiles;
+  for (int i = 0; i < numPages; ++i) {
+    pPage page = doc->page(i).toStrongRef();
+    QVERIFY(page);
+    QSize pageSize = (QSizeF(page->pageSizeF()) * res / 72.).toSize();
+    for (int y = 0; y < pageSize.height(); y += tileSize) {
+      for (int x = 0; x < pageSize.width(); x += tileSize)
+        tiles << qMakePair(page, QRect(x, y, tileSize, tileSize));
+    }
+  }
+
+  doc->processingThreadPool().setMaxThreadCount(numThreads);
+
+  QBENCHMARK {
+    doc->pageCache().clear();
+    RenderEventCounter listener;
+    for (int i = 0; i < tiles.size(); ++i)
+      tiles[i].first->getTileImage(&listener, res, res, tiles[i].second);
+    QVERIFY(listener.waitForRenderedPages(tiles.size()));
+  }
+
+  doc->processingThreadPool().setMaxThreadCount(0);
+  doc->pageCache().clear();
+}
+
+void TestQtPDF::popplerHandles()
+{
+#ifdef USE_POPPLERQT
+  using PopplerDoc = QtPDF::Backend::PopplerQt::Document;
+
+  Backend backend;
+  PopplerDoc::setDefaultMaxHandleCount(2);
+  pDoc doc = backend.newDocument(QString::fromLatin1("page-rotation.pdf"));
+  PopplerDoc::setDefaultMaxHandleCount(0);
+  PopplerDoc * popplerDoc = dynamic_cast<PopplerDoc *>(doc.data());
+  QVERIFY(popplerDoc);
+  QVERIFY(popplerDoc->isValid());
+
+  QCOMPARE(popplerDoc->maxHandleCount(), 2);
+  popplerDoc->setMaxHandleCount(0);
+  QCOMPARE(popplerDoc->maxHandleCount(), PopplerDoc::defaultMaxHandleCount());
+  popplerDoc->setMaxHandleCount(2);
+
+  // Render all pages concurrently; the results must not depend on which
+  // Poppler document was used to render them
+  QList<QImage> reference;
+  for (int i = 0; i < doc->numPages(); ++i)
+    reference << doc->page(i).toStrongRef()->renderToImage(36, 36);
+
+  popplerDoc->resetContentionStatistics();
+  doc->processingThreadPool().setMaxThreadCount(2);
+  doc->pageCache().clear();
+  RenderEventCounter listener;
+  for (int i = 0; i < doc->numPages(); ++i)
+    doc->page(i).toStrongRef()->getTileImage(&listener, 36, 36);
+  QVERIFY(listener.waitForRenderedPages(doc->numPages()));
+  doc->processingThreadPool().setMaxThreadCount(0);
+
+  PopplerDoc::ContentionStatistics stats = popplerDoc->contentionStatistics(PopplerDoc::Usage_Render);
+  QCOMPARE(stats.numRequests, static_cast<quint64>(doc->numPages()));
+  QVERIFY(stats.numBlocked <= stats.numRequests);
+  QVERIFY(stats.maxWaitNs <= stats.totalWaitNs);
+
+  for (int i = 0; i < doc->numPages(); ++i) {
+    QtPDF::Backend::PDFTileImage img = doc->page(i).toStrongRef()->getTileImage(nullptr, 36, 36);
+    QVERIFY(img);
+    QCOMPARE(*img, reference[i]);
+  }
+
+  // Reloading discards all additional handles and must not deadlock
+  doc->reload();
+  QVERIFY(doc->isValid());
+  QCOMPARE(doc->numPages(), reference.size());
+  doc->pageCache().clear();
+#else
+  QSKIP("Only applicable to the poppler-qt backend");
+#endif
+}
+
 } // namespace UnitTest
 
 #if defined(STATIC_QT5) && defined(Q_OS_WIN)
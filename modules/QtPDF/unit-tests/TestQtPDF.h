@@ -161,6 +161,11 @@ private slots:
   void page_search_data();
   void page_search();
 
+  void textIndex_data();
+  void textIndex();
+  void textIndexWordBreaks();
+  void buildTextIndex();
+
   void paperSize_data();
   void paperSize();
 
@@ -168,6 +173,25 @@ private slots:
   void transitions();
 
   void pageTile();
+
+  void processingThreadPool();
+  void renderViewport();
+  void tileCache();
+  void tileCompression_data();
+  void tileCompression();
+  void tileDecompression();
+  void tileHandOff();
+  void colorTransform_data();
+  void colorTransform();
+  void colorTransformCache();
+  void previewCache();
+  void pageFingerprint();
+  void reloadUnchangedPages();
+  void reloadChangedGraphics();
+  void renderThreadPool_data();
+  void renderThreadPool();
+
+  void popplerHandles();
 };
 
 } // namespace UnitTest
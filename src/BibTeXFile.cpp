@@ -22,94 +22,96 @@
 
 #include <QFile>
 #include <QTextCodec>
+#include <limits>
 
-BibTeXFile::Entry::Type BibTeXFile::Entry::type() const
+struct BibTeXFile::Data
 {
-	if (_type.toLower() == QString::fromLatin1("comment"))
-		return COMMENT;
-	if (_type.toLower() == QString::fromLatin1("preamble"))
-		return PREAMBLE;
-	if (_type.toLower() == QString::fromLatin1("string"))
-		return STRING;
-	return NORMAL;
-}
+	struct Field {
+		int name; // see fieldIds
+		// position of the (raw) value in text
+		int start;
+		int length;
+	};
+
+	QString text;
+	QVector<Field> fields;
+	// maps lower-case field names to ids
+	QHash<QString, int> fieldIds;
+};
 
 QString BibTeXFile::Entry::howPublished() const
 {
-	if (_cache.valid) return _cache.howPublished;
-	if (hasField(QString::fromLatin1("howpublished")))
-		return value(QString::fromLatin1("howpublished"));
-	return value(QString::fromLatin1("journal"));
+	if (hasField(QStringLiteral("howpublished")))
+		return value(QStringLiteral("howpublished"));
+	return value(QStringLiteral("journal"));
 }
 
-QString BibTeXFile::Entry::value(const QString & key) const
+int BibTeXFile::Entry::findField(const QString & key) const
 {
-	QString retVal;
-	for (QMap<QString, QString>::const_iterator it = _fields.constBegin(); it != _fields.constEnd(); ++it) {
-		if (QString::compare(key, it.key(), Qt::CaseInsensitive) == 0) {
-			retVal = it.value();
-			break;
-		}
+	if (!_data)
+		return -1;
+	// Avoid lowercasing the key in the common case that it already is
+	QHash<QString, int>::const_iterator it = _data->fieldIds.constFind(key);
+	if (it == _data->fieldIds.constEnd())
+		it = _data->fieldIds.constFind(key.toLower());
+	if (it == _data->fieldIds.constEnd())
+		return -1;
+	// If a field is given more than once, the last one wins
+	for (int i = _firstField + _numFields - 1; i >= _firstField; --i) {
+		if (_data->fields[i].name == it.value())
+			return i;
 	}
+	return -1;
+}
+
+QString BibTeXFile::Entry::value(const QString & key) const
+{
+	const int idx = findField(key);
+	if (idx < 0)
+		return QString();
+	const Data::Field & field = _data->fields[idx];
+	QStringRef retVal = _data->text.midRef(field.start, field.length).trimmed();
 	// strip surrounding {} (if any)
 	if (retVal.startsWith(QLatin1Char('{')) && retVal.endsWith(QLatin1Char('}')))
 		retVal = retVal.mid(1, retVal.length() - 2);
 	// or surrounding "" (if any)
 	else if (retVal.startsWith(QLatin1Char('"')) && retVal.endsWith(QLatin1Char('"')))
 		retVal = retVal.mid(1, retVal.length() - 2);
-	return retVal;
+	return retVal.toString();
 }
 
 bool BibTeXFile::Entry::hasField(const QString & key) const
 {
-	for (QMap<QString, QString>::const_iterator it = _fields.constBegin(); it != _fields.constEnd(); ++it) {
-		if (QString::compare(key, it.key(), Qt::CaseInsensitive) == 0)
-			return true;
-	}
-	return false;
-}
-
-void BibTeXFile::Entry::updateCache()
-{
-	// invalidate cache so that all subsequent method calls actually search the
-	// fields
-	_cache.valid = false;
-	_cache.author = author();
-	_cache.howPublished = howPublished();
-	_cache.title = title();
-	_cache.year = year();
-	_cache.valid = true;
+	return findField(key) >= 0;
 }
 
 bool BibTeXFile::load(const QString & filename)
 {
 	QFile file(filename);
-	QByteArray content;
-	QTextCodec * codec = QTextCodec::codecForName("utf-8");
-	int curPos = 0;
 
+	_data.reset();
 	_entries.clear();
+	_keyIndex.clear();
 
-	if (!file.open(QFile::ReadOnly | QFile::Text))
+	if (!file.open(QFile::ReadOnly))
 		return false;
 
-	content = file.readAll();
+	QSharedPointer<Data> data(new Data);
+	const qint64 size = file.size();
+	if (size > 0 && size < std::numeric_limits<int>::max()) {
+		// Map the file rather than reading it into a buffer of our own; it is
+		// only needed once for decoding anyway
+		uchar * mapped = file.map(0, size);
+		const QByteArray content = (mapped ? QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), static_cast<int>(size)) : file.readAll());
+		// FIXME: Encoding detection beyond BOMs
+		data->text = QTextCodec::codecForUtfText(content, QTextCodec::codecForName("UTF-8"))->toUnicode(content);
+		if (mapped)
+			file.unmap(mapped);
+	}
 	file.close();
 
-	// FIXME: Encoding detection
-	if (!codec)
-		return false;
-
-	do {
-		Entry e(this);
-		curPos = readEntry(e, content, curPos, codec);
-		if (curPos > 0) {
-			e.updateCache();
-			_entries.append(e);
-		}
-		// DEBUG
-	} while(curPos > 0);
-
+	_data = data;
+	parse();
 	return true;
 }
 
@@ -134,125 +136,140 @@ template <class S, class C> int findBlock(const S & content, int from, const C &
 	return -1;
 }
 
-inline int findBlock(const QByteArray & content, int from, char startDelim = '{', char endDelim = '}', char escapeChar = 0)
+inline int findBlock(const QString & content, int from, const QChar & startDelim = QChar::fromLatin1('{'), const QChar & endDelim = QChar::fromLatin1('}'), const QChar & escapeChar = QChar())
 {
-	return findBlock<QByteArray, char>(content, from, startDelim, endDelim, escapeChar);
+	return findBlock<QString, QChar>(content, from, startDelim, endDelim, escapeChar);
 }
 
-inline int findBlock(const QString & content, int from, const QChar & startDelim = QChar::fromLatin1('{'), const QChar & endDelim = QChar::fromLatin1('}'), const QChar & escapeChar = QChar())
+void BibTeXFile::parse()
 {
-	return findBlock<QString, QChar>(content, from, startDelim, endDelim, escapeChar);
+	// Entries of the same type share their type string
+	QHash<QString, QString> types;
+	int curPos = 0;
+	while (curPos >= 0)
+		curPos = readEntry(curPos, types);
+	_entries.squeeze();
+	_data->fields.squeeze();
 }
 
-// static
-int BibTeXFile::readEntry(Entry & e, const QByteArray & content, int curPos, const QTextCodec * codec)
+int BibTeXFile::readEntry(int curPos, QHash<QString, QString> & types)
 {
-	curPos = content.indexOf('@', curPos);
+	const QString & text = _data->text;
+
+	curPos = text.indexOf(QLatin1Char('@'), curPos);
 	if (curPos < 0)
 		return -1;
 	++curPos;
-	int start = content.indexOf('{', curPos);
-	if (start < 0)
+	// Entries are enclosed in {} or ()
+	int start = curPos;
+	while (start < text.size() && text[start] != QLatin1Char('{') && text[start] != QLatin1Char('('))
+		++start;
+	if (start >= text.size())
 		return -1;
-	e._type = codec->toUnicode(content.mid(curPos, start - curPos));
-
-	int end = findBlock(content, start);
+	const QChar endDelim = (text[start] == QLatin1Char('{') ? QLatin1Char('}') : QLatin1Char(')'));
+	const int end = findBlock(text, start, text[start], endDelim);
 	if (end < 0) return -1;
+
+	const QString type = text.mid(curPos, start - curPos).trimmed();
+	Entry e;
+	if (type.compare(QLatin1String("comment"), Qt::CaseInsensitive) == 0)
+		e._typeId = Entry::COMMENT;
+	else if (type.compare(QLatin1String("preamble"), Qt::CaseInsensitive) == 0)
+		e._typeId = Entry::PREAMBLE;
+	else if (type.compare(QLatin1String("string"), Qt::CaseInsensitive) == 0)
+		e._typeId = Entry::STRING;
+	// Only normal entries are accessible, so don't bother with the others
+	if (e._typeId != Entry::NORMAL)
+		return end + 1;
+
+	QHash<QString, QString>::const_iterator it = types.constFind(type);
+	if (it == types.constEnd())
+		it = types.insert(type, type);
+	e._type = it.value();
+	e._data = _data.data();
+
 	++start;
-	QByteArray block = content.mid(start, end - start);
-
-	switch (e.type()) {
-	case Entry::COMMENT:
-		e._key = codec->toUnicode(block);
-		break;
-	case Entry::PREAMBLE:
-		e._key = codec->toUnicode(block);
-		break;
-	case Entry::STRING:
-		// FIXME
-		e._key = codec->toUnicode(block);
-		break;
-	case Entry::NORMAL:
-		parseEntry(e, codec->toUnicode(block));
-		break;
+	const int comma = text.indexOf(QLatin1Char(','), start);
+	if (comma < 0 || comma > end)
+		e._key = text.mid(start, end - start).trimmed();
+	else {
+		e._key = text.mid(start, comma - start).trimmed();
+		readFields(e, comma + 1, end);
 	}
 
+	if (!_keyIndex.contains(e._key))
+		_keyIndex.insert(e._key, _entries.size());
+	_entries.append(e);
 	return end + 1;
 }
 
-//static
-void BibTeXFile::parseEntry(Entry & e, const QString & block)
+void BibTeXFile::readFields(Entry & e, int start, const int end)
 {
-	int pos = block.indexOf(QChar::fromLatin1(','));
-	e._key = block.mid(0, pos).trimmed();
-	if (pos == -1) return;
-
-	QChar startDelim, endDelim;
-
-	do {
-		int start = pos + 1;
-		pos = block.indexOf(QChar::fromLatin1('='), start);
-		if (pos < 0) break;
-		QString key = block.mid(start, pos - start).trimmed();
-		QString val;
-		int i{pos + 1};
+	const QString & text = _data->text;
 
-		start = -1;
+	e._firstField = _data->fields.size();
+	while (start < end) {
+		const int pos = text.indexOf(QLatin1Char('='), start);
+		if (pos < 0 || pos >= end) break;
+		const int name = internFieldName(text.mid(start, pos - start).trimmed());
 
 		// Skip initial whitespace
-		for (i = pos + 1; i < block.size() && start < 0; ++i) {
-			if (!block[i].isSpace()) start = i;
-		}
-
-		for (i = start; i < block.size(); ++i) {
-			if (block[i] == QChar::fromLatin1(',')) break;
-			if (block[i] == QChar::fromLatin1('{')) {
-				startDelim = QChar::fromLatin1('{');
-				endDelim = QChar::fromLatin1('}');
-			}
-			else if (block[i] == QChar::fromLatin1('"')) {
-				startDelim = QChar::fromLatin1('"');
-				endDelim = QChar::fromLatin1('"');
-			}
-			else {
-				val += block[i];
-				continue;
-			}
-
-			int end = findBlock(block, i, startDelim, endDelim);
-			if (end < 0) {
-				val += block.midRef(i);
-				i = block.size();
-			}
-			else {
-				val += block.midRef(i, end - i + 1);
+		int i{pos + 1};
+		while (i < end && text[i].isSpace())
+			++i;
+		const int valueStart = i;
+
+		// The value extends to the next comma that is not enclosed in {} or ""
+		for (; i < end; ++i) {
+			const QChar c = text[i];
+			if (c == QLatin1Char(',')) break;
+			if (c != QLatin1Char('{') && c != QLatin1Char('"')) continue;
+			const int blockEnd = findBlock(text, i, c, (c == QLatin1Char('{') ? QLatin1Char('}') : c));
+			if (blockEnd < 0 || blockEnd >= end) {
 				i = end;
+				break;
 			}
+			i = blockEnd;
 		}
-		e._fields[key] = val.trimmed();
-		pos = i;
-	} while (pos >= 0 && pos + 1 < block.size());
+		_data->fields.append({name, valueStart, i - valueStart});
+		++e._numFields;
+		start = i + 1;
+	}
 }
 
-unsigned int BibTeXFile::numEntries() const
+int BibTeXFile::internFieldName(const QString & name)
 {
-	// Only count "normal" entries
-	unsigned int retVal = 0;
-	for (int i = 0; i < _entries.size(); ++i) {
-		if (_entries[i].type() == Entry::NORMAL) ++retVal;
-	}
-	return retVal;
+	const QString lowerName = name.toLower();
+	QHash<QString, int>::const_iterator it = _data->fieldIds.constFind(lowerName);
+	if (it != _data->fieldIds.constEnd())
+		return it.value();
+	const int id = _data->fieldIds.size();
+	_data->fieldIds.insert(lowerName, id);
+	return id;
 }
 
 const BibTeXFile::Entry & BibTeXFile::entry(const unsigned int idx) const
 {
-	unsigned int j = 0;
-	for (int i = 0; i < _entries.size(); ++i) {
-		if (_entries[i].type() != Entry::NORMAL) continue;
-		if (j == idx) return _entries[i];
-		++j;
-	}
+	if (idx < numEntries())
+		return _entries[static_cast<int>(idx)];
 	// We should never get here
-	static BibTeXFile::Entry e(nullptr);
+	static BibTeXFile::Entry e;
 	return e;
 }
+
+const BibTeXFile::Entry * BibTeXFile::entryForKey(const QString & key) const
+{
+	QHash<QString, int>::const_iterator it = _keyIndex.constFind(key);
+	if (it == _keyIndex.constEnd())
+		return nullptr;
+	return &_entries[it.value()];
+}
+
+QStringList BibTeXFile::keys() const
+{
+	QStringList retVal;
+	retVal.reserve(_entries.size());
+	for (int i = 0; i < _entries.size(); ++i)
+		retVal << _entries[i].key();
+	return retVal;
+}
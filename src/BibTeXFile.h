@@ -21,56 +21,74 @@
 #ifndef BIBTEXFILE_H
 #define BIBTEXFILE_H
 
-#include <QList>
-#include <QMap>
+#include <QHash>
+#include <QSharedPointer>
 #include <QString>
+#include <QStringList>
+#include <QVector>
 
+// Reads the entries of a BibTeX database. The file is decoded once and
+// scanned in a single pass; only the type, key, and the positions of the
+// fields of each entry are recorded while loading. Field values are
+// extracted from the text when they are requested, and field names are
+// interned per file. Entries can be looked up by key in constant time.
 class BibTeXFile
 {
+	struct Data;
 public:
 	class Entry {
 		friend BibTeXFile;
 	public:
 		enum Type { NORMAL, COMMENT, PREAMBLE, STRING };
 
-		explicit Entry(BibTeXFile * parent) : _parent(parent) { _cache.valid = false; }
-		Type type() const;
+		Entry() = default;
+		Type type() const { return _typeId; }
 		QString value(const QString & key) const;
 		bool hasField(const QString & key) const;
-		QString title() const { return (_cache.valid ? _cache.title : value(QString::fromLatin1("title"))); }
-		QString author() const { return (_cache.valid ? _cache.author : value(QString::fromLatin1("author"))); }
-		QString year() const { return (_cache.valid ? _cache.year : value(QString::fromLatin1("year"))); }
+		QString title() const { return value(QStringLiteral("title")); }
+		QString author() const { return value(QStringLiteral("author")); }
+		QString year() const { return value(QStringLiteral("year")); }
 		QString howPublished() const;
 		QString typeString() const { return _type; }
 		QString key() const { return _key; }
 
 	protected:
-		void updateCache();
+		// Returns the index of the field in Data::fields, or -1
+		int findField(const QString & key) const;
 
 		QString _type;
 		QString _key;
-		// Use a cache for common values to avoid having to search through all
-		// fields each time
-		struct {
-			QString title, author, year, howPublished;
-			bool valid;
-		} _cache;
-		QMap<QString, QString> _fields;
-		BibTeXFile * _parent;
+		Type _typeId{NORMAL};
+		// Note: Entries refer to the data of the BibTeXFile they were read
+		// from, so they are only valid as long as that (or a copy of it)
+		// exists
+		const Data * _data{nullptr};
+		int _firstField{0};
+		int _numFields{0};
 	};
 
 	BibTeXFile() = default;
 	explicit BibTeXFile(const QString & filename) : BibTeXFile() { load(filename); }
 
-	unsigned int numEntries() const;
+	// Only "normal" entries (i.e., no comments, preambles, or strings) are
+	// counted and accessible
+	unsigned int numEntries() const { return static_cast<unsigned int>(_entries.size()); }
 	const Entry & entry(const unsigned int idx) const;
+	// Returns the (first) entry with the given key, or nullptr
+	const Entry * entryForKey(const QString & key) const;
+	// Keys of all entries, in the order in which they appear
+	QStringList keys() const;
 
 	bool load(const QString & filename);
 protected:
-	static int readEntry(Entry & e, const QByteArray & content, int curPos, const QTextCodec * codec);
-	static void parseEntry(Entry & e, const QString & block);
+	void parse();
+	int readEntry(int curPos, QHash<QString, QString> & types);
+	void readFields(Entry & e, int start, const int end);
+	int internFieldName(const QString & name);
 
-	QList<Entry> _entries;
+	QSharedPointer<Data> _data;
+	QVector<Entry> _entries;
+	QHash<QString, int> _keyIndex;
 };
 
 #endif // BIBTEXFILE_H
@@ -23,6 +23,10 @@
 
 #include <QAbstractButton>
 #include <QKeyEvent>
+#include <QtConcurrent>
+
+// Number of entries from which on the filter is matched in the background
+const int kAsyncFilterThreshold = 10000;
 
 KeyForwarder::KeyForwarder(QObject * target, QObject * parent /* = nullptr */)
   : QObject(parent), _target(target)
@@ -72,7 +76,7 @@ CitationSelectDialog::CitationSelectDialog(QWidget *parent)
 
 	lineEdit->installEventFilter(new KeyForwarder(tableView));
 
-	connect(lineEdit, SIGNAL(textChanged(QString)), &_proxyModel, SLOT(setFilterFixedString(QString)));
+	connect(lineEdit, SIGNAL(textChanged(QString)), &_proxyModel, SLOT(setFilterText(QString)));
 	connect(buttonBox, SIGNAL(clicked(QAbstractButton*)), this, SLOT(buttonClicked(QAbstractButton*)));
 }
 
@@ -240,8 +244,9 @@ void CitationModel::setSelectedKeys(const QStringList & keys)
 
 const BibTeXFile::Entry * CitationModel::getEntry(const QString & key) const
 {
-	Q_FOREACH(const BibTeXFile::Entry * entry, _entries) {
-		if (key == entry->key()) return entry;
+	for (int i = 0; i < _bibFiles.size(); ++i) {
+		const BibTeXFile::Entry * e = _bibFiles[i].entryForKey(key);
+		if (e) return e;
 	}
 	return nullptr;
 }
@@ -300,25 +305,153 @@ void CitationModel::rebuildEntryCache()
 			_entries[i] = &(_bibFiles[iBibFile].entry(iEntry));
 		}
 	}
+
+	static QLatin1Char space(' ');
+	_searchStrings.resize(n);
+	for (i = 0; i < n; ++i) {
+		const BibTeXFile::Entry * e = _entries[i];
+		_searchStrings[i] = (e->key() + space + e->typeString() + space + e->author() + space + e->title() + space + e->year() + space + e->howPublished()).toLower();
+	}
+}
+
+CitationProxyModel::CitationProxyModel(QObject * parent /* = nullptr */)
+  : QSortFilterProxyModel(parent)
+{
+	connect(&_watcher, SIGNAL(finished()), this, SLOT(matchingFinished()));
+}
+
+CitationProxyModel::~CitationProxyModel()
+{
+	_watcher.waitForFinished();
+}
+
+//virtual
+void CitationProxyModel::setSourceModel(QAbstractItemModel * sourceModel)
+{
+	if (this->sourceModel())
+		disconnect(this->sourceModel(), nullptr, this, SLOT(refilter()));
+	QSortFilterProxyModel::setSourceModel(sourceModel);
+	if (sourceModel) {
+		// Note: CitationModel updates its search strings in response to the
+		// same signals, and it connected first
+		connect(sourceModel, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(refilter()));
+		connect(sourceModel, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(refilter()));
+		connect(sourceModel, SIGNAL(rowsMoved(QModelIndex,int,int,QModelIndex,int)), this, SLOT(refilter()));
+		connect(sourceModel, SIGNAL(modelReset()), this, SLOT(refilter()));
+	}
+	refilter();
+}
+
+void CitationProxyModel::refilter()
+{
+	// Use the most recent filter
+	if (_filterPending)
+		filter(_pendingNeedles, true);
+	else if (_watcher.isRunning())
+		filter(_runningNeedles, true);
+	else
+		filter(_needles, true);
 }
 
 bool CitationProxyModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const
 {
 	Q_UNUSED(source_parent)
+	// Rows that have not been matched yet (e.g., while matching runs in the
+	// background) are shown
+	if (source_row < 0 || source_row >= _matches.size())
+		return true;
+	return _matches.testBit(source_row);
+}
+
+void CitationProxyModel::setFilterText(const QString & text)
+{
 #if QT_VERSION < QT_VERSION_CHECK(5, 14, 0)
 	constexpr auto SkipEmptyParts = QString::SkipEmptyParts;
 #else
 	constexpr auto SkipEmptyParts = Qt::SkipEmptyParts;
 #endif
-	static QLatin1String space(" ");
-	const BibTeXFile::Entry * e = static_cast<const BibTeXFile::Entry*>(sourceModel()->index(source_row, 1).internalPointer());
-	QString haystack = e->key() + space + e->typeString() + space + e->author() + space + e->title() + space + e->year() + space + e->howPublished();
-	QStringList needles = filterRegExp().pattern().split(QChar::fromLatin1(' '), SkipEmptyParts);
+	filter(text.toLower().split(QChar::fromLatin1(' '), SkipEmptyParts), false);
+}
+
+void CitationProxyModel::filter(const QStringList & needles, const bool fromScratch)
+{
+	if (_watcher.isRunning()) {
+		// Only the most recent filter matters
+		_pendingFromScratch = (_pendingFromScratch || fromScratch);
+		_filterPending = true;
+		_pendingNeedles = needles;
+		return;
+	}
+
+	const CitationModel * model = qobject_cast<const CitationModel *>(sourceModel());
+	if (!model) {
+		applyMatches(needles, QBitArray());
+		return;
+	}
+	const QVector<QString> & haystacks = model->searchStrings();
+
+	// If each of the previous words is part of one of the new ones, rows that
+	// did not match before cannot match now
+	bool refines = (!fromScratch && _matches.size() == haystacks.size());
+	for (int i = 0; refines && i < _needles.size(); ++i) {
+		refines = false;
+		foreach (const QString & needle, needles) {
+			if (needle.contains(_needles[i])) {
+				refines = true;
+				break;
+			}
+		}
+	}
+	const QBitArray candidates = (refines ? _matches : QBitArray(haystacks.size(), true));
+
+	if (haystacks.size() < kAsyncFilterThreshold) {
+		applyMatches(needles, matchRows(haystacks, needles, candidates));
+		return;
+	}
+	_runningNeedles = needles;
+	_watcher.setFuture(QtConcurrent::run(&CitationProxyModel::matchRows, haystacks, needles, candidates));
+}
 
-	haystack = haystack.toLower();
+void CitationProxyModel::matchingFinished()
+{
+	const CitationModel * model = qobject_cast<const CitationModel *>(sourceModel());
+	const QBitArray matches = _watcher.result();
+	// The rows may have changed in the meantime
+	const bool valid = (model && matches.size() == model->searchStrings().size());
+	if (valid)
+		applyMatches(_runningNeedles, matches);
+
+	if (_filterPending || _pendingFromScratch || !valid) {
+		const QStringList needles = (_filterPending ? _pendingNeedles : _runningNeedles);
+		const bool fromScratch = (_pendingFromScratch || !valid);
+		_filterPending = false;
+		_pendingFromScratch = false;
+		_pendingNeedles.clear();
+		filter(needles, fromScratch);
+	}
+}
 
-	Q_FOREACH(QString needle, needles) {
-		if (!haystack.contains(needle.toLower())) return false;
+void CitationProxyModel::applyMatches(const QStringList & needles, const QBitArray & matches)
+{
+	_needles = needles;
+	_matches = matches;
+	invalidateFilter();
+	emit filteringFinished();
+}
+
+//static
+QBitArray CitationProxyModel::matchRows(const QVector<QString> & haystacks, const QStringList & needles, const QBitArray & candidates)
+{
+	QBitArray retVal(candidates);
+	for (int i = 0; i < haystacks.size() && i < retVal.size(); ++i) {
+		if (!retVal.testBit(i))
+			continue;
+		foreach (const QString & needle, needles) {
+			if (!haystacks[i].contains(needle)) {
+				retVal.clearBit(i);
+				break;
+			}
+		}
 	}
-	return true;
+	return retVal;
 }
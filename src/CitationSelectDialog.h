@@ -23,8 +23,10 @@
 
 #include "BibTeXFile.h"
 
+#include <QBitArray>
 #include <QDialog>
 #include <QDialogButtonBox>
+#include <QFutureWatcher>
 #include <QLineEdit>
 #include <QSet>
 #include <QSortFilterProxyModel>
@@ -50,20 +52,60 @@ public:
 	const BibTeXFile::Entry * getEntry(const QString & key) const;
 
 	void addBibTeXFile(const BibTeXFile & file);
+
+	// Lower-case text of each row that the filter is matched against (key,
+	// type, author, title, year, and journal)
+	const QVector<QString> & searchStrings() const { return _searchStrings; }
 protected slots:
 	void rebuildEntryCache();
 protected:
 	QList<BibTeXFile> _bibFiles;
 	QVector<const BibTeXFile::Entry *> _entries;
+	QVector<QString> _searchStrings;
 	QSet<QString> _selectedKeys;
 };
 
+// Shows the rows of a CitationModel that contain all (space-separated) words
+// of the filter text. The matching rows are cached, so refining the filter
+// (e.g., by typing further characters) only checks the rows that matched
+// before. For large libraries, the matching is done in the background.
 class CitationProxyModel : public QSortFilterProxyModel
 {
+	Q_OBJECT
 public:
-	CitationProxyModel(QObject * parent = nullptr) : QSortFilterProxyModel(parent) { }
+	CitationProxyModel(QObject * parent = nullptr);
+	~CitationProxyModel() override;
+
+	void setSourceModel(QAbstractItemModel * sourceModel) override;
 	bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
 	void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override { setSortRole(column == 0 ? Qt::CheckStateRole : Qt::DisplayRole); QSortFilterProxyModel::sort(column, order); }
+
+	bool isFiltering() const { return _watcher.isRunning(); }
+
+public slots:
+	void setFilterText(const QString & text);
+
+signals:
+	void filteringFinished();
+
+private slots:
+	void refilter();
+	void matchingFinished();
+
+private:
+	void filter(const QStringList & needles, const bool fromScratch);
+	void applyMatches(const QStringList & needles, const QBitArray & matches);
+	static QBitArray matchRows(const QVector<QString> & haystacks, const QStringList & needles, const QBitArray & candidates);
+
+	// the words of the filter and the rows that contain them
+	QStringList _needles;
+	QBitArray _matches;
+
+	QFutureWatcher<QBitArray> _watcher;
+	QStringList _runningNeedles;
+	bool _filterPending{false};
+	bool _pendingFromScratch{false};
+	QStringList _pendingNeedles;
 };
 
 class CitationTableView : public QTableView
@@ -32,7 +32,6 @@
 #include <QAbstractTextDocumentLayout>
 #include <QApplication>
 #include <QClipboard>
-#include <QCompleter>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -41,24 +40,28 @@
 #include <QModelIndex>
 #include <QPainter>
 #include <QScrollBar>
+#include <QSet>
 #include <QSignalMapper>
-#include <QStandardItem>
-#include <QStandardItemModel>
 #include <QTextBlock>
 #include <QTextCodec>
 #include <QTextCursor>
 #include <QTextStream>
 #include <QTimer>
+#include <QtConcurrent>
+
+// Fuzzy completion (if enabled) is only tried for prefixes of at least
+// kMinFuzzyPrefixLength characters and only offers reasonably close matches
+// (see Tw::Utils::CompletionIndex::findFuzzy())
+const int kMinFuzzyPrefixLength = 3;
+const int kMinFuzzyScore = 0;
+const int kMaxFuzzyCompletions = 50;
 
 CompletingEdit::CompletingEdit(QWidget *parent /* = nullptr */)
 	: QTextEdit(parent)
 {
 	Tw::Settings settings;
-	if (!sharedCompleter) { // initialize shared (static) members
-		sharedCompleter = new QCompleter(qApp);
-		sharedCompleter->setCompletionMode(QCompleter::InlineCompletion);
-		sharedCompleter->setCaseSensitivity(Qt::CaseInsensitive);
-		loadCompletionFiles(sharedCompleter);
+	if (!currentCompletionFormat) { // initialize shared (static) members
+		loadCompletionFiles();
 
 		currentCompletionFormat = new QTextCharFormat;
 		braceMatchingFormat = new QTextCharFormat;
@@ -66,6 +69,7 @@ CompletingEdit::CompletingEdit(QWidget *parent /* = nullptr */)
 
 		highlightCurrentLine = settings.value(QString::fromLatin1("highlightCurrentLine"), true).toBool();
 		autocompleteEnabled = settings.value(QString::fromLatin1("autocompleteEnabled"), true).toBool();
+		fuzzyCompletion = settings.value(QStringLiteral("fuzzyCompletion"), kDefault_FuzzyCompletion).toBool();
 	}
 	setCursorWidth(settings.value(QStringLiteral("cursorWidth"), kDefault_CursorWidth).toInt());
 
@@ -206,23 +210,16 @@ void CompletingEdit::updateColors()
 	lineNumberArea->setBgColor(QColor::fromRgbF(0.75 * bgR + 0.25 * fgR, 0.75 * bgG + 0.25 * fgG, 0.75 * bgB + 0.25 * fgB));
 }
 
-CompletingEdit::~CompletingEdit()
-{
-	setCompleter(nullptr);
-}
-
-void CompletingEdit::setCompleter(QCompleter *completer)
+void CompletingEdit::resetCompletion()
 {
-	c = completer;
-	if (!c)
-		return;
-
-	c->setWidget(this);
+	cmpCandidates.clear();
+	cmpRow = -1;
+	cmpPrefix.clear();
 }
 
 void CompletingEdit::cursorPositionChangedSlot()
 {
-	setCompleter(nullptr);
+	resetCompletion();
 	if (!currentCompletionRange.isNull())
 		currentCompletionRange = QTextCursor();
 	resetExtraSelections();
@@ -556,8 +553,6 @@ void CompletingEdit::timerEvent(QTimerEvent *e)
 
 void CompletingEdit::focusInEvent(QFocusEvent *e)
 {
-	if (c)
-		c->setWidget(this);
 	QTextEdit::focusInEvent(e);
 }
 
@@ -870,7 +865,25 @@ bool CompletingEdit::handleCompletionShortcut(QKeyEvent *e)
 			atLineStart = true;
 	}
 
-	if (!c && !atLineStart) {
+	if (cmpCandidates.isEmpty() && !atLineStart && projectIndex) {
+		// Inside the argument of, e.g., \ref or \cite, complete the whole
+		// argument from the project's symbols (labels often contain
+		// characters such as ':' that end words)
+		QTextCursor argument;
+		Tw::Document::ProjectIndex::Symbol::Type type{Tw::Document::ProjectIndex::Symbol::Label};
+		if (noSelection && findSymbolArgument(textCursor().position(), argument, type)) {
+			cmpCandidates = findProjectSymbols(argument.selectedText(), type);
+			if (!cmpCandidates.isEmpty()) {
+				cmpCursor = argument;
+				cmpPrefix = argument.selectedText();
+				cmpRow = (seq == actionPrevious_Completion->shortcut() ? cmpCandidates.size() - 1 : 0);
+				showCurrentCompletion();
+				return true;
+			}
+		}
+	}
+
+	if (cmpCandidates.isEmpty() && !atLineStart) {
 		cmpCursor = textCursor();
 		if (!selectWord(cmpCursor) && textCursor().selectionStart() > 0) {
 			cmpCursor.setPosition(textCursor().selectionStart() - 1);
@@ -907,20 +920,24 @@ bool CompletingEdit::handleCompletionShortcut(QKeyEvent *e)
 		while (true) {
 			QString completionPrefix = cmpCursor.selectedText();
 			if (!completionPrefix.isEmpty()) {
-				setCompleter(sharedCompleter);
-				c->setCompletionPrefix(completionPrefix);
-				if (c->completionCount() == 0) {
+				cmpCandidates = findCompletions(completionPrefix, false);
+				if (cmpCandidates.isEmpty()) {
 					if (cmpCursor.selectionStart() < start) {
 						// we must have included a preceding brace or hyphen; now try without it
 						cmpCursor.setPosition(start);
 						cmpCursor.setPosition(end, QTextCursor::KeepAnchor);
 						continue;
 					}
-					setCompleter(nullptr);
+					// no abbreviation starts with the prefix; if enabled, fall
+					// back to abbreviations that contain its characters in
+					// order. This is off by default as it would keep Tab from
+					// inserting a tab after ordinary words.
+					if (fuzzyCompletion && completionPrefix.length() >= kMinFuzzyPrefixLength)
+						cmpCandidates = findCompletions(completionPrefix, true);
 				}
-				else {
-					if (seq == actionPrevious_Completion->shortcut())
-						c->setCurrentRow(c->completionCount() - 1);
+				if (!cmpCandidates.isEmpty()) {
+					cmpPrefix = completionPrefix;
+					cmpRow = (seq == actionPrevious_Completion->shortcut() ? cmpCandidates.size() - 1 : 0);
 					showCurrentCompletion();
 					return true;
 				}
@@ -929,24 +946,24 @@ bool CompletingEdit::handleCompletionShortcut(QKeyEvent *e)
 		}
 	}
 
-	if (c && c->completionCount() > 0) {
+	if (!cmpCandidates.isEmpty()) {
 		if (seq == actionPrevious_Completion->shortcut()) {
-			if (c->currentRow() == 0) {
-				showCompletion(c->completionPrefix());
-				setCompleter(nullptr);
+			if (cmpRow == 0) {
+				showCompletion(cmpPrefix);
+				resetCompletion();
 			}
 			else {
-				c->setCurrentRow(c->currentRow() - 1);
+				--cmpRow;
 				showCurrentCompletion();
 			}
 		}
 		else {
-			if (c->currentRow() == c->completionCount() - 1) {
-				showCompletion(c->completionPrefix());
-				setCompleter(nullptr);
+			if (cmpRow == cmpCandidates.size() - 1) {
+				showCompletion(cmpPrefix);
+				resetCompletion();
 			}
 			else {
-				c->setCurrentRow(c->currentRow() + 1);
+				++cmpRow;
 				showCurrentCompletion();
 			}
 		}
@@ -972,13 +989,10 @@ void CompletingEdit::showCompletion(const QString& completion, int insOffset)
 {
 	disconnect(this, SIGNAL(cursorPositionChanged()), this, SLOT(cursorPositionChangedSlot()));
 
-	if (c->widget() != this)
-		return;
-
 	QTextCursor tc = cmpCursor;
 	if (tc.isNull()) {
 		tc = textCursor();
-		tc.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, c->completionPrefix().length());
+		tc.movePosition(QTextCursor::PreviousCharacter, QTextCursor::KeepAnchor, cmpPrefix.length());
 	}
 
 	tc.insertText(completion);
@@ -997,34 +1011,10 @@ void CompletingEdit::showCompletion(const QString& completion, int insOffset)
 
 void CompletingEdit::showCurrentCompletion()
 {
-	if (c->widget() != this)
+	if (cmpRow < 0 || cmpRow >= cmpCandidates.size())
 		return;
 
-	QStandardItemModel *model = qobject_cast<QStandardItemModel*>(c->model());
-	QList<QStandardItem*> items = model->findItems(c->currentCompletion());
-
-	if (items.count() > 1) {
-		if (c->currentCompletion() == prevCompletion) {
-			if (c->currentIndex().row() > prevRow)
-				++itemIndex;
-			else
-				--itemIndex;
-			if (itemIndex < 0)
-				itemIndex = items.count() - 1;
-			else if (itemIndex > items.count() - 1)
-				itemIndex = 0;
-		}
-		else
-			itemIndex = 0;
-		prevRow = c->currentIndex().row();
-		prevCompletion = c->currentCompletion();
-	}
-	else {
-		prevCompletion = QString();
-		itemIndex = 0;
-	}
-
-	QString completion = model->item(items[itemIndex]->row(), 1)->text();
+	QString completion = cmpCandidates[cmpRow];
 
 	int insOffset = completion.indexOf(QLatin1String("#INS#"));
 	if (insOffset != -1)
@@ -1033,46 +1023,125 @@ void CompletingEdit::showCurrentCompletion()
 	showCompletion(completion, insOffset);
 }
 
-void CompletingEdit::loadCompletionsFromFile(QStandardItemModel *model, const QString& filename)
+static Tw::Utils::CompletionIndex * buildCompletionIndex(const QStringList & files)
 {
-	QFile	completionFile(filename);
-	if (completionFile.exists() && completionFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-		QTextStream in(&completionFile);
-		in.setCodec("UTF-8");
-		in.setAutoDetectUnicode(true);
-		QList<QStandardItem*> row;
-		while (true) {
-			QString	line = in.readLine();
-			if (line.isNull())
-				break;
-			if (line[0] == QChar::fromLatin1('%'))
-				continue;
-			line.replace(QLatin1String("#RET#"), QLatin1String("\n"));
-			QStringList parts = line.split(QString::fromLatin1(":="));
-			if (parts.count() > 2)
-				continue;
-			if (parts.count() == 1)
-				parts.append(parts[0]);
-			parts[0].replace(QLatin1String("#INS#"), QLatin1String(""));
-			row.append(new QStandardItem(parts[0]));
-			row.append(new QStandardItem(parts[1]));
-			model->appendRow(row);
-			row.clear();
-		}
-		completionFile.close();
-	}
+	return new Tw::Utils::CompletionIndex(Tw::Utils::CompletionIndex::load(files));
 }
 
-void CompletingEdit::loadCompletionFiles(QCompleter *theCompleter)
+//static
+void CompletingEdit::loadCompletionFiles()
 {
-	QStandardItemModel *model = new QStandardItemModel(0, 2, theCompleter); // columns are abbrev, expansion
-
+	// Only the list of files is determined here; reading and indexing them
+	// happens in the background while the application starts up
+	QStringList files;
 	QDir completionDir(TWUtils::getLibraryPath(QString::fromLatin1("completion")));
 	foreach (QFileInfo fileInfo, completionDir.entryInfoList(QDir::Files | QDir::Readable, QDir::Name)) {
-		loadCompletionsFromFile(model, fileInfo.canonicalFilePath());
+		files << fileInfo.canonicalFilePath();
 	}
+	sharedCompletionIndex = QtConcurrent::run(buildCompletionIndex, files);
+}
 
-	theCompleter->setModel(model);
+//static
+const Tw::Utils::CompletionIndex & CompletingEdit::completionIndex()
+{
+	// Blocks only if the index is requested before it has finished loading
+	return *sharedCompletionIndex.result();
+}
+
+void CompletingEdit::setProjectIndex(Tw::Document::ProjectIndex * index)
+{
+	if (projectIndex)
+		disconnect(projectIndex, nullptr, this, nullptr);
+	projectIndex = index;
+	projectCompletionsOutdated = true;
+	if (projectIndex)
+		connect(projectIndex, SIGNAL(updated()), this, SLOT(projectIndexUpdated()));
+}
+
+void CompletingEdit::updateProjectCompletions()
+{
+	if (!projectCompletionsOutdated)
+		return;
+	projectCompletionsOutdated = false;
+
+	projectCompletions = QVector<Tw::Utils::CompletionIndex>(static_cast<int>(Tw::Document::ProjectIndex::Symbol::Citation) + 1);
+	if (projectIndex) {
+		foreach (const Tw::Document::ProjectIndex::Symbol & symbol, projectIndex->symbols())
+			projectCompletions[symbol.type].addEntry(symbol.name, symbol.name);
+	}
+	for (int i = 0; i < projectCompletions.size(); ++i)
+		projectCompletions[i].finalize();
+}
+
+QStringList CompletingEdit::findProjectSymbols(const QString & prefix, const Tw::Document::ProjectIndex::Symbol::Type type)
+{
+	updateProjectCompletions();
+	QStringList retVal;
+	if (static_cast<int>(type) >= projectCompletions.size())
+		return retVal;
+	const Tw::Utils::CompletionIndex & index = projectCompletions[type];
+	foreach (const int entry, index.find(prefix))
+		retVal << index.expansion(entry);
+	return retVal;
+}
+
+QStringList CompletingEdit::findCompletions(const QString & prefix, const bool fuzzy)
+{
+	QStringList retVal;
+	foreach (const int entry, (fuzzy ? completionIndex().findFuzzy(prefix, kMaxFuzzyCompletions, kMinFuzzyScore) : completionIndex().find(prefix)))
+		retVal << completionIndex().expansion(entry);
+
+	// Project symbols come after the static completions; a preceding brace
+	// (which we may have included in the prefix) is kept
+	if (!projectIndex)
+		return retVal;
+	updateProjectCompletions();
+	const bool hasBrace = prefix.startsWith(QChar::fromLatin1('{'));
+	const QString symbolPrefix = (hasBrace ? prefix.mid(1) : prefix);
+	if (symbolPrefix.isEmpty())
+		return retVal;
+	QSet<QString> found;
+	foreach (const QString & completion, retVal)
+		found.insert(completion);
+	foreach (const Tw::Utils::CompletionIndex & index, projectCompletions) {
+		foreach (const int entry, (fuzzy ? index.findFuzzy(symbolPrefix, kMaxFuzzyCompletions, kMinFuzzyScore) : index.find(symbolPrefix))) {
+			const QString completion = (hasBrace ? QChar::fromLatin1('{') : QString()) + index.expansion(entry);
+			if (!found.contains(completion)) {
+				found.insert(completion);
+				retVal << completion;
+			}
+		}
+	}
+	return retVal;
+}
+
+bool CompletingEdit::findSymbolArgument(const int pos, QTextCursor & argument, Tw::Document::ProjectIndex::Symbol::Type & type) const
+{
+	// The last (possibly empty) item of a comma-separated list in the first
+	// mandatory argument of a command
+	static const QRegularExpression reArgument(QStringLiteral("\\\\([A-Za-z]+)\\*?\\s*(?:\\[[^\\]]*\\]\\s*)*\\{(?:[^{},]*,)*\\s*([^{},\\s]*)$"));
+
+	const QTextBlock block = document()->findBlock(pos);
+	if (!block.isValid())
+		return false;
+	const QRegularExpressionMatch m = reArgument.match(block.text().left(pos - block.position()));
+	if (!m.hasMatch())
+		return false;
+
+	const QString command = m.captured(1);
+	if (command.contains(QLatin1String("ref"), Qt::CaseInsensitive) && command != QLatin1String("href"))
+		type = Tw::Document::ProjectIndex::Symbol::Label;
+	else if (command.contains(QLatin1String("cite"), Qt::CaseInsensitive))
+		type = Tw::Document::ProjectIndex::Symbol::Citation;
+	else if (command == QLatin1String("begin") || command == QLatin1String("end"))
+		type = Tw::Document::ProjectIndex::Symbol::Environment;
+	else
+		return false;
+
+	argument = QTextCursor(document());
+	argument.setPosition(block.position() + m.capturedStart(2));
+	argument.setPosition(pos, QTextCursor::KeepAnchor);
+	return true;
 }
 
 void CompletingEdit::jumpToPdf(QTextCursor pos)
@@ -1285,6 +1354,7 @@ void CompletingEdit::resizeEvent(QResizeEvent *e)
 
 	QRect cr = contentsRect();
 	lineNumberArea->setGeometry(QRect(cr.left(), cr.top(), lineNumberArea->sizeHint().width(), cr.height()));
+	updateHighlightingPriority();
 }
 
 void CompletingEdit::wheelEvent(QWheelEvent *e)
@@ -1332,6 +1402,7 @@ void CompletingEdit::setDocument(QTextDocument * document)
 	QTextEdit::setDocument(document);
 	setCursorWidth(oldCursorWidth);
 	connect(document, SIGNAL(blockCountChanged(int)), this, SLOT(updateLineNumberAreaWidth(int)));
+	updateHighlightingPriority();
 }
 
 bool CompletingEdit::event(QEvent *e)
@@ -1370,6 +1441,21 @@ void CompletingEdit::scrollContentsBy(int dx, int dy)
 		emit updateRequest(viewport()->rect(), dy);
 	}
 	QTextEdit::scrollContentsBy(dx, dy);
+	if (dy != 0)
+		updateHighlightingPriority();
+}
+
+void CompletingEdit::updateHighlightingPriority()
+{
+	// Have the visible text highlighted first
+	Tw::Document::TeXDocument * doc = qobject_cast<Tw::Document::TeXDocument *>(document());
+	if (doc == nullptr)
+		return;
+	TeXHighlighter * highlighter = doc->getHighlighter();
+	if (highlighter == nullptr)
+		return;
+	const QRect r = viewport()->rect();
+	highlighter->setPriorityRange(cursorForPosition(r.topLeft()).position(), cursorForPosition(r.bottomRight()).position());
 }
 
 Tw::Document::SpellChecker::Dictionary * CompletingEdit::getSpellChecker() const
@@ -1434,8 +1520,9 @@ QTextCharFormat	*CompletingEdit::braceMatchingFormat = nullptr;
 QTextCharFormat	*CompletingEdit::currentLineFormat = nullptr;
 bool CompletingEdit::highlightCurrentLine = true;
 bool CompletingEdit::autocompleteEnabled = true;
+bool CompletingEdit::fuzzyCompletion = kDefault_FuzzyCompletion;
 
-QCompleter	*CompletingEdit::sharedCompleter = nullptr;
+QFuture<Tw::Utils::CompletionIndex *> CompletingEdit::sharedCompletionIndex;
 
 QList<CompletingEdit::IndentMode> *CompletingEdit::indentModes = nullptr;
 QList<CompletingEdit::QuotesMode> *CompletingEdit::quotesModes = nullptr;
@@ -22,19 +22,21 @@
 #ifndef COMPLETING_EDIT_H
 #define COMPLETING_EDIT_H
 
+#include "document/ProjectIndex.h"
 #include "document/SpellChecker.h"
 #include "ui/LineNumberWidget.h"
 #include "ui_CompletingEdit.h"
+#include "utils/CompletionIndex.h"
 
 #include <QDrag>
+#include <QFuture>
 #include <QHash>
 #include <QMimeData>
+#include <QPointer>
 #include <QRegularExpression>
 #include <QTextEdit>
 #include <QTimer>
 
-class QCompleter;
-class QStandardItemModel;
 class QTextCodec;
 
 class CompletingEdit : public QTextEdit, private Ui::CompletingEdit
@@ -43,7 +45,7 @@ class CompletingEdit : public QTextEdit, private Ui::CompletingEdit
 
 public:
 	CompletingEdit(QWidget *parent = nullptr);
-	~CompletingEdit() override;
+	~CompletingEdit() override = default;
 
 	bool selectWord(QTextCursor& cursor);
 
@@ -75,6 +77,10 @@ public:
 	void prefixLines(const QString &prefix);
 	void unPrefixLines(const QString &prefix);
 
+	// Offers the symbols of the project (labels, macros, etc.) for completion
+	// in addition to the static completion files
+	void setProjectIndex(Tw::Document::ProjectIndex * index);
+
 public slots:
 	void setAutoIndentMode(int index);
 	void setSmartQuotesMode(int index);
@@ -85,6 +91,7 @@ public slots:
 	void setFontItalic(bool italic);
 	void setFontPointSize(qreal s);
 	void setFontWeight(int weight);
+	void updateHighlightingPriority();
 
 signals:
 	void syncClick(int line, int col);
@@ -120,17 +127,29 @@ private slots:
 	void jumpToPdf(QTextCursor pos = {});
 	void jumpToPdfFromContextMenu();
 	void updateLineNumberArea(const QRect&, int);
+	void projectIndexUpdated() { projectCompletionsOutdated = true; }
 
 private:
 	void updateColors();
 
-	void setCompleter(QCompleter *c);
+	void resetCompletion();
 
 	void showCompletion(const QString& completion, int insOffset = -1);
 	void showCurrentCompletion();
 
-	void loadCompletionsFromFile(QStandardItemModel *model, const QString& filename);
-	void loadCompletionFiles(QCompleter *theCompleter);
+	static void loadCompletionFiles();
+	static const Tw::Utils::CompletionIndex & completionIndex();
+
+	// Returns the expansions of all (static and project) completions for
+	// `prefix`
+	QStringList findCompletions(const QString & prefix, const bool fuzzy);
+	// Returns the project symbols of the given type that start with `prefix`
+	QStringList findProjectSymbols(const QString & prefix, const Tw::Document::ProjectIndex::Symbol::Type type);
+	// Checks if `pos` is in the argument of a command that takes a project
+	// symbol (e.g., \ref or \cite); if so, `argument` is set to the part of
+	// the argument before `pos`
+	bool findSymbolArgument(const int pos, QTextCursor & argument, Tw::Document::ProjectIndex::Symbol::Type & type) const;
+	void updateProjectCompletions();
 
 	bool handleCompletionShortcut(QKeyEvent *e);
 	void handleReturn(QKeyEvent *e);
@@ -186,12 +205,17 @@ private:
 
 	int smartQuotesMode{-1};
 
-	QCompleter * c{nullptr};
 	QTextCursor cmpCursor;
+	// the completion in progress: candidates (expansions), the one currently
+	// shown, and the text they complete
+	QStringList cmpCandidates;
+	int cmpRow{-1};
+	QString cmpPrefix;
 
-	QString prevCompletion; // used with multiple entries for the same key (e.g., "--")
-	int itemIndex{0};
-	int prevRow{-1};
+	QPointer<Tw::Document::ProjectIndex> projectIndex;
+	// one index per Tw::Document::ProjectIndex::Symbol::Type
+	QVector<Tw::Utils::CompletionIndex> projectCompletions;
+	bool projectCompletionsOutdated{false};
 
 	QTextCursor currentWord;
 
@@ -203,10 +227,11 @@ private:
 	static QTextCharFormat	*braceMatchingFormat;
 	static QTextCharFormat	*currentLineFormat;
 
-	static QCompleter	*sharedCompleter;
+	static QFuture<Tw::Utils::CompletionIndex *> sharedCompletionIndex;
 
 	static bool highlightCurrentLine;
 	static bool autocompleteEnabled;
+	static bool fuzzyCompletion;
 };
 
 #endif // COMPLETING_EDIT_H
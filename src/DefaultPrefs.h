@@ -39,6 +39,7 @@ const int kDefault_HideConsole = 1;
 const bool kDefault_HighlightCurrentLine = true;
 const int kDefault_CursorWidth = 1;
 const bool kDefault_AutocompleteEnabled = true;
+const bool kDefault_FuzzyCompletion = false;
 const bool kDefault_AutoFollowFocusEnabled = false;
 const bool kDefault_AllowScriptFileReading = false;
 const bool kDefault_AllowScriptFileWriting = false;
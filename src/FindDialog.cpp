@@ -112,7 +112,9 @@ void FindDialog::init(QTextEdit *document)
 	checkBox_findAll->setChecked(findAll);
 
 	bool allFiles = settings.value(QString::fromLatin1("searchAllFiles")).toBool();
-	checkBox_allFiles->setEnabled(TeXDocumentWindow::documentList().count() > 1);
+	// Searching all files also covers the files of the project on disk
+	TeXDocumentWindow * texDoc = qobject_cast<TeXDocumentWindow*>(document->window());
+	checkBox_allFiles->setEnabled(TeXDocumentWindow::documentList().count() > 1 || (texDoc && !texDoc->untitled()));
 	checkBox_allFiles->setChecked(allFiles && checkBox_allFiles->isEnabled());
 
 	bool selectionOption = settings.value(QString::fromLatin1("searchSelection")).toBool();
@@ -427,6 +429,31 @@ SearchResults::SearchResults(QWidget* parent)
 	QShortcut * sc = new QShortcut(Qt::Key_Escape, table);
 	sc->setContext(Qt::WidgetShortcut);
 	connect(sc, SIGNAL(activated()), this, SLOT(goToSourceAndClose()));
+
+	table->setHorizontalHeaderLabels(QStringList() << tr("File") << tr("Line") << tr("Start") << tr("End") << tr("Text"));
+	table->horizontalHeader()->setSectionResizeMode(4, QHeaderView::Stretch);
+	table->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
+	table->verticalHeader()->hide();
+	table->setColumnHidden(2, true);
+	table->setColumnHidden(3, true);
+}
+
+// Returns the window of the document the result in `item` was found in if it
+// was found in a document that is (still) open. Otherwise, `fileName` is set
+// to the file to open (which is empty for untitled documents that were closed
+// in the meantime).
+static TeXDocumentWindow * windowForResult(const QTableWidgetItem * item, QString & fileName)
+{
+	const quintptr document = item->data(Qt::UserRole).value<quintptr>();
+	fileName = (document ? QString() : item->toolTip());
+	if (document == 0)
+		return nullptr;
+	// Note: The pointer is only compared as the document may not exist anymore
+	foreach (TeXDocumentWindow * doc, TeXDocumentWindow::documentList()) {
+		if (reinterpret_cast<quintptr>(static_cast<const QTextDocument *>(doc->textDoc())) == document)
+			return doc;
+	}
+	return nullptr;
 }
 
 void SearchResults::goToSource()
@@ -439,15 +466,16 @@ void SearchResults::goToSource()
 	QTableWidgetItem* item = table->item(row, 0);
 	if (!item)
 		return;
-	fileName = item->toolTip();
-
-	if (!fileName.isEmpty()) {
-		QWidget *theDoc = TeXDocumentWindow::openDocument(fileName);
-		if (theDoc) {
-			QTextEdit *editor = theDoc->findChild<QTextEdit*>(QString::fromLatin1("textEdit"));
-			if (editor)
-				editor->setFocus();
-		}
+
+	TeXDocumentWindow * theDoc = windowForResult(item, fileName);
+	if (theDoc)
+		theDoc->selectWindow();
+	else if (!fileName.isEmpty())
+		theDoc = TeXDocumentWindow::openDocument(fileName);
+	if (theDoc) {
+		QTextEdit *editor = theDoc->findChild<QTextEdit*>(QString::fromLatin1("textEdit"));
+		if (editor)
+			editor->setFocus();
 	}
 }
 
@@ -475,21 +503,54 @@ void SearchResults::presentResults(const QString& searchText,
 
 	SearchResults* resultsWindow = new SearchResults(parent);
 	resultsWindow->setWindowTitle(tr("Search Results - %1 (%2 found)").arg(searchText).arg(results.count()));
+	resultsWindow->appendResults(results);
+	resultsWindow->present(parent, singleFile);
+}
 
-	resultsWindow->table->setRowCount(results.count());
-	int i = 0;
+//static
+SearchResults * SearchResults::presentResults(const QString& searchText, Tw::Document::ProjectSearch * search,
+											  QMainWindow* parent)
+{
+	SearchResults* resultsWindow = new SearchResults(parent);
+	resultsWindow->_searchText = searchText;
+	resultsWindow->_projectSearch = search;
+	search->setParent(resultsWindow);
+	resultsWindow->setWindowTitle(tr("Search Results - %1 (searching...)").arg(searchText));
+	// Closing the window destroys it (and thereby cancels the search)
+	resultsWindow->setAttribute(Qt::WA_DeleteOnClose);
+	connect(search, &Tw::Document::ProjectSearch::resultsFound, resultsWindow, &SearchResults::projectResultsFound);
+	connect(search, &Tw::Document::ProjectSearch::finished, resultsWindow, &SearchResults::projectSearchFinished);
+	resultsWindow->present(parent, false);
+	return resultsWindow;
+}
+
+void SearchResults::appendResults(const QList<SearchResult>& results)
+{
+	int i = table->rowCount();
+	table->setRowCount(i + results.count());
 	foreach (const SearchResult &result, results) {
-		QTableWidgetItem *item = new QTableWidgetItem(QFileInfo(result.doc->fileName()).fileName());
-		item->setToolTip(result.doc->fileName());
-		resultsWindow->table->setItem(i, 0, item);
-		resultsWindow->table->setItem(i, 1, new QTableWidgetItem(QString::number(result.lineNo)));
-		resultsWindow->table->setItem(i, 2, new QTableWidgetItem(QString::number(result.selStart)));
-		resultsWindow->table->setItem(i, 3, new QTableWidgetItem(QString::number(result.selEnd)));
+		QString name = result.fileName;
+		if (name.isEmpty()) {
+			// Untitled documents only have the name shown in their window
+			foreach (TeXDocumentWindow * doc, TeXDocumentWindow::documentList()) {
+				if (doc->textDoc() == result.document)
+					name = doc->fileName();
+			}
+		}
+		QTableWidgetItem *item = new QTableWidgetItem(QFileInfo(name).fileName());
+		item->setToolTip(name);
+		// Results in open documents are identified by the document (see
+		// windowForResult())
+		item->setData(Qt::UserRole, QVariant::fromValue(reinterpret_cast<quintptr>(result.document)));
+		table->setItem(i, 0, item);
+		table->setItem(i, 1, new QTableWidgetItem(QString::number(result.lineNo)));
+		table->setItem(i, 2, new QTableWidgetItem(QString::number(result.selStart)));
+		table->setItem(i, 3, new QTableWidgetItem(QString::number(result.selEnd)));
 
 		// Only show a limited number of characters before and after the
 		// specified search string to keep the results clear
 		bool truncateStart = true, truncateEnd = true;
-		QString text = result.doc->getLineText(result.lineNo);
+		QString text = result.lineText;
 		int iStart = result.selStart - MAXIMUM_CHARACTERS_BEFORE_SEARCH_RESULT;
 		int iEnd = result.selEnd + MAXIMUM_CHARACTERS_AFTER_SEARCH_RESULT;
 		if (iStart < 0) {
@@ -523,34 +584,48 @@ void SearchResults::presentResults(const QString& searchText,
 			text.prepend(tr("..."));
 		if (truncateEnd)
 			text.append(tr("..."));
-		resultsWindow->table->setItem(i, 4, new QTableWidgetItem(text));
+		table->setItem(i, 4, new QTableWidgetItem(text));
 
 		++i;
 	}
 
-	resultsWindow->table->setHorizontalHeaderLabels(QStringList() << tr("File") << tr("Line") << tr("Start") << tr("End") << tr("Text"));
-	resultsWindow->table->horizontalHeader()->setSectionResizeMode(4, QHeaderView::Stretch);
-	resultsWindow->table->verticalHeader()->setSectionResizeMode(QHeaderView::ResizeToContents);
-	resultsWindow->table->verticalHeader()->hide();
-	resultsWindow->table->setColumnHidden(2, true);
-	resultsWindow->table->setColumnHidden(3, true);
-
-	resultsWindow->table->resizeColumnsToContents();
-	resultsWindow->table->resizeRowsToContents();
+	table->resizeColumnsToContents();
+}
 
+void SearchResults::present(QMainWindow * parent, bool singleFile)
+{
 	if (singleFile) {
-		resultsWindow->setAllowedAreas(Qt::TopDockWidgetArea|Qt::BottomDockWidgetArea);
-		resultsWindow->setFloating(false);
-		parent->addDockWidget(Qt::TopDockWidgetArea, resultsWindow);
+		setAllowedAreas(Qt::TopDockWidgetArea|Qt::BottomDockWidgetArea);
+		setFloating(false);
+		parent->addDockWidget(Qt::TopDockWidgetArea, this);
 	}
 	else {
-		resultsWindow->setAllowedAreas(Qt::NoDockWidgetArea);
-		resultsWindow->setFeatures(QDockWidget::NoDockWidgetFeatures);
-		resultsWindow->setParent(nullptr);
-		resultsWindow->setWindowFlags(Qt::Window | Qt::WindowStaysOnTopHint);
+		setAllowedAreas(Qt::NoDockWidgetArea);
+		setFeatures(QDockWidget::NoDockWidgetFeatures);
+		setParent(nullptr);
+		setWindowFlags(Qt::Window | Qt::WindowStaysOnTopHint);
 	}
 
-	resultsWindow->show();
+	show();
+}
+
+void SearchResults::projectResultsFound(const QString & fileName, QTextDocument * document, const QVector<Tw::Document::ProjectSearch::Hit> & hits)
+{
+	QList<SearchResult> results;
+	results.reserve(hits.size());
+	foreach (const Tw::Document::ProjectSearch::Hit & hit, hits)
+		results.append(SearchResult(fileName, hit.lineNo, hit.selStart, hit.selEnd, hit.lineText, document));
+	appendResults(results);
+	setWindowTitle(tr("Search Results - %1 (%2 found, searching...)").arg(_searchText).arg(table->rowCount()));
+}
+
+void SearchResults::projectSearchFinished()
+{
+	if (!_projectSearch || _projectSearch->wasCanceled())
+		return;
+	if (table->rowCount() == 0)
+		qApp->beep();
+	setWindowTitle(tr("Search Results - %1 (%2 found in %n file(s))", "", _projectSearch->numFilesSearched()).arg(_searchText).arg(table->rowCount()));
 }
 
 void SearchResults::showEntry(QTableWidgetItem * item)
@@ -558,8 +633,8 @@ void SearchResults::showEntry(QTableWidgetItem * item)
 	if (!item)
 		return;
 	int row = item->row();
-	item = table->item(row, 0);
-	QString fileName = item->toolTip();
+	QString fileName;
+	TeXDocumentWindow * doc = windowForResult(table->item(row, 0), fileName);
 	item = table->item(row, 1);
 	int lineNo = item->text().toInt();
 	item = table->item(row, 2);
@@ -567,7 +642,11 @@ void SearchResults::showEntry(QTableWidgetItem * item)
 	item = table->item(row, 3);
 	int selEnd = item->text().toInt();
 
-	if (!fileName.isEmpty())
+	if (doc) {
+		doc->selectWindow(false);
+		doc->goToLine(lineNo, selStart, selEnd);
+	}
+	else if (!fileName.isEmpty())
 		TeXDocumentWindow::openDocument(fileName, false, true, lineNo, selStart, selEnd);
 }
 
@@ -26,6 +26,7 @@
 #include <QDockWidget>
 #include <QList>
 
+#include "document/ProjectSearch.h"
 #include "ui_Find.h"
 #include "ui_PDFFind.h"
 #include "ui_Replace.h"
@@ -124,14 +125,19 @@ private:
 
 class SearchResult {
 public:
-	SearchResult(const TeXDocumentWindow* texdoc, int line, int start, int end)
-		: doc(texdoc), lineNo(line), selStart(start), selEnd(end)
+	SearchResult(const QString & file, int line, int start, int end, const QString & text, const QTextDocument * doc = nullptr)
+		: fileName(file), document(doc), lineNo(line), selStart(start), selEnd(end), lineText(text)
 		{ }
 
-	const TeXDocumentWindow* doc;
+	// Empty for untitled documents
+	QString fileName;
+	// The open document the result was found in (if any); it is only used to
+	// identify the document (which may be closed in the meantime)
+	const QTextDocument * document;
 	int lineNo;
 	int selStart;
 	int selEnd;
+	QString lineText;
 };
 
 class PDFSearchResult {
@@ -152,14 +158,28 @@ class SearchResults : public QDockWidget, private Ui::SearchResults
 public:
 	static void presentResults(const QString& searchText, const QList<SearchResult>& results,
 							   QMainWindow* parent, bool singleFile);
+	// Shows the results of `search` as they arrive; the results window takes
+	// ownership of `search` and cancels it when it is closed
+	static SearchResults * presentResults(const QString& searchText, Tw::Document::ProjectSearch * search,
+										  QMainWindow* parent);
 
 	explicit SearchResults(QWidget * parent);
 
+	void appendResults(const QList<SearchResult>& results);
+
 private slots:
 	void showSelectedEntry();
 	void showEntry(QTableWidgetItem * item);
 	void goToSource();
 	void goToSourceAndClose();
+	void projectResultsFound(const QString & fileName, QTextDocument * document, const QVector<Tw::Document::ProjectSearch::Hit> & hits);
+	void projectSearchFinished();
+
+private:
+	void present(QMainWindow * parent, bool singleFile);
+
+	QString _searchText;
+	Tw::Document::ProjectSearch * _projectSearch{nullptr};
 };
 
 #endif
@@ -0,0 +1,469 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "NonblockingSyntaxHighlighter.h"
+
+#include <QElapsedTimer>
+#include <QTextBlock>
+#include <QTimer>
+#include <QtConcurrent>
+
+NonblockingSyntaxHighlighter::NonblockingSyntaxHighlighter(QTextDocument * parent)
+	: QObject(parent)
+	, MAX_CHARS_PER_JOB(64 * 1024)
+	, MAX_CHECKPOINT_DISTANCE(256)
+	, IDLE_DELAY_TIME(40)
+	, _processingPending(false)
+	, _parent(nullptr)
+{
+	connect(&_jobWatcher, SIGNAL(finished()), this, SLOT(jobFinished()));
+	setDocument(parent);
+}
+
+NonblockingSyntaxHighlighter::~NonblockingSyntaxHighlighter()
+{
+	setDocument(nullptr);
+}
+
+double NonblockingSyntaxHighlighter::Statistics::mainThreadMSecsPerMB() const
+{
+	if (charactersHighlighted <= 0)
+		return 0;
+	return (static_cast<double>(mainThreadNSecs) / 1e6) / (static_cast<double>(charactersHighlighted) / (1024 * 1024));
+}
+
+void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc)
+{
+	stopWorker();
+	if (_parent)
+		disconnect(_parent);
+	_parent = doc;
+	_highlightRanges.clear();
+	_dirtyRanges.clear();
+	if (_parent) {
+		connect(_parent, SIGNAL(destroyed(QObject*)), this, SLOT(unlinkFromDocument()));
+		connect(_parent, SIGNAL(contentsChange(int,int,int)), this, SLOT(maybeRehighlightText(int, int, int)));
+		rehighlight();
+	}
+}
+
+void NonblockingSyntaxHighlighter::rehighlight()
+{
+	if (!_parent)
+		return;
+
+	_highlightRanges.clear();
+	range r;
+	r.from = 0;
+	r.to = _parent->characterCount();
+	_highlightRanges.push_back(r);
+	processWhenIdle();
+}
+
+void NonblockingSyntaxHighlighter::setPriorityRange(const int from, const int to)
+{
+	_priorityRange.from = from;
+	_priorityRange.to = to;
+	if (hasPriorityBlocksToHighlight())
+		processWhenIdle();
+}
+
+void NonblockingSyntaxHighlighter::rehighlightBlock(const QTextBlock & block)
+{
+	pushHighlightBlock(block);
+	processWhenIdle();
+}
+
+void NonblockingSyntaxHighlighter::maybeRehighlightText(int position, int charsRemoved, int charsAdded)
+{
+	if (!_parent)
+		return;
+
+	// Adjust ranges already present in _highlightRanges
+	for (int i = 0; i < _highlightRanges.size(); ++i) {
+		// Adjust front (if necessary)
+		if (_highlightRanges[i].from >= position + charsRemoved)
+			_highlightRanges[i].from += charsAdded - charsRemoved;
+		else if (_highlightRanges[i].from >= position) // && _highlightRanges[i].from < position + charsRemoved
+			_highlightRanges[i].from = position + charsAdded;
+		// Adjust back (if necessary)
+		if (_highlightRanges[i].to >= position + charsRemoved)
+			_highlightRanges[i].to += charsAdded - charsRemoved;
+		else if (_highlightRanges[i].to >= position) // && _highlightRanges[i].to < position + charsRemoved
+			_highlightRanges[i].to = position;
+	}
+	// Results for blocks at or after the edit can no longer be applied (see
+	// jobFinished())
+	if (position < _job.editPosition)
+		_job.editPosition = position;
+
+	// Keep the priority range in place until the view updates it
+	if (_priorityRange.from > position)
+		_priorityRange.from = qMax(position, _priorityRange.from + charsAdded - charsRemoved);
+	if (_priorityRange.to > position)
+		_priorityRange.to = qMax(position, _priorityRange.to + charsAdded - charsRemoved);
+
+	// NB: pushHighlightRange() implicitly calls sanitizeHighlightRanges() so
+	// there is no need to call it here explicitly
+
+	// NB: Don't subtract charsRemoved. If charsAdded = 0 and charsRemoved > 0
+	// we still want to rehighlight that line
+	// Add 1 because of the following cases:
+	// a) if charsAdded = 0, we still need to have at least one character in the range
+	// b) if the insertion ends in a newline character (0x2029), for some
+	//    reason the line immediately following the inserted line loses
+	//    highlighting. Adding 1 ensures that that next line is rehighlighted
+	//    as well.
+	// c) if the insertion does not end in a newline character, adding 1 does
+	//    not extend the range to a new line, so it doesn't matter (as
+	//    highlighting is only performed line-wise).
+	pushHighlightRange(position, position + charsAdded + 1);
+
+	processWhenIdle();
+}
+
+void NonblockingSyntaxHighlighter::sanitizeHighlightRanges()
+{
+	// 1) clip ranges
+	int n = (_parent ? _parent->characterCount() : 0);
+	for (int i = 0; i < _highlightRanges.size(); ++i) {
+		if (_highlightRanges[i].from < 0) _highlightRanges[i].from = 0;
+		if (_highlightRanges[i].to > n) _highlightRanges[i].to = n;
+	}
+
+	// 2) remove any invalid ranges
+	for (int i = _highlightRanges.size() - 1; i >= 0; --i) {
+		if (_highlightRanges[i].to <= _highlightRanges[i].from)
+			_highlightRanges.remove(i);
+	}
+	// 3) merge adjacent (or overlapping) ranges
+	// NB: There must not be any invalid ranges in here for this or else the
+	// merging algorithm would fail
+	for (int i = _highlightRanges.size() - 1; i >= 1; --i) {
+		if (_highlightRanges[i].from <= _highlightRanges[i - 1].to) {
+			if (_highlightRanges[i - 1].from > _highlightRanges[i].from)
+				_highlightRanges[i - 1].from = _highlightRanges[i].from;
+			if (_highlightRanges[i - 1].to < _highlightRanges[i].to)
+				_highlightRanges[i - 1].to = _highlightRanges[i].to;
+			_highlightRanges.remove(i);
+		}
+	}
+}
+
+
+void NonblockingSyntaxHighlighter::process()
+{
+	_processingPending = false;
+	// If the worker is busy, jobFinished() takes care of the remaining blocks
+	if (!_parent || _jobWatcher.isRunning())
+		return;
+	startJob();
+}
+
+void NonblockingSyntaxHighlighter::startJob()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	_job = Job();
+	const range r = nextRangeToHighlight();
+	if (_parent && r.to > r.from) {
+		QTextBlock block = _parent->findBlock(r.from);
+		// The highlighting of a block may depend on the state of the previous
+		// one. Blocks that are not queued serve as checkpoints as their state
+		// is up to date. If the job would start in the middle of a queued range
+		// (e.g., at the viewport), start at the closest checkpoint instead if
+		// it is near. Otherwise, the job starts from the (possibly outdated)
+		// state of the previous block; if that changes later on, the change
+		// propagates as usual (see jobFinished()).
+		QTextBlock checkpoint = block.previous();
+		for (int i = 0; i < MAX_CHECKPOINT_DISTANCE && checkpoint.isValid() && isQueued(checkpoint.position()); ++i)
+			checkpoint = checkpoint.previous();
+		if (!checkpoint.isValid())
+			block = _parent->begin();
+		else if (!isQueued(checkpoint.position()))
+			block = checkpoint.next();
+
+		// Snapshot consecutive queued blocks
+		int numChars = 0;
+		_job.previousBlockState = block.previous().userState();
+		for (; block.isValid() && block.position() < r.to && numChars < MAX_CHARS_PER_JOB; block = block.next()) {
+			_job.blocks.append({block.blockNumber(), block.position(), block.length(), block.userState(), block.text()});
+			numChars += block.length();
+		}
+	}
+	if (!_job.blocks.isEmpty()) {
+		_cancelJob.store(0);
+		_jobWatcher.setFuture(QtConcurrent::run(this, &NonblockingSyntaxHighlighter::runJob));
+	}
+
+	_statistics.mainThreadNSecs += timer.nsecsElapsed();
+}
+
+void NonblockingSyntaxHighlighter::runJob()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	_job.results.reserve(_job.blocks.size());
+	_previousBlockState = _job.previousBlockState;
+	foreach (const BlockSnapshot & snapshot, _job.blocks) {
+		if (_cancelJob.load() != 0)
+			break;
+		BlockResult result;
+		result.state = snapshot.userState;
+		_currentResult = &result;
+		highlightBlock(snapshot.text);
+		_currentResult = nullptr;
+		_previousBlockState = result.state;
+		_job.results.append(result);
+	}
+
+	_job.workerNSecs = timer.nsecsElapsed();
+}
+
+void NonblockingSyntaxHighlighter::jobFinished()
+{
+	// Stale notification for a job that has been stopped in the meantime
+	if (!_parent || _jobWatcher.isRunning())
+		return;
+
+	QElapsedTimer timer;
+	timer.start();
+
+	_statistics.workerNSecs += _job.workerNSecs;
+	for (int i = 0; i < _job.results.size(); ++i) {
+		const BlockSnapshot & snapshot = _job.blocks[i];
+		const BlockResult & result = _job.results[i];
+		// The block (or the ones before it) has been edited while the worker
+		// was running; maybeRehighlightText() has queued it again
+		if (snapshot.position + snapshot.length > _job.editPosition)
+			break;
+		QTextBlock block = _parent->findBlockByNumber(snapshot.number);
+		if (!block.isValid() || block.position() != snapshot.position || block.length() != snapshot.length)
+			break;
+
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+		block.layout()->setAdditionalFormats(result.formats.toList());
+#else
+		block.layout()->setFormats(result.formats);
+#endif
+		applyTags(block, result.tags);
+
+		// If the userState has changed, make sure the next block is
+		// rehighlighted as well (unless it was part of this job, in which case
+		// it was highlighted with the new state already)
+		if (result.state != block.userState()) {
+			block.setUserState(result.state);
+			if (i + 1 == _job.blocks.size())
+				pushHighlightBlock(block.next());
+		}
+		blockHighlighted(block);
+		_statistics.charactersHighlighted += snapshot.length;
+	}
+	_job = Job();
+
+	// Notify the document of our changes
+	markDirtyContent();
+
+	_statistics.mainThreadNSecs += timer.nsecsElapsed();
+
+	// if there is more work around the priority range, hand it to the worker
+	// right away; the rest can wait until we are idle
+	if (hasPriorityBlocksToHighlight())
+		startJob();
+	else if (hasBlocksToHighlight())
+		processWhenIdle();
+}
+
+void NonblockingSyntaxHighlighter::stopWorker()
+{
+	_cancelJob.store(1);
+	_jobWatcher.waitForFinished();
+	// The results may have been computed with outdated settings
+	_job.results.clear();
+}
+
+void NonblockingSyntaxHighlighter::pushHighlightBlock(const QTextBlock & block)
+{
+	if (block.isValid())
+		pushHighlightRange(block.position(), block.position() + block.length());
+}
+
+void NonblockingSyntaxHighlighter::pushHighlightRange(const int from, const int to)
+{
+	int i{0};
+	range r;
+	r.from = from;
+	r.to = to;
+
+	// Find the first old range such that the start of the new range is before
+	// the end of the old range
+	for (i = 0; i < _highlightRanges.size(); ++i) {
+		if (from < _highlightRanges[i].from)
+			break;
+	}
+
+	if (i == _highlightRanges.size())
+		_highlightRanges.push_back(r);
+	else
+		_highlightRanges.insert(i, r);
+
+	sanitizeHighlightRanges();
+}
+
+void NonblockingSyntaxHighlighter::popHighlightRange(const int from, const int to)
+{
+	for (int i = _highlightRanges.size() - 1; i >= 0 && _highlightRanges[i].to > from; --i) {
+		// Case 1: crop the end of the range (or the whole range)
+		if (to >= _highlightRanges[i].to) {
+			if (from <= _highlightRanges[i].from)
+				_highlightRanges.remove(i);
+			else
+				_highlightRanges[i].to = from;
+		}
+		// Case 2: crop the middle
+		else if (from > _highlightRanges[i].from) {
+			// Split the range into two
+			range r = _highlightRanges[i];
+			_highlightRanges[i].from = to;
+			r.to = from;
+			_highlightRanges.insert(i, r);
+			--i;
+		}
+		// Case 3: crop the front of the range
+		else if (to > _highlightRanges[i].from) {
+			_highlightRanges[i].from = to;
+		}
+		// Case 4: to <= _highlightRanges[i].from
+		// no overlap => do nothing
+	}
+}
+
+void NonblockingSyntaxHighlighter::blockHighlighted(const QTextBlock &block)
+{
+	popHighlightRange(block.position(), block.position() + block.length());
+	pushDirtyRange(block);
+}
+
+bool NonblockingSyntaxHighlighter::isQueued(const int position) const
+{
+	foreach (const range & r, _highlightRanges) {
+		if (r.from > position)
+			break;
+		if (position < r.to)
+			return true;
+	}
+	return false;
+}
+
+NonblockingSyntaxHighlighter::range NonblockingSyntaxHighlighter::queuedRangeIn(const int from, const int to) const
+{
+	foreach (const range & r, _highlightRanges) {
+		if (r.from >= to)
+			break;
+		if (r.to > from)
+			return {qMax(r.from, from), r.to};
+	}
+	return {0, 0};
+}
+
+NonblockingSyntaxHighlighter::range NonblockingSyntaxHighlighter::nextRangeToHighlight() const
+{
+	if (_highlightRanges.empty())
+		return {0, 0};
+
+	// 1) the priority range itself, 2) the text following it, 3) the text
+	// preceding it, 4) everything else (front to back)
+	const int margin = _priorityRange.to - _priorityRange.from;
+	range r = queuedRangeIn(_priorityRange.from, _priorityRange.to);
+	if (r.to <= r.from)
+		r = queuedRangeIn(_priorityRange.to, _priorityRange.to + margin);
+	if (r.to <= r.from)
+		r = queuedRangeIn(_priorityRange.from - margin, _priorityRange.from);
+	if (r.to <= r.from)
+		r = _highlightRanges[0];
+	return r;
+}
+
+bool NonblockingSyntaxHighlighter::hasPriorityBlocksToHighlight() const
+{
+	const int margin = _priorityRange.to - _priorityRange.from;
+	const range r = queuedRangeIn(_priorityRange.from - margin, _priorityRange.to + margin);
+	return (r.to > r.from);
+}
+
+void NonblockingSyntaxHighlighter::pushDirtyRange(const int from, const int length)
+{
+	// NB: we currently use (at most) one range as it seems that
+	// QTextDocument::markContentsDirty() operates not only on the given lines
+	// but also on all later lines. Thus, calling it repeatedly with adjacent
+	// lines would create a huge, unncessary overhead compared to calling it
+	// once.
+
+	int to = from + length;
+	if (_dirtyRanges.empty()) {
+		range r;
+		r.from = from;
+		r.to = to;
+		_dirtyRanges.push_back(r);
+	}
+	else {
+		if (_dirtyRanges[0].from > from) _dirtyRanges[0].from = from;
+		if (_dirtyRanges[0].to < to) _dirtyRanges[0].to = to;
+	}
+}
+
+void NonblockingSyntaxHighlighter::markDirtyContent()
+{
+	if (!_parent)
+		return;
+
+	foreach(range r, _dirtyRanges)
+		_parent->markContentsDirty(r.from, r.to - r.from);
+	_dirtyRanges.clear();
+}
+
+
+void NonblockingSyntaxHighlighter::setFormat(const int start, const int count, const QTextCharFormat & format)
+{
+	if (!_currentResult)
+		return;
+	QTextLayout::FormatRange formatRange;
+	formatRange.start = start;
+	formatRange.length = count;
+	formatRange.format = format;
+	_currentResult->formats << formatRange;
+}
+
+void NonblockingSyntaxHighlighter::addTag(const int start, const int length, const unsigned int level, const QString & text)
+{
+	if (_currentResult)
+		_currentResult->tags.append({start, length, level, text});
+}
+
+void NonblockingSyntaxHighlighter::processWhenIdle()
+{
+	if (!_processingPending) {
+		_processingPending = true;
+		QTimer::singleShot(IDLE_DELAY_TIME, this, SLOT(process()));
+	}
+}
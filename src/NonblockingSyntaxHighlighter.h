@@ -0,0 +1,174 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#ifndef NonblockingSyntaxHighlighter_H
+#define NonblockingSyntaxHighlighter_H
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QTextCharFormat>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <climits>
+
+// This class implements a non-blocking syntax highlighter that is a rewrite/
+// replacement of QSyntaxHighlighter. It queues all highlight requests and
+// hands snapshots of the text of the queued blocks to a worker thread (in
+// batches of up to MAX_CHARS_PER_JOB characters) which runs highlightBlock()
+// on them. The GUI thread only applies the resulting formats, block states and
+// tags, so it stays responsive even while large documents are highlighted.
+// Results for blocks that were edited in the meantime are dropped (those
+// blocks are queued for highlighting again anyway).
+// Queued blocks in the priority range (typically the visible part of the
+// document, see setPriorityRange()) are highlighted first, followed by those
+// around it; the rest of the document is highlighted front to back when idle.
+// Inspired by http://enki-editor.org/2014/08/22/Syntax_highlighting.html
+class NonblockingSyntaxHighlighter : public QObject
+{
+	Q_OBJECT
+
+public:
+	struct Tag {
+		int start;
+		int length;
+		unsigned int level;
+		QString text;
+	};
+
+	struct Statistics {
+		qint64 charactersHighlighted{0};
+		// time spent snapshotting blocks and applying results
+		qint64 mainThreadNSecs{0};
+		// time spent in highlightBlock()
+		qint64 workerNSecs{0};
+
+		double mainThreadMSecsPerMB() const;
+	};
+
+	NonblockingSyntaxHighlighter(QTextDocument * parent);
+	~NonblockingSyntaxHighlighter() override;
+
+	QTextDocument * document() const { return _parent; }
+	void setDocument(QTextDocument * doc);
+
+	const Statistics & statistics() const { return _statistics; }
+
+	// Sets the range of characters to highlight first (e.g., the viewport of
+	// an editor)
+	void setPriorityRange(const int from, const int to);
+
+public slots:
+	void rehighlight();
+	void rehighlightBlock(const QTextBlock & block);
+
+protected:
+	// Note: highlightBlock() is run on a worker thread. It must not access the
+	// document, and must only use state that does not change while the worker
+	// is running (see stopWorker())
+	virtual void highlightBlock(const QString & text) = 0;
+	// Called on the GUI thread when the results for `block` are applied
+	virtual void applyTags(const QTextBlock & block, const QVector<Tag> & tags) { Q_UNUSED(block) Q_UNUSED(tags) }
+	void setFormat(const int start, const int count, const QTextCharFormat & format);
+	void addTag(const int start, const int length, const unsigned int level, const QString & text);
+	int currentBlockState() const { return (_currentResult ? _currentResult->state : -1); }
+	void setCurrentBlockState(const int state) { if (_currentResult) _currentResult->state = state; }
+	int previousBlockState() const { return _previousBlockState; }
+	// Cancels the worker and waits for it to finish; its partial results are
+	// discarded. Call this before changing any state highlightBlock() uses.
+	void stopWorker();
+
+	bool hasBlocksToHighlight() const { return !_highlightRanges.empty(); }
+	bool hasPriorityBlocksToHighlight() const;
+	bool isQueued(const int position) const;
+	void pushHighlightBlock(const QTextBlock & block);
+	void pushHighlightRange(const int from, const int to);
+	void popHighlightRange(const int from, const int to);
+	void blockHighlighted(const QTextBlock & block);
+	void pushDirtyRange(const QTextBlock & block) { pushDirtyRange(block.position(), block.position() + block.length()); }
+	void pushDirtyRange(const int from, const int length);
+	void markDirtyContent();
+	void sanitizeHighlightRanges();
+
+	struct range {
+		int from, to; // character ranges
+	};
+	// Returns the part of the first queued range that overlaps [from, to)
+	// (clipped at the front only), or an empty range
+	range queuedRangeIn(const int from, const int to) const;
+	range nextRangeToHighlight() const;
+
+	int MAX_CHARS_PER_JOB;
+	int MAX_CHECKPOINT_DISTANCE; // in blocks
+	int IDLE_DELAY_TIME;
+
+private slots:
+	void maybeRehighlightText(int position, int charsRemoved, int charsAdded);
+	void process();
+	void processWhenIdle();
+	void jobFinished();
+	void unlinkFromDocument() { setDocument(nullptr); }
+
+private:
+	void startJob();
+	// Runs on the worker thread
+	void runJob();
+
+	bool _processingPending;
+	QTextDocument * _parent;
+
+	QVector<range> _highlightRanges;
+	QVector<range> _dirtyRanges;
+	range _priorityRange{0, 0};
+
+	struct BlockSnapshot {
+		int number;
+		int position;
+		int length;
+		int userState;
+		QString text;
+	};
+	struct BlockResult {
+		QVector<QTextLayout::FormatRange> formats;
+		int state;
+		QVector<Tag> tags;
+	};
+	struct Job {
+		QVector<BlockSnapshot> blocks;
+		int previousBlockState{-1};
+		// Written by the worker
+		QVector<BlockResult> results;
+		qint64 workerNSecs{0};
+		// Smallest position edited while the job was running
+		int editPosition{INT_MAX};
+	};
+	Job _job;
+	QFutureWatcher<void> _jobWatcher;
+	QAtomicInt _cancelJob{0};
+
+	// Only used by the worker
+	BlockResult * _currentResult{nullptr};
+	int _previousBlockState{-1};
+
+	Statistics _statistics;
+};
+
+#endif // !defined(NonblockingSyntaxHighlighter_H)
@@ -50,6 +50,7 @@
 #include <QToolTip>
 #include <QUrl>
 #include <QVector>
+#include <QtConcurrent>
 #include <cmath>
 
 
@@ -64,6 +65,42 @@ const int magSizes[] = { 200, 300, 400 };
 // duration of highlighting in PDF view (might make configurable?)
 const int kPDFHighlightDuration = 2000;
 
+namespace {
+
+// Synchronizer that takes the text for fine-grained synchronization from the
+// open TeX and PDF documents
+class WindowSynchronizer : public TWSyncTeXSynchronizer
+{
+public:
+	explicit WindowSynchronizer(const QString & filename) : TWSyncTeXSynchronizer(filename) { }
+
+protected:
+	QString _texText(const QString & filename, const int line, const bool open) const override {
+		TeXDocumentWindow * tex = (open ? TeXDocumentWindow::openDocument(filename, false, false, line) : TeXDocumentWindow::findDocument(filename));
+		if (!tex)
+			return QString();
+		return tex->getLineText(line);
+	}
+
+	QString _pdfText(const QString & filename, const int page, const QList<QRectF> & rects, QMap<int, QRectF> * wordBoxes, QMap<int, QRectF> * charBoxes) const override {
+		PDFDocumentWindow * pdf = PDFDocumentWindow::findDocument(filename);
+		if (!pdf || !pdf->widget())
+			return QString();
+		QSharedPointer<QtPDF::Backend::Document> pdfDoc = pdf->widget()->document().toStrongRef();
+		if (!pdfDoc)
+			return QString();
+		QSharedPointer<QtPDF::Backend::Page> pdfPage = pdfDoc->page(page - 1).toStrongRef();
+		if (!pdfPage)
+			return QString();
+		QList<QPolygonF> selection;
+		foreach (const QRectF & r, rects)
+			selection.append(r);
+		return pdfPage->selectedText(selection, wordBoxes, charBoxes);
+	}
+};
+
+} // anonymous namespace
+
 
 
 // TODO: This is seemingly unused---verify && remove
@@ -112,12 +149,19 @@ PDFDocumentWindow::PDFDocumentWindow(const QString &fileName, TeXDocumentWindow
 PDFDocumentWindow::~PDFDocumentWindow()
 {
 	docList.removeAll(this);
+	if (_loadingSyncData) {
+		_synchronizerWatcher.waitForFinished();
+		delete _synchronizerWatcher.result();
+	}
+	delete _synchronizer;
 }
 
 void PDFDocumentWindow::init()
 {
 	docList.append(this);
 
+	connect(&_synchronizerWatcher, SIGNAL(finished()), this, SLOT(syncDataLoaded()));
+
 	setupUi(this);
 
 	setAttribute(Qt::WA_DeleteOnClose, true);
@@ -287,6 +331,10 @@ void PDFDocumentWindow::init()
 	}
 	resetMagnifier();
 
+	QtPDF::Backend::PDFPageProcessingThreadPool::setDefaultMaxThreadCount(settings.value(QString::fromLatin1("pdfRenderThreads"), kDefault_PDFRenderThreads).toInt());
+	QtPDF::Backend::PDFTileCache::instance().setMaxSize(settings.value(QString::fromLatin1("pdfCacheSize"), kDefault_PDFCacheSize).toLongLong() * 1024 * 1024);
+	QtPDF::Backend::PDFPreviewCache::instance().setMaxSize(settings.value(QString::fromLatin1("pdfPreviewCacheSize"), kDefault_PDFPreviewCacheSize).toLongLong() * 1024 * 1024);
+
 	if (settings.contains(QString::fromLatin1("previewResolution")))
 		pdfWidget->setResolution(settings.value(QString::fromLatin1("previewResolution"), QApplication::desktop()->logicalDpiX()).toInt());
 
@@ -447,13 +495,41 @@ void PDFDocumentWindow::loadSyncData()
 		delete _synchronizer;
 		_synchronizer = nullptr;
 	}
-	_synchronizer = new TWSyncTeXSynchronizer(curFile);
+	// The SyncTeX file may have changed while it was being parsed; the outdated
+	// result is discarded in syncDataLoaded()
+	if (_loadingSyncData) {
+		_reloadSyncDataPending = true;
+		return;
+	}
+	_loadingSyncData = true;
+	const QString fileName = curFile;
+	_synchronizerWatcher.setFuture(QtConcurrent::run([fileName]() -> TWSyncTeXSynchronizer * { return new WindowSynchronizer(fileName); }));
+}
+
+void PDFDocumentWindow::syncDataLoaded()
+{
+	TWSyncTeXSynchronizer * synchronizer = _synchronizerWatcher.result();
+	_loadingSyncData = false;
+	if (_reloadSyncDataPending) {
+		delete synchronizer;
+		_reloadSyncDataPending = false;
+		loadSyncData();
+		return;
+	}
+
+	_synchronizer = synchronizer;
 	if (!_synchronizer)
 		statusBar()->showMessage(tr("Error initializing SyncTeX"), kStatusMessageDuration);
 	else if (!_synchronizer->isValid())
 		statusBar()->showMessage(tr("No SyncTeX data available"), kStatusMessageDuration);
 	else
 		statusBar()->showMessage(tr("SyncTeX: \"%1\"").arg(_synchronizer->syncTeXFilename()), kStatusMessageDuration);
+
+	if (_pendingSyncAction) {
+		std::function<void()> action = _pendingSyncAction;
+		_pendingSyncAction = nullptr;
+		action();
+	}
 }
 
 void PDFDocumentWindow::syncClick(int pageIndex, const QPointF& pos)
@@ -477,6 +553,10 @@ void PDFDocumentWindow::syncClick(int pageIndex, const QPointF& pos)
 
 void PDFDocumentWindow::syncRange(const int pageIndex, const QPointF & start, const QPointF & end, const TWSynchronizer::Resolution resolution)
 {
+	if (isLoadingSyncData()) {
+		_pendingSyncAction = [this, pageIndex, start, end, resolution]() { syncRange(pageIndex, start, end, resolution); };
+		return;
+	}
 	if (!_synchronizer)
 		return;
 
@@ -493,27 +573,15 @@ void PDFDocumentWindow::syncRange(const int pageIndex, const QPointF & start, co
 	if (!page)
 		return;
 
-	// Synchronize the point "start"
-	TWSynchronizer::PDFSyncPoint srcStart;
-	srcStart.filename = curFile;
-	srcStart.page = pageIndex + 1;
-	srcStart.rects.append(QRectF(start.x(), page->pageSizeF().height() - start.y(), 0, 0));
-	TWSynchronizer::TeXSyncPoint destStart = _synchronizer->syncFromPDF(srcStart, resolution);
-
-	// Syncronize the point "end"
-	TWSynchronizer::TeXSyncPoint destEnd;
-	if (end.isNull() || end == start)
-		// If "end" was not provided or was the same as "start", just copy the
-		// result
-		destEnd = destStart;
-	else {
-		// Otherwise, perform the synchronization
-		TWSynchronizer::PDFSyncPoint srcEnd;
-		srcEnd.filename = curFile;
-		srcEnd.page = pageIndex + 1;
-		srcEnd.rects.append(QRectF(end.x(), page->pageSizeF().height() - end.y(), 0, 0));
-		destEnd = _synchronizer->syncFromPDF(srcEnd, resolution);
-	}
+	// Synchronize the points "start" and "end" (if "end" was not provided or
+	// is the same as "start", the result for "start" is used for both)
+	QVector<TWSynchronizer::PDFSyncPoint> src;
+	src.append({curFile, pageIndex + 1, QList<QRectF>() << QRectF(start.x(), page->pageSizeF().height() - start.y(), 0, 0)});
+	if (!end.isNull() && end != start)
+		src.append({curFile, pageIndex + 1, QList<QRectF>() << QRectF(end.x(), page->pageSizeF().height() - end.y(), 0, 0)});
+	const QVector<TWSynchronizer::TeXSyncPoint> dest = _synchronizer->syncPointsFromPDF(src, resolution);
+	const TWSynchronizer::TeXSyncPoint & destStart = dest.first();
+	const TWSynchronizer::TeXSyncPoint & destEnd = dest.last();
 
 	// Check if (at least) "start" was properly synchronized; if not: bail out
 	if (destStart.filename.isEmpty() || destStart.line < 0)
@@ -563,6 +631,10 @@ void PDFDocumentWindow::syncRange(const int pageIndex, const QPointF & start, co
 
 void PDFDocumentWindow::syncFromSource(const QString& sourceFile, int lineNo, int col, bool activatePreview)
 {
+	if (isLoadingSyncData()) {
+		_pendingSyncAction = [this, sourceFile, lineNo, col, activatePreview]() { syncFromSource(sourceFile, lineNo, col, activatePreview); };
+		return;
+	}
 	if (!_synchronizer)
 		return;
 
@@ -31,12 +31,14 @@
 
 #include <QButtonGroup>
 #include <QCursor>
+#include <QFutureWatcher>
 #include <QImage>
 #include <QLabel>
 #include <QList>
 #include <QMouseEvent>
 #include <QPainterPath>
 #include <QTimer>
+#include <functional>
 
 
 const int kDefault_MagnifierSize = 2;
@@ -44,6 +46,13 @@ const bool kDefault_CircularMagnifier = true;
 const int kDefault_PreviewScaleOption = 1;
 const int kDefault_PreviewScale = 200;
 const QtPDF::PDFDocumentView::PageMode kDefault_PDFPageMode = QtPDF::PDFDocumentView::PageMode_OneColumnContinuous;
+// Number of threads used for rendering each pdf; 0 = one per CPU core
+const int kDefault_PDFRenderThreads = 0;
+// Size of the cache for rendered pages shared by all pdfs (in MiB)
+const int kDefault_PDFCacheSize = 1024;
+// Size of the on-disk cache of page previews shared by all pdfs (in MiB); 0 =
+// disabled
+const int kDefault_PDFPreviewCacheSize = 128;
 
 const int kPDFWindowStateVersion = 1;
 
@@ -80,7 +89,8 @@ public:
 	void enableTypesetAction(bool enabled);
 	void updateTypesettingAction(bool processRunning);
 	void linkToSource(TeXDocumentWindow *texDoc);
-	bool hasSyncData() const { return _synchronizer != nullptr; }
+	bool hasSyncData() const { return _synchronizer != nullptr || isLoadingSyncData(); }
+	bool isLoadingSyncData() const { return _loadingSyncData; }
 
 	QtPDF::PDFDocumentWidget * widget() { return pdfWidget; }
 
@@ -122,6 +132,7 @@ private slots:
 	void syncClick(int page, const QPointF& pos);
 	void syncRange(const int pageIndex, const QPointF & start, const QPointF & end, const TWSynchronizer::Resolution resolution);
 	void invalidateSyncHighlight();
+	void syncDataLoaded();
 	void scaleLabelClick(QMouseEvent * event) { showScaleContextMenu(event->pos()); }
 	void showScaleContextMenu(const QPoint pos);
 	void setScaleFromContextMenu(const QString & strZoom);
@@ -173,6 +184,13 @@ private:
 	static QList<PDFDocumentWindow*> docList;
 
 	TWSyncTeXSynchronizer * _synchronizer;
+	// The SyncTeX data is parsed in the background; sync requests made in the
+	// meantime are deferred until it is available (only the last one is kept
+	// as it supersedes any earlier ones)
+	QFutureWatcher<TWSyncTeXSynchronizer*> _synchronizerWatcher;
+	bool _loadingSyncData{false};
+	bool _reloadSyncDataPending{false};
+	std::function<void()> _pendingSyncAction;
 };
 
 #endif
@@ -208,6 +208,8 @@ void TWApp::init()
 
 	scriptManager = new TWScriptManager;
 
+	connect(this, SIGNAL(applicationStateChanged(Qt::ApplicationState)), this, SLOT(handleApplicationStateChange(Qt::ApplicationState)));
+
 #if defined(Q_OS_DARWIN)
 	setQuitOnLastWindowClosed(false);
 	setAttribute(Qt::AA_DontShowIconsInMenus);
@@ -282,6 +284,18 @@ void TWApp::maybeQuit()
 #endif
 }
 
+void TWApp::handleApplicationStateChange(Qt::ApplicationState state)
+{
+	// Hidden/suspended applications are the first candidates for being
+	// reclaimed by the OS when memory runs low, so free what we can.
+	// Note: Qt only reports these states on some platforms (e.g., macOS when
+	// the application is hidden); on Windows and X11, applications are merely
+	// inactive and the tile cache only reacts once rendering fails (see
+	// PDFTileCache::handleMemoryPressure())
+	if (state == Qt::ApplicationHidden || state == Qt::ApplicationSuspended)
+		QtPDF::Backend::PDFTileCache::instance().handleMemoryPressure(QtPDF::Backend::PDFTileCache::MemoryPressure_Moderate);
+}
+
 void TWApp::changeLanguage()
 {
 #if defined(Q_OS_DARWIN)
@@ -230,6 +230,8 @@ private slots:
 
 	void globalDestroyed(QObject * obj);
 
+	void handleApplicationStateChange(Qt::ApplicationState state);
+
 protected:
 	bool event(QEvent *) override;
 
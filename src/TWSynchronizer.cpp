@@ -21,12 +21,15 @@
 
 #include "TWSynchronizer.h"
 
-#include "PDFDocumentWindow.h"
-#include "TWApp.h"
-#include "TeXDocumentWindow.h"
+#include "document/TeXDocument.h"
 
 #include <QDir>
 #include <QFileInfo>
+#include <QStack>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <tuple>
 
 // TODO for fine-grained search:
 // - Specially handle \commands (and possibly other TeX codes)
@@ -36,9 +39,52 @@
 //   substrings in the line (e.g., to properly sync lines like
 //   "abc\footnote{abc}")
 
+//virtual
+QVector<TWSynchronizer::PDFSyncPoint> TWSynchronizer::syncPointsFromTeX(const QVector<TeXSyncPoint> & src, const Resolution resolution) const
+{
+  QVector<PDFSyncPoint> retVal;
+  retVal.reserve(src.size());
+  foreach (const TeXSyncPoint & point, src)
+    retVal.append(syncFromTeX(point, resolution));
+  return retVal;
+}
+
+//virtual
+QVector<TWSynchronizer::TeXSyncPoint> TWSynchronizer::syncPointsFromPDF(const QVector<PDFSyncPoint> & src, const Resolution resolution) const
+{
+  QVector<TeXSyncPoint> retVal;
+  retVal.reserve(src.size());
+  foreach (const PDFSyncPoint & point, src)
+    retVal.append(syncFromPDF(point, resolution));
+  return retVal;
+}
+
+//virtual
+QVector<TWSynchronizer::PDFSyncPoint> TWSynchronizer::syncLinesFromTeX(const QString & filename, const int firstLine, const int lastLine) const
+{
+  QVector<PDFSyncPoint> retVal;
+  for (int line = firstLine; line <= lastLine; ++line) {
+    const PDFSyncPoint point = syncFromTeX({filename, line, -1, -1}, LineResolution);
+    if (point.page < 1)
+      continue;
+    QVector<PDFSyncPoint>::iterator it = retVal.begin();
+    while (it != retVal.end() && it->page < point.page)
+      ++it;
+    if (it == retVal.end() || it->page != point.page)
+      it = retVal.insert(it, {point.filename, point.page, QList<QRectF>()});
+    foreach (const QRectF & r, point.rects) {
+      if (!it->rects.contains(r))
+        it->rects.append(r);
+    }
+  }
+  return retVal;
+}
+
+
 TWSyncTeXSynchronizer::TWSyncTeXSynchronizer(const QString & filename)
 {
   _scanner = SyncTeX::synctex_scanner_new_with_output_file(filename.toLocal8Bit().data(), nullptr, 1);
+  _buildIndex();
 }
 
 TWSyncTeXSynchronizer::~TWSyncTeXSynchronizer()
@@ -70,135 +116,191 @@ QString TWSyncTeXSynchronizer::pdfFilename() const
 //virtual
 TWSynchronizer::PDFSyncPoint TWSyncTeXSynchronizer::syncFromTeX(const TWSynchronizer::TeXSyncPoint & src, const Resolution resolution) const
 {
-  PDFSyncPoint retVal;
-  retVal.page = -1;
-
-  // Find the name SyncTeX is using for this source file...
-  const QFileInfo sourceFileInfo(src.filename);
-  QDir curDir(QFileInfo(pdfFilename()).canonicalPath());
-  SyncTeX::synctex_node_p node = SyncTeX::synctex_scanner_input(_scanner);
-  QString name;
-  bool found = false;
-  while (node) {
-    name = QString::fromLocal8Bit(SyncTeX::synctex_scanner_get_name(_scanner, SyncTeX::synctex_node_tag(node)));
-    const QFileInfo fi(curDir, name);
-    if (fi == sourceFileInfo) {
-      found = true;
-      break;
-    }
-    node = synctex_node_sibling(node);
-  }
-  if (!found)
-    return retVal;
+  return syncPointsFromTeX(QVector<TeXSyncPoint>{src}, resolution).first();
+}
 
-  retVal.filename = pdfFilename();
+//virtual
+TWSynchronizer::TeXSyncPoint TWSyncTeXSynchronizer::syncFromPDF(const TWSynchronizer::PDFSyncPoint & src, const Resolution resolution) const
+{
+  return syncPointsFromPDF(QVector<PDFSyncPoint>{src}, resolution).first();
+}
 
-  if (SyncTeX::synctex_display_query(_scanner, name.toLocal8Bit().data(), src.line, src.col, -1) > 0) {
-	while ((node = SyncTeX::synctex_scanner_next_result(_scanner))) {
-      if (retVal.page < 0)
-        retVal.page = SyncTeX::synctex_node_page(node);
-      if (SyncTeX::synctex_node_page(node) != retVal.page)
-        continue;
-      QRectF nodeRect(synctex_node_box_visible_h(node),
-                      synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
-                      synctex_node_box_visible_width(node),
-                      synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node));
-      retVal.rects.append(nodeRect);
+//virtual
+QVector<TWSynchronizer::PDFSyncPoint> TWSyncTeXSynchronizer::syncPointsFromTeX(const QVector<TWSynchronizer::TeXSyncPoint> & src, const Resolution resolution) const
+{
+  QVector<PDFSyncPoint> retVal;
+  retVal.reserve(src.size());
+
+  // Points on the same line share their boxes and the text the fine
+  // synchronization works on, so those are only looked up once per line
+  QHash<QString, int> tags;
+  QHash< QPair<QString, int>, PDFSyncPoint > lines;
+  QHash< QPair<QString, int>, FineContext > contexts;
+
+  foreach (const TeXSyncPoint & point, src) {
+    const QPair<QString, int> key(point.filename, point.line);
+    QHash< QPair<QString, int>, PDFSyncPoint >::const_iterator line = lines.constFind(key);
+    if (line == lines.constEnd()) {
+      // Find the tag SyncTeX is using for this source file...
+      QHash<QString, int>::const_iterator tag = tags.constFind(point.filename);
+      if (tag == tags.constEnd())
+        tag = tags.insert(point.filename, _tagForFile(point.filename));
+
+      PDFSyncPoint dest;
+      dest.page = -1;
+      if (tag.value() > 0) {
+        dest.filename = pdfFilename();
+        dest.rects = _lineBoxes(tag.value(), point.line, dest.page);
+      }
+      line = lines.insert(key, dest);
+    }
+    PDFSyncPoint dest = line.value();
+
+    // Only perform fine synchronization if requested (and if we get sensible
+    // column information)
+    if (resolution != LineResolution && point.col >= 0 && dest.page > 0) {
+      QHash< QPair<QString, int>, FineContext >::const_iterator context = contexts.constFind(key);
+      if (context == contexts.constEnd()) {
+        const QDir curDir(QFileInfo(point.filename).canonicalPath());
+        context = contexts.insert(key, _fineContext(point.filename, point.line, false, QFileInfo(curDir, dest.filename).canonicalFilePath(), dest.page, dest.rects));
+      }
+      _syncFromTeXFine(context.value(), point.col, dest, resolution);
     }
+    retVal.append(dest);
   }
-
-  // Only perform fine synchronization if requested
-  if (resolution != LineResolution)
-    _syncFromTeXFine(src, retVal, resolution);
-
   return retVal;
 }
 
 //virtual
-TWSynchronizer::TeXSyncPoint TWSyncTeXSynchronizer::syncFromPDF(const TWSynchronizer::PDFSyncPoint & src, const Resolution resolution) const
+QVector<TWSynchronizer::TeXSyncPoint> TWSyncTeXSynchronizer::syncPointsFromPDF(const QVector<TWSynchronizer::PDFSyncPoint> & src, const Resolution resolution) const
 {
-  TeXSyncPoint retVal;
-  retVal.line = -1;
-  retVal.col = -1;
-  retVal.len = -1;
-
-  if (src.rects.length() != 1)
-    return retVal;
+  QVector<TeXSyncPoint> retVal;
+  retVal.reserve(src.size());
+
+  // Points often hit the same input lines (e.g., the start and end of a
+  // selection), so the names of the input files and the text the fine
+  // synchronization works on are only looked up once per line and page
+  QHash<int, QString> names;
+  QHash< QPair<int, QPair<int, int> >, FineContext > contexts;
+
+  foreach (const PDFSyncPoint & point, src) {
+    TeXSyncPoint dest;
+    dest.line = -1;
+    dest.col = -1;
+    dest.len = -1;
+
+    if (point.rects.length() != 1) {
+      retVal.append(dest);
+      continue;
+    }
 
-  if (SyncTeX::synctex_edit_query(_scanner, src.page, static_cast<float>(src.rects[0].left()), static_cast<float>(src.rects[0].top())) > 0) {
-    SyncTeX::synctex_node_p node{nullptr};
-    while ((node = SyncTeX::synctex_scanner_next_result(_scanner))) {
-      retVal.filename = QString::fromLocal8Bit(SyncTeX::synctex_scanner_get_name(_scanner, SyncTeX::synctex_node_tag(node)));
-      retVal.line = SyncTeX::synctex_node_line(node);
-      if (retVal.line <= 0)
+    foreach (const QPair<int, int> & candidate, _nodesAt(point.page, point.rects[0].topLeft())) {
+      QHash<int, QString>::const_iterator name = names.constFind(candidate.first);
+      if (name == names.constEnd())
+        name = names.insert(candidate.first, QString::fromLocal8Bit(SyncTeX::synctex_scanner_get_name(_scanner, candidate.first)));
+      dest.filename = name.value();
+      dest.line = candidate.second;
+      if (dest.line <= 0)
         continue;
-      retVal.col = -1;
-      retVal.len = -1;
+      dest.col = -1;
+      dest.len = -1;
 
       // If we only need to match lines, we are done
       if (resolution == LineResolution)
         break;
+      if (dest.filename.isEmpty())
+        continue;
 
-      _syncFromPDFFine(src, retVal, resolution);
+      const QPair<int, QPair<int, int> > key(point.page, candidate);
+      QHash< QPair<int, QPair<int, int> >, FineContext >::const_iterator context = contexts.constFind(key);
+      if (context == contexts.constEnd()) {
+        // In order to get the full context corresponding to the whole input
+        // line, we use all boxes of the line on the page (there may be more
+        // than one for multiline paragraphs).
+        // Note: this still does not help for paragraphs broken across pages
+        int page = point.page;
+        const QList<QRectF> rects = _lineBoxes(candidate.first, candidate.second, page);
+        const QDir curDir(QFileInfo(point.filename).canonicalPath());
+        // This also opens the TeX file to show the result
+        context = contexts.insert(key, _fineContext(QFileInfo(curDir, dest.filename).canonicalFilePath(), dest.line, true, point.filename, point.page, rects));
+      }
+      _syncFromPDFFine(context.value(), point.rects[0].center(), dest, resolution);
       // If we found a (unique) match, we are done; otherwise, try other
-      // synctex_edit_query results (if any)
-      if (retVal.col > -1 && retVal.len > 0)
+      // candidates (if any)
+      if (dest.col > -1 && dest.len > 0)
         break;
     }
+    retVal.append(dest);
   }
-
   return retVal;
 }
 
-void TWSyncTeXSynchronizer::_syncFromTeXFine(const TWSynchronizer::TeXSyncPoint & src, TWSynchronizer::PDFSyncPoint & dest, const Resolution resolution) const
+//virtual
+QVector<TWSynchronizer::PDFSyncPoint> TWSyncTeXSynchronizer::syncLinesFromTeX(const QString & filename, const int firstLine, const int lastLine) const
 {
-  // FIXME: this does not work properly for text which is split across pages!
-
-  // If we get no sensible column information, there's no point in continuing
-  if (src.col < 0)
-    return;
+  QVector<PDFSyncPoint> retVal;
+  const int tag = _tagForFile(filename);
+  if (tag <= 0 || firstLine > lastLine)
+    return retVal;
 
-  QDir curDir(QFileInfo(src.filename).canonicalPath());
-  TeXDocumentWindow * tex = TeXDocumentWindow::findDocument(src.filename);
-  PDFDocumentWindow * pdf = PDFDocumentWindow::findDocument(QFileInfo(curDir, dest.filename).canonicalFilePath());
-  if (!tex || !pdf || !pdf->widget())
-    return;
-  QSharedPointer<QtPDF::Backend::Document> pdfDoc = pdf->widget()->document().toStrongRef();
-  if (!pdfDoc)
-    return;
-  QSharedPointer<QtPDF::Backend::Page> pdfPage = pdfDoc->page(dest.page - 1).toStrongRef();
-  if (!pdfPage)
-    return;
+  // Collect the boxes of all lines in one pass over the index (the records of
+  // consecutive lines are adjacent); boxes are sorted by page, so sorting the
+  // box indices also groups them by page
+  const Record key{tag, firstLine, 0, 0};
+  QVector<Record>::const_iterator it = std::lower_bound(_recordsByLine.begin(), _recordsByLine.end(), key, [](const Record & a, const Record & b) {
+    return std::tie(a.tag, a.line) < std::tie(b.tag, b.line);
+  });
+  QVector<int> boxIds;
+  for (; it != _recordsByLine.end() && it->tag == tag && it->line <= lastLine; ++it)
+    boxIds.append(it->box);
+  std::sort(boxIds.begin(), boxIds.end());
+  boxIds.erase(std::unique(boxIds.begin(), boxIds.end()), boxIds.end());
+
+  foreach (const int boxId, boxIds) {
+    const Box & box = _boxes[boxId];
+    if (retVal.isEmpty() || retVal.last().page != box.page)
+      retVal.append({pdfFilename(), box.page, QList<QRectF>()});
+    retVal.last().rects.append(box.rect());
+  }
+  return retVal;
+}
 
-  // Get source context
-  QString srcContext = tex->getLineText(src.line);
-  if (srcContext.isEmpty())
-    return;
+TWSyncTeXSynchronizer::FineContext TWSyncTeXSynchronizer::_fineContext(const QString & texFile, const int line, const bool openTeX, const QString & pdfFile, const int page, const QList<QRectF> & rects) const
+{
+  FineContext retVal;
+  retVal.texText = _texText(texFile, line, openTeX);
+  if (retVal.texText.isEmpty())
+    return retVal;
 
-  // Get destination context
-  QList<QPolygonF> selection;
-  foreach (QRectF r, dest.rects)
-    selection.append(r);
-  QMap<int, QRectF> wordBoxes, charBoxes;
-  QString destContext = pdfPage->selectedText(selection, &wordBoxes, &charBoxes);
-  // Normalize the destContext. selectedText() returns newline chars between
+  retVal.pdfText = _pdfText(pdfFile, page, rects, &retVal.wordBoxes, &retVal.charBoxes);
+  // Normalize the pdfText. selectedText() returns newline chars between
   // separate (output) lines that all correspond to the same input line
   // (different input lines are handled by SyncTeX). Here we replace those \n
-  // to make destContext more comparable to srcContext.
-  destContext.replace(QChar::fromLatin1('\n'), QChar::fromLatin1(' '));
+  // to make pdfText more comparable to texText.
+  retVal.pdfText.replace(QChar::fromLatin1('\n'), QChar::fromLatin1(' '));
 
   // FIXME: the string returned by selectedText() seems to twist the beginning
   // (and ends) of footnotes sometimes.
+  return retVal;
+}
+
+// static
+void TWSyncTeXSynchronizer::_syncFromTeXFine(const FineContext & context, const int col, TWSynchronizer::PDFSyncPoint & dest, const Resolution resolution)
+{
+  // FIXME: this does not work properly for text which is split across pages!
+
+  if (context.texText.isEmpty() || context.pdfText.isEmpty())
+    return;
 
   // If the user clicked past the end of the line, start matching at the last
   // character
-  int col = src.col;
-  if (col >= srcContext.length())
-    col = srcContext.length() - 1;
+  int srcCol = col;
+  if (srcCol >= context.texText.length())
+    srcCol = context.texText.length() - 1;
 
   // Perform the text matching
   bool unique = false;
-  int destCol = _findCorrespondingPosition(srcContext, destContext, col, unique);
+  int destCol = _findCorrespondingPosition(context.texText, context.pdfText, srcCol, unique);
 
   // If we found no (unique) match bail out
   if (destCol < 0 || !unique)
@@ -207,74 +309,33 @@ void TWSyncTeXSynchronizer::_syncFromTeXFine(const TWSynchronizer::TeXSyncPoint
   // Update the matching destination rectangles
   if (resolution == WordResolution) {
     dest.rects.clear();
-    dest.rects.append(wordBoxes[destCol]);
+    dest.rects.append(context.wordBoxes.value(destCol));
   }
   else if (resolution == CharacterResolution){
     dest.rects.clear();
-    dest.rects.append(charBoxes[destCol]);
+    dest.rects.append(context.charBoxes.value(destCol));
   }
 }
 
-void TWSyncTeXSynchronizer::_syncFromPDFFine(const TWSynchronizer::PDFSyncPoint &src, TWSynchronizer::TeXSyncPoint &dest, const Resolution resolution) const
+// static
+void TWSyncTeXSynchronizer::_syncFromPDFFine(const FineContext & context, const QPointF & pt, TWSynchronizer::TeXSyncPoint & dest, const Resolution resolution)
 {
-  if (dest.filename.isEmpty())
-    return;
-  QDir curDir(QFileInfo(src.filename).canonicalPath());
-  TeXDocumentWindow * tex = TeXDocumentWindow::openDocument(QFileInfo(curDir, dest.filename).canonicalFilePath(), false, false, dest.line);
-  PDFDocumentWindow * pdf = PDFDocumentWindow::findDocument(src.filename);
-  if (!tex || !pdf || !pdf->widget())
-    return;
-  QSharedPointer<QtPDF::Backend::Document> pdfDoc = pdf->widget()->document().toStrongRef();
-  if (!pdfDoc)
-    return;
-  QSharedPointer<QtPDF::Backend::Page> pdfPage = pdfDoc->page(src.page - 1).toStrongRef();
-  if (!pdfPage)
+  if (context.texText.isEmpty() || context.pdfText.isEmpty())
     return;
 
-  // Get source context
-  // In order to get the full context corresponding to the whole input line,
-  // we use a forward search from the source to the PDF (which may turn up more
-  // than one PDF rect for multiline paragraphs).
-  // Note: this still does not help for paragraphs broken across pages
-  QList<QPolygonF> selection;
-  if (SyncTeX::synctex_display_query(_scanner, dest.filename.toLocal8Bit().data(), dest.line, -1, src.page) > 0) {
-    SyncTeX::synctex_node_p node{nullptr};
-	while ((node = SyncTeX::synctex_scanner_next_result(_scanner))) {
-      if (SyncTeX::synctex_node_page(node) != src.page)
-        continue;
-      QRectF nodeRect(synctex_node_box_visible_h(node),
-                      synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
-                      synctex_node_box_visible_width(node),
-                      synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node));
-      selection.append(nodeRect);
-    }
-  }
   // Find the box the user clicked on
-  QMap<int, QRectF> boxes;
-  QString srcContext = pdfPage->selectedText(selection, nullptr, &boxes);
-  // Normalize the srcContext. selectedText() returns newline chars between
-  // separate (output) lines that all correspond to the same input line
-  // (different input lines are handled by SyncTeX). Here we replace those \n
-  // to make srcContext more comparable to destContext below.
-  srcContext.replace(QChar::fromLatin1('\n'), QChar::fromLatin1(' '));
-
   int col{0};
-  for (col = 0; col < boxes.count(); ++col) {
-    if (boxes[col].contains(src.rects[0].center()))
+  for (col = 0; col < context.charBoxes.count(); ++col) {
+    if (context.charBoxes.value(col).contains(pt))
       break;
   }
   // If no valid box was found, bail out
-  if (col >= boxes.count())
-    return;
-
-  // Get destination context
-  QString destContext = tex->getLineText(dest.line);
-  if (destContext.isEmpty())
+  if (col >= context.charBoxes.count())
     return;
 
   // Perform the text matching
   bool unique = false;
-  int destCol = _findCorrespondingPosition(srcContext, destContext, col, unique);
+  int destCol = _findCorrespondingPosition(context.pdfText, context.texText, col, unique);
 
   // If we found no (unique) match bail out
   if (destCol < 0 || !unique)
@@ -285,7 +346,7 @@ void TWSyncTeXSynchronizer::_syncFromPDFFine(const TWSynchronizer::PDFSyncPoint
   // \newcommand{\A}{abc}
   // \A abc\A
 
-  if (col != _findCorrespondingPosition(destContext, srcContext, destCol, unique) || !unique)
+  if (col != _findCorrespondingPosition(context.texText, context.pdfText, destCol, unique) || !unique)
     return;
 
   if (resolution == CharacterResolution) {
@@ -293,7 +354,7 @@ void TWSyncTeXSynchronizer::_syncFromPDFFine(const TWSynchronizer::PDFSyncPoint
     dest.len = 1;
   }
   else if (resolution == WordResolution) {
-    Tw::Document::TeXDocument::findNextWord(destContext, destCol, dest.col, dest.len);
+    Tw::Document::TeXDocument::findNextWord(context.texText, destCol, dest.col, dest.len);
     dest.len -= dest.col;
     // Always select at least one character
     if (dest.len <= 0)
@@ -301,6 +362,212 @@ void TWSyncTeXSynchronizer::_syncFromPDFFine(const TWSynchronizer::PDFSyncPoint
   }
 }
 
+//virtual
+QString TWSyncTeXSynchronizer::_texText(const QString & filename, const int line, const bool open) const
+{
+  Q_UNUSED(filename)
+  Q_UNUSED(line)
+  Q_UNUSED(open)
+  return QString();
+}
+
+//virtual
+QString TWSyncTeXSynchronizer::_pdfText(const QString & filename, const int page, const QList<QRectF> & rects, QMap<int, QRectF> * wordBoxes, QMap<int, QRectF> * charBoxes) const
+{
+  Q_UNUSED(filename)
+  Q_UNUSED(page)
+  Q_UNUSED(rects)
+  Q_UNUSED(wordBoxes)
+  Q_UNUSED(charBoxes)
+  return QString();
+}
+
+void TWSyncTeXSynchronizer::_buildIndex()
+{
+  if (!_scanner)
+    return;
+
+  // Map the input files to their tags so looking up a file does not need to
+  // compare it to each input in turn
+  const QDir curDir(QFileInfo(pdfFilename()).canonicalPath());
+  for (SyncTeX::synctex_node_p node = SyncTeX::synctex_scanner_input(_scanner); node; node = SyncTeX::synctex_node_sibling(node)) {
+    const int tag = SyncTeX::synctex_node_tag(node);
+    const QFileInfo fi(curDir, QString::fromLocal8Bit(SyncTeX::synctex_scanner_get_name(_scanner, tag)));
+    const QString path = (fi.exists() ? fi.canonicalFilePath() : fi.absoluteFilePath());
+    // As before, the first input of a file wins
+    if (!_tagsByFile.contains(path))
+      _tagsByFile.insert(path, tag);
+  }
+
+  _firstBoxOfPage.append(0); // there is no page 0
+  // NB: Pages are numbered consecutively; should there be a page without
+  // SyncTeX data, the following pages are not indexed and lookups on them
+  // fall back to the scanner queries
+  for (int page = 1; SyncTeX::synctex_sheet(_scanner, page); ++page) {
+    _firstBoxOfPage.append(_boxes.size());
+
+    // Several nodes typically share an enclosing box (e.g., a line of text)
+    std::map<std::tuple<float, float, float, float>, int> boxIds;
+
+    // Walk the tree depth-first (in document order) and record the leaves.
+    // Boxes with children are not recorded themselves: their tag and line
+    // are those of the TeX code that built the box (e.g., the end of a
+    // paragraph), which is not what the user points at, and SyncTeX's
+    // display query also prefers the leaves. Their extent is not lost, as
+    // the leaves are recorded with the box enclosing them.
+    QStack<SyncTeX::synctex_node_p> stack;
+    if (SyncTeX::synctex_node_p content = SyncTeX::synctex_sheet_content(_scanner, page))
+      stack.push(content);
+    while (!stack.isEmpty()) {
+      SyncTeX::synctex_node_p node = stack.pop();
+      if (SyncTeX::synctex_node_p sibling = SyncTeX::synctex_node_sibling(node))
+        stack.push(sibling);
+      if (SyncTeX::synctex_node_p child = SyncTeX::synctex_node_child(node)) {
+        stack.push(child);
+        continue;
+      }
+
+      const int tag = SyncTeX::synctex_node_tag(node);
+      const int line = SyncTeX::synctex_node_line(node);
+      if (tag <= 0 || line <= 0)
+        continue;
+
+      const float height = SyncTeX::synctex_node_box_visible_height(node);
+      const Box box{page, SyncTeX::synctex_node_box_visible_h(node),
+                    SyncTeX::synctex_node_box_visible_v(node) - height,
+                    SyncTeX::synctex_node_box_visible_width(node),
+                    height + SyncTeX::synctex_node_box_visible_depth(node)};
+      // Empty boxes (e.g., an empty header or footer) cannot be pointed at
+      // and are not reported by SyncTeX's display query either
+      if (box.width <= 0 || box.height <= 0)
+        continue;
+      const std::tuple<float, float, float, float> key{box.left, box.top, box.width, box.height};
+      std::map<std::tuple<float, float, float, float>, int>::const_iterator it = boxIds.find(key);
+      if (it == boxIds.end()) {
+        it = boxIds.insert(std::make_pair(key, _boxes.size())).first;
+        _boxes.append(box);
+      }
+      _recordsByLine.append({tag, line, it->second, SyncTeX::synctex_node_visible_h(node)});
+    }
+  }
+  _firstBoxOfPage.append(_boxes.size());
+
+  _recordsByBox = _recordsByLine;
+  std::stable_sort(_recordsByBox.begin(), _recordsByBox.end(), [](const Record & a, const Record & b) {
+    return (a.box < b.box || (a.box == b.box && a.h < b.h));
+  });
+
+  std::stable_sort(_recordsByLine.begin(), _recordsByLine.end(), [](const Record & a, const Record & b) {
+    return std::tie(a.tag, a.line, a.box) < std::tie(b.tag, b.line, b.box);
+  });
+  // For lookups by line, only the boxes matter
+  _recordsByLine.erase(std::unique(_recordsByLine.begin(), _recordsByLine.end(), [](const Record & a, const Record & b) {
+    return (a.tag == b.tag && a.line == b.line && a.box == b.box);
+  }), _recordsByLine.end());
+  _recordsByLine.squeeze();
+  _boxes.squeeze();
+}
+
+int TWSyncTeXSynchronizer::_tagForFile(const QString & filename) const
+{
+  const QFileInfo fi(filename);
+  return _tagsByFile.value(fi.exists() ? fi.canonicalFilePath() : fi.absoluteFilePath(), 0);
+}
+
+QList<QRectF> TWSyncTeXSynchronizer::_boxesForLine(const int tag, const int line, int & page) const
+{
+  QList<QRectF> retVal;
+  const Record key{tag, line, 0, 0};
+  QVector<Record>::const_iterator it = std::lower_bound(_recordsByLine.begin(), _recordsByLine.end(), key, [](const Record & a, const Record & b) {
+    return std::tie(a.tag, a.line) < std::tie(b.tag, b.line);
+  });
+  for (; it != _recordsByLine.end() && it->tag == tag && it->line == line; ++it) {
+    const Box & box = _boxes[it->box];
+    if (page < 1)
+      page = box.page;
+    // The records are sorted by page (via the box), so we can stop early
+    if (box.page > page)
+      break;
+    if (box.page == page)
+      retVal.append(box.rect());
+  }
+  return retVal;
+}
+
+QVector< QPair<int, int> > TWSyncTeXSynchronizer::_linesAt(const int page, const QPointF & pt) const
+{
+  QVector< QPair<int, int> > retVal;
+  if (page < 1 || page + 1 >= _firstBoxOfPage.size())
+    return retVal;
+
+  // Find the innermost (i.e., smallest) box containing pt
+  int boxId = -1;
+  qreal minArea = std::numeric_limits<qreal>::max();
+  for (int i = _firstBoxOfPage[page]; i < _firstBoxOfPage[page + 1]; ++i) {
+    const QRectF r = _boxes[i].rect();
+    if (r.contains(pt) && r.width() * r.height() < minArea) {
+      boxId = i;
+      minArea = r.width() * r.height();
+    }
+  }
+  if (boxId < 0)
+    return retVal;
+
+  const Record key{0, 0, boxId, 0};
+  QVector<Record>::const_iterator begin = std::lower_bound(_recordsByBox.begin(), _recordsByBox.end(), key, [](const Record & a, const Record & b) { return a.box < b.box; });
+  QVector<Record>::const_iterator end = begin;
+  QVector<Record>::const_iterator closest = begin;
+  for (; end != _recordsByBox.end() && end->box == boxId; ++end) {
+    if (static_cast<qreal>(end->h) <= pt.x())
+      closest = end;
+  }
+  if (closest == end)
+    return retVal;
+
+  retVal.append(qMakePair(closest->tag, closest->line));
+  for (QVector<Record>::const_iterator it = begin; it != end; ++it) {
+    const QPair<int, int> candidate(it->tag, it->line);
+    if (!retVal.contains(candidate))
+      retVal.append(candidate);
+  }
+  return retVal;
+}
+
+QList<QRectF> TWSyncTeXSynchronizer::_lineBoxes(const int tag, const int line, int & page) const
+{
+  QList<QRectF> retVal = _boxesForLine(tag, line, page);
+  if (!retVal.isEmpty())
+    return retVal;
+
+  const QByteArray name(SyncTeX::synctex_scanner_get_name(_scanner, tag));
+  if (SyncTeX::synctex_display_query(_scanner, name.data(), line, -1, page) > 0) {
+    SyncTeX::synctex_node_p node{nullptr};
+    while ((node = SyncTeX::synctex_scanner_next_result(_scanner))) {
+      if (page < 1)
+        page = SyncTeX::synctex_node_page(node);
+      if (SyncTeX::synctex_node_page(node) != page)
+        continue;
+      QRectF nodeRect(synctex_node_box_visible_h(node),
+                      synctex_node_box_visible_v(node) - synctex_node_box_visible_height(node),
+                      synctex_node_box_visible_width(node),
+                      synctex_node_box_visible_height(node) + synctex_node_box_visible_depth(node));
+      retVal.append(nodeRect);
+    }
+  }
+  return retVal;
+}
+
+QVector< QPair<int, int> > TWSyncTeXSynchronizer::_nodesAt(const int page, const QPointF & pt) const
+{
+  QVector< QPair<int, int> > retVal = _linesAt(page, pt);
+  if (retVal.isEmpty() && SyncTeX::synctex_edit_query(_scanner, page, static_cast<float>(pt.x()), static_cast<float>(pt.y())) > 0) {
+    SyncTeX::synctex_node_p node{nullptr};
+    while ((node = SyncTeX::synctex_scanner_next_result(_scanner)))
+      retVal.append(qMakePair(SyncTeX::synctex_node_tag(node), SyncTeX::synctex_node_line(node)));
+  }
+  return retVal;
+}
+
 // static
 int TWSyncTeXSynchronizer::_findCorrespondingPosition(const QString & srcContext, const QString & destContext, const int col, bool & unique)
 {
@@ -22,9 +22,14 @@
 #ifndef TW_SYNCHRONIZER_H
 #define TW_SYNCHRONIZER_H
 
+#include <QHash>
 #include <QList>
+#include <QMap>
+#include <QPair>
+#include <QPointF>
 #include <QRectF>
 #include <QString>
+#include <QVector>
 
 
 namespace SyncTeX {
@@ -55,9 +60,22 @@ public:
   virtual ~TWSynchronizer() = default;
   virtual PDFSyncPoint syncFromTeX(const TeXSyncPoint & src, const Resolution resolution) const = 0;
   virtual TeXSyncPoint syncFromPDF(const PDFSyncPoint & src, const Resolution resolution) const = 0;
+
+  // Batch versions of syncFromTeX() and syncFromPDF(); the results are in the
+  // same order as `src`. The default implementations synchronize each point
+  // individually.
+  virtual QVector<PDFSyncPoint> syncPointsFromTeX(const QVector<TeXSyncPoint> & src, const Resolution resolution) const;
+  virtual QVector<TeXSyncPoint> syncPointsFromPDF(const QVector<PDFSyncPoint> & src, const Resolution resolution) const;
+  // Returns the boxes corresponding to the lines [firstLine, lastLine] of
+  // `filename` (one PDFSyncPoint per page, in page order)
+  virtual QVector<PDFSyncPoint> syncLinesFromTeX(const QString & filename, const int firstLine, const int lastLine) const;
 };
 
 
+// Note: The constructor parses the complete SyncTeX file, which can take a
+// while for large documents; it is safe to construct the synchronizer on a
+// worker thread (all other methods must only be used from one thread at a
+// time, though)
 class TWSyncTeXSynchronizer : public TWSynchronizer
 {
 public:
@@ -71,14 +89,82 @@ public:
 
   PDFSyncPoint syncFromTeX(const TeXSyncPoint & src, const Resolution resolution) const override;
   TeXSyncPoint syncFromPDF(const PDFSyncPoint & src, const Resolution resolution) const override;
+  QVector<PDFSyncPoint> syncPointsFromTeX(const QVector<TeXSyncPoint> & src, const Resolution resolution) const override;
+  QVector<TeXSyncPoint> syncPointsFromPDF(const QVector<PDFSyncPoint> & src, const Resolution resolution) const override;
+  QVector<PDFSyncPoint> syncLinesFromTeX(const QString & filename, const int firstLine, const int lastLine) const override;
 
 protected:
-  void _syncFromTeXFine(const TeXSyncPoint & src, PDFSyncPoint & dest, const Resolution resolution) const;
-  void _syncFromPDFFine(const PDFSyncPoint & src, TeXSyncPoint & dest, const Resolution resolution) const;
+  // The text of an input line and of its boxes on one page of the PDF, which
+  // the fine synchronization compares; the boxes are indexed by the position
+  // of their word/character in pdfText
+  struct FineContext {
+    QString texText;
+    QString pdfText;
+    QMap<int, QRectF> wordBoxes;
+    QMap<int, QRectF> charBoxes;
+  };
+  FineContext _fineContext(const QString & texFile, const int line, const bool openTeX, const QString & pdfFile, const int page, const QList<QRectF> & rects) const;
+  static void _syncFromTeXFine(const FineContext & context, const int col, PDFSyncPoint & dest, const Resolution resolution);
+  static void _syncFromPDFFine(const FineContext & context, const QPointF & pt, TeXSyncPoint & dest, const Resolution resolution);
 
   static int _findCorrespondingPosition(const QString & srcContext, const QString & destContext, const int col, bool & unique);
 
+  // The fine synchronization compares the text of the TeX source to the text
+  // in the PDF; the synchronizer itself has no access to either, so these
+  // return an empty string unless they are reimplemented
+  // Returns the text of `line` in the TeX file `filename`; if `open` is
+  // true, the file should be opened (and `line` shown) if necessary
+  virtual QString _texText(const QString & filename, const int line, const bool open) const;
+  // Returns the text inside `rects` on `page` of the PDF file `filename` and
+  // (optionally) the boxes of its words and characters (indexed by their
+  // position in the text)
+  virtual QString _pdfText(const QString & filename, const int page, const QList<QRectF> & rects, QMap<int, QRectF> * wordBoxes, QMap<int, QRectF> * charBoxes) const;
+
+  // Compact index of the nodes recorded by SyncTeX and the boxes enclosing
+  // them; it is built once when the file is loaded so that most lookups do
+  // not need to go through the scanner's node tree. Lookups that cannot be
+  // answered from the index (e.g., lines without any nodes, for which SyncTeX
+  // picks the nearest line) fall back to the scanner's queries.
+  struct Box {
+    int page;
+    float left, top, width, height;
+    QRectF rect() const { return QRectF(static_cast<qreal>(left), static_cast<qreal>(top), static_cast<qreal>(width), static_cast<qreal>(height)); }
+  };
+  struct Record {
+    int tag;
+    int line;
+    int box; // index into _boxes
+    float h; // horizontal position of the node
+  };
+  void _buildIndex();
+  // Returns the SyncTeX tag of `filename`, or 0
+  int _tagForFile(const QString & filename) const;
+  // Returns the boxes containing nodes of the given input line on `page`; if
+  // `page` < 1, the first page with any such boxes is used (and returned in
+  // `page`)
+  QList<QRectF> _boxesForLine(const int tag, const int line, int & page) const;
+  // Returns the (tag, line) pairs of the nodes in the innermost box at `pt`;
+  // the node closest to the left of `pt` comes first
+  QVector< QPair<int, int> > _linesAt(const int page, const QPointF & pt) const;
+  // Like _boxesForLine() and _linesAt(), but lines and points that are not
+  // in the index are looked up with SyncTeX's queries (which pick the
+  // nearest line or node)
+  QList<QRectF> _lineBoxes(const int tag, const int line, int & page) const;
+  QVector< QPair<int, int> > _nodesAt(const int page, const QPointF & pt) const;
+
   SyncTeX::synctex_scanner_p _scanner;
+
+  // tags of the input files by their canonical (or, if they do not exist,
+  // absolute) path
+  QHash<QString, int> _tagsByFile;
+  // sorted by page
+  QVector<Box> _boxes;
+  // the boxes of page p are [_firstBoxOfPage[p], _firstBoxOfPage[p + 1])
+  QVector<int> _firstBoxOfPage;
+  // sorted by tag, line, box
+  QVector<Record> _recordsByLine;
+  // sorted by box, h
+  QVector<Record> _recordsByBox;
 };
 
 #endif // !defined(TW_SYNCHRONIZER_H)
@@ -22,10 +22,10 @@
 #include "TeXDocks.h"
 
 #include "TeXDocumentWindow.h"
+#include "ui/TagsModel.h"
 
 #include <QHeaderView>
 #include <QScrollBar>
-#include <QTreeWidget>
 
 TeXDock::TeXDock(const QString & title, TeXDocumentWindow * doc)
 	: QDockWidget(title, doc), document(doc), filled(false)
@@ -45,101 +45,77 @@ void TeXDock::myVisibilityChanged(bool visible)
 
 TagsDock::TagsDock(TeXDocumentWindow * doc)
 	: TeXDock(tr("Tags"), doc)
+	, model(nullptr)
 {
 	setObjectName(QString::fromLatin1("tags"));
 	setAllowedAreas(Qt::LeftDockWidgetArea | Qt::RightDockWidgetArea);
-	tree = new TeXDockTreeWidget(this);
+	tree = new TeXDockTreeView(this);
 	tree->header()->hide();
 	tree->setHorizontalScrollMode(QAbstractItemView::ScrollPerPixel);
 	setWidget(tree);
-	connect(doc->textDoc(), SIGNAL(tagsChanged()), this, SLOT(listChanged()));
 	saveScrollValue = 0;
 }
 
 void TagsDock::fillInfo()
 {
-	disconnect(tree, SIGNAL(itemSelectionChanged()), this, SLOT(followTagSelection()));
-	disconnect(tree, SIGNAL(itemActivated(QTreeWidgetItem*, int)), this, SLOT(followTagSelection()));
-	disconnect(tree, SIGNAL(itemClicked(QTreeWidgetItem*, int)), this, SLOT(followTagSelection()));
-	tree->clear();
-	const QList<Tw::Document::TextDocument::Tag> & tags = document->textDoc()->getTags();
-	if (!tags.empty()) {
-		QTreeWidgetItem *item = nullptr, *bmItem = nullptr;
-		QTreeWidgetItem *bookmarks = new QTreeWidgetItem(tree);
-		bookmarks->setText(0, tr("Bookmarks"));
-		bookmarks->setFlags(Qt::ItemIsEnabled);
-		bookmarks->setForeground(0, Qt::blue);
-		tree->expandItem(bookmarks);
-		QTreeWidgetItem *outline = new QTreeWidgetItem(tree, bookmarks);
-		outline->setText(0, tr("Outline"));
-		outline->setFlags(Qt::ItemIsEnabled);
-		outline->setForeground(0, Qt::blue);
-		tree->expandItem(outline);
-		for (int index = 0; index < tags.size(); ++index) {
-			const Tw::Document::TextDocument::Tag & bm = tags[index];
-			if (bm.level < 1) {
-				bmItem = new QTreeWidgetItem(bookmarks, QTreeWidgetItem::UserType);
-				bmItem->setText(0, bm.text);
-				bmItem->setText(1, QString::number(index));
-			}
-			else  {
-				while (item && item->type() >= QTreeWidgetItem::UserType + static_cast<int>(bm.level))
-					item = item->parent();
-				if (!item)
-					item = new QTreeWidgetItem(outline, QTreeWidgetItem::UserType + static_cast<int>(bm.level));
-				else
-					item = new QTreeWidgetItem(item, QTreeWidgetItem::UserType + static_cast<int>(bm.level));
-				item->setText(0, bm.text);
-				item->setText(1, QString::number(index));
-				tree->expandItem(item);
-			}
-		}
-		if (bookmarks->childCount() == 0)
-			bookmarks->setHidden(true);
-		if (outline->childCount() == 0)
-			outline->setHidden(true);
-		if (saveScrollValue > 0) {
-			tree->verticalScrollBar()->setValue(saveScrollValue);
-			saveScrollValue = 0;
-		}
-		connect(tree, SIGNAL(itemSelectionChanged()), this, SLOT(followTagSelection()));
-		connect(tree, SIGNAL(itemActivated(QTreeWidgetItem*, int)), this, SLOT(followTagSelection()));
-		connect(tree, SIGNAL(itemClicked(QTreeWidgetItem*, int)), this, SLOT(followTagSelection()));
-	} else {
-		QTreeWidgetItem *item = new QTreeWidgetItem();
-		item->setText(0, tr("No tags"));
-		item->setFlags(item->flags() & ~(Qt::ItemIsEnabled | Qt::ItemIsSelectable));
-		tree->addTopLevelItem(item);
-	}
+	// Once created, the model keeps itself up to date (see
+	// Tw::UI::TagsModel::tagsChanged())
+	model = new Tw::UI::TagsModel(document->textDoc(), this);
+	tree->setModel(model);
+	tree->expandAll();
+	connect(model, SIGNAL(modelAboutToBeReset()), this, SLOT(listAboutToChange()));
+	connect(model, SIGNAL(modelReset()), this, SLOT(listChanged()));
+	connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(tagsInserted(QModelIndex, int, int)));
+	connect(tree->selectionModel(), SIGNAL(selectionChanged(QItemSelection, QItemSelection)), this, SLOT(followTagSelection()));
+	connect(tree, SIGNAL(activated(QModelIndex)), this, SLOT(followTagSelection()));
+	connect(tree, SIGNAL(clicked(QModelIndex)), this, SLOT(followTagSelection()));
 }
 
-void TagsDock::listChanged()
+void TagsDock::listAboutToChange()
 {
 	saveScrollValue = tree->verticalScrollBar()->value();
-	tree->clear();
-	filled = false;
-	if (document && isVisible())
-		fillInfo();
+}
+
+void TagsDock::listChanged()
+{
+	tree->expandAll();
+	if (saveScrollValue > 0) {
+		tree->verticalScrollBar()->setValue(saveScrollValue);
+		saveScrollValue = 0;
+	}
+}
+
+static void expandRecursively(QTreeView * tree, const QModelIndex & index)
+{
+	tree->expand(index);
+	for (int row = 0; row < index.model()->rowCount(index); ++row)
+		expandRecursively(tree, index.model()->index(row, 0, index));
+}
+
+void TagsDock::tagsInserted(const QModelIndex & parent, int first, int last)
+{
+	// Like the rest of the list (see listChanged()), show new tags expanded
+	for (int row = first; row <= last; ++row)
+		expandRecursively(tree, model->index(row, 0, parent));
 }
 
 void TagsDock::followTagSelection()
 {
-	QList<QTreeWidgetItem*> items = tree->selectedItems();
-	if (items.count() > 0) {
-		QTreeWidgetItem* item = items.first();
-		QString dest = item->text(1);
-		if (!dest.isEmpty())
-			document->goToTag(dest.toInt());
+	const QModelIndexList indexes = tree->selectionModel()->selectedIndexes();
+	if (!indexes.isEmpty()) {
+		const int tag = model->tagIndex(indexes.first());
+		if (tag >= 0)
+			document->goToTag(tag);
 	}
 }
 
-TeXDockTreeWidget::TeXDockTreeWidget(QWidget* parent)
-	: QTreeWidget(parent)
+TeXDockTreeView::TeXDockTreeView(QWidget* parent)
+	: QTreeView(parent)
 {
 	setIndentation(10);
 }
 
-QSize TeXDockTreeWidget::sizeHint() const
+QSize TeXDockTreeView::sizeHint() const
 {
 	return QSize(180, 300);
 }
@@ -25,12 +25,17 @@
 #include <QDockWidget>
 #include <QListWidget>
 #include <QScrollArea>
-#include <QTreeWidget>
+#include <QTreeView>
 
 class TeXDocumentWindow;
 class QListWidget;
 class QTableWidget;
-class QTreeWidgetItem;
+
+namespace Tw {
+namespace UI {
+class TagsModel;
+} // namespace UI
+} // namespace Tw
 
 class TeXDock : public QDockWidget
 {
@@ -67,20 +72,23 @@ protected:
 	void fillInfo() override;
 
 private slots:
+	void listAboutToChange();
+	void tagsInserted(const QModelIndex & parent, int first, int last);
 	void followTagSelection();
 
 private:
-	QTreeWidget *tree;
+	QTreeView *tree;
+	Tw::UI::TagsModel *model;
 	int saveScrollValue;
 };
 
-class TeXDockTreeWidget : public QTreeWidget
+class TeXDockTreeView : public QTreeView
 {
 	Q_OBJECT
 
 public:
-	explicit TeXDockTreeWidget(QWidget * parent);
-	~TeXDockTreeWidget() override = default;
+	explicit TeXDockTreeView(QWidget * parent);
+	~TeXDockTreeView() override = default;
 
 	QSize sizeHint() const override;
 };
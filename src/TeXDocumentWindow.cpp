@@ -34,6 +34,7 @@
 #include "TeXDocks.h"
 #include "TeXHighlighter.h"
 #include "TemplateDialog.h"
+#include "document/ProjectIndex.h"
 #include "scripting/ScriptAPI.h"
 #include "ui/ClickableLabel.h"
 
@@ -68,6 +69,9 @@
 
 QList<TeXDocumentWindow*> TeXDocumentWindow::docList;
 
+// time (in msec) after the last edit before the project is indexed again
+const int kProjectIndexDelay = 1500;
+
 TeXDocumentWindow::TeXDocumentWindow()
 	: _texDoc(new Tw::Document::TeXDocument(this))
 {
@@ -210,6 +214,14 @@ void TeXDocumentWindow::init()
 	connect(textEdit, SIGNAL(cursorPositionChanged()), this, SLOT(showCursorPosition()));
 	connect(textEdit, SIGNAL(selectionChanged()), this, SLOT(showCursorPosition()));
 	connect(textEdit, SIGNAL(syncClick(int, int)), this, SLOT(syncClick(int, int)));
+
+	// Keep the symbols of the project (used for completion) up to date; the
+	// indexing runs in the background once typing pauses (see
+	// updateProjectIndex())
+	_projectIndexTimer.setSingleShot(true);
+	_projectIndexTimer.setInterval(kProjectIndexDelay);
+	connect(&_projectIndexTimer, SIGNAL(timeout()), this, SLOT(updateProjectIndex()));
+	connect(textEdit->document(), SIGNAL(contentsChanged()), &_projectIndexTimer, SLOT(start()));
 	connect(this, SIGNAL(syncFromSource(const QString&, int, int, bool)), qApp, SIGNAL(syncPdf(const QString&, int, int, bool)));
 
 	connect(QApplication::clipboard(), SIGNAL(dataChanged()), this, SLOT(clipboardChanged()));
@@ -372,6 +384,7 @@ void TeXDocumentWindow::init()
 
 	reloadSpellcheckerMenu();
 	connect(Tw::Document::SpellChecker::instance(), SIGNAL(dictionaryListChanged()), this, SLOT(reloadSpellcheckerMenu()));
+	connect(Tw::Document::SpellChecker::instance(), SIGNAL(dictionaryLoaded(const QString&)), this, SLOT(dictionaryLoaded(const QString&)));
 
 	menuShow->addAction(toolBar_run->toggleViewAction());
 	menuShow->addAction(toolBar_edit->toggleViewAction());
@@ -430,7 +443,10 @@ void TeXDocumentWindow::setLangInternal(const QString& lang)
 	// called internally by the spelling menu actions;
 	// not for use from scripts as it won't update the menu
 	Tw::Document::SpellChecker::Dictionary * oldDictionary = highlighter->getSpellChecker();
-	Tw::Document::SpellChecker::Dictionary * newDictionary = Tw::Document::SpellChecker::getDictionary(lang);
+	// Don't block while the dictionary is loaded; spell checking is turned on
+	// once it is available (see dictionaryLoaded())
+	Tw::Document::SpellChecker::Dictionary * newDictionary = Tw::Document::SpellChecker::requestDictionary(lang);
+	_pendingSpellcheckLanguage = (!newDictionary && Tw::Document::SpellChecker::isLoading(lang) ? lang : QString());
 	// if the dictionary hasn't change, don't reset the spell checker as that
 	// can result in a serious delay for long documents
 	// NB: Don't delete the dictionaries; the pointers are kept by
@@ -441,6 +457,12 @@ void TeXDocumentWindow::setLangInternal(const QString& lang)
 	highlighter->setSpellChecker(newDictionary);
 }
 
+void TeXDocumentWindow::dictionaryLoaded(const QString& lang)
+{
+	if (!_pendingSpellcheckLanguage.isEmpty() && lang == _pendingSpellcheckLanguage)
+		setLangInternal(lang);
+}
+
 void TeXDocumentWindow::setSpellcheckLanguage(const QString& lang)
 {
 	// this is called by the %!TEX spellcheck... line, or by scripts;
@@ -476,6 +498,8 @@ QString TeXDocumentWindow::spellcheckLanguage() const
 {
 	if (_texDoc == nullptr)
 		return QString();
+	if (!_pendingSpellcheckLanguage.isEmpty())
+		return _pendingSpellcheckLanguage;
 	TeXHighlighter * highlighter = _texDoc->getHighlighter();
 	if (highlighter == nullptr)
 		return QString();
@@ -1180,6 +1204,7 @@ void TeXDocumentWindow::delayedInit()
 
 		TeXHighlighter * highlighter = new TeXHighlighter(_texDoc);
 		connect(textEdit, SIGNAL(rehighlight()), highlighter, SLOT(rehighlight()));
+		textEdit->updateHighlightingPriority();
 
 		// set up syntax highlighting
 		// First, use the current file's syntaxMode property (if available)
@@ -1207,6 +1232,31 @@ void TeXDocumentWindow::delayedInit()
 			setSpellcheckLanguage(settings.value(QString::fromLatin1("language")).toString());
 		}
 	}
+	updateProjectIndex();
+}
+
+void TeXDocumentWindow::updateProjectIndex()
+{
+	_projectIndexTimer.stop();
+
+	// All documents of a project share one index
+	const QString rootFile = (untitled() ? fileName() : getRootFilePath());
+	if (!_projectIndex || rootFile != _projectIndexRootFile) {
+		_projectIndex = Tw::Document::ProjectIndex::forRootFile(rootFile);
+		_projectIndexRootFile = rootFile;
+		textEdit->setProjectIndex(_projectIndex.data());
+	}
+
+	// Documents that are open in other windows are only passed along if they
+	// have unsaved changes; all others are read from disk (or taken from the
+	// index if they did not change)
+	QHash<QString, QString> openDocuments;
+	openDocuments.insert(fileName(), textEdit->toPlainText());
+	foreach (TeXDocumentWindow * doc, docList) {
+		if (doc != this && doc->textEdit->document()->isModified())
+			openDocuments.insert(doc->fileName(), doc->textEdit->toPlainText());
+	}
+	_projectIndex->update(rootFile, openDocuments);
 }
 
 #define FILE_MODIFICATION_ACCURACY	1000	// in msec
@@ -1455,6 +1505,7 @@ bool TeXDocumentWindow::saveFile(const QFileInfo & fileInfo)
 								kStatusMessageDuration);
 
 	QTimer::singleShot(0, this, SLOT(setupFileWatcher()));
+	updateProjectIndex();
 	return true;
 }
 
@@ -2274,42 +2325,25 @@ void TeXDocumentWindow::doFindAgain(bool fromDialog)
 		}
 	}
 
-	if (fromDialog && (settings.value(QString::fromLatin1("searchFindAll")).toBool() || settings.value(QString::fromLatin1("searchAllFiles")).toBool())) {
-		bool singleFile = true;
+	if (fromDialog && settings.value(QString::fromLatin1("searchAllFiles")).toBool()) {
+		// Search all files of the project (and all open documents) in the
+		// background; the results are shown as they come in
+		QVector<Tw::Document::ProjectSearch::OpenDocument> openDocuments;
+		foreach (TeXDocumentWindow* doc, docList)
+			openDocuments.append({doc->textDoc(), (doc->untitled() ? QString() : doc->fileName()), doc->textEdit->toPlainText()});
+		Tw::Document::ProjectSearch * search = new Tw::Document::ProjectSearch(searchText, regex, flags);
+		SearchResults::presentResults(searchText, search, this);
+		search->start(untitled() ? QString() : getRootFilePath(), openDocuments, TWApp::instance()->getDefaultCodec());
+	}
+	else if (fromDialog && settings.value(QString::fromLatin1("searchFindAll")).toBool()) {
 		QList<SearchResult> results;
 		flags &= ~QTextDocument::FindBackward;
-		int docListIndex = 0;
-		TeXDocumentWindow* theDoc = this;
-		while (true) {
-			QTextCursor curs(theDoc->textDoc());
-			curs.movePosition(QTextCursor::End);
-			int rangeStart = 0;
-			int rangeEnd = curs.position();
-			while (true) {
-				curs = doSearch(theDoc->textDoc(), searchText, regex, flags, rangeStart, rangeEnd);
-				if (curs.isNull())
-					break;
-				int blockStart = curs.block().position();
-				results.append(SearchResult(theDoc, curs.blockNumber() + 1,
-								curs.selectionStart() - blockStart, curs.selectionEnd() - blockStart));
-				if ((flags & QTextDocument::FindBackward) != 0)
-					rangeEnd = curs.selectionStart();
-				else
-					rangeStart = curs.selectionEnd();
-			}
-
-			if (!settings.value(QString::fromLatin1("searchAllFiles")).toBool())
-				break;
-			// go to next document
-		next_doc:
-			if (docList[docListIndex] == theDoc)
-				docListIndex++;
-			if (docListIndex == docList.count())
-				break;
-			theDoc = docList[docListIndex];
-			if (theDoc == this)
-				goto next_doc;
-			singleFile = false;
+		const Tw::Document::TextSearch search(textDoc(), searchText, regex, flags);
+		foreach (const Tw::Document::TextSearch::Match & match, search.findAll(0, search.text().length())) {
+			const QTextBlock block = textDoc()->findBlock(match.start);
+			const int blockStart = block.position();
+			results.append(SearchResult((untitled() ? QString() : fileName()), block.blockNumber() + 1,
+							match.start - blockStart, match.end - blockStart, block.text(), textDoc()));
 		}
 
 		if (results.count() == 0) {
@@ -2317,35 +2351,32 @@ void TeXDocumentWindow::doFindAgain(bool fromDialog)
 			statusBar()->showMessage(tr("Not found"), kStatusMessageDuration);
 		}
 		else {
-			SearchResults::presentResults(searchText, results, this, singleFile);
+			SearchResults::presentResults(searchText, results, this, true);
 			statusBar()->showMessage(tr("Found %n occurrence(s)", "", results.count()), kStatusMessageDuration);
 		}
 	}
 	else {
+		const Tw::Document::TextSearch search(textEdit->document(), searchText, regex, flags);
 		QTextCursor	curs = textEdit->textCursor();
 		if (settings.value(QString::fromLatin1("searchSelection")).toBool() && curs.hasSelection()) {
 			int rangeStart = curs.selectionStart();
 			int rangeEnd = curs.selectionEnd();
-			curs = doSearch(textEdit->document(), searchText, regex, flags, rangeStart, rangeEnd);
+			curs = doSearch(textEdit->document(), search, rangeStart, rangeEnd);
 		}
 		else {
 			if ((flags & QTextDocument::FindBackward) != 0) {
 				int rangeStart = 0;
 				int rangeEnd = curs.selectionStart();
-				curs = doSearch(textEdit->document(), searchText, regex, flags, rangeStart, rangeEnd);
-				if (curs.isNull() && settings.value(QString::fromLatin1("searchWrap")).toBool()) {
-					curs = QTextCursor(textEdit->document());
-					curs.movePosition(QTextCursor::End);
-					curs = doSearch(textEdit->document(), searchText, regex, flags, 0, curs.position());
-				}
+				curs = doSearch(textEdit->document(), search, rangeStart, rangeEnd);
+				if (curs.isNull() && settings.value(QString::fromLatin1("searchWrap")).toBool())
+					curs = doSearch(textEdit->document(), search, 0, search.text().length());
 			}
 			else {
 				int rangeStart = curs.selectionEnd();
-				curs.movePosition(QTextCursor::End);
-				int rangeEnd = curs.position();
-				curs = doSearch(textEdit->document(), searchText, regex, flags, rangeStart, rangeEnd);
+				int rangeEnd = search.text().length();
+				curs = doSearch(textEdit->document(), search, rangeStart, rangeEnd);
 				if (curs.isNull() && settings.value(QString::fromLatin1("searchWrap")).toBool())
-					curs = doSearch(textEdit->document(), searchText, regex, flags, 0, rangeEnd);
+					curs = doSearch(textEdit->document(), search, 0, rangeEnd);
 			}
 		}
 
@@ -2451,8 +2482,9 @@ void TeXDocumentWindow::doReplace(ReplaceDialog::DialogCode mode)
 	}
 
 	if (mode == ReplaceDialog::ReplaceOne) {
-		QTextCursor curs = doSearch(textEdit->document(), searchText, regex, flags, rangeStart, rangeEnd);
-		if (curs.isNull() && searchWrap) {
+		const Tw::Document::TextSearch search(textEdit->document(), searchText, regex, flags);
+		Tw::Document::TextSearch::Match match = search.find(rangeStart, rangeEnd);
+		if (!match.isValid() && searchWrap) {
 			// If we haven't found anything and wrapping is enabled, try again
 			// with a "wrapped" search range
 			if ((flags & QTextDocument::FindBackward) != 0) {
@@ -2464,21 +2496,18 @@ void TeXDocumentWindow::doReplace(ReplaceDialog::DialogCode mode)
 				rangeEnd = rangeStart;
 				rangeStart = 0;
 			}
-			curs = doSearch(textEdit->document(), searchText, regex, flags, rangeStart, rangeEnd);
+			match = search.find(rangeStart, rangeEnd);
 		}
-		if (curs.isNull()) {
+		if (!match.isValid()) {
 			qApp->beep();
 			statusBar()->showMessage(tr("Not found"), kStatusMessageDuration);
 		}
 		else {
 			// do replacement
-			QString target;
-			if (regex)
-				target = textEdit->document()->toPlainText()
-							.mid(curs.selectionStart(), curs.selectionEnd() - curs.selectionStart()).replace(*regex, replacement);
-			else
-				target = replacement;
-			curs.insertText(target);
+			QTextCursor curs(textEdit->document());
+			curs.setPosition(match.start);
+			curs.setPosition(match.end, QTextCursor::KeepAnchor);
+			curs.insertText(search.replacementText(match, replacement));
 			textEdit->setTextCursor(curs);
 		}
 	}
@@ -2511,110 +2540,34 @@ void TeXDocumentWindow::doReplace(ReplaceDialog::DialogCode mode)
 int TeXDocumentWindow::doReplaceAll(const QString& searchText, QRegularExpression * regex, const QString& replacement,
 								QTextDocument::FindFlags flags, int rangeStart, int rangeEnd)
 {
-	QTextCursor searchRange = textCursor();
-	searchRange.select(QTextCursor::Document);
+	// Search a single snapshot of the text and apply all replacements in one
+	// edit block, rather than searching the whole document again after each
+	// replacement
+	const Tw::Document::TextSearch search(textEdit->document(), searchText, regex, flags);
 	if (rangeStart < 0)
-		rangeStart = searchRange.selectionStart();
+		rangeStart = 0;
 	if (rangeEnd < 0)
-		rangeEnd = searchRange.selectionEnd();
+		rangeEnd = search.text().length();
 
-	int replacements = 0;
-	bool first = true;
-	while (true) {
-		QTextCursor curs = doSearch(textEdit->document(), searchText, regex, flags, rangeStart, rangeEnd);
-		if (curs.isNull()) {
-			if (!first)
-				searchRange.endEditBlock();
-			break;
-		}
-		if (first) {
-			searchRange.beginEditBlock();
-			first = false;
-		}
-		QString target;
-		int oldLen = curs.selectionEnd() - curs.selectionStart();
-		if (regex)
-			target = textEdit->document()->toPlainText().mid(curs.selectionStart(), oldLen).replace(*regex, replacement);
-		else
-			target = replacement;
-		int newLen = target.length();
-		if ((flags & QTextDocument::FindBackward) != 0)
-			rangeEnd = curs.selectionStart();
-		else {
-			rangeStart = curs.selectionEnd() - oldLen + newLen;
-			rangeEnd += newLen - oldLen;
-		}
-		searchRange.setPosition(curs.selectionStart());
-		searchRange.setPosition(curs.selectionEnd(), QTextCursor::KeepAnchor);
-		searchRange.insertText(target);
-		++replacements;
-	}
-	if (!first) {
-		searchRange.setPosition(rangeStart);
-		textEdit->setTextCursor(searchRange);
+	int replacedEnd = 0;
+	int replacements = search.replaceAll(textEdit->document(), replacement, rangeStart, rangeEnd, &replacedEnd);
+	if (replacements > 0) {
+		QTextCursor curs = textCursor();
+		curs.setPosition(replacedEnd);
+		textEdit->setTextCursor(curs);
 	}
 	return replacements;
 }
 
-QTextCursor TeXDocumentWindow::doSearch(QTextDocument *theDoc, const QString& searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags, int s, int e)
+QTextCursor TeXDocumentWindow::doSearch(QTextDocument *theDoc, const Tw::Document::TextSearch & search, int s, int e)
 {
-	QTextCursor curs;
-	const QString& docText = theDoc->toPlainText();
+	const Tw::Document::TextSearch::Match match = search.find(s, e);
+	if (!match.isValid())
+		return QTextCursor();
 
-	if ((flags & QTextDocument::FindBackward) != 0) {
-		if (regex) {
-			// this doesn't seem to match \n or even \x2029 for newline
-			// curs = theDoc->find(*regex, e, flags);
-			QRegularExpressionMatch m;
-#if QT_VERSION >= 0x050500
-			int offset = docText.lastIndexOf(*regex, e, &m);
-#else
-			int offset = docText.lastIndexOf(*regex, e);
-			if (offset >= 0)
-				m = regex->match(docText, offset);
-#endif
-			while (offset >= s && m.capturedEnd() > e) {
-#if QT_VERSION >= 0x050500
-				offset = docText.lastIndexOf(*regex, offset - 1, &m);
-#else
-				offset = docText.lastIndexOf(*regex, offset - 1);
-				if (offset >= 0)
-					m = regex->match(docText, offset);
-#endif
-			}
-			if (offset >= s) {
-				curs = QTextCursor(theDoc);
-				curs.setPosition(m.capturedStart());
-				curs.setPosition(m.capturedEnd(), QTextCursor::KeepAnchor);
-			}
-		}
-		else {
-			curs = theDoc->find(searchText, e, flags);
-			if (!curs.isNull()) {
-				if (curs.selectionEnd() > e)
-					curs = theDoc->find(searchText, curs, flags);
-				if (curs.selectionStart() < s)
-					curs = QTextCursor();
-			}
-		}
-	}
-	else {
-		if (regex) {
-			// this doesn't seem to match \n or even \x2029 for newline
-			// curs = theDoc->find(*regex, s, flags);
-			QRegularExpressionMatch m = regex->match(docText, s);
-			if (m.hasMatch()) {
-				curs = QTextCursor(theDoc);
-				curs.setPosition(m.capturedStart());
-				curs.setPosition(m.capturedEnd(), QTextCursor::KeepAnchor);
-			}
-		}
-		else {
-			curs = theDoc->find(searchText, s, flags);
-		}
-		if (curs.selectionEnd() > e)
-			curs = QTextCursor();
-	}
+	QTextCursor curs(theDoc);
+	curs.setPosition(match.start);
+	curs.setPosition(match.end, QTextCursor::KeepAnchor);
 	return curs;
 }
 
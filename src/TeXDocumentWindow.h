@@ -26,6 +26,7 @@
 #include "TWScriptableWindow.h"
 #include "document/SpellChecker.h"
 #include "document/TeXDocument.h"
+#include "document/TextSearch.h"
 #include "ui_TeXDocumentWindow.h"
 
 #include <QDateTime>
@@ -33,7 +34,9 @@
 #include <QMouseEvent>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QSharedPointer>
 #include <QSignalMapper>
+#include <QTimer>
 
 class QAction;
 class QMenu;
@@ -48,6 +51,9 @@ class QFileSystemWatcher;
 class PDFDocumentWindow;
 
 namespace Tw {
+namespace Document {
+class ProjectIndex;
+} // namespace Document
 namespace UI {
 class ClickableLabel;
 } // namespace UI
@@ -195,6 +201,7 @@ public slots:
 
 private slots:
 	void setLangInternal(const QString& lang);
+	void dictionaryLoaded(const QString& lang);
 	void maybeEnableSaveAndRevert(bool modified);
 	void clipboardChanged();
 	void doReplace(ReplaceDialog::DialogCode mode);
@@ -219,6 +226,7 @@ private slots:
 	void encodingLabelClick(QMouseEvent * event) { encodingPopup(event->pos()); }
 	void anchorClicked(const QUrl& url);
 	void delayedInit();
+	void updateProjectIndex();
 
 private:
 	void init();
@@ -237,8 +245,7 @@ private:
 	void replaceSelection(const QString& newText);
 	void doHardWrap(int mode, int lineWidth, bool rewrap);
 	void zoomToLeft(QWidget *otherWindow);
-	QTextCursor doSearch(QTextDocument *theDoc, const QString& searchText, const QRegularExpression *regex,
-						 QTextDocument::FindFlags flags, int rangeStart, int rangeEnd);
+	QTextCursor doSearch(QTextDocument *theDoc, const Tw::Document::TextSearch & search, int rangeStart, int rangeEnd);
 	int doReplaceAll(const QString& searchText, QRegularExpression* regex, const QString& replacement,
 						QTextDocument::FindFlags flags, int rangeStart = -1, int rangeEnd = -1);
 	void executeAfterTypesetHooks();
@@ -277,6 +284,8 @@ private:
 	QString engineName;
 
 	QSignalMapper dictSignalMapper;
+	// language whose dictionary is still being loaded (see setLangInternal())
+	QString _pendingSpellcheckLanguage;
 
 	QComboBox * engine{nullptr};
 	QProcess * process{nullptr};
@@ -289,6 +298,10 @@ private:
 
 	QFileSystemWatcher * watcher{nullptr};
 
+	QSharedPointer<Tw::Document::ProjectIndex> _projectIndex;
+	QString _projectIndexRootFile;
+	QTimer _projectIndexTimer;
+
 	QTextCursor	dragSavedCursor;
 
 	static QList<TeXDocumentWindow*> docList;
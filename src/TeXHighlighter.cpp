@@ -24,10 +24,10 @@
 #include "document/TeXDocument.h"
 
 #include <QTextCursor>
-#include <climits> // for INT_MAX
 
 QList<TeXHighlighter::HighlightingSpec> *TeXHighlighter::syntaxRules = nullptr;
 QList<TeXHighlighter::TagPattern> *TeXHighlighter::tagPatterns = nullptr;
+Tw::Utils::MultiPatternMatcher *TeXHighlighter::tagMatcher = nullptr;
 
 TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent)
 	: NonblockingSyntaxHighlighter(parent)
@@ -69,26 +69,18 @@ void TeXHighlighter::highlightBlock(const QString &text)
 {
 	int charPos = 0;
 	if (highlightIndex >= 0 && highlightIndex < syntaxRules->count()) {
-		QList<HighlightingRule>& highlightingRules = (*syntaxRules)[highlightIndex].rules;
+		const HighlightingSpec & spec = syntaxRules->at(highlightIndex);
 		// Go through the whole text...
 		while (charPos < text.length()) {
 			// ... and find the highlight pattern that matches closest to the
 			// current character index
-			int firstIndex{INT_MAX}, len{0};
-			const HighlightingRule* firstRule = nullptr;
-			QRegularExpressionMatch firstMatch;
-			for (int i = 0; i < highlightingRules.size(); ++i) {
-				HighlightingRule &rule = highlightingRules[i];
-				QRegularExpressionMatch m = rule.pattern.match(text, charPos);
-				if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
-					firstIndex = m.capturedStart();
-					firstMatch = m;
-					firstRule = &rule;
-				}
-			}
+			int len{0};
+			const Tw::Utils::MultiPatternMatcher::Match firstMatch = spec.matcher.match(text, charPos);
 			// If we found a rule, apply it and advance the character index to
 			// the end of the highlighted range
-			if (firstRule && firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
+			if (firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
+				const int firstIndex = firstMatch.capturedStart();
+				const HighlightingRule * firstRule = &spec.rules[firstMatch.patternIndex()];
 				if (_dictionary && firstIndex > charPos)
 					spellCheckRange(text, charPos, firstIndex, spellFormat);
 				setFormat(firstIndex, len, firstRule->format);
@@ -104,51 +96,56 @@ void TeXHighlighter::highlightBlock(const QString &text)
 	if (_dictionary)
 		spellCheckRange(text, charPos, text.length(), spellFormat);
 
-	if (texDoc) {
-		texDoc->removeTags(currentBlock().position(), currentBlock().length());
-		if (isTagging) {
-			int index = 0;
-			while (index < text.length()) {
-				int firstIndex{INT_MAX}, len{0};
-				TagPattern* firstPatt = nullptr;
-				QRegularExpressionMatch firstMatch;
-				for (int i = 0; i < tagPatterns->count(); ++i) {
-					TagPattern& patt = (*tagPatterns)[i];
-					QRegularExpressionMatch m = patt.pattern.match(text, index);
-					if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
-						firstIndex = m.capturedStart();
-						firstMatch = m;
-						firstPatt = &patt;
-					}
-				}
-				if (firstPatt && firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
-					QTextCursor	cursor(document());
-					cursor.setPosition(currentBlock().position() + firstIndex);
-					cursor.setPosition(currentBlock().position() + firstIndex + len, QTextCursor::KeepAnchor);
-					QString tagText = firstMatch.captured(1);
-					if (tagText.isEmpty())
-						tagText = firstMatch.captured(0);
-					texDoc->addTag(cursor, firstPatt->level, tagText);
-					index = firstIndex + len;
-				}
-				else
-					break;
+	if (texDoc && isTagging) {
+		int index = 0;
+		while (index < text.length()) {
+			int len{0};
+			const Tw::Utils::MultiPatternMatcher::Match firstMatch = tagMatcher->match(text, index);
+			if (firstMatch.hasMatch() && (len = firstMatch.capturedLength()) > 0) {
+				const int firstIndex = firstMatch.capturedStart();
+				const TagPattern * firstPatt = &tagPatterns->at(firstMatch.patternIndex());
+				QString tagText = firstMatch.captured(1);
+				if (tagText.isEmpty())
+					tagText = firstMatch.captured(0);
+				addTag(firstIndex, len, firstPatt->level, tagText);
+				index = firstIndex + len;
 			}
+			else
+				break;
 		}
 	}
 }
 
+void TeXHighlighter::applyTags(const QTextBlock & block, const QVector<Tag> & tags)
+{
+	if (!texDoc)
+		return;
+	QList<Tw::Document::TextDocument::Tag> docTags;
+	foreach (const Tag & tag, tags) {
+		QTextCursor	cursor(document());
+		cursor.setPosition(block.position() + tag.start);
+		cursor.setPosition(block.position() + tag.start + tag.length, QTextCursor::KeepAnchor);
+		docTags.append({cursor, tag.level, tag.text});
+	}
+	texDoc->replaceTags(block.position(), block.length(), docTags);
+}
+
 void TeXHighlighter::setActiveIndex(int index)
 {
-	int oldIndex = highlightIndex;
-	highlightIndex = (index >= 0 && index < syntaxRules->count()) ? index : -1;
-	if (oldIndex != highlightIndex)
+	const int newIndex = (index >= 0 && index < syntaxRules->count()) ? index : -1;
+	if (newIndex != highlightIndex) {
+		stopWorker();
+		highlightIndex = newIndex;
 		rehighlight();
+	}
 }
 
 void TeXHighlighter::setSpellChecker(Tw::Document::SpellChecker::Dictionary * dictionary)
 {
 	if (_dictionary != dictionary) {
+		// The worker must not use the old dictionary anymore (which may be
+		// deleted, see Tw::Document::SpellChecker::clearDictionaries())
+		stopWorker();
 		_dictionary = dictionary;
 		QTimer::singleShot(1, this, SLOT(rehighlight()));
 	}
@@ -245,6 +242,12 @@ void TeXHighlighter::loadPatterns()
 			if (spec.rules.count() > 0)
 				syntaxRules->append(spec);
 		}
+		for (int i = 0; i < syntaxRules->size(); ++i) {
+			QList<QRegularExpression> patterns;
+			foreach (const HighlightingRule & rule, syntaxRules->at(i).rules)
+				patterns << rule.pattern;
+			(*syntaxRules)[i].matcher = Tw::Utils::MultiPatternMatcher(patterns);
+		}
 	}
 
 	if (!tagPatterns) {
@@ -272,263 +275,9 @@ void TeXHighlighter::loadPatterns()
 				}
 			}
 		}
-	}
-}
-
-///////////////////////////////////////////////////////////////////////////////
-/// NonblockingSyntaxHighlighter
-///////////////////////////////////////////////////////////////////////////////
-
-void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc)
-{
-	if (_parent)
-		disconnect(_parent);
-	_parent = doc;
-	_highlightRanges.clear();
-	_dirtyRanges.clear();
-	if (_parent) {
-		connect(_parent, SIGNAL(destroyed(QObject*)), this, SLOT(unlinkFromDocument()));
-		connect(_parent, SIGNAL(contentsChange(int,int,int)), this, SLOT(maybeRehighlightText(int, int, int)));
-		rehighlight();
-	}
-}
-
-void NonblockingSyntaxHighlighter::rehighlight()
-{
-	if (!_parent)
-		return;
-
-	_highlightRanges.clear();
-	range r;
-	r.from = 0;
-	r.to = _parent->characterCount();
-	_highlightRanges.push_back(r);
-	processWhenIdle();
-}
-
-void NonblockingSyntaxHighlighter::rehighlightBlock(const QTextBlock & block)
-{
-	pushHighlightBlock(block);
-	processWhenIdle();
-}
-
-void NonblockingSyntaxHighlighter::maybeRehighlightText(int position, int charsRemoved, int charsAdded)
-{
-	if (!_parent)
-		return;
-
-	// Adjust ranges already present in _highlightRanges
-	for (int i = 0; i < _highlightRanges.size(); ++i) {
-		// Adjust front (if necessary)
-		if (_highlightRanges[i].from >= position + charsRemoved)
-			_highlightRanges[i].from += charsAdded - charsRemoved;
-		else if (_highlightRanges[i].from >= position) // && _highlightRanges[i].from < position + charsRemoved
-			_highlightRanges[i].from = position + charsAdded;
-		// Adjust back (if necessary)
-		if (_highlightRanges[i].to >= position + charsRemoved)
-			_highlightRanges[i].to += charsAdded - charsRemoved;
-		else if (_highlightRanges[i].to >= position) // && _highlightRanges[i].to < position + charsRemoved
-			_highlightRanges[i].to = position;
-	}
-	// NB: pushHighlightRange() implicitly calls sanitizeHighlightRanges() so
-	// there is no need to call it here explicitly
-
-	// NB: Don't subtract charsRemoved. If charsAdded = 0 and charsRemoved > 0
-	// we still want to rehighlight that line
-	// Add 1 because of the following cases:
-	// a) if charsAdded = 0, we still need to have at least one character in the range
-	// b) if the insertion ends in a newline character (0x2029), for some
-	//    reason the line immediately following the inserted line loses
-	//    highlighting. Adding 1 ensures that that next line is rehighlighted
-	//    as well.
-	// c) if the insertion does not end in a newline character, adding 1 does
-	//    not extend the range to a new line, so it doesn't matter (as
-	//    highlighting is only performed line-wise).
-	pushHighlightRange(position, position + charsAdded + 1);
-
-	processWhenIdle();
-}
-
-void NonblockingSyntaxHighlighter::sanitizeHighlightRanges()
-{
-	// 1) clip ranges
-	int n = (_parent ? _parent->characterCount() : 0);
-	for (int i = 0; i < _highlightRanges.size(); ++i) {
-		if (_highlightRanges[i].from < 0) _highlightRanges[i].from = 0;
-		if (_highlightRanges[i].to > n) _highlightRanges[i].to = n;
-	}
-
-	// 2) remove any invalid ranges
-	for (int i = _highlightRanges.size() - 1; i >= 0; --i) {
-		if (_highlightRanges[i].to <= _highlightRanges[i].from)
-			_highlightRanges.remove(i);
-	}
-	// 3) merge adjacent (or overlapping) ranges
-	// NB: There must not be any invalid ranges in here for this or else the
-	// merging algorithm would fail
-	for (int i = _highlightRanges.size() - 1; i >= 1; --i) {
-		if (_highlightRanges[i].from <= _highlightRanges[i - 1].to) {
-			if (_highlightRanges[i - 1].from > _highlightRanges[i].from)
-				_highlightRanges[i - 1].from = _highlightRanges[i].from;
-			if (_highlightRanges[i - 1].to < _highlightRanges[i].to)
-				_highlightRanges[i - 1].to = _highlightRanges[i].to;
-			_highlightRanges.remove(i);
-		}
-	}
-}
-
-
-void NonblockingSyntaxHighlighter::process()
-{
-	_processingPending = false;
-	if (!_parent)
-		return;
-
-	QTime start = QTime::currentTime();
-
-	while (start.msecsTo(QTime::currentTime()) < MAX_TIME_MSECS && hasBlocksToHighlight()) {
-		const QTextBlock & block = nextBlockToHighlight();
-		if (block.isValid()) {
-			int prevUserState = block.userState();
-			_currentBlock = block;
-			_currentFormatRanges.clear();
-			highlightBlock(block.text());
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
-			block.layout()->setAdditionalFormats(_currentFormatRanges.toList());
-#else
-			block.layout()->setFormats(_currentFormatRanges);
-#endif
-
-			// If the userState has changed, make sure the next block is rehighlighted
-			// as well
-			if (block.userState() != prevUserState)
-				pushHighlightBlock(block.next());
-			blockHighlighted(block);
-		}
-	}
-
-	// Notify the document of our changes
-	markDirtyContent();
-
-	// if there is more work, queue another round
-	if (hasBlocksToHighlight())
-		processWhenIdle();
-}
-
-void NonblockingSyntaxHighlighter::pushHighlightBlock(const QTextBlock & block)
-{
-	if (block.isValid())
-		pushHighlightRange(block.position(), block.position() + block.length());
-}
-
-void NonblockingSyntaxHighlighter::pushHighlightRange(const int from, const int to)
-{
-	int i{0};
-	range r;
-	r.from = from;
-	r.to = to;
-
-	// Find the first old range such that the start of the new range is before
-	// the end of the old range
-	for (i = 0; i < _highlightRanges.size(); ++i) {
-		if (from < _highlightRanges[i].from)
-			break;
-	}
-
-	if (i == _highlightRanges.size())
-		_highlightRanges.push_back(r);
-	else
-		_highlightRanges.insert(i, r);
-
-	sanitizeHighlightRanges();
-}
-
-void NonblockingSyntaxHighlighter::popHighlightRange(const int from, const int to)
-{
-	for (int i = _highlightRanges.size() - 1; i >= 0 && _highlightRanges[i].to > from; --i) {
-		// Case 1: crop the end of the range (or the whole range)
-		if (to >= _highlightRanges[i].to) {
-			if (from <= _highlightRanges[i].from)
-				_highlightRanges.remove(i);
-			else
-				_highlightRanges[i].to = from;
-		}
-		// Case 2: crop the middle
-		else if (from > _highlightRanges[i].from) {
-			// Split the range into two
-			range r = _highlightRanges[i];
-			_highlightRanges[i].from = to;
-			r.to = from;
-			_highlightRanges.insert(i, r);
-			--i;
-		}
-		// Case 3: crop the front of the range
-		else if (to > _highlightRanges[i].from) {
-			_highlightRanges[i].from = to;
-		}
-		// Case 4: to <= _highlightRanges[i].from
-		// no overlap => do nothing
-	}
-}
-
-void NonblockingSyntaxHighlighter::blockHighlighted(const QTextBlock &block)
-{
-	popHighlightRange(block.position(), block.position() + block.length());
-	pushDirtyRange(block);
-}
-
-const QTextBlock NonblockingSyntaxHighlighter::nextBlockToHighlight() const
-{
-	if (!_parent || _highlightRanges.empty()) return QTextBlock();
-	return _parent->findBlock(_highlightRanges[0].from);
-}
-
-void NonblockingSyntaxHighlighter::pushDirtyRange(const int from, const int length)
-{
-	// NB: we currently use (at most) one range as it seems that
-	// QTextDocument::markContentsDirty() operates not only on the given lines
-	// but also on all later lines. Thus, calling it repeatedly with adjacent
-	// lines would create a huge, unncessary overhead compared to calling it
-	// once.
-
-	int to = from + length;
-	if (_dirtyRanges.empty()) {
-		range r;
-		r.from = from;
-		r.to = to;
-		_dirtyRanges.push_back(r);
-	}
-	else {
-		if (_dirtyRanges[0].from > from) _dirtyRanges[0].from = from;
-		if (_dirtyRanges[0].to < to) _dirtyRanges[0].to = to;
-	}
-}
-
-void NonblockingSyntaxHighlighter::markDirtyContent()
-{
-	if (!_parent)
-		return;
-
-	foreach(range r, _dirtyRanges)
-		_parent->markContentsDirty(r.from, r.to - r.from);
-	_dirtyRanges.clear();
-}
-
-
-void NonblockingSyntaxHighlighter::setFormat(const int start, const int count, const QTextCharFormat & format)
-{
-	QTextLayout::FormatRange formatRange;
-	formatRange.start = start;
-	formatRange.length = count;
-	formatRange.format = format;
-	_currentFormatRanges << formatRange;
-}
-
-void NonblockingSyntaxHighlighter::processWhenIdle()
-{
-	if (!_processingPending) {
-		_processingPending = true;
-		QTimer::singleShot(IDLE_DELAY_TIME, this, SLOT(process()));
+		QList<QRegularExpression> patterns;
+		foreach (const TagPattern & patt, *tagPatterns)
+			patterns << patt.pattern;
+		tagMatcher = new Tw::Utils::MultiPatternMatcher(patterns);
 	}
 }
@@ -22,13 +22,13 @@
 #ifndef TEX_HIGHLIGHTER_H
 #define TEX_HIGHLIGHTER_H
 
+#include "NonblockingSyntaxHighlighter.h"
 #include "document/SpellChecker.h"
+#include "utils/MultiPatternMatcher.h"
 
 #include <QRegularExpression>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
-#include <QTextDocument>
-#include <QTextLayout>
 #include <QTimer>
 
 namespace Tw {
@@ -39,72 +39,13 @@ class TeXDocument;
 } // namespace Document
 } // namespace Tw
 
-// This class implements a non-blocking syntax highlighter that is a rewrite/
-// replacement of QSyntaxHighlighter. It queues all highlight requests and
-// processes them in small chunks that take no longer than MAX_TIME_MSECS
-// before returning control to the main event loop to keep the UI responsive.
-// Inspired by http://enki-editor.org/2014/08/22/Syntax_highlighting.html
-class NonblockingSyntaxHighlighter : public QObject
-{
-	Q_OBJECT
-
-public:
-	NonblockingSyntaxHighlighter(QTextDocument * parent) : QObject(parent), _processingPending(false), _parent(nullptr), MAX_TIME_MSECS(5), IDLE_DELAY_TIME(40) { setDocument(parent); }
-	~NonblockingSyntaxHighlighter() override { setDocument(nullptr); }
-
-	QTextDocument * document() const { return _parent; }
-	void setDocument(QTextDocument * doc);
-
-public slots:
-	void rehighlight();
-	void rehighlightBlock(const QTextBlock & block);
-
-protected:
-	virtual void highlightBlock(const QString & text) = 0;
-	void setFormat(const int start, const int count, const QTextCharFormat & format);
-	QTextBlock currentBlock() const { return _currentBlock; }
-	int currentBlockState() const { return _currentBlock.userState(); }
-	int previousBlockState() const { return _currentBlock.previous().userState(); }
-
-	bool hasBlocksToHighlight() const { return !_highlightRanges.empty(); }
-	const QTextBlock nextBlockToHighlight() const;
-	void pushHighlightBlock(const QTextBlock & block);
-	void pushHighlightRange(const int from, const int to);
-	void popHighlightRange(const int from, const int to);
-	void blockHighlighted(const QTextBlock & block);
-	void pushDirtyRange(const QTextBlock & block) { pushDirtyRange(block.position(), block.position() + block.length()); }
-	void pushDirtyRange(const int from, const int length);
-	void markDirtyContent();
-	void sanitizeHighlightRanges();
-
-private slots:
-	void maybeRehighlightText(int position, int charsRemoved, int charsAdded);
-	void process();
-	void processWhenIdle();
-	void unlinkFromDocument() { setDocument(nullptr); }
-
-private:
-	bool _processingPending;
-	QTextDocument * _parent;
-	int MAX_TIME_MSECS;
-	int IDLE_DELAY_TIME;
-
-	struct range {
-		int from, to; // character ranges
-	};
-	QVector<range> _highlightRanges;
-	QVector<range> _dirtyRanges;
-
-	QTextBlock _currentBlock;
-	QVector<QTextLayout::FormatRange> _currentFormatRanges;
-};
-
 class TeXHighlighter : public NonblockingSyntaxHighlighter
 {
 	Q_OBJECT
 
 public:
 	explicit TeXHighlighter(Tw::Document::TeXDocument * parent);
+	~TeXHighlighter() override { stopWorker(); }
 	void setActiveIndex(int index);
 
 	void setSpellChecker(Tw::Document::SpellChecker::Dictionary * dictionary);
@@ -119,6 +60,7 @@ public:
 
 protected:
 	void highlightBlock(const QString &text) override;
+	void applyTags(const QTextBlock & block, const QVector<Tag> & tags) override;
 
 	void spellCheckRange(const QString &text, int index, int limit, const QTextCharFormat &spellFormat);
 
@@ -135,6 +77,8 @@ private:
 	struct HighlightingSpec {
 		QString				name;
 		HighlightingRules	rules;
+		// all rule patterns combined so each block is tokenized in one pass
+		Tw::Utils::MultiPatternMatcher matcher;
 	};
 	static QList<HighlightingSpec> *syntaxRules;
 
@@ -145,6 +89,7 @@ private:
 		unsigned int level;
 	};
 	static QList<TagPattern> *tagPatterns;
+	static Tw::Utils::MultiPatternMatcher *tagMatcher;
 
 	int highlightIndex;
 	bool isTagging;
@@ -0,0 +1,324 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "document/ProjectIndex.h"
+
+#include "BibTeXFile.h"
+#include "utils/MultiPatternMatcher.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextCodec>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace Tw {
+namespace Document {
+
+namespace {
+
+// The order must match the patterns in scanTeX()
+enum TeXPattern { LabelPattern, NewCommandPattern, DefPattern, NewEnvironmentPattern, IncludePattern, BibliographyPattern };
+
+QString readTextFile(const QString & fileName)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return {};
+	const QByteArray bytes = file.readAll();
+	return QTextCodec::codecForUtfText(bytes, QTextCodec::codecForName("UTF-8"))->toUnicode(bytes);
+}
+
+// Resolves `name` the way TeX would (i.e., trying it with `suffix` appended
+// first), relative to each of `dirs` in turn
+QString resolveFile(const QString & name, const QStringList & dirs, const QString & suffix)
+{
+	QStringList candidates;
+	if (QFileInfo(name).suffix().compare(suffix, Qt::CaseInsensitive) != 0)
+		candidates << name + QChar::fromLatin1('.') + suffix;
+	candidates << name;
+	foreach (const QString & dir, dirs) {
+		foreach (const QString & candidate, candidates) {
+			const QFileInfo fi(QDir(dir).absoluteFilePath(candidate));
+			if (fi.isFile())
+				return QDir::cleanPath(fi.absoluteFilePath());
+		}
+	}
+	return {};
+}
+
+} // anonymous namespace
+
+ProjectIndex::ProjectIndex(QObject * parent /* = nullptr */)
+	: QObject(parent)
+{
+	connect(&_watcher, SIGNAL(finished()), this, SLOT(updateFinished()));
+	connect(&_fileWatcher, SIGNAL(fileChanged(QString)), this, SLOT(indexedFileChanged()));
+}
+
+ProjectIndex::~ProjectIndex()
+{
+	_canceled.store(1);
+	_watcher.waitForFinished();
+}
+
+//static
+QSharedPointer<ProjectIndex> ProjectIndex::forRootFile(const QString & rootFile)
+{
+	static QHash< QString, QWeakPointer<ProjectIndex> > indexes;
+
+	// Untitled documents are not part of any (other) project
+	const QString key = QFileInfo(rootFile).canonicalFilePath();
+	if (key.isEmpty())
+		return QSharedPointer<ProjectIndex>(new ProjectIndex());
+
+	QSharedPointer<ProjectIndex> retVal = indexes.value(key).toStrongRef();
+	if (!retVal) {
+		retVal = QSharedPointer<ProjectIndex>(new ProjectIndex(), [key](ProjectIndex * index) {
+			if (indexes.value(key).isNull())
+				indexes.remove(key);
+			delete index;
+		});
+		indexes.insert(key, retVal);
+	}
+	return retVal;
+}
+
+void ProjectIndex::update(const QString & rootFile, const QHash<QString, QString> & openDocuments)
+{
+	_rootFile = rootFile;
+	_openDocuments = openDocuments;
+	if (_watcher.isRunning()) {
+		// Only the most recent request matters
+		_updatePending = true;
+		return;
+	}
+	_watcher.setFuture(QtConcurrent::run(&ProjectIndex::index, _rootFile, _openDocuments, _files, &_canceled));
+}
+
+void ProjectIndex::updateFinished()
+{
+	if (_canceled.load() != 0)
+		return;
+
+	const Result result = _watcher.result();
+	_files = result.files;
+	const bool changed = (result.symbols != _symbols);
+	_symbols = result.symbols;
+	watchFiles();
+
+	if (_updatePending) {
+		_updatePending = false;
+		update(_rootFile, _openDocuments);
+	}
+	if (changed)
+		emit updated();
+}
+
+void ProjectIndex::watchFiles()
+{
+	QSet<QString> files;
+	for (FileCache::const_iterator it = _files.constBegin(); it != _files.constEnd(); ++it) {
+		if (it->lastModified.isValid())
+			files.insert(it.key());
+	}
+
+	QStringList obsolete, added;
+	foreach (const QString & path, _fileWatcher.files()) {
+		if (!files.remove(path))
+			obsolete << path;
+	}
+	// NB: Files that were replaced (as many editors do when saving) are
+	// dropped by QFileSystemWatcher, so they are added again here
+	foreach (const QString & path, files)
+		added << path;
+	if (!obsolete.isEmpty())
+		_fileWatcher.removePaths(obsolete);
+	if (!added.isEmpty())
+		_fileWatcher.addPaths(added);
+}
+
+//static
+void ProjectIndex::scanTeX(const QString & text, QVector<Symbol> & symbols, QStringList & includes, QStringList & bibFiles)
+{
+	static const QRegularExpression reBibModeline(QStringLiteral("^%\\s*!TEX\\s+bibfiles?\\s*=\\s*(.+)$"), QRegularExpression::CaseInsensitiveOption);
+	static const Utils::MultiPatternMatcher matcher({
+		QRegularExpression(QStringLiteral("\\\\label\\s*\\{([^{}]+)\\}")),
+		QRegularExpression(QStringLiteral("\\\\(?:(?:re)?newcommand|providecommand|DeclareRobustCommand|(?:New|Renew|Provide|Declare)DocumentCommand|DeclareMathOperator)\\*?\\s*\\{?\\s*\\\\([A-Za-z@]+)")),
+		QRegularExpression(QStringLiteral("\\\\(?:[egx]?def|let)\\s*\\\\([A-Za-z@]+)")),
+		QRegularExpression(QStringLiteral("\\\\(?:(?:re)?newenvironment|(?:New|Renew|Provide|Declare)DocumentEnvironment|newtheorem)\\*?\\s*\\{([^{}]+)\\}")),
+		QRegularExpression(QStringLiteral("\\\\(?:input|include|subfile)\\s*\\{([^{}]+)\\}")),
+		QRegularExpression(QStringLiteral("\\\\(?:bibliography|addbibresource|addglobalbib)\\s*(?:\\[[^\\]]*\\])?\\s*\\{([^{}]+)\\}"))
+	});
+
+	// Blank out comments so commented-out code is ignored; the bibfile
+	// modelines are comments, too, so pick them up on the way
+	QString code = text;
+	int lineStart = 0;
+	while (lineStart < code.length()) {
+		int lineEnd = code.indexOf(QChar::fromLatin1('\n'), lineStart);
+		if (lineEnd < 0)
+			lineEnd = code.length();
+		for (int i = lineStart; i < lineEnd; ++i) {
+			if (code[i] == QChar::fromLatin1('\\'))
+				++i;
+			else if (code[i] == QChar::fromLatin1('%')) {
+				if (i == lineStart) {
+					const QRegularExpressionMatch m = reBibModeline.match(text.mid(lineStart, lineEnd - lineStart));
+					if (m.hasMatch()) {
+						foreach (const QString & bibFile, m.captured(1).split(QChar::fromLatin1(',')))
+							bibFiles << bibFile.trimmed();
+					}
+				}
+				std::fill(code.begin() + i, code.begin() + lineEnd, QChar::fromLatin1(' '));
+				break;
+			}
+		}
+		lineStart = lineEnd + 1;
+	}
+
+	int pos = 0;
+	while (true) {
+		const Utils::MultiPatternMatcher::Match m = matcher.match(code, pos);
+		if (!m.hasMatch())
+			break;
+		pos = m.capturedEnd();
+		const QString arg = m.captured(1).trimmed();
+		switch (m.patternIndex()) {
+			case LabelPattern:
+				symbols.append({Symbol::Label, arg});
+				break;
+			case NewCommandPattern:
+			case DefPattern:
+				symbols.append({Symbol::Command, QChar::fromLatin1('\\') + arg});
+				break;
+			case NewEnvironmentPattern:
+				symbols.append({Symbol::Environment, arg});
+				break;
+			case IncludePattern:
+				includes << arg;
+				break;
+			case BibliographyPattern:
+				foreach (const QString & bibFile, arg.split(QChar::fromLatin1(',')))
+					bibFiles << bibFile.trimmed();
+				break;
+		}
+	}
+	bibFiles.removeAll(QString());
+}
+
+//static
+QVector<ProjectIndex::Symbol> ProjectIndex::scanBibTeX(const QString & fileName)
+{
+	QVector<Symbol> retVal;
+	foreach (const QString & key, BibTeXFile(fileName).keys()) {
+		if (!key.isEmpty())
+			retVal.append({Symbol::Citation, key});
+	}
+	return retVal;
+}
+
+//static
+ProjectIndex::Result ProjectIndex::index(const QString & rootFile, const QHash<QString, QString> & openDocuments, const FileCache & cache, const QAtomicInt * canceled)
+{
+	Result retVal;
+	if (rootFile.isEmpty())
+		return retVal;
+
+	QHash<QString, QString> snapshots;
+	for (QHash<QString, QString>::const_iterator it = openDocuments.constBegin(); it != openDocuments.constEnd(); ++it)
+		snapshots.insert(QDir::cleanPath(QFileInfo(it.key()).absoluteFilePath()), it.value());
+
+	const QString root = QDir::cleanPath(QFileInfo(rootFile).absoluteFilePath());
+	const QString rootDir = QFileInfo(root).absolutePath();
+	QStringList queue{root};
+	QSet<QString> seen{root};
+	QSet< QPair<int, QString> > seenSymbols;
+
+	for (int i = 0; i < queue.size() && canceled->load() == 0; ++i) {
+		const QString fileName = queue[i];
+		const bool isBibFile = fileName.endsWith(QLatin1String(".bib"), Qt::CaseInsensitive);
+		const FileCache::const_iterator cached = cache.constFind(fileName);
+		FileData data;
+
+		if (!isBibFile && snapshots.contains(fileName)) {
+			const QString & text = snapshots[fileName];
+			const uint textHash = qHash(text);
+			if (cached != cache.constEnd() && !cached->lastModified.isValid() && cached->textHash == textHash)
+				data = *cached;
+			else {
+				data.textHash = textHash;
+				scanTeX(text, data.symbols, data.includes, data.bibFiles);
+			}
+		}
+		else {
+			const QFileInfo fileInfo(fileName);
+			if (!fileInfo.isFile())
+				continue;
+			if (cached != cache.constEnd() && cached->lastModified.isValid() && cached->lastModified == fileInfo.lastModified())
+				data = *cached;
+			else {
+				data.lastModified = fileInfo.lastModified();
+				if (isBibFile)
+					data.symbols = scanBibTeX(fileName);
+				else
+					scanTeX(readTextFile(fileName), data.symbols, data.includes, data.bibFiles);
+			}
+		}
+
+		// Like TeX, resolve paths relative to the root file; modelines are
+		// typically relative to the file that contains them
+		QStringList dirs{rootDir};
+		if (QFileInfo(fileName).absolutePath() != rootDir)
+			dirs << QFileInfo(fileName).absolutePath();
+		foreach (const QString & include, data.includes) {
+			const QString path = resolveFile(include, dirs, QStringLiteral("tex"));
+			if (!path.isEmpty() && !seen.contains(path)) {
+				seen.insert(path);
+				queue << path;
+			}
+		}
+		foreach (const QString & bibFile, data.bibFiles) {
+			const QString path = resolveFile(bibFile, dirs, QStringLiteral("bib"));
+			if (!path.isEmpty() && !seen.contains(path)) {
+				seen.insert(path);
+				queue << path;
+			}
+		}
+
+		foreach (const Symbol & symbol, data.symbols) {
+			const QPair<int, QString> key(symbol.type, symbol.name);
+			if (seenSymbols.contains(key))
+				continue;
+			seenSymbols.insert(key);
+			retVal.symbols.append(symbol);
+		}
+		retVal.files.insert(fileName, data);
+	}
+	return retVal;
+}
+
+} // namespace Document
+} // namespace Tw
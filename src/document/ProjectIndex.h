@@ -0,0 +1,123 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#ifndef Document_ProjectIndex_H
+#define Document_ProjectIndex_H
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QVector>
+
+namespace Tw {
+namespace Document {
+
+// Collects the symbols of a TeX project that are useful for completion: the
+// labels, the macros and environments defined in the root file and all files
+// included from it (\input, \include), and the keys of the BibTeX databases
+// it uses (\bibliography, \addbibresource, or the %!TEX bibfile modeline).
+// Indexing runs in the background; open documents are indexed from the text
+// snapshots passed to update() so unsaved changes are taken into account.
+// Files are only read again if they changed since the last update, so
+// updating is cheap even for large projects. The indexed files are watched,
+// so changes made outside of the editor (e.g., to a .bib file) are picked up
+// as well.
+class ProjectIndex : public QObject
+{
+	Q_OBJECT
+public:
+	struct Symbol {
+		enum Type { Label, Command, Environment, Citation };
+		Type type;
+		QString name;
+
+		bool operator==(const Symbol & other) const { return type == other.type && name == other.name; }
+	};
+
+	explicit ProjectIndex(QObject * parent = nullptr);
+	~ProjectIndex() override;
+
+	// Returns the index for the project with the given root file. Documents
+	// of the same project (as identified by the canonical path of the root
+	// file) share one index; it is deleted along with the last reference.
+	static QSharedPointer<ProjectIndex> forRootFile(const QString & rootFile);
+
+	// `openDocuments` maps file names to the (current) text of documents that
+	// are open in an editor. If an update is already running, the new one is
+	// started as soon as that has finished.
+	void update(const QString & rootFile, const QHash<QString, QString> & openDocuments);
+	bool isUpdating() const { return _watcher.isRunning(); }
+
+	// Symbols found by the last update (duplicates removed), in the order in
+	// which they appear in the project
+	const QVector<Symbol> & symbols() const { return _symbols; }
+	int numFilesIndexed() const { return _files.size(); }
+
+	// Extracts the symbols defined in TeX code as well as the files it
+	// includes and the bibliographies it uses (as given in the code, i.e.,
+	// typically without path or suffix)
+	static void scanTeX(const QString & text, QVector<Symbol> & symbols, QStringList & includes, QStringList & bibFiles);
+	static QVector<Symbol> scanBibTeX(const QString & fileName);
+
+signals:
+	void updated();
+
+private slots:
+	void updateFinished();
+	void indexedFileChanged() { update(_rootFile, _openDocuments); }
+
+private:
+	struct FileData {
+		QDateTime lastModified; // invalid for text snapshots of open documents
+		uint textHash{0};
+		QVector<Symbol> symbols;
+		QStringList includes;
+		QStringList bibFiles;
+	};
+	typedef QHash<QString, FileData> FileCache;
+	struct Result {
+		FileCache files;
+		QVector<Symbol> symbols;
+	};
+
+	static Result index(const QString & rootFile, const QHash<QString, QString> & openDocuments, const FileCache & cache, const QAtomicInt * canceled);
+	void watchFiles();
+
+	QFutureWatcher<Result> _watcher;
+	QAtomicInt _canceled{0};
+	FileCache _files;
+	QVector<Symbol> _symbols;
+	QFileSystemWatcher _fileWatcher;
+
+	// The most recent request
+	QString _rootFile;
+	QHash<QString, QString> _openDocuments;
+	bool _updatePending{false};
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_ProjectIndex_H)
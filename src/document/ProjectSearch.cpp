@@ -0,0 +1,217 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "document/ProjectSearch.h"
+
+#include "document/TextSearch.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextCodec>
+#include <QtConcurrent>
+#include <limits>
+
+namespace Tw {
+namespace Document {
+
+ProjectSearch::ProjectSearch(const QString & searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags, QObject * parent /* = nullptr */)
+	: QObject(parent)
+	, _searchText(searchText)
+	, _useRegex(regex != nullptr)
+	, _flags(flags & ~QTextDocument::FindBackward)
+{
+	if (regex)
+		_regex = *regex;
+	qRegisterMetaType< QVector<Tw::Document::ProjectSearch::Hit> >();
+}
+
+ProjectSearch::~ProjectSearch()
+{
+	cancel();
+	_pool.waitForDone();
+}
+
+//static
+const QStringList & ProjectSearch::fileSuffixes()
+{
+	static const QStringList suffixes{
+		QStringLiteral("tex"), QStringLiteral("ltx"), QStringLiteral("bib"),
+		QStringLiteral("sty"), QStringLiteral("cls"), QStringLiteral("dtx")
+	};
+	return suffixes;
+}
+
+void ProjectSearch::start(const QString & rootFile, const QVector<OpenDocument> & openDocuments, QTextCodec * defaultCodec)
+{
+	// Hold a reference while scheduling so finished() cannot be emitted before
+	// all initial tasks are queued
+	_pending.ref();
+
+	_codec = (defaultCodec ? defaultCodec : QTextCodec::codecForName("UTF-8"));
+	if (!rootFile.isEmpty())
+		_rootDir = QFileInfo(rootFile).absolutePath();
+
+	foreach (const OpenDocument & doc, openDocuments) {
+		// Untitled documents can't be reached from other files (nor be listed
+		// twice), so they need not be marked
+		if (!doc.fileName.isEmpty() && !markSeen(doc.fileName))
+			continue;
+		_pending.ref();
+		QtConcurrent::run(&_pool, this, &ProjectSearch::searchText, doc.fileName, doc.document, doc.text);
+	}
+
+	if (!_rootDir.isEmpty()) {
+		// The root file may not be in the directory tree if it does not have
+		// one of the standard suffixes
+		schedule(QFileInfo(rootFile).absoluteFilePath());
+		_pending.ref();
+		QtConcurrent::run(&_pool, this, &ProjectSearch::walkDirectory, _rootDir);
+	}
+
+	taskDone();
+}
+
+void ProjectSearch::cancel()
+{
+	// Note: Tasks that are still queued return immediately once they run so
+	// that finished() is emitted as usual
+	_canceled.store(1);
+}
+
+void ProjectSearch::walkDirectory(const QString & dir)
+{
+	QStringList nameFilters;
+	foreach (const QString & suffix, fileSuffixes())
+		nameFilters << QStringLiteral("*.") + suffix;
+
+	QDirIterator it(dir, nameFilters, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+	while (!wasCanceled() && it.hasNext())
+		schedule(it.next());
+	taskDone();
+}
+
+void ProjectSearch::searchFile(const QString & fileName)
+{
+	if (wasCanceled()) {
+		taskDone();
+		return;
+	}
+
+	QString text;
+	QFile file(fileName);
+	if (file.open(QIODevice::ReadOnly) && file.size() > 0 && file.size() < std::numeric_limits<int>::max()) {
+		const int size = static_cast<int>(file.size());
+		// Map the file rather than reading it into a buffer of our own; the
+		// pages are only touched once by decoding anyway
+		uchar * data = file.map(0, size);
+		const QByteArray bytes = (data ? QByteArray::fromRawData(reinterpret_cast<const char *>(data), size) : file.readAll());
+		text = QTextCodec::codecForUtfText(bytes, _codec)->toUnicode(bytes);
+		if (data)
+			file.unmap(data);
+
+		// Normalize line endings the same way TeXDocumentWindow::loadFile()
+		// does so that line and column numbers match those in the editor
+		if (text.contains(QChar::fromLatin1('\r'))) {
+			text.replace(QLatin1String("\r\n"), QChar::fromLatin1('\n'));
+			text.replace(QChar::fromLatin1('\r'), QChar::fromLatin1('\n'));
+		}
+	}
+	file.close();
+	searchText(fileName, nullptr, text);
+}
+
+void ProjectSearch::searchText(const QString & fileName, QTextDocument * document, const QString & text)
+{
+	if (wasCanceled()) {
+		taskDone();
+		return;
+	}
+
+	// Follow \input and \include to files outside the directory tree
+	if (!_rootDir.isEmpty() && !fileName.isEmpty() && QFileInfo(fileName).suffix() != QLatin1String("bib")) {
+		const QRegularExpression reInclude(QStringLiteral("\\\\(?:input|include)\\s*\\{([^}]+)\\}"));
+		const QDir rootDir(_rootDir);
+		QRegularExpressionMatchIterator it = reInclude.globalMatch(text);
+		while (!wasCanceled() && it.hasNext()) {
+			const QString path = rootDir.absoluteFilePath(it.next().captured(1).trimmed());
+			// Like TeX, try the name with .tex appended first
+			if (QFileInfo(path + QStringLiteral(".tex")).isFile())
+				schedule(path + QStringLiteral(".tex"));
+			else if (QFileInfo(path).isFile())
+				schedule(path);
+		}
+	}
+
+	const TextSearch search(text, _searchText, (_useRegex ? &_regex : nullptr), _flags);
+	QVector<Hit> hits;
+	int lineNo = 1, lineStart = 0, pos = 0;
+	foreach (const TextSearch::Match & match, search.findAll(0, text.length())) {
+		// The matches are in document order, so the line numbers can be
+		// computed incrementally
+		for (; pos < match.start; ++pos) {
+			if (text[pos] == QChar::fromLatin1('\n')) {
+				++lineNo;
+				lineStart = pos + 1;
+			}
+		}
+		int lineEnd = text.indexOf(QChar::fromLatin1('\n'), lineStart);
+		if (lineEnd < 0)
+			lineEnd = text.length();
+		hits.append({lineNo, match.start - lineStart, match.end - lineStart, text.mid(lineStart, lineEnd - lineStart)});
+	}
+	_numFilesSearched.ref();
+
+	if (!hits.isEmpty() && !wasCanceled())
+		emit resultsFound(fileName, document, hits);
+	taskDone();
+}
+
+bool ProjectSearch::markSeen(const QString & fileName)
+{
+	// Note: Files that don't exist (anymore), e.g., open documents that were
+	// deleted on disk, have no canonical path
+	const QString canonicalPath = QFileInfo(fileName).canonicalFilePath();
+	const QString key = (canonicalPath.isEmpty() ? QFileInfo(fileName).absoluteFilePath() : canonicalPath);
+	QMutexLocker l(&_seenMutex);
+	if (_seen.contains(key))
+		return false;
+	_seen.insert(key);
+	return true;
+}
+
+void ProjectSearch::schedule(const QString & fileName)
+{
+	if (wasCanceled() || !markSeen(fileName))
+		return;
+	_pending.ref();
+	QtConcurrent::run(&_pool, this, &ProjectSearch::searchFile, fileName);
+}
+
+void ProjectSearch::taskDone()
+{
+	if (!_pending.deref())
+		emit finished();
+}
+
+} // namespace Document
+} // namespace Tw
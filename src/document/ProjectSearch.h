@@ -0,0 +1,121 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#ifndef Document_ProjectSearch_H
+#define Document_ProjectSearch_H
+
+#include <QAtomicInt>
+#include <QMetaType>
+#include <QMutex>
+#include <QObject>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextDocument>
+#include <QThreadPool>
+#include <QVector>
+
+class QTextCodec;
+
+namespace Tw {
+namespace Document {
+
+// Searches all files of a TeX project in the background: the files in the
+// root file's directory tree (see fileSuffixes()), all files that are
+// included from those (\input, \include) even if they are located elsewhere,
+// and all documents that are currently open. Open documents are searched
+// using the text snapshots passed to start() (so unsaved changes are taken
+// into account) instead of their file on disk; they are identified by their
+// QTextDocument (which is the only way to identify untitled documents).
+// The files are read using memory mapping and searched on a thread pool of
+// their own; the results are reported per file by resultsFound() as soon as
+// they are available. The search can be canceled at any time; it is canceled
+// automatically when the ProjectSearch is destroyed.
+class ProjectSearch : public QObject
+{
+	Q_OBJECT
+public:
+	struct Hit {
+		int lineNo;
+		int selStart;
+		int selEnd;
+		QString lineText;
+	};
+
+	// A document that is open in an editor; `fileName` is empty for untitled
+	// documents
+	struct OpenDocument {
+		QTextDocument * document;
+		QString fileName;
+		QString text;
+	};
+
+	ProjectSearch(const QString & searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags, QObject * parent = nullptr);
+	~ProjectSearch() override;
+
+	void start(const QString & rootFile, const QVector<OpenDocument> & openDocuments, QTextCodec * defaultCodec);
+	bool isRunning() const { return _pending.load() > 0; }
+	bool wasCanceled() const { return _canceled.load() != 0; }
+	int numFilesSearched() const { return _numFilesSearched.load(); }
+
+	static const QStringList & fileSuffixes();
+
+public slots:
+	void cancel();
+
+signals:
+	// Note: These signals are emitted from worker threads
+	// `document` is the open document the hits were found in (nullptr if they
+	// were found in a file on disk); `fileName` is empty for untitled documents
+	void resultsFound(const QString & fileName, QTextDocument * document, const QVector<Tw::Document::ProjectSearch::Hit> & hits);
+	void finished();
+
+private:
+	void walkDirectory(const QString & dir);
+	void searchFile(const QString & fileName);
+	void searchText(const QString & fileName, QTextDocument * document, const QString & text);
+	// Returns true if `fileName` had not been scheduled for searching before
+	bool markSeen(const QString & fileName);
+	void schedule(const QString & fileName);
+	void taskDone();
+
+	QString _searchText;
+	QRegularExpression _regex;
+	bool _useRegex{false};
+	QTextDocument::FindFlags _flags;
+
+	QString _rootDir;
+	QTextCodec * _codec{nullptr};
+
+	QThreadPool _pool;
+	QAtomicInt _pending{0};
+	QAtomicInt _canceled{0};
+	QAtomicInt _numFilesSearched{0};
+
+	QMutex _seenMutex;
+	QSet<QString> _seen;
+};
+
+} // namespace Document
+} // namespace Tw
+
+Q_DECLARE_METATYPE(Tw::Document::ProjectSearch::Hit)
+Q_DECLARE_METATYPE(QVector<Tw::Document::ProjectSearch::Hit>)
+
+#endif // !defined(Document_ProjectSearch_H)
@@ -23,13 +23,21 @@
 
 #include "TWUtils.h" // for TWUtils::getLibraryPath
 
+#include <QFileSystemWatcher>
+#include <QtConcurrent>
 #include <hunspell.h>
 
 namespace Tw {
 namespace Document {
 
+// The cache is simply cleared when it grows beyond this size (it is refilled
+// quickly by the words that actually occur in the open documents)
+const int kMaxCachedVerdicts = 100000;
+
 QMultiHash<QString, QString> * SpellChecker::dictionaryList = nullptr;
 QHash<const QString,SpellChecker::Dictionary*> * SpellChecker::dictionaries = nullptr;
+QHash<QString, SpellChecker::Loader> * SpellChecker::loaders = nullptr;
+QFileSystemWatcher * SpellChecker::dictionaryDirWatcher = nullptr;
 SpellChecker * SpellChecker::_instance = new SpellChecker();
 
 // static
@@ -52,39 +60,144 @@ QMultiHash<QString, QString> * SpellChecker::getDictionaryList(const bool forceR
 		}
 	}
 
+	// Keep the list until dictionaries are added to or removed from one of
+	// the directories (instead of rescanning them on every request)
+	if (!dictionaryDirWatcher && QCoreApplication::instance()) {
+		dictionaryDirWatcher = new QFileSystemWatcher(SpellChecker::instance());
+		connect(dictionaryDirWatcher, &QFileSystemWatcher::directoryChanged, SpellChecker::instance(), []() { getDictionaryList(true); });
+	}
+	if (dictionaryDirWatcher) {
+		if (!dictionaryDirWatcher->directories().isEmpty())
+			dictionaryDirWatcher->removePaths(dictionaryDirWatcher->directories());
+		foreach (const QString & dir, dirs) {
+			if (QFileInfo(dir).isDir())
+				dictionaryDirWatcher->addPath(dir);
+		}
+	}
+
 	emit SpellChecker::instance()->dictionaryListChanged();
 	return dictionaryList;
 }
 
 // static
 SpellChecker::Dictionary * SpellChecker::getDictionary(const QString& language)
+{
+	Dictionary * d = requestDictionary(language);
+	if (d || !loaders)
+		return d;
+
+	for (QHash<QString, Loader>::const_iterator it = loaders->constBegin(); it != loaders->constEnd(); ++it) {
+		if (it.value().languages.contains(language)) {
+			const QString dicPath = it.key();
+			it.value().watcher->waitForFinished();
+			// Don't wait for the event loop to deliver the finished() signal
+			engineLoaded(dicPath);
+			break;
+		}
+	}
+	return (dictionaries ? dictionaries->value(language) : nullptr);
+}
+
+// static
+SpellChecker::Dictionary * SpellChecker::requestDictionary(const QString & language)
 {
 	if (language.isEmpty())
 		return nullptr;
 
 	if (!dictionaries)
 		dictionaries = new QHash<const QString, Dictionary*>;
+	if (!loaders)
+		loaders = new QHash<QString, Loader>;
 
 	if (dictionaries->contains(language))
 		return dictionaries->value(language);
+	if (isLoading(language))
+		return nullptr;
 
 	const QStringList dirs = TWUtils::getLibraryPaths(QStringLiteral("dictionaries"));
 	foreach (QDir dicDir, dirs) {
 		QFileInfo affFile(dicDir, language + QLatin1String(".aff"));
 		QFileInfo dicFile(dicDir, language + QLatin1String(".dic"));
-		if (affFile.isReadable() && dicFile.isReadable()) {
-			Hunhandle * h = Hunspell_create(affFile.canonicalFilePath().toLocal8Bit().data(),
-								dicFile.canonicalFilePath().toLocal8Bit().data());
-			dictionaries->insert(language, new Dictionary(language, h));
-			return dictionaries->value(language);
+		if (!affFile.isReadable() || !dicFile.isReadable())
+			continue;
+
+		const QString dicPath = dicFile.canonicalFilePath();
+		// Aliases (e.g., symlinks) of a language share the Hunspell instance
+		foreach (Dictionary * d, *dictionaries) {
+			if (d->_engine->dicPath == dicPath) {
+				dictionaries->insert(language, new Dictionary(language, d->_engine));
+				return dictionaries->value(language);
+			}
+		}
+		if (loaders->contains(dicPath)) {
+			(*loaders)[dicPath].languages.append(language);
+			return nullptr;
 		}
+
+		// Creating a Hunspell instance for a large dictionary can take quite
+		// some time, so do it in the background
+		Loader loader;
+		loader.watcher = new QFutureWatcher<Dictionary::Engine*>();
+		loader.languages.append(language);
+		connect(loader.watcher, &QFutureWatcherBase::finished, SpellChecker::instance(), [dicPath]() { engineLoaded(dicPath); });
+		loader.watcher->setFuture(QtConcurrent::run(&SpellChecker::loadEngine, affFile.canonicalFilePath(), dicPath));
+		loaders->insert(dicPath, loader);
+		return nullptr;
 	}
 	return nullptr;
 }
 
+// static
+bool SpellChecker::isLoading(const QString & language)
+{
+	if (!loaders)
+		return false;
+	foreach (const Loader & loader, *loaders) {
+		if (loader.languages.contains(language))
+			return true;
+	}
+	return false;
+}
+
+// static
+SpellChecker::Dictionary::Engine * SpellChecker::loadEngine(const QString & affPath, const QString & dicPath)
+{
+	return new Dictionary::Engine(Hunspell_create(affPath.toLocal8Bit().data(), dicPath.toLocal8Bit().data()), dicPath);
+}
+
+// static
+void SpellChecker::engineLoaded(const QString & dicPath)
+{
+	// NB: The engine may have been handled already by getDictionary() or
+	// clearDictionaries()
+	if (!loaders || !loaders->contains(dicPath))
+		return;
+
+	const Loader loader = loaders->take(dicPath);
+	QSharedPointer<Dictionary::Engine> engine(loader.watcher->result());
+	loader.watcher->disconnect();
+	loader.watcher->deleteLater();
+
+	foreach (const QString & language, loader.languages)
+		dictionaries->insert(language, new Dictionary(language, engine));
+	foreach (const QString & language, loader.languages)
+		emit SpellChecker::instance()->dictionaryLoaded(language);
+}
+
 // static
 void SpellChecker::clearDictionaries()
 {
+	if (loaders) {
+		foreach (const Loader & loader, *loaders) {
+			loader.watcher->disconnect();
+			loader.watcher->waitForFinished();
+			delete loader.watcher->result();
+			delete loader.watcher;
+		}
+		delete loaders;
+		loaders = nullptr;
+	}
+
 	if (!dictionaries)
 		return;
 
@@ -95,26 +208,47 @@ void SpellChecker::clearDictionaries()
 	dictionaries = nullptr;
 }
 
-SpellChecker::Dictionary::Dictionary(const QString & language, Hunhandle * hunhandle)
-	: _language(language)
-	, _hunhandle(hunhandle)
-	, _codec(nullptr)
+SpellChecker::Dictionary::Engine::Engine(Hunhandle * hunhandle, const QString & dicPath)
+	: hunhandle(hunhandle)
+	, dicPath(dicPath)
+{
+	if (hunhandle)
+		codec = QTextCodec::codecForName(Hunspell_get_dic_encoding(hunhandle));
+	if (!codec)
+		codec = QTextCodec::codecForLocale(); // almost certainly wrong, if we couldn't find the actual name!
+}
+
+SpellChecker::Dictionary::Engine::~Engine()
 {
-	if (_hunhandle)
-		_codec = QTextCodec::codecForName(Hunspell_get_dic_encoding(_hunhandle));
-	if (!_codec)
-		_codec = QTextCodec::codecForLocale(); // almost certainly wrong, if we couldn't find the actual name!
+	if (hunhandle)
+		Hunspell_destroy(hunhandle);
 }
 
-SpellChecker::Dictionary::~Dictionary()
+SpellChecker::Dictionary::Dictionary(const QString & language, const QSharedPointer<Engine> & engine)
+	: _language(language)
+	, _engine(engine)
 {
-	if (_hunhandle)
-		Hunspell_destroy(_hunhandle);
 }
 
+SpellChecker::Dictionary::~Dictionary() = default;
+
 bool SpellChecker::Dictionary::isWordCorrect(const QString & word) const
 {
-	return (Hunspell_spell(_hunhandle, _codec->fromUnicode(word).data()) != 0);
+	{
+		QReadLocker l(&_engine->cacheLock);
+		QHash<QString, bool>::const_iterator it = _engine->cache.constFind(word);
+		if (it != _engine->cache.constEnd())
+			return it.value();
+	}
+
+	QMutexLocker l(&_engine->mutex);
+	const bool correct = (Hunspell_spell(_engine->hunhandle, _engine->codec->fromUnicode(word).data()) != 0);
+
+	QWriteLocker cacheLocker(&_engine->cacheLock);
+	if (_engine->cache.size() >= kMaxCachedVerdicts)
+		_engine->cache.clear();
+	_engine->cache.insert(word, correct);
+	return correct;
 }
 
 QList<QString> SpellChecker::Dictionary::suggestionsForWord(const QString & word) const
@@ -122,12 +256,13 @@ QList<QString> SpellChecker::Dictionary::suggestionsForWord(const QString & word
 	QList<QString> suggestions;
 	char ** suggestionList{nullptr};
 
-	int numSuggestions = Hunspell_suggest(_hunhandle, &suggestionList, _codec->fromUnicode(word).data());
+	QMutexLocker l(&_engine->mutex);
+	int numSuggestions = Hunspell_suggest(_engine->hunhandle, &suggestionList, _engine->codec->fromUnicode(word).data());
 	suggestions.reserve(numSuggestions);
 	for (int iSuggestion = 0; iSuggestion < numSuggestions; ++iSuggestion)
-		suggestions.append(_codec->toUnicode(suggestionList[iSuggestion]));
+		suggestions.append(_engine->codec->toUnicode(suggestionList[iSuggestion]));
 
-	Hunspell_free_list(_hunhandle, &suggestionList, numSuggestions);
+	Hunspell_free_list(_engine->hunhandle, &suggestionList, numSuggestions);
 
 	return suggestions;
 }
@@ -135,7 +270,13 @@ QList<QString> SpellChecker::Dictionary::suggestionsForWord(const QString & word
 void SpellChecker::Dictionary::ignoreWord(const QString & word)
 {
 	// note that this is not persistent after quitting TW
-	Hunspell_add(_hunhandle, _codec->fromUnicode(word).data());
+	QMutexLocker l(&_engine->mutex);
+	Hunspell_add(_engine->hunhandle, _engine->codec->fromUnicode(word).data());
+
+	// Hunspell also accepts variants of the word now (e.g., capitalized ones),
+	// so we cannot simply update the verdict for `word`
+	QWriteLocker cacheLocker(&_engine->cacheLock);
+	_engine->cache.clear();
 }
 
 } // namespace Document
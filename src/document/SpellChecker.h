@@ -21,10 +21,16 @@
 #ifndef SpellChecker_H
 #define SpellChecker_H
 
+#include <QFutureWatcher>
 #include <QHash>
+#include <QMutex>
 #include <QObject>
+#include <QReadWriteLock>
+#include <QSharedPointer>
+#include <QStringList>
 #include <QTextCodec>
 
+class QFileSystemWatcher;
 struct Hunhandle;
 
 namespace Tw {
@@ -42,11 +48,30 @@ public:
 	class Dictionary {
 		friend class SpellChecker;
 
+		// A Hunspell instance; it is shared by all dictionaries using the same
+		// files (i.e., all aliases of a language)
+		struct Engine {
+			Engine(Hunhandle * hunhandle, const QString & dicPath);
+			~Engine();
+
+			Hunhandle * hunhandle;
+			QString dicPath;
+			QTextCodec * codec{nullptr};
+			// Hunspell is not thread-safe, but dictionaries are used from the
+			// syntax highlighter's worker thread as well as from the GUI thread
+			QMutex mutex;
+			// Verdicts of isWordCorrect(); most words occur many times in a
+			// document, and every rehighlight checks them again. Only modified
+			// while `mutex` is held so entries cannot be outdated by
+			// ignoreWord()
+			QReadWriteLock cacheLock;
+			QHash<QString, bool> cache;
+		};
+
 		QString _language;
-		Hunhandle * _hunhandle;
-		QTextCodec * _codec;
+		QSharedPointer<Engine> _engine;
 
-		Dictionary(const QString & language, Hunhandle * hunhandle);
+		Dictionary(const QString & language, const QSharedPointer<Engine> & engine);
 	public:
 		virtual ~Dictionary();
 		QString getLanguage() const { return _language; }
@@ -58,11 +83,17 @@ public:
 
 	static SpellChecker * instance() { return _instance; }
 
-	// get list of available dictionaries
+	// get list of available dictionaries; the list is reloaded automatically
+	// when the dictionary directories change
 	static QMultiHash<QString, QString> * getDictionaryList(const bool forceReload = false);
 
-	// get dictionary for a given language
+	// get dictionary for a given language; blocks until it is loaded
 	static Dictionary * getDictionary(const QString& language);
+	// returns the dictionary for a given language if it is loaded already;
+	// otherwise, starts loading it in the background and returns nullptr
+	// (dictionaryLoaded() is emitted once it is available)
+	static Dictionary * requestDictionary(const QString & language);
+	static bool isLoading(const QString & language);
 	// deallocates all dictionaries
 	// WARNING: Don't call this while some window is using a dictionary as that
 	// window won't be notified; deactivate spell checking in all windows first
@@ -73,11 +104,27 @@ signals:
 	// emitted when getDictionaryList reloads the dictionary list;
 	// windows can connect to it to rebuild, e.g., a spellchecking menu
 	void dictionaryListChanged() const;
+	// emitted when a dictionary requested by requestDictionary() has been
+	// loaded
+	void dictionaryLoaded(const QString & language) const;
 
 private:
+	// Runs on a worker thread
+	static Dictionary::Engine * loadEngine(const QString & affPath, const QString & dicPath);
+	static void engineLoaded(const QString & dicPath);
+
+	struct Loader {
+		QFutureWatcher<Dictionary::Engine*> * watcher;
+		// all languages (aliases) waiting for this engine
+		QStringList languages;
+	};
+
 	static SpellChecker * _instance;
 	static QMultiHash<QString, QString> * dictionaryList;
 	static QHash<const QString,SpellChecker::Dictionary*> * dictionaries;
+	// engines being loaded by the canonical path of their .dic file
+	static QHash<QString, Loader> * loaders;
+	static QFileSystemWatcher * dictionaryDirWatcher;
 };
 
 } // namespace Document
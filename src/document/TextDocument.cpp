@@ -21,6 +21,8 @@
 
 #include "document/TextDocument.h"
 
+#include <algorithm>
+
 namespace Tw {
 namespace Document {
 
@@ -30,36 +32,59 @@ TextDocument::TextDocument(const QString & text, QObject * parent) : QTextDocume
 
 void TextDocument::addTag(const QTextCursor & cursor, const unsigned int level, const QString & text)
 {
-	QList<Tag>::iterator it;
-
-	for (it = _tags.begin(); it != _tags.end(); ++it) {
-		if (it->cursor.selectionStart() > cursor.selectionStart())
-			break;
-	}
-	_tags.insert(it, {cursor, level, text});
-	emit tagsChanged();
+	// Insert after all tags that start at the same position
+	const int index = firstTagAt(cursor.selectionStart() + 1);
+	_tags.insert(index, {cursor, level, text});
+	emit tagsChanged(index, 0, 1);
 }
 
 unsigned int TextDocument::removeTags(int offset, int len)
 {
-	unsigned int removed = 0;
-	QList<Tag>::iterator start, end;
+	const int start = firstTagAt(offset);
+	const int end = firstTagAt(offset + len);
+	if (end <= start)
+		return 0;
+	_tags.erase(_tags.begin() + start, _tags.begin() + end);
+	emit tagsChanged(start, end - start, 0);
+	return static_cast<unsigned int>(end - start);
+}
 
-	for (start = _tags.begin(); start != _tags.end(); ++start) {
-		if (start->cursor.selectionStart() >= offset)
-			break;
-	}
-	for (end = start; end != _tags.end(); ++end) {
-		if (end->cursor.selectionStart() < offset + len)
-			++removed;
-		else
-			break;
+unsigned int TextDocument::replaceTags(int offset, int len, const QList<Tag> & tags)
+{
+	const int start = firstTagAt(offset);
+	const int end = firstTagAt(offset + len);
+	const int removed = end - start;
+
+	// Typically, the tags of a line are the same before and after an edit
+	if (removed == tags.size()) {
+		bool unchanged = true;
+		for (int i = 0; i < removed && unchanged; ++i) {
+			const Tag & t = _tags[start + i];
+			unchanged = (t.cursor.selectionStart() == tags[i].cursor.selectionStart() &&
+						 t.cursor.selectionEnd() == tags[i].cursor.selectionEnd() &&
+						 t.level == tags[i].level && t.text == tags[i].text);
+		}
+		if (unchanged)
+			return 0;
+		for (int i = 0; i < removed; ++i)
+			_tags[start + i] = tags[i];
 	}
-	if (removed > 0) {
-		_tags.erase(start, end);
-		emit tagsChanged();
+	else {
+		_tags.erase(_tags.begin() + start, _tags.begin() + end);
+		for (int i = 0; i < tags.size(); ++i)
+			_tags.insert(start + i, tags[i]);
 	}
-	return removed;
+	emit tagsChanged(start, removed, tags.size());
+	return static_cast<unsigned int>(removed);
+}
+
+int TextDocument::firstTagAt(const int position) const
+{
+	// Binary search; the tags are sorted by their start position
+	const QList<Tag>::const_iterator it = std::lower_bound(_tags.begin(), _tags.end(), position, [](const Tag & tag, const int pos) {
+		return tag.cursor.selectionStart() < pos;
+	});
+	return static_cast<int>(it - _tags.begin());
 }
 
 } // namespace Document
@@ -42,14 +42,26 @@ public:
 	explicit TextDocument(QObject * parent = nullptr);
 	explicit TextDocument(const QString & text, QObject * parent = nullptr);
 
+	// Tags are kept sorted by their (start) position; as the cursors move
+	// along with the text, the order is maintained under editing
 	const QList<Tag> & getTags() const { return _tags; }
 	void addTag(const QTextCursor & cursor, const unsigned int level, const QString & text);
 	unsigned int removeTags(int offset, int len);
+	// Replaces the tags starting in [offset, offset + len) by `tags` (which
+	// must be sorted and start in the same range). This is equivalent to
+	// removeTags() followed by addTag() for each new tag but results in only
+	// one (or no, if nothing changed) tagsChanged() notification.
+	unsigned int replaceTags(int offset, int len, const QList<Tag> & tags);
 
 signals:
-	void tagsChanged() const;
+	// Emitted when the `removed` tags starting at `index` in getTags() have
+	// been replaced by `added` tags
+	void tagsChanged(int index, int removed, int added) const;
 
 protected:
+	// Returns the index of the first tag starting at or after `position`
+	int firstTagAt(const int position) const;
+
 	QList<Tag> _tags;
 };
 
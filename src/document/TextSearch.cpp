@@ -0,0 +1,230 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "document/TextSearch.h"
+
+#include <QTextCursor>
+
+namespace Tw {
+namespace Document {
+
+TextSearch::TextSearch(const QTextDocument * doc, const QString & searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags)
+	: TextSearch(doc ? doc->toPlainText() : QString(), searchText, regex, flags)
+{
+}
+
+TextSearch::TextSearch(const QString & text, const QString & searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags)
+	: _text(text)
+	, _searchText(searchText)
+	, _useRegex(regex != nullptr)
+	, _flags(flags)
+{
+	if (regex)
+		_regex = *regex;
+}
+
+TextSearch::Match TextSearch::find(int rangeStart, int rangeEnd) const
+{
+	rangeStart = qMax(0, rangeStart);
+	rangeEnd = qMin(_text.length(), rangeEnd);
+	if (rangeStart > rangeEnd)
+		return {};
+
+	const bool backward = ((_flags & QTextDocument::FindBackward) != 0);
+	if (_useRegex)
+		return findRegex(rangeStart, rangeEnd, backward);
+	return findPlain(rangeStart, rangeEnd, backward);
+}
+
+QVector<TextSearch::Match> TextSearch::findAll(int rangeStart, int rangeEnd) const
+{
+	QVector<Match> retVal;
+
+	rangeStart = qMax(0, rangeStart);
+	rangeEnd = qMin(_text.length(), rangeEnd);
+	if (rangeStart > rangeEnd)
+		return retVal;
+
+	if (_useRegex) {
+		// globalMatch() takes care of advancing past empty matches
+		QRegularExpressionMatchIterator it = _regex.globalMatch(_text, rangeStart);
+		while (it.hasNext()) {
+			QRegularExpressionMatch m = it.next();
+			// Subsequent matches cannot end before this one, so we can stop
+			if (m.capturedEnd() > rangeEnd)
+				break;
+			retVal.append({m.capturedStart(), m.capturedEnd(), m});
+		}
+	}
+	else {
+		while (true) {
+			Match m = findPlain(rangeStart, rangeEnd, false);
+			if (!m.isValid())
+				break;
+			retVal.append(m);
+			rangeStart = m.end;
+		}
+	}
+	return retVal;
+}
+
+QString TextSearch::replacementText(const Match & match, const QString & replacement) const
+{
+	if (!_useRegex || !match.regexMatch.hasMatch())
+		return replacement;
+
+	// Expand back references the same way QString::replace() does
+	const int numCaptures = _regex.captureCount();
+	QString retVal;
+	retVal.reserve(replacement.length());
+	for (int i = 0; i < replacement.length(); ++i) {
+		if (replacement[i] == QChar::fromLatin1('\\') && i + 1 < replacement.length()) {
+			int no = replacement[i + 1].digitValue();
+			if (no > 0 && no <= numCaptures) {
+				int len = 2;
+				if (i + 2 < replacement.length()) {
+					const int secondDigit = replacement[i + 2].digitValue();
+					if (secondDigit != -1 && no * 10 + secondDigit <= numCaptures) {
+						no = no * 10 + secondDigit;
+						++len;
+					}
+				}
+				retVal += match.regexMatch.captured(no);
+				i += len - 1;
+				continue;
+			}
+		}
+		retVal += replacement[i];
+	}
+	return retVal;
+}
+
+int TextSearch::replaceAll(QTextDocument * doc, const QString & replacement, int rangeStart, int rangeEnd, int * replacedEnd /* = nullptr */) const
+{
+	if (!doc)
+		return 0;
+
+	const QVector<Match> matches = findAll(rangeStart, rangeEnd);
+	if (matches.isEmpty())
+		return 0;
+
+	QTextCursor curs(doc);
+	int delta = 0;
+	curs.beginEditBlock();
+	// Replace from the back so the positions of the remaining matches (which
+	// refer to the snapshot) stay valid
+	for (int i = matches.size() - 1; i >= 0; --i) {
+		const Match & m = matches[i];
+		const QString target = replacementText(m, replacement);
+		curs.setPosition(m.start);
+		curs.setPosition(m.end, QTextCursor::KeepAnchor);
+		curs.insertText(target);
+		delta += target.length() - m.length();
+	}
+	curs.endEditBlock();
+
+	if (replacedEnd)
+		*replacedEnd = matches.last().end + delta;
+	return matches.size();
+}
+
+TextSearch::Match TextSearch::findPlain(int rangeStart, int rangeEnd, bool backward) const
+{
+	if (_searchText.isEmpty())
+		return {};
+
+	const Qt::CaseSensitivity cs = ((_flags & QTextDocument::FindCaseSensitively) != 0 ? Qt::CaseSensitive : Qt::CaseInsensitive);
+	const bool wholeWords = ((_flags & QTextDocument::FindWholeWords) != 0);
+	const int len = _searchText.length();
+
+	if (backward) {
+		int from = rangeEnd - len;
+		while (from >= rangeStart) {
+			const int idx = _text.lastIndexOf(_searchText, from, cs);
+			if (idx < rangeStart)
+				break;
+			if (!wholeWords || isWholeWord(idx, idx + len))
+				return {idx, idx + len};
+			from = idx - 1;
+		}
+	}
+	else {
+		int from = rangeStart;
+		while (true) {
+			const int idx = _text.indexOf(_searchText, from, cs);
+			if (idx < 0 || idx + len > rangeEnd)
+				break;
+			if (!wholeWords || isWholeWord(idx, idx + len))
+				return {idx, idx + len};
+			from = idx + 1;
+		}
+	}
+	return {};
+}
+
+TextSearch::Match TextSearch::findRegex(int rangeStart, int rangeEnd, bool backward) const
+{
+	QRegularExpressionMatch m;
+
+	if (backward) {
+#if QT_VERSION >= 0x050500
+		int offset = _text.lastIndexOf(_regex, rangeEnd, &m);
+#else
+		int offset = _text.lastIndexOf(_regex, rangeEnd);
+		if (offset >= 0)
+			m = _regex.match(_text, offset);
+#endif
+		while (offset >= rangeStart && m.capturedEnd() > rangeEnd) {
+			// Note: lastIndexOf() with a negative offset would start searching
+			// from the end again
+			if (offset == 0)
+				return {};
+#if QT_VERSION >= 0x050500
+			offset = _text.lastIndexOf(_regex, offset - 1, &m);
+#else
+			offset = _text.lastIndexOf(_regex, offset - 1);
+			if (offset >= 0)
+				m = _regex.match(_text, offset);
+#endif
+		}
+		if (offset < rangeStart)
+			return {};
+	}
+	else {
+		m = _regex.match(_text, rangeStart);
+		if (!m.hasMatch() || m.capturedEnd() > rangeEnd)
+			return {};
+	}
+	return {m.capturedStart(), m.capturedEnd(), m};
+}
+
+bool TextSearch::isWholeWord(int start, int end) const
+{
+	// Same criterion as QTextDocument::find()
+	if (start > 0 && _text[start - 1].isLetterOrNumber())
+		return false;
+	if (end < _text.length() && _text[end].isLetterOrNumber())
+		return false;
+	return true;
+}
+
+} // namespace Document
+} // namespace Tw
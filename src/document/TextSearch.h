@@ -0,0 +1,93 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#ifndef Document_TextSearch_H
+#define Document_TextSearch_H
+
+#include <QRegularExpression>
+#include <QTextDocument>
+#include <QVector>
+
+namespace Tw {
+namespace Document {
+
+// Searches a snapshot of a document's text. The text is obtained only once
+// when the TextSearch is constructed, so that finding all matches (or
+// repeatedly finding the next match) is linear in the size of the document.
+// Plain text searches behave like QTextDocument::find() (i.e., they honor
+// FindCaseSensitively and FindWholeWords); for regular expressions, the flags
+// must already be part of the QRegularExpression's pattern options.
+class TextSearch
+{
+public:
+	struct Match {
+		int start{-1};
+		int end{-1};
+		// only set for regular expression searches
+		QRegularExpressionMatch regexMatch;
+
+		Match() = default;
+		Match(const int s, const int e, const QRegularExpressionMatch & m = QRegularExpressionMatch())
+			: start(s), end(e), regexMatch(m) { }
+
+		bool isValid() const { return start >= 0; }
+		int length() const { return end - start; }
+	};
+
+	TextSearch(const QTextDocument * doc, const QString & searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags);
+	TextSearch(const QString & text, const QString & searchText, const QRegularExpression * regex, QTextDocument::FindFlags flags);
+
+	const QString & text() const { return _text; }
+
+	// Returns the first match (or the last match if FindBackward is set) that
+	// lies entirely within [rangeStart, rangeEnd]
+	Match find(int rangeStart, int rangeEnd) const;
+	// Returns all (non-overlapping) matches within [rangeStart, rangeEnd] in
+	// document order; FindBackward is ignored
+	QVector<Match> findAll(int rangeStart, int rangeEnd) const;
+
+	// Returns the text that replaces `match`; for regular expressions,
+	// back references (\1, \2, ...) in `replacement` are expanded like in
+	// QString::replace()
+	QString replacementText(const Match & match, const QString & replacement) const;
+
+	// Replaces all matches within [rangeStart, rangeEnd] in `doc` as a single
+	// edit block (i.e., one undo step and one contentsChange() notification).
+	// `doc` must still contain the text the search was constructed with.
+	// If `replacedEnd` is not nullptr, it receives the position right after
+	// the last replacement.
+	int replaceAll(QTextDocument * doc, const QString & replacement, int rangeStart, int rangeEnd, int * replacedEnd = nullptr) const;
+
+private:
+	Match findPlain(int rangeStart, int rangeEnd, bool backward) const;
+	Match findRegex(int rangeStart, int rangeEnd, bool backward) const;
+	bool isWholeWord(int start, int end) const;
+
+	QString _text;
+	QString _searchText;
+	QRegularExpression _regex;
+	bool _useRegex{false};
+	QTextDocument::FindFlags _flags;
+};
+
+} // namespace Document
+} // namespace Tw
+
+#endif // !defined(Document_TextSearch_H)
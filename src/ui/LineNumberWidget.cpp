@@ -39,10 +39,16 @@ LineNumberWidget::LineNumberWidget(QTextEdit * parent)
 
 QSize LineNumberWidget::sizeHint() const
 {
+	// The size only depends on the number of digits of the last line number,
+	// but this is called for every change of the document
+	const int blockCount = (_editor ? _editor->document()->blockCount() : 0);
+	if (_sizeHint.isValid() && blockCount == _sizeHintBlockCount)
+		return _sizeHint;
+
 	int digits = 1;
 
 	if (_editor) {
-		int max = qMax(1, _editor->document()->blockCount());
+		int max = qMax(1, blockCount);
 		while (max >= 10) {
 			max /= 10;
 			++digits;
@@ -54,7 +60,9 @@ QSize LineNumberWidget::sizeHint() const
 #else
 	int space = 3 + fontMetrics().horizontalAdvance(QChar::fromLatin1('9')) * digits;
 #endif
-	return QSize(space, 0);
+	_sizeHintBlockCount = blockCount;
+	_sizeHint = QSize(space, 0);
+	return _sizeHint;
 }
 
 void LineNumberWidget::paintEvent(QPaintEvent * event)
@@ -65,35 +73,81 @@ void LineNumberWidget::paintEvent(QPaintEvent * event)
 	if (!_editor)
 		return;
 
-	QTextBlock block = _editor->document()->begin();
-	int blockNumber = 1;
-
 	QAbstractTextDocumentLayout *layout = _editor->document()->documentLayout();
-	int top = static_cast<int>(layout->blockBoundingRect(block).top() - _editor->verticalScrollBar()->value());
-	int bottom = static_cast<int>(top + layout->blockBoundingRect(block).height());
-
-	while (block.isValid() && top <= event->rect().bottom()) {
-		if (bottom >= event->rect().top()) {
-			QString number = QString::number(blockNumber);
-			painter.drawText(0, top, width() - 1, fontMetrics().height(),
-							 Qt::AlignRight, number);
-		}
+	const int scrollPos = _editor->verticalScrollBar()->value();
 
-		block = block.next();
-		if (block == _editor->document()->end())
-			break;
+	// Only look at the blocks in the exposed area rather than walking the
+	// document from the beginning
+	QTextBlock block = blockAt(scrollPos + event->rect().top());
+	int blockNumber = block.blockNumber() + 1;
+
+	while (block.isValid()) {
+		const QRectF rect = layout->blockBoundingRect(block);
 		// NB: The top of this block may not coincide with the bottom of the
 		// previous block in case the line spacing is not 100%
-		top = static_cast<int>(layout->blockBoundingRect(block).top() - _editor->verticalScrollBar()->value());
-		bottom = top + static_cast<int>(layout->blockBoundingRect(block).height());
+		const int top = static_cast<int>(rect.top() - scrollPos);
+		if (top > event->rect().bottom())
+			break;
+		const int bottom = top + static_cast<int>(rect.height());
+		if (bottom >= event->rect().top())
+			drawLineNumber(painter, blockNumber, top);
+
+		block = block.next();
 		++blockNumber;
 	}
 }
 
+QTextBlock LineNumberWidget::blockAt(const qreal y) const
+{
+	if (!_editor)
+		return QTextBlock();
+
+	const QTextDocument * doc = _editor->document();
+	QAbstractTextDocumentLayout * layout = doc->documentLayout();
+
+	// The tops of the blocks are increasing, so we can use a binary search;
+	// finding a block by number is logarithmic, too
+	int lo = 0, hi = doc->blockCount() - 1;
+	while (lo < hi) {
+		const int mid = lo + (hi - lo + 1) / 2;
+		if (layout->blockBoundingRect(doc->findBlockByNumber(mid)).top() <= y)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	return doc->findBlockByNumber(lo);
+}
+
+void LineNumberWidget::drawLineNumber(QPainter & painter, int lineNumber, const int top)
+{
+	if (_digits.isEmpty()) {
+		for (int i = 0; i <= 9; ++i) {
+			QStaticText digit(QString::number(i));
+			digit.setPerformanceHint(QStaticText::AggressiveCaching);
+			digit.prepare(QTransform(), font());
+			_digits.append(digit);
+		}
+	}
+
+	// Draw the digits right-aligned from right to left
+	qreal x = width() - 1;
+	do {
+		const QStaticText & digit = _digits[lineNumber % 10];
+		x -= digit.size().width();
+		painter.drawStaticText(QPointF(x, top), digit);
+		lineNumber /= 10;
+	} while (lineNumber > 0);
+}
+
 void LineNumberWidget::changeEvent(QEvent * event)
 {
 	if (event->type() == QEvent::ParentChange) {
 		_editor = qobject_cast<QTextEdit*>(parentWidget());
+		_sizeHint = QSize();
+	}
+	else if (event->type() == QEvent::FontChange) {
+		_digits.clear();
+		_sizeHint = QSize();
 	}
 	QWidget::changeEvent(event);
 }
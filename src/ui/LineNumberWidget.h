@@ -22,7 +22,10 @@
 #define LineNumberWidget_H
 
 #include <QPaintEvent>
+#include <QStaticText>
+#include <QTextBlock>
 #include <QTextEdit>
+#include <QVector>
 
 namespace Tw {
 namespace UI {
@@ -42,9 +45,19 @@ protected:
 	void paintEvent(QPaintEvent * event) override;
 	void changeEvent(QEvent * event) override;
 
+	// Returns the last block whose top is at or above `y` (in document
+	// coordinates)
+	QTextBlock blockAt(const qreal y) const;
+	void drawLineNumber(QPainter & painter, int lineNumber, const int top);
+
 private:
 	QTextEdit * _editor;
 	QColor _bgColor;
+
+	// pre-laid-out glyphs of the digits 0-9 (for the current font)
+	QVector<QStaticText> _digits;
+	mutable int _sizeHintBlockCount{-1};
+	mutable QSize _sizeHint;
 };
 
 } // namespace UI
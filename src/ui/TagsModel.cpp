@@ -0,0 +1,381 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "TagsModel.h"
+
+#include <QBrush>
+#include <QSet>
+
+namespace Tw {
+namespace UI {
+
+constexpr quintptr TagsModel::BookmarksNode;
+constexpr quintptr TagsModel::OutlineNode;
+constexpr quintptr TagsModel::NoTagsNode;
+
+// Returns the parent of each tag (or -1 for top-level entries): bookmarks have
+// no parent, outline entries are nested under the closest preceding outline
+// entry of a lower level
+static QVector<int> tagParents(const QList<Tw::Document::TextDocument::Tag> & tags)
+{
+	QVector<int> parents;
+	parents.reserve(tags.size());
+	int item = -1;
+	for (int i = 0; i < tags.size(); ++i) {
+		const unsigned int level = tags[i].level;
+		if (level < 1) {
+			parents.append(-1);
+			continue;
+		}
+		while (item >= 0 && tags[item].level >= level)
+			item = parents[item];
+		parents.append(item);
+		item = i;
+	}
+	return parents;
+}
+
+TagsModel::TagsModel(Tw::Document::TextDocument * doc, QObject * parent /* = nullptr */)
+	: QAbstractItemModel(parent)
+	, _doc(doc)
+{
+	if (_doc) {
+		connect(_doc, SIGNAL(tagsChanged(int, int, int)), this, SLOT(tagsChanged(int, int, int)));
+		connect(_doc, SIGNAL(destroyed()), this, SLOT(unlinkFromDocument()));
+	}
+	rebuild();
+}
+
+QModelIndex TagsModel::index(int row, int column, const QModelIndex & parent /* = {} */) const
+{
+	if (row < 0 || column != 0)
+		return {};
+
+	const QVector<quintptr> * children = &_topLevel;
+	if (parent.isValid()) {
+		const Node * p = node(parent.internalId());
+		if (!p)
+			return {};
+		children = &p->children;
+	}
+	if (row >= children->size())
+		return {};
+	return createIndex(row, column, (*children)[row]);
+}
+
+QModelIndex TagsModel::parent(const QModelIndex & child) const
+{
+	if (!child.isValid())
+		return {};
+	const Node * n = node(child.internalId());
+	if (!n || n->tag < 0)
+		return {};
+	return indexForNode(n->parent);
+}
+
+int TagsModel::rowCount(const QModelIndex & parent /* = {} */) const
+{
+	if (!parent.isValid())
+		return _topLevel.size();
+	if (parent.column() != 0)
+		return 0;
+	const Node * n = node(parent.internalId());
+	return (n ? n->children.size() : 0);
+}
+
+int TagsModel::columnCount(const QModelIndex & parent /* = {} */) const
+{
+	Q_UNUSED(parent)
+	return 1;
+}
+
+QVariant TagsModel::data(const QModelIndex & index, int role /* = Qt::DisplayRole */) const
+{
+	if (!index.isValid())
+		return {};
+
+	switch (index.internalId()) {
+		case BookmarksNode:
+			if (role == Qt::DisplayRole)
+				return tr("Bookmarks");
+			if (role == Qt::ForegroundRole)
+				return QBrush(Qt::blue);
+			return {};
+		case OutlineNode:
+			if (role == Qt::DisplayRole)
+				return tr("Outline");
+			if (role == Qt::ForegroundRole)
+				return QBrush(Qt::blue);
+			return {};
+		case NoTagsNode:
+			if (role == Qt::DisplayRole)
+				return tr("No tags");
+			return {};
+		default:
+			break;
+	}
+
+	const int tag = tagIndex(index);
+	if (role == Qt::DisplayRole && _doc && tag >= 0 && tag < _doc->getTags().size())
+		return _doc->getTags()[tag].text;
+	return {};
+}
+
+Qt::ItemFlags TagsModel::flags(const QModelIndex & index) const
+{
+	if (!index.isValid())
+		return Qt::NoItemFlags;
+	switch (index.internalId()) {
+		case BookmarksNode:
+		case OutlineNode:
+			return Qt::ItemIsEnabled;
+		case NoTagsNode:
+			return Qt::NoItemFlags;
+		default:
+			return Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+	}
+}
+
+int TagsModel::tagIndex(const QModelIndex & index) const
+{
+	if (!index.isValid() || index.model() != this)
+		return -1;
+	const Node * n = node(index.internalId());
+	return (n ? n->tag : -1);
+}
+
+QModelIndex TagsModel::indexForTag(const int tagIndex) const
+{
+	if (tagIndex < 0 || tagIndex >= _tagNodes.size())
+		return {};
+	return indexForNode(_tagNodes[tagIndex]);
+}
+
+QModelIndex TagsModel::indexForNode(const quintptr node) const
+{
+	const Node * n = this->node(node);
+	if (!n)
+		return {};
+	return createIndex(n->row, 0, node);
+}
+
+const TagsModel::Node * TagsModel::node(const quintptr id) const
+{
+	const QHash<quintptr, Node>::const_iterator it = _nodes.constFind(id);
+	return (it == _nodes.constEnd() ? nullptr : &it.value());
+}
+
+void TagsModel::insertNode(const quintptr id, const int tag, const unsigned int level, const quintptr parent, const int row)
+{
+	_nodes.insert(id, {tag, level, parent, row, {}});
+	QVector<quintptr> & siblings = _nodes[parent].children;
+	siblings.insert(row, id);
+	for (int i = row + 1; i < siblings.size(); ++i)
+		_nodes[siblings[i]].row = i;
+}
+
+void TagsModel::removeNodes(const quintptr parent, const int first, const int last)
+{
+	QVector<quintptr> & siblings = _nodes[parent].children;
+	QVector<quintptr> nodes = siblings.mid(first, last - first + 1);
+	siblings.remove(first, last - first + 1);
+	for (int i = first; i < siblings.size(); ++i)
+		_nodes[siblings[i]].row = i;
+	// Remove the nodes along with all their descendants
+	while (!nodes.isEmpty()) {
+		const quintptr id = nodes.takeLast();
+		nodes += _nodes[id].children;
+		_nodes.remove(id);
+	}
+}
+
+void TagsModel::tagsChanged(int index, int removed, int added)
+{
+	if ((removed == 0 && added == 0) || !_doc)
+		return;
+
+	// If the levels (and thus the tree structure) stay the same, only the
+	// text of the changed tags needs to be updated
+	if (removed == added && index + added <= _tagNodes.size()) {
+		const QList<Tw::Document::TextDocument::Tag> & tags = _doc->getTags();
+		bool sameStructure = true;
+		for (int i = index; i < index + added && sameStructure; ++i)
+			sameStructure = (tags[i].level == node(_tagNodes[i])->level);
+		if (sameStructure) {
+			for (int i = index; i < index + added; ++i) {
+				const QModelIndex idx = indexForTag(i);
+				emit dataChanged(idx, idx);
+			}
+			return;
+		}
+	}
+
+	if (updateStructure(index, removed, added))
+		return;
+
+	beginResetModel();
+	rebuild();
+	endResetModel();
+}
+
+bool TagsModel::updateStructure(const int index, const int removed, const int added)
+{
+	const QList<Tw::Document::TextDocument::Tag> & tags = _doc->getTags();
+	if (index < 0 || index + removed > _tagNodes.size() || _tagNodes.size() - removed + added != tags.size())
+		return false;
+
+	const QVector<int> parents = tagParents(tags);
+	auto isRemoved = [index, removed](const int tag) { return (tag >= index && tag < index + removed); };
+	auto isAdded = [index, added](const int tag) { return (tag >= index && tag < index + added); };
+	auto newTag = [index, removed, added](const int tag) { return (tag < index ? tag : tag - removed + added); };
+
+	// All other tags must keep their parent. Otherwise (e.g., if a new section
+	// adopts some existing subsections), rows would have to be moved.
+	for (int tag = 0; tag < _tagNodes.size(); ++tag) {
+		if (isRemoved(tag))
+			continue;
+		const int parent = node(node(_tagNodes[tag])->parent)->tag;
+		if (parent >= 0 && isRemoved(parent))
+			return false;
+		if (parents[newTag(tag)] != (parent >= 0 ? newTag(parent) : -1))
+			return false;
+	}
+	// Adding or removing categories would change the top level
+	bool hasBookmarks = false, hasOutline = false;
+	foreach (const Tw::Document::TextDocument::Tag & tag, tags) {
+		if (tag.level < 1)
+			hasBookmarks = true;
+		else
+			hasOutline = true;
+	}
+	if (hasBookmarks != _topLevel.contains(BookmarksNode) || hasOutline != _topLevel.contains(OutlineNode))
+		return false;
+
+	// Renumber the tags that are kept
+	const QVector<quintptr> removedNodes = _tagNodes.mid(index, removed);
+	_tagNodes.remove(index, removed);
+	for (int i = index; i < _tagNodes.size(); ++i)
+		_nodes[_tagNodes[i]].tag = i + added;
+
+	// Remove the old tags. Their descendants are removed along with them, and
+	// consecutive siblings are removed at once.
+	QSet<quintptr> removedSet;
+	foreach (const quintptr id, removedNodes)
+		removedSet.insert(id);
+	foreach (const quintptr id, removedNodes) {
+		const Node * n = node(id);
+		if (!n)
+			continue;
+		const quintptr parent = n->parent;
+		const QVector<quintptr> & siblings = node(parent)->children;
+		const int first = n->row;
+		int last = first;
+		while (last + 1 < siblings.size() && removedSet.contains(siblings[last + 1]))
+			++last;
+		beginRemoveRows(indexForNode(parent), first, last);
+		removeNodes(parent, first, last);
+		endRemoveRows();
+	}
+
+	// Insert the new tags. Those whose parent is not new themselves are
+	// inserted as rows (consecutive siblings at once), the others along with
+	// them.
+	for (int i = 0; i < added; ++i)
+		_tagNodes.insert(index + i, _nextNode++);
+	auto parentNode = [this, &tags, &parents](const int tag) {
+		return (parents[tag] >= 0 ? _tagNodes[parents[tag]] : (tags[tag].level < 1 ? BookmarksNode : OutlineNode));
+	};
+	QVector<int> roots(added);
+	for (int tag = index; tag < index + added; ++tag)
+		roots[tag - index] = (isAdded(parents[tag]) ? roots[parents[tag] - index] : tag);
+	for (int tag = index; tag < index + added; ++tag) {
+		const quintptr parent = parentNode(tag);
+		if (roots[tag - index] != tag || node(_tagNodes[tag]))
+			continue;
+
+		// Siblings are ordered like the tags
+		const QVector<quintptr> & siblings = node(parent)->children;
+		int row = 0;
+		while (row < siblings.size() && node(siblings[row])->tag < tag)
+			++row;
+		QVector<int> group;
+		for (int sibling = tag; sibling < index + added; ++sibling) {
+			if (roots[sibling - index] == sibling && parentNode(sibling) == parent)
+				group.append(sibling);
+		}
+
+		beginInsertRows(indexForNode(parent), row, row + group.size() - 1);
+		for (int i = 0; i < group.size(); ++i)
+			insertNode(_tagNodes[group[i]], group[i], tags[group[i]].level, parent, row + i);
+		for (int descendant = tag; descendant < index + added; ++descendant) {
+			if (roots[descendant - index] == descendant || !group.contains(roots[descendant - index]))
+				continue;
+			const quintptr p = _tagNodes[parents[descendant]];
+			insertNode(_tagNodes[descendant], descendant, tags[descendant].level, p, node(p)->children.size());
+		}
+		endInsertRows();
+	}
+	return true;
+}
+
+void TagsModel::unlinkFromDocument()
+{
+	beginResetModel();
+	_doc = nullptr;
+	rebuild();
+	endResetModel();
+}
+
+void TagsModel::rebuild()
+{
+	_nodes.clear();
+	_tagNodes.clear();
+	_nodes.insert(BookmarksNode, {-1, 0, 0, 0, {}});
+	_nodes.insert(OutlineNode, {-1, 0, 0, 0, {}});
+	_nodes.insert(NoTagsNode, {-1, 0, 0, 0, {}});
+
+	const QList<Tw::Document::TextDocument::Tag> tags = (_doc ? _doc->getTags() : QList<Tw::Document::TextDocument::Tag>());
+	const QVector<int> parents = tagParents(tags);
+	_tagNodes.reserve(tags.size());
+	for (int i = 0; i < tags.size(); ++i) {
+		const quintptr id = _nextNode++;
+		const quintptr parent = (parents[i] >= 0 ? _tagNodes[parents[i]] : (tags[i].level < 1 ? BookmarksNode : OutlineNode));
+		_tagNodes.append(id);
+		insertNode(id, i, tags[i].level, parent, _nodes[parent].children.size());
+	}
+	updateTopLevel();
+}
+
+void TagsModel::updateTopLevel()
+{
+	_topLevel.clear();
+	if (!_nodes[BookmarksNode].children.isEmpty())
+		_topLevel.append(BookmarksNode);
+	if (!_nodes[OutlineNode].children.isEmpty())
+		_topLevel.append(OutlineNode);
+	if (_topLevel.isEmpty())
+		_topLevel.append(NoTagsNode);
+	for (int i = 0; i < _topLevel.size(); ++i)
+		_nodes[_topLevel[i]].row = i;
+}
+
+} // namespace UI
+} // namespace Tw
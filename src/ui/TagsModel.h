@@ -0,0 +1,103 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#ifndef TagsModel_H
+#define TagsModel_H
+
+#include "document/TextDocument.h"
+
+#include <QAbstractItemModel>
+#include <QHash>
+#include <QVector>
+
+namespace Tw {
+namespace UI {
+
+// Presents the tags of a TextDocument as a tree: bookmarks (level 0) are
+// listed under "Bookmarks", outline entries (level >= 1) are nested by level
+// under "Outline". The model follows the document's tagsChanged()
+// notifications; if the levels of the changed tags stay the same (as is the
+// case when editing the text of a heading), only the affected rows are
+// updated. Otherwise, the changed tags are removed and inserted as rows,
+// unless that would move unchanged tags to a different parent (or add or
+// remove a category); then, the (cheap) tree structure is rebuilt and the
+// model is reset.
+class TagsModel : public QAbstractItemModel
+{
+	Q_OBJECT
+public:
+	explicit TagsModel(Tw::Document::TextDocument * doc, QObject * parent = nullptr);
+	~TagsModel() override = default;
+
+	QModelIndex index(int row, int column, const QModelIndex & parent = {}) const override;
+	QModelIndex parent(const QModelIndex & child) const override;
+	int rowCount(const QModelIndex & parent = {}) const override;
+	int columnCount(const QModelIndex & parent = {}) const override;
+	QVariant data(const QModelIndex & index, int role = Qt::DisplayRole) const override;
+	Qt::ItemFlags flags(const QModelIndex & index) const override;
+
+	// Returns the index into TextDocument::getTags() of the tag at `index`, or
+	// -1 if `index` does not refer to a tag (e.g., a category)
+	int tagIndex(const QModelIndex & index) const;
+	QModelIndex indexForTag(const int tagIndex) const;
+
+private slots:
+	void tagsChanged(int index, int removed, int added);
+	void unlinkFromDocument();
+
+private:
+	void rebuild();
+	// Updates the tree for a tagsChanged() notification by removing and
+	// inserting rows; returns false (without changing anything) if that is not
+	// possible
+	bool updateStructure(const int index, const int removed, const int added);
+	void updateTopLevel();
+	QModelIndex indexForNode(const quintptr node) const;
+
+	// Node ids of the categories; tags get unique ids that stay the same as
+	// long as the tag exists (so persistent indexes remain valid)
+	static constexpr quintptr BookmarksNode = ~static_cast<quintptr>(0);
+	static constexpr quintptr OutlineNode = ~static_cast<quintptr>(0) - 1;
+	static constexpr quintptr NoTagsNode = ~static_cast<quintptr>(0) - 2;
+
+	struct Node {
+		int tag; // index into TextDocument::getTags(), or -1 for categories
+		unsigned int level;
+		quintptr parent;
+		int row;
+		QVector<quintptr> children;
+	};
+	const Node * node(const quintptr id) const;
+	void insertNode(const quintptr id, const int tag, const unsigned int level, const quintptr parent, const int row);
+	void removeNodes(const quintptr parent, const int first, const int last);
+
+	Tw::Document::TextDocument * _doc;
+
+	QHash<quintptr, Node> _nodes;
+	// The node id of each tag
+	QVector<quintptr> _tagNodes;
+	QVector<quintptr> _topLevel;
+	quintptr _nextNode{0};
+};
+
+} // namespace UI
+} // namespace Tw
+
+#endif // !defined(TagsModel_H)
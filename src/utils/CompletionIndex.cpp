@@ -0,0 +1,216 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "utils/CompletionIndex.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <algorithm>
+#include <limits>
+
+namespace Tw {
+namespace Utils {
+
+//static
+CompletionIndex CompletionIndex::load(const QStringList & files)
+{
+	CompletionIndex retVal;
+	foreach (const QString & path, files)
+		retVal.addFile(path);
+	retVal.finalize();
+	return retVal;
+}
+
+bool CompletionIndex::addFile(const QString & path)
+{
+	QFile completionFile(path);
+	if (!completionFile.open(QIODevice::ReadOnly | QIODevice::Text))
+		return false;
+
+	QTextStream in(&completionFile);
+	in.setCodec("UTF-8");
+	in.setAutoDetectUnicode(true);
+	while (true) {
+		QString line = in.readLine();
+		if (line.isNull())
+			break;
+		if (line.isEmpty() || line.startsWith(QChar::fromLatin1('%')))
+			continue;
+		line.replace(QLatin1String("#RET#"), QLatin1String("\n"));
+		QStringList parts = line.split(QString::fromLatin1(":="));
+		if (parts.count() > 2)
+			continue;
+		if (parts.count() == 1)
+			parts.append(parts[0]);
+		parts[0].replace(QLatin1String("#INS#"), QLatin1String(""));
+		addEntry(parts[0], parts[1]);
+	}
+	return true;
+}
+
+void CompletionIndex::addEntry(const QString & abbreviation, const QString & expansion)
+{
+	const QString folded = abbreviation.toCaseFolded();
+	Entry e;
+	e.key = intern(folded);
+	e.keyLength = folded.length();
+	e.abbreviation = intern(abbreviation);
+	e.abbreviationLength = abbreviation.length();
+	e.expansion = intern(expansion);
+	e.expansionLength = expansion.length();
+	_entries.append(e);
+}
+
+void CompletionIndex::finalize()
+{
+	_interned.clear();
+	_strings.squeeze();
+	_entries.squeeze();
+
+	_sorted.resize(_entries.size());
+	for (int i = 0; i < _sorted.size(); ++i)
+		_sorted[i] = i;
+	std::stable_sort(_sorted.begin(), _sorted.end(), [this](const int a, const int b) {
+		return key(a).compare(key(b), Qt::CaseSensitive) < 0;
+	});
+}
+
+QString CompletionIndex::abbreviation(const int entry) const
+{
+	if (entry < 0 || entry >= _entries.size())
+		return {};
+	return _strings.mid(_entries[entry].abbreviation, _entries[entry].abbreviationLength);
+}
+
+QString CompletionIndex::expansion(const int entry) const
+{
+	if (entry < 0 || entry >= _entries.size())
+		return {};
+	return _strings.mid(_entries[entry].expansion, _entries[entry].expansionLength);
+}
+
+QVector<int> CompletionIndex::find(const QString & prefix) const
+{
+	const QString folded = prefix.toCaseFolded();
+	const int len = folded.length();
+
+	// Compare only the first len characters of each key so that all keys
+	// starting with the prefix compare equal
+	auto keyPrefix = [this, len](const int entry) {
+		return key(entry).left(len);
+	};
+	const QVector<int>::const_iterator first = std::lower_bound(_sorted.begin(), _sorted.end(), folded, [&keyPrefix](const int entry, const QString & s) {
+		return keyPrefix(entry).compare(s, Qt::CaseSensitive) < 0;
+	});
+	const QVector<int>::const_iterator last = std::upper_bound(first, _sorted.end(), folded, [&keyPrefix](const QString & s, const int entry) {
+		return keyPrefix(entry).compare(s, Qt::CaseSensitive) > 0;
+	});
+
+	QVector<int> retVal;
+	retVal.reserve(static_cast<int>(last - first));
+	for (QVector<int>::const_iterator it = first; it != last; ++it)
+		retVal.append(*it);
+	std::sort(retVal.begin(), retVal.end());
+	return retVal;
+}
+
+QVector<int> CompletionIndex::findFuzzy(const QString & pattern, const int maxResults /* = 50 */, const int minScore /* = std::numeric_limits<int>::min() + 1 */) const
+{
+	QVector<int> retVal;
+	const QString folded = pattern.toCaseFolded();
+	if (folded.isEmpty() || maxResults <= 0)
+		return retVal;
+
+	struct Candidate {
+		int score;
+		int length;
+		int entry;
+	};
+	QVector<Candidate> candidates;
+	for (int i = 0; i < _entries.size(); ++i) {
+		if (_entries[i].keyLength < folded.length())
+			continue;
+		const int score = fuzzyScore(key(i), folded);
+		if (score > std::numeric_limits<int>::min() && score >= minScore)
+			candidates.append({score, _entries[i].keyLength, i});
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate & a, const Candidate & b) {
+		if (a.score != b.score)
+			return a.score > b.score;
+		if (a.length != b.length)
+			return a.length < b.length;
+		return a.entry < b.entry;
+	});
+
+	const int n = qMin(maxResults, candidates.size());
+	retVal.reserve(n);
+	for (int i = 0; i < n; ++i)
+		retVal.append(candidates[i].entry);
+	return retVal;
+}
+
+qint64 CompletionIndex::memoryUsage() const
+{
+	return static_cast<qint64>(sizeof(*this)) +
+			static_cast<qint64>(_strings.capacity()) * static_cast<qint64>(sizeof(QChar)) +
+			static_cast<qint64>(_entries.capacity()) * static_cast<qint64>(sizeof(Entry)) +
+			static_cast<qint64>(_sorted.capacity()) * static_cast<qint64>(sizeof(int));
+}
+
+int CompletionIndex::intern(const QString & str)
+{
+	const QHash<QString, int>::const_iterator it = _interned.constFind(str);
+	if (it != _interned.constEnd())
+		return it.value();
+	const int offset = _strings.length();
+	_strings.append(str);
+	_interned.insert(str, offset);
+	return offset;
+}
+
+int CompletionIndex::fuzzyScore(const QStringRef & str, const QString & pattern) const
+{
+	// Match the pattern characters greedily from left to right; consecutive
+	// matches (and a match at the very beginning) are rewarded, gaps are
+	// penalized
+	int score = 0;
+	int pos = 0;
+	int prevMatch = -2;
+	foreach (const QChar & ch, pattern) {
+		const int idx = str.indexOf(ch, pos, Qt::CaseSensitive);
+		if (idx < 0)
+			return std::numeric_limits<int>::min();
+		if (idx == 0)
+			score += 10;
+		else if (idx == prevMatch + 1)
+			score += 5;
+		else
+			score -= idx - pos;
+		prevMatch = idx;
+		pos = idx + 1;
+	}
+	// Prefer matches that cover most of the key
+	return score - (str.length() - pattern.length());
+}
+
+} // namespace Utils
+} // namespace Tw
@@ -0,0 +1,95 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#ifndef CompletionIndex_H
+#define CompletionIndex_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <limits>
+
+namespace Tw {
+namespace Utils {
+
+// A compact index of completion entries (abbreviation => expansion, see the
+// files in res/resfiles/completion). All strings are interned in a single
+// buffer, and the entries are kept in an array sorted by their case-folded
+// abbreviation, so that prefix lookups are binary searches that don't
+// allocate anything per entry.
+class CompletionIndex
+{
+public:
+	CompletionIndex() = default;
+
+	// Loads all given completion files and finalizes the index
+	static CompletionIndex load(const QStringList & files);
+
+	// Adds the entries of a completion file; returns false if the file could
+	// not be read
+	bool addFile(const QString & path);
+	void addEntry(const QString & abbreviation, const QString & expansion);
+	// Must be called after adding entries and before searching
+	void finalize();
+
+	int size() const { return _entries.size(); }
+	QString abbreviation(const int entry) const;
+	QString expansion(const int entry) const;
+
+	// Returns the entries whose abbreviation starts with `prefix`
+	// (case-insensitively) in the order in which they were added
+	QVector<int> find(const QString & prefix) const;
+	// Returns the entries whose abbreviation contains all characters of
+	// `pattern` in order (case-insensitively); entries where the characters
+	// are consecutive, start early, or cover most of the abbreviation are
+	// ranked first. Entries scoring less than `minScore` are omitted.
+	QVector<int> findFuzzy(const QString & pattern, const int maxResults = 50, const int minScore = std::numeric_limits<int>::min() + 1) const;
+
+	// Approximate number of bytes used by the index
+	qint64 memoryUsage() const;
+
+private:
+	struct Entry {
+		// offsets and lengths in _strings
+		int key; // the case-folded abbreviation
+		int keyLength;
+		int abbreviation;
+		int abbreviationLength;
+		int expansion;
+		int expansionLength;
+	};
+
+	int intern(const QString & str);
+	QStringRef key(const int entry) const { return QStringRef(&_strings, _entries[entry].key, _entries[entry].keyLength); }
+	int fuzzyScore(const QStringRef & str, const QString & pattern) const;
+
+	QString _strings;
+	QVector<Entry> _entries;
+	// indices into _entries, sorted by key (and by index for equal keys)
+	QVector<int> _sorted;
+	// only used while adding entries
+	QHash<QString, int> _interned;
+};
+
+} // namespace Utils
+} // namespace Tw
+
+#endif // !defined(CompletionIndex_H)
@@ -0,0 +1,155 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+
+#include "utils/MultiPatternMatcher.h"
+
+#include <QStringList>
+#include <climits> // for INT_MAX
+
+namespace Tw {
+namespace Utils {
+
+QString MultiPatternMatcher::Match::captured(const int nth /* = 0 */) const
+{
+	if (!hasMatch() || nth < 0 || nth > _numGroups)
+		return {};
+	return _match.captured(_group + nth);
+}
+
+MultiPatternMatcher::MultiPatternMatcher(const QList<QRegularExpression> & patterns)
+	: _patterns(patterns)
+{
+	if (_patterns.isEmpty())
+		return;
+
+	// Wrap each pattern in a capture group of its own so we can tell which
+	// one matched; the groups of the patterns themselves are shifted
+	// accordingly
+	QStringList alternatives;
+	int group = 1;
+	foreach (const QRegularExpression & pattern, _patterns) {
+		if (!pattern.isValid() || !canBeCombined(pattern.pattern()) ||
+			pattern.patternOptions() != _patterns.first().patternOptions() ||
+			(pattern.patternOptions() & QRegularExpression::ExtendedPatternSyntaxOption))
+			return;
+		alternatives << QStringLiteral("(") + pattern.pattern() + QStringLiteral(")");
+		_groups << group;
+		group += 1 + pattern.captureCount();
+	}
+
+	_combined = QRegularExpression(alternatives.join(QChar::fromLatin1('|')), _patterns.first().patternOptions());
+	if (!_combined.isValid() || _combined.captureCount() != group - 1) {
+		_groups.clear();
+		return;
+	}
+	_combined.optimize();
+	_isCombined = true;
+}
+
+MultiPatternMatcher::Match MultiPatternMatcher::match(const QString & text, const int offset /* = 0 */) const
+{
+	if (!_isCombined)
+		return matchIndividually(text, offset);
+
+	Match retVal;
+	retVal._match = _combined.match(text, offset);
+	if (!retVal._match.hasMatch())
+		return retVal;
+	// Only the group of the alternative that matched is set
+	for (int i = 0; i < _groups.size(); ++i) {
+		if (retVal._match.capturedStart(_groups[i]) >= 0) {
+			retVal._index = i;
+			retVal._group = _groups[i];
+			retVal._numGroups = _patterns[i].captureCount();
+			break;
+		}
+	}
+	return retVal;
+}
+
+MultiPatternMatcher::Match MultiPatternMatcher::matchIndividually(const QString & text, const int offset /* = 0 */) const
+{
+	Match retVal;
+	int firstIndex{INT_MAX};
+	for (int i = 0; i < _patterns.size(); ++i) {
+		QRegularExpressionMatch m = _patterns[i].match(text, offset);
+		if (m.capturedStart() >= 0 && m.capturedStart() < firstIndex) {
+			firstIndex = m.capturedStart();
+			retVal._match = m;
+			retVal._index = i;
+			retVal._numGroups = _patterns[i].captureCount();
+		}
+	}
+	return retVal;
+}
+
+//static
+bool MultiPatternMatcher::canBeCombined(const QString & pattern)
+{
+	const int len = pattern.length();
+	for (int i = 0; i < len; ++i) {
+		const QChar c = pattern[i];
+		if (c == QChar::fromLatin1('\\')) {
+			if (i + 1 >= len)
+				return false;
+			const QChar next = pattern[i + 1];
+			// Back references (\1, \g{1}, \k<name>) would point to the wrong
+			// groups, and \K would move the start of the wrapping group
+			if ((next.isDigit() && next != QChar::fromLatin1('0')) || next == QChar::fromLatin1('g') ||
+				next == QChar::fromLatin1('k') || next == QChar::fromLatin1('K'))
+				return false;
+			++i;
+			continue;
+		}
+		if (c == QChar::fromLatin1('(') && i + 2 < len) {
+			const QChar next = pattern[i + 1];
+			const QChar type = pattern[i + 2];
+			// Backtracking control verbs such as (*SKIP) affect the whole
+			// alternation
+			if (next == QChar::fromLatin1('*'))
+				return false;
+			if (next != QChar::fromLatin1('?'))
+				continue;
+			// Lookbehind assertions are fine, named groups are not
+			if (type == QChar::fromLatin1('<')) {
+				if (i + 3 < len && (pattern[i + 3] == QChar::fromLatin1('=') || pattern[i + 3] == QChar::fromLatin1('!')))
+					continue;
+				return false;
+			}
+			// Named groups/references, branch resets, recursion and subroutine
+			// calls
+			if (type == QChar::fromLatin1('P') || type == QChar::fromLatin1('\'') || type == QChar::fromLatin1('|') ||
+				type == QChar::fromLatin1('R') || type == QChar::fromLatin1('&') || type == QChar::fromLatin1('+') ||
+				type == QChar::fromLatin1('-') || type.isDigit())
+				return false;
+			// In extended mode, a comment would swallow the rest of the
+			// alternation
+			for (int j = i + 2; j < len && pattern[j].isLetter(); ++j) {
+				if (pattern[j] == QChar::fromLatin1('x'))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+} // namespace Utils
+} // namespace Tw
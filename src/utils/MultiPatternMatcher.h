@@ -0,0 +1,86 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#ifndef MultiPatternMatcher_H
+#define MultiPatternMatcher_H
+
+#include <QList>
+#include <QRegularExpression>
+#include <QVector>
+
+namespace Tw {
+namespace Utils {
+
+// Finds the leftmost match of any of a list of regular expressions; if
+// several patterns match at the same position, the one that comes first in
+// the list wins. This is the same as matching each pattern individually and
+// taking the earliest match, but the patterns are compiled into a single
+// alternation so the text is only scanned once.
+// Patterns that cannot be combined without changing their meaning (e.g.,
+// because they use back references or named groups, which would be
+// renumbered or clash) make the matcher fall back to matching each pattern
+// individually.
+class MultiPatternMatcher
+{
+public:
+	class Match
+	{
+		friend class MultiPatternMatcher;
+	public:
+		bool hasMatch() const { return _index >= 0; }
+		// Index of the matching pattern in the list, or -1
+		int patternIndex() const { return _index; }
+		int capturedStart() const { return _match.capturedStart(_group); }
+		int capturedLength() const { return _match.capturedLength(_group); }
+		int capturedEnd() const { return _match.capturedEnd(_group); }
+		// `nth` refers to the capture groups of the matching pattern
+		QString captured(const int nth = 0) const;
+	private:
+		int _index{-1};
+		int _group{0};
+		int _numGroups{0};
+		QRegularExpressionMatch _match;
+	};
+
+	MultiPatternMatcher() = default;
+	explicit MultiPatternMatcher(const QList<QRegularExpression> & patterns);
+
+	int size() const { return _patterns.size(); }
+	bool isCombined() const { return _isCombined; }
+
+	Match match(const QString & text, const int offset = 0) const;
+	// Matches each pattern individually; used as a fallback and for reference
+	Match matchIndividually(const QString & text, const int offset = 0) const;
+
+	// Returns whether `pattern` has the same meaning as part of an alternation
+	static bool canBeCombined(const QString & pattern);
+
+private:
+	QList<QRegularExpression> _patterns;
+	QRegularExpression _combined;
+	// capture group of _combined that wraps the i-th pattern
+	QVector<int> _groups;
+	bool _isCombined{false};
+};
+
+} // namespace Utils
+} // namespace Tw
+
+#endif // !defined(MultiPatternMatcher_H)
@@ -40,6 +40,7 @@ SOURCES = \
   "../src/scripting/Script.cpp" \
   "../src/scripting/ScriptAPI.cpp" \
   "../src/ui/LineNumberWidget.cpp" \
+  "../src/ui/TagsModel.cpp" \
   "../src/utils/FileVersionDatabase.cpp"
 
 HEADERS = \
@@ -86,6 +87,7 @@ HEADERS = \
   "../src/scripting/ScriptAPIInterface.h" \
   "../src/scripting/ScriptLanguageInterface.h" \
   "../src/ui/LineNumberWidget.h" \
+  "../src/ui/TagsModel.h" \
   "../src/utils/FileVersionDatabase.h"
 
 FORMS = \
@@ -21,6 +21,8 @@
 #include "BibTeXFile_test.h"
 #include "BibTeXFile.h"
 
+#include <QTemporaryDir>
+
 namespace UnitTest {
 
 void TestBibTeXFile::load()
@@ -94,6 +96,140 @@ void TestBibTeXFile::entry_howPublished()
   QCOMPARE(b.entry(0).howPublished(), QString());
 }
 
+void TestBibTeXFile::entryForKey()
+{
+  BibTeXFile b("bibtex-1.bib");
+  const BibTeXFile::Entry * e = b.entryForKey(QString::fromLatin1("a1"));
+  QVERIFY(e != nullptr);
+  QCOMPARE(e, &b.entry(0));
+  QVERIFY(b.entryForKey(QString::fromLatin1("A1")) == nullptr);
+  // Only normal entries can be looked up
+  QVERIFY(b.entryForKey(QString::fromLatin1("Tw = \"TeXworks\"")) == nullptr);
+
+  // Entries remain valid in copies
+  BibTeXFile copy(b);
+  b = BibTeXFile();
+  QCOMPARE(copy.entryForKey(QString::fromLatin1("a1"))->year(), QString::fromLatin1("1900"));
+}
+
+void TestBibTeXFile::keys()
+{
+  BibTeXFile b("bibtex-1.bib");
+  QCOMPARE(b.keys(), QStringList() << QString::fromLatin1("a1"));
+  QCOMPARE(BibTeXFile().keys(), QStringList());
+}
+
+static QString writeTemporaryFile(const QTemporaryDir & dir, const QByteArray & content)
+{
+  const QString path = dir.filePath(QString::fromLatin1("test.bib"));
+  QFile f(path);
+  if (!f.open(QIODevice::WriteOnly))
+    return QString();
+  f.write(content);
+  return path;
+}
+
+void TestBibTeXFile::parse()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString path = writeTemporaryFile(dir,
+    "Some text @Book(knuth84,\r\n"
+    "  TITLE = {The {\\TeX}book, Volume A},\r\n"
+    "  author=\"Knuth, Donald E.\",\r\n"
+    "  year = 1984, year = 1986,\r\n"
+    "  publisher = aw # \" Publishing\",\r\n"
+    "  howpublished = {}\r\n"
+    ")\r\n"
+    "@misc{nofields}\n"
+    "@article{dup, journal = {First}}\n"
+    "@article{dup, journal = {Second}}\n"
+    "@misc{broken, title = {unbalanced\n"
+  );
+  QVERIFY(!path.isEmpty());
+
+  BibTeXFile b(path);
+  QCOMPARE(b.keys(), QStringList() << QString::fromLatin1("knuth84") << QString::fromLatin1("nofields") << QString::fromLatin1("dup") << QString::fromLatin1("dup"));
+
+  const BibTeXFile::Entry & knuth = b.entry(0);
+  QCOMPARE(knuth.typeString(), QString::fromLatin1("Book"));
+  QCOMPARE(knuth.title(), QString::fromLatin1("The {\\TeX}book, Volume A"));
+  QCOMPARE(knuth.value(QString::fromLatin1("Title")), knuth.title());
+  QCOMPARE(knuth.author(), QString::fromLatin1("Knuth, Donald E."));
+  // If a field is given more than once, the last one wins
+  QCOMPARE(knuth.year(), QString::fromLatin1("1986"));
+  QCOMPARE(knuth.value(QString::fromLatin1("publisher")), QString::fromLatin1("aw # \" Publishing\""));
+  QVERIFY(knuth.hasField(QString::fromLatin1("howpublished")));
+  QCOMPARE(knuth.howPublished(), QString());
+
+  QCOMPARE(b.entry(1).typeString(), QString::fromLatin1("misc"));
+  QVERIFY(!b.entry(1).hasField(QString::fromLatin1("title")));
+
+  // The first entry wins for duplicate keys
+  QCOMPARE(b.entryForKey(QString::fromLatin1("dup")), &b.entry(2));
+  QCOMPARE(b.entryForKey(QString::fromLatin1("dup"))->howPublished(), QString::fromLatin1("First"));
+  QCOMPARE(b.entry(3).howPublished(), QString::fromLatin1("Second"));
+
+  // Out of range
+  QCOMPARE(b.entry(4).key(), QString());
+  QCOMPARE(b.entry(4).title(), QString());
+}
+
+static QByteArray largeBibliography(const int numEntries)
+{
+  QByteArray retVal;
+  for (int i = 0; i < numEntries; ++i) {
+    retVal += "@article{key" + QByteArray::number(i) + ",\n"
+              "  author = {Doe, John and Smith, Jane and Others, Some},\n"
+              "  title = {A {Study} of Things, Number " + QByteArray::number(i) + "},\n"
+              "  journal = \"Journal of Important Results\",\n"
+              "  volume = {" + QByteArray::number(i % 50) + "},\n"
+              "  pages = {1--10},\n"
+              "  year = " + QByteArray::number(1950 + i % 70) + ",\n"
+              "  doi = {10.1000/" + QByteArray::number(i) + "},\n"
+              "  abstract = {" + QByteArray(400, 'x') + "}\n"
+              "}\n\n";
+  }
+  return retVal;
+}
+
+void TestBibTeXFile::benchmark_load()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QByteArray content = largeBibliography(60000);
+  const QString path = writeTemporaryFile(dir, content);
+  QVERIFY(!path.isEmpty());
+
+  BibTeXFile b;
+  QBENCHMARK {
+    QVERIFY(b.load(path));
+  }
+  QCOMPARE(b.numEntries(), 60000u);
+  QCOMPARE(b.entry(12345).year(), QString::number(1950 + 12345 % 70));
+}
+
+void TestBibTeXFile::benchmark_lookup()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  const QString path = writeTemporaryFile(dir, largeBibliography(60000));
+  QVERIFY(!path.isEmpty());
+  BibTeXFile b(path);
+
+  QStringList keys;
+  for (int i = 0; i < 60000; i += 600)
+    keys << QString::fromLatin1("key%1").arg(i);
+
+  QBENCHMARK {
+    foreach (const QString & key, keys) {
+      const BibTeXFile::Entry * e = b.entryForKey(key);
+      QVERIFY(e != nullptr);
+      QVERIFY(!e->title().isEmpty());
+    }
+  }
+}
+
 } // namespace UnitTest
 
 #if defined(STATIC_QT5) && defined(Q_OS_WIN)
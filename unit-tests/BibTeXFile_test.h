@@ -37,6 +37,11 @@ private slots:
   void entry_author();
   void entry_year();
   void entry_howPublished();
+  void entryForKey();
+  void keys();
+  void parse();
+  void benchmark_load();
+  void benchmark_lookup();
 };
 
 } // namespace UnitTest
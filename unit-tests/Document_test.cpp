@@ -21,24 +21,29 @@
 
 #include "Document_test.h"
 
+#include "NonblockingSyntaxHighlighter.h"
 #include "TWUtils.h"
 #include "TeXHighlighter.h"
 #include "document/Document.h"
+#include "document/ProjectIndex.h"
+#include "document/ProjectSearch.h"
 #include "document/SpellChecker.h"
 #include "document/TeXDocument.h"
 #include "document/TextDocument.h"
+#include "document/TextSearch.h"
 
+#include <QPointer>
+#include <QSemaphore>
 #include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTextCodec>
+#include <QtConcurrent>
+#include <functional>
 #include <limits>
 
-void NonblockingSyntaxHighlighter::setDocument(QTextDocument * doc) { Q_UNUSED(doc) }
-void NonblockingSyntaxHighlighter::rehighlight() { }
-void NonblockingSyntaxHighlighter::rehighlightBlock(const QTextBlock & block) { Q_UNUSED(block) }
-void NonblockingSyntaxHighlighter::maybeRehighlightText(int position, int charsRemoved, int charsAdded) { Q_UNUSED(position) Q_UNUSED(charsRemoved) Q_UNUSED(charsAdded) }
-void NonblockingSyntaxHighlighter::process() { }
-void NonblockingSyntaxHighlighter::processWhenIdle() {}
 TeXHighlighter::TeXHighlighter(Tw::Document::TeXDocument * parent) : NonblockingSyntaxHighlighter(parent) { }
 void TeXHighlighter::highlightBlock(const QString &text) { Q_UNUSED(text) }
+void TeXHighlighter::applyTags(const QTextBlock & block, const QVector<Tag> & tags) { Q_UNUSED(block) Q_UNUSED(tags) }
 
 const QStringList TWUtils::getLibraryPaths(const QString & subdir, const bool updateOnDisk) { Q_UNUSED(subdir) Q_UNUSED(updateOnDisk) return QStringList(QDir::currentPath()); }
 
@@ -54,6 +59,72 @@ bool operator==(const TextDocument::Tag & t1, const TextDocument::Tag & t2) {
 
 namespace UnitTest {
 
+// Tags every block with a format carrying (the prefix and) the text it was
+// highlighted from. Until open() is called, highlightBlock() blocks so tests
+// can act while a job is running.
+class GatedHighlighter : public NonblockingSyntaxHighlighter
+{
+public:
+	explicit GatedHighlighter(QTextDocument * parent) : NonblockingSyntaxHighlighter(parent) { }
+	~GatedHighlighter() override { open(); stopWorker(); }
+
+	using NonblockingSyntaxHighlighter::hasBlocksToHighlight;
+	using NonblockingSyntaxHighlighter::pushHighlightRange;
+	using NonblockingSyntaxHighlighter::popHighlightRange;
+
+	QPair<int, int> queuedRangeIn(const int from, const int to) const {
+		const range r = NonblockingSyntaxHighlighter::queuedRangeIn(from, to);
+		return qMakePair(r.from, r.to);
+	}
+	QPair<int, int> nextRangeToHighlight() const {
+		const range r = NonblockingSyntaxHighlighter::nextRangeToHighlight();
+		return qMakePair(r.from, r.to);
+	}
+	int maxCheckpointDistance() const { return MAX_CHECKPOINT_DISTANCE; }
+
+	void open() { _open.store(1); _gate.release(); }
+	bool isWaiting() const { return _started.available() > 0 && _open.load() == 0; }
+	void setPrefix(const QString & prefix) { stopWorker(); _prefix = prefix; }
+	QStringList highlightedTexts() const { QMutexLocker locker(&_mutex); return _highlightedTexts; }
+	void clearHighlightedTexts() { QMutexLocker locker(&_mutex); _highlightedTexts.clear(); }
+
+protected:
+	void highlightBlock(const QString & text) override {
+		{
+			QMutexLocker locker(&_mutex);
+			_highlightedTexts << _prefix + text;
+		}
+		_started.release();
+		if (_open.load() == 0) {
+			_gate.acquire();
+			_gate.release();
+		}
+		QTextCharFormat format;
+		format.setProperty(QTextFormat::UserProperty, _prefix + text);
+		setFormat(0, text.length(), format);
+	}
+
+private:
+	QString _prefix;
+	QAtomicInt _open{0};
+	QSemaphore _gate;
+	QSemaphore _started;
+	mutable QMutex _mutex;
+	QStringList _highlightedTexts;
+};
+
+static QString highlightedAs(const QTextBlock & block)
+{
+#if QT_VERSION < QT_VERSION_CHECK(5, 6, 0)
+	const QList<QTextLayout::FormatRange> formats = block.layout()->additionalFormats();
+#else
+	const QVector<QTextLayout::FormatRange> formats = block.layout()->formats();
+#endif
+	if (formats.isEmpty())
+		return QString();
+	return formats.first().format.property(QTextFormat::UserProperty).toString();
+}
+
 void TestDocument::isPDFfile_data()
 {
 	QTest::addColumn<bool>("success");
@@ -138,7 +209,7 @@ void TestDocument::absoluteFilePath()
 void TestDocument::tags()
 {
 	Tw::Document::TextDocument doc(QStringLiteral("Hello World"));
-	QSignalSpy spy(&doc, SIGNAL(tagsChanged()));
+	QSignalSpy spy(&doc, SIGNAL(tagsChanged(int, int, int)));
 
 	Tw::Document::TextDocument::Tag tag1{QTextCursor(&doc), 0, QStringLiteral("tag1")};
 	tag1.cursor.movePosition(QTextCursor::NextCharacter, QTextCursor::KeepAnchor, 2);
@@ -152,6 +223,8 @@ void TestDocument::tags()
 	doc.addTag(tag2.cursor, tag2.level, tag2.text);
 	doc.addTag(tag1.cursor, tag1.level, tag1.text);
 	QCOMPARE(spy.count(), 2);
+	QCOMPARE(spy[0], QList<QVariant>({0, 0, 1}));
+	QCOMPARE(spy[1], QList<QVariant>({0, 0, 1}));
 
 	QList<Tw::Document::TextDocument::Tag> tags = doc.getTags();
 	QCOMPARE(tags, QList<Tw::Document::TextDocument::Tag>() << tag1 << tag2);
@@ -162,6 +235,46 @@ void TestDocument::tags()
 
 	QCOMPARE(doc.removeTags(0, 1), 1u);
 	QCOMPARE(spy.count(), 1);
+	QCOMPARE(spy[0], QList<QVariant>({0, 1, 0}));
+}
+
+void TestDocument::replaceTags()
+{
+	Tw::Document::TextDocument doc(QStringLiteral("\\section{A}\nText\n\\section{B}\n"));
+	QSignalSpy spy(&doc, SIGNAL(tagsChanged(int, int, int)));
+
+	auto makeTag = [&doc](const int start, const int end, const unsigned int level, const QString & text) -> Tw::Document::TextDocument::Tag {
+		Tw::Document::TextDocument::Tag tag{QTextCursor(&doc), level, text};
+		tag.cursor.setPosition(start);
+		tag.cursor.setPosition(end, QTextCursor::KeepAnchor);
+		return tag;
+	};
+	const Tw::Document::TextDocument::Tag tagA = makeTag(0, 11, 1, QStringLiteral("A"));
+	const Tw::Document::TextDocument::Tag tagB = makeTag(17, 28, 1, QStringLiteral("B"));
+	doc.addTag(tagA.cursor, tagA.level, tagA.text);
+	doc.addTag(tagB.cursor, tagB.level, tagB.text);
+	spy.clear();
+
+	// Identical tags => no notification
+	QCOMPARE(doc.replaceTags(17, 12, {tagB}), 0u);
+	QCOMPARE(spy.count(), 0);
+
+	// Changed text
+	const Tw::Document::TextDocument::Tag tagC = makeTag(17, 28, 1, QStringLiteral("C"));
+	QCOMPARE(doc.replaceTags(17, 12, {tagC}), 1u);
+	QCOMPARE(spy.count(), 1);
+	QCOMPARE(spy[0], QList<QVariant>({1, 1, 1}));
+	QCOMPARE(doc.getTags(), QList<Tw::Document::TextDocument::Tag>() << tagA << tagC);
+
+	// Removed and added tags
+	spy.clear();
+	const Tw::Document::TextDocument::Tag tagText = makeTag(12, 16, 0, QStringLiteral("Text"));
+	QCOMPARE(doc.replaceTags(0, 12, {}), 1u);
+	QCOMPARE(doc.replaceTags(12, 5, {tagText}), 0u);
+	QCOMPARE(spy.count(), 2);
+	QCOMPARE(spy[0], QList<QVariant>({0, 1, 0}));
+	QCOMPARE(spy[1], QList<QVariant>({0, 0, 1}));
+	QCOMPARE(doc.getTags(), QList<Tw::Document::TextDocument::Tag>() << tagText << tagC);
 }
 
 void TestDocument::getHighlighter()
@@ -173,6 +286,159 @@ void TestDocument::getHighlighter()
 	QCOMPARE(doc.getHighlighter(), &highlighter);
 }
 
+void TestDocument::NonblockingSyntaxHighlighter_staleResults()
+{
+	QStringList lines;
+	for (int i = 0; i < 10; ++i)
+		lines << QStringLiteral("line %1").arg(i);
+	QTextDocument doc(lines.join(QChar::fromLatin1('\n')));
+	GatedHighlighter highlighter(&doc);
+
+	// Wait until the worker is busy with the first block, then edit a block
+	// that is part of the running job
+	QTRY_VERIFY(highlighter.isWaiting());
+	QTextCursor cur(doc.findBlockByNumber(5));
+	cur.insertText(QStringLiteral("X"));
+	highlighter.open();
+	QTRY_VERIFY(!highlighter.hasBlocksToHighlight());
+
+	for (QTextBlock block = doc.begin(); block.isValid(); block = block.next())
+		QCOMPARE(highlightedAs(block), block.text());
+	// The results for the blocks before the edit are applied; the stale one for
+	// the edited block is dropped and the block highlighted again
+	const QStringList highlighted = highlighter.highlightedTexts();
+	QCOMPARE(highlighted.count(QStringLiteral("line 0")), 1);
+	QCOMPARE(highlighted.count(QStringLiteral("line 4")), 1);
+	QCOMPARE(highlighted.count(QStringLiteral("line 5")), 1);
+	QCOMPARE(highlighted.count(QStringLiteral("Xline 5")), 1);
+}
+
+void TestDocument::NonblockingSyntaxHighlighter_stopWorker()
+{
+	QTextDocument doc(QStringLiteral("line 0\nline 1\nline 2"));
+	GatedHighlighter highlighter(&doc);
+
+	QTRY_VERIFY(highlighter.isWaiting());
+	// setPrefix() stops (and waits for) the worker, so the gate must be opened
+	// from another thread
+	QThreadPool pool;
+	QFuture<void> opener = QtConcurrent::run(&pool, [&highlighter]() {
+		QThread::msleep(50);
+		highlighter.open();
+	});
+	highlighter.setPrefix(QStringLiteral("new:"));
+	opener.waitForFinished();
+	QVERIFY(highlighter.highlightedTexts().contains(QStringLiteral("line 0")));
+
+	// None of the results computed with the old prefix may be applied
+	QTRY_VERIFY(!highlighter.hasBlocksToHighlight());
+	for (QTextBlock block = doc.begin(); block.isValid(); block = block.next())
+		QCOMPARE(highlightedAs(block), QStringLiteral("new:") + block.text());
+}
+
+void TestDocument::NonblockingSyntaxHighlighter_priorityRange()
+{
+	QStringList lines;
+	for (int i = 0; i < 100; ++i)
+		lines << QStringLiteral("line %1").arg(i);
+	QTextDocument doc(lines.join(QChar::fromLatin1('\n')));
+	const int end = doc.characterCount();
+	auto pos = [&doc](const int blockNumber) { return doc.findBlockByNumber(blockNumber).position(); };
+
+	// No job is started as long as the event loop is not entered
+	GatedHighlighter highlighter(&doc);
+	QCOMPARE(highlighter.queuedRangeIn(pos(10), pos(20)), qMakePair(pos(10), end));
+
+	highlighter.popHighlightRange(pos(10), pos(20));
+	QCOMPARE(highlighter.queuedRangeIn(pos(12), pos(15)), qMakePair(0, 0));
+	QCOMPARE(highlighter.queuedRangeIn(pos(5), pos(15)), qMakePair(pos(5), pos(10)));
+	QCOMPARE(highlighter.queuedRangeIn(pos(15), pos(25)), qMakePair(pos(20), end));
+
+	// The visible blocks come first, then those following them, then those
+	// preceding them, then the rest of the document front to back
+	highlighter.setPriorityRange(pos(50), pos(60));
+	QCOMPARE(highlighter.nextRangeToHighlight(), qMakePair(pos(50), end));
+	highlighter.popHighlightRange(pos(50), pos(60));
+	QCOMPARE(highlighter.nextRangeToHighlight(), qMakePair(pos(60), end));
+	highlighter.popHighlightRange(pos(60), pos(70));
+	QCOMPARE(highlighter.nextRangeToHighlight(), qMakePair(pos(40), pos(50)));
+	highlighter.popHighlightRange(pos(40), pos(50));
+	QCOMPARE(highlighter.nextRangeToHighlight(), qMakePair(0, pos(10)));
+}
+
+void TestDocument::NonblockingSyntaxHighlighter_scrollAndEdit()
+{
+	QStringList lines;
+	for (int i = 0; i < 1000; ++i)
+		lines << QStringLiteral("line %1").arg(i);
+	QTextDocument doc(lines.join(QChar::fromLatin1('\n')));
+	GatedHighlighter highlighter(&doc);
+
+	// Scroll to the middle of the document before it has been highlighted
+	highlighter.setPriorityRange(doc.findBlockByNumber(500).position(), doc.findBlockByNumber(520).position());
+	QTRY_VERIFY(highlighter.isWaiting());
+	QCOMPARE(highlighter.highlightedTexts().first(), QStringLiteral("line 500"));
+	const int numStale = doc.blockCount() - 500;
+
+	// Insert lines at the top while the worker is busy; the results of the
+	// running job are dropped and the (moved) view is highlighted first again
+	QTextCursor cur(&doc);
+	cur.insertText(QStringLiteral("%\n").repeated(10));
+	highlighter.open();
+	QTRY_VERIFY(!highlighter.hasBlocksToHighlight());
+
+	for (QTextBlock block = doc.begin(); block.isValid(); block = block.next())
+		QCOMPARE(highlightedAs(block), block.text());
+	const QStringList highlighted = highlighter.highlightedTexts();
+	QCOMPARE(highlighted.at(numStale), QStringLiteral("line 500"));
+	QVERIFY(highlighted.indexOf(QStringLiteral("line 519"), numStale) < highlighted.indexOf(QStringLiteral("%")));
+	QVERIFY(highlighted.indexOf(QStringLiteral("line 519"), numStale) < highlighted.indexOf(QStringLiteral("line 0")));
+}
+
+void TestDocument::NonblockingSyntaxHighlighter_checkpoints()
+{
+	QStringList lines;
+	for (int i = 0; i < 2000; ++i)
+		lines << QStringLiteral("line %1").arg(i);
+	QTextDocument doc(lines.join(QChar::fromLatin1('\n')));
+	auto pos = [&doc](const int blockNumber) { return doc.findBlockByNumber(blockNumber).position(); };
+
+	GatedHighlighter highlighter(&doc);
+	highlighter.open();
+	QTRY_VERIFY(!highlighter.hasBlocksToHighlight());
+
+	const int distance = highlighter.maxCheckpointDistance();
+	QVERIFY(2 * distance < 1000);
+
+	// The job starts at the closest highlighted block before the view if it
+	// is near...
+	highlighter.clearHighlightedTexts();
+	highlighter.pushHighlightRange(pos(1000 - distance / 2), doc.characterCount());
+	highlighter.setPriorityRange(pos(1000), pos(1020));
+	QTRY_VERIFY(!highlighter.hasBlocksToHighlight());
+	QCOMPARE(highlighter.highlightedTexts().first(), QStringLiteral("line %1").arg(1000 - distance / 2));
+
+	// ...but not if that would delay highlighting the view
+	highlighter.clearHighlightedTexts();
+	highlighter.pushHighlightRange(pos(1000 - 2 * distance), doc.characterCount());
+	highlighter.setPriorityRange(pos(1000), pos(1020));
+	QTRY_VERIFY(!highlighter.hasBlocksToHighlight());
+	QCOMPARE(highlighter.highlightedTexts().first(), QStringLiteral("line 1000"));
+}
+
+void TestDocument::NonblockingSyntaxHighlighter_benchmark()
+{
+	QTextDocument doc(QStringLiteral("Lorem ipsum dolor sit amet, consectetur adipiscing elit\n").repeated(20000));
+	GatedHighlighter highlighter(&doc);
+	highlighter.open();
+	QTRY_VERIFY_WITH_TIMEOUT(!highlighter.hasBlocksToHighlight(), 60000);
+
+	// Report the time the GUI thread spends per MB of text
+	const NonblockingSyntaxHighlighter::Statistics & statistics = highlighter.statistics();
+	QCOMPARE(statistics.charactersHighlighted, static_cast<qint64>(doc.characterCount()));
+	QTest::setBenchmarkResult(statistics.mainThreadMSecsPerMB(), QTest::WalltimeMilliseconds);
+}
+
 void TestDocument::modelines()
 {
 	Tw::Document::TeXDocument doc(QStringLiteral("Lorem ipsum\n").repeated(200));
@@ -313,6 +579,342 @@ void TestDocument::findNextWord()
 	}
 }
 
+void TestDocument::TextSearch_find_data()
+{
+	QTest::addColumn<QString>("searchText");
+	QTest::addColumn<bool>("useRegex");
+	QTest::addColumn<int>("flags");
+	QTest::addColumn<int>("rangeStart");
+	QTest::addColumn<int>("rangeEnd");
+	QTest::addColumn<int>("expectedStart");
+	QTest::addColumn<int>("expectedEnd");
+
+	const int backward = QTextDocument::FindBackward;
+	const int caseSensitive = QTextDocument::FindCaseSensitively;
+	const int wholeWords = QTextDocument::FindWholeWords;
+
+	// text: "Foo bar\nfoobar foo\nBAR"
+	QTest::newRow("plain") << QStringLiteral("foo") << false << 0 << 0 << 22 << 0 << 3;
+	QTest::newRow("plain-case-sensitive") << QStringLiteral("foo") << false << caseSensitive << 0 << 22 << 8 << 11;
+	QTest::newRow("plain-whole-words") << QStringLiteral("foo") << false << (caseSensitive | wholeWords) << 0 << 22 << 15 << 18;
+	QTest::newRow("plain-range") << QStringLiteral("bar") << false << 0 << 5 << 22 << 11 << 14;
+	QTest::newRow("plain-range-end") << QStringLiteral("bar") << false << 0 << 5 << 13 << -1 << -1;
+	QTest::newRow("plain-backward") << QStringLiteral("bar") << false << backward << 0 << 21 << 11 << 14;
+	QTest::newRow("plain-backward-whole-words") << QStringLiteral("foo") << false << (backward | wholeWords) << 0 << 14 << 0 << 3;
+	QTest::newRow("plain-not-found") << QStringLiteral("baz") << false << 0 << 0 << 22 << -1 << -1;
+	QTest::newRow("regex") << QStringLiteral("o+b") << true << 0 << 0 << 22 << 9 << 12;
+	QTest::newRow("regex-newline") << QStringLiteral("foo\\nbar") << true << 0 << 0 << 22 << 15 << 22;
+	QTest::newRow("regex-backward") << QStringLiteral("f[a-z]+") << true << backward << 0 << 22 << 15 << 18;
+	QTest::newRow("regex-backward-range") << QStringLiteral("f[a-z]+") << true << backward << 0 << 17 << 8 << 14;
+}
+
+void TestDocument::TextSearch_find()
+{
+	QFETCH(QString, searchText);
+	QFETCH(bool, useRegex);
+	QFETCH(int, flags);
+	QFETCH(int, rangeStart);
+	QFETCH(int, rangeEnd);
+	QFETCH(int, expectedStart);
+	QFETCH(int, expectedEnd);
+
+	const QTextDocument::FindFlags findFlags = static_cast<QTextDocument::FindFlags>(flags);
+	const QRegularExpression regex(searchText, (findFlags & QTextDocument::FindCaseSensitively) != 0 ? QRegularExpression::NoPatternOption : QRegularExpression::CaseInsensitiveOption);
+	QTextDocument doc(QStringLiteral("Foo bar\nfoobar foo\nBAR"));
+
+	Tw::Document::TextSearch search(&doc, searchText, (useRegex ? &regex : nullptr), findFlags);
+	Tw::Document::TextSearch::Match match = search.find(rangeStart, rangeEnd);
+	QCOMPARE(match.start, expectedStart);
+	QCOMPARE(match.end, expectedEnd);
+
+	// Plain text searches give the same results as QTextDocument::find()
+	if (!useRegex) {
+		QTextCursor curs = doc.find(searchText, ((findFlags & QTextDocument::FindBackward) != 0 ? rangeEnd : rangeStart), findFlags);
+		if ((findFlags & QTextDocument::FindBackward) != 0 && !curs.isNull() && curs.selectionEnd() > rangeEnd)
+			curs = doc.find(searchText, curs, findFlags);
+		if (!curs.isNull() && (curs.selectionStart() < rangeStart || curs.selectionEnd() > rangeEnd))
+			curs = QTextCursor();
+		QCOMPARE(match.start, curs.isNull() ? -1 : curs.selectionStart());
+		QCOMPARE(match.end, curs.isNull() ? -1 : curs.selectionEnd());
+	}
+}
+
+void TestDocument::TextSearch_replaceAll()
+{
+	QTextDocument doc(QStringLiteral("\\section{One}\n\\section{Two} \\section*{Three}\n"));
+	const QRegularExpression regex(QStringLiteral("\\\\section\\{([^}]*)\\}"));
+
+	Tw::Document::TextSearch search(&doc, regex.pattern(), &regex, {});
+	QCOMPARE(search.findAll(0, search.text().length()).size(), 2);
+
+	int replacedEnd{-1};
+	QCOMPARE(search.replaceAll(&doc, QStringLiteral("\\chapter{\\1}"), 0, search.text().length(), &replacedEnd), 2);
+	QCOMPARE(doc.toPlainText(), QStringLiteral("\\chapter{One}\n\\chapter{Two} \\section*{Three}\n"));
+	QCOMPARE(replacedEnd, 27);
+	// All replacements form a single undo step
+	QCOMPARE(doc.availableUndoSteps(), 1);
+	doc.undo();
+	QCOMPARE(doc.toPlainText(), search.text());
+
+	// Replacements are restricted to the range; empty matches are handled
+	QTextDocument doc2(QStringLiteral("aaa"));
+	const QRegularExpression empty(QStringLiteral("x*"));
+	Tw::Document::TextSearch emptySearch(&doc2, empty.pattern(), &empty, {});
+	QCOMPARE(emptySearch.replaceAll(&doc2, QStringLiteral("-"), 1, 2), 2);
+	QCOMPARE(doc2.toPlainText(), QStringLiteral("a-a-a"));
+
+	QTextDocument doc3(QStringLiteral("a b ab b"));
+	Tw::Document::TextSearch plainSearch(&doc3, QStringLiteral("b"), nullptr, QTextDocument::FindWholeWords);
+	QCOMPARE(plainSearch.replaceAll(&doc3, QStringLiteral("\\1c"), 0, 8), 2);
+	QCOMPARE(doc3.toPlainText(), QStringLiteral("a \\1c ab \\1c"));
+}
+
+void TestDocument::TextSearch_benchmark_data()
+{
+	QTest::addColumn<bool>("useRegex");
+
+	QTest::newRow("plain") << false;
+	QTest::newRow("regex") << true;
+}
+
+void TestDocument::TextSearch_benchmark()
+{
+	QFETCH(bool, useRegex);
+
+	// A synthetic multi-megabyte table as generated by, e.g., pgfplotstable
+	QString text;
+	const int numRows = 40000;
+	text.reserve(numRows * 80);
+	text += QStringLiteral("\\begin{tabular}{rrrrrr}\n");
+	for (int i = 0; i < numRows; ++i)
+		text += QStringLiteral("%1 & %2 & %3 & 0.%4 & \\num{%5} & \\num{%6} \\\\\n").arg(i).arg(i * 7).arg(i % 13).arg(i % 997, 3, 10, QChar::fromLatin1('0')).arg(i * 31).arg(i * 113);
+	text += QStringLiteral("\\end{tabular}\n");
+	QVERIFY(text.length() > 1024 * 1024);
+
+	const QString searchText = (useRegex ? QStringLiteral("\\\\num\\{(\\d+)\\}") : QStringLiteral("\\num"));
+	const QString replacement = (useRegex ? QStringLiteral("\\SI{\\1}{}") : QStringLiteral("\\SI"));
+	const QRegularExpression regex(searchText);
+
+	int replacements{0};
+	QBENCHMARK {
+		QTextDocument doc(text);
+		Tw::Document::TextSearch search(&doc, searchText, (useRegex ? &regex : nullptr), {});
+		replacements = search.replaceAll(&doc, replacement, 0, search.text().length());
+	}
+	QCOMPARE(replacements, 2 * numRows);
+}
+
+static void writeFile(const QString & path, const QByteArray & contents)
+{
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	QFile f(path);
+	QVERIFY(f.open(QIODevice::WriteOnly));
+	f.write(contents);
+}
+
+void TestDocument::ProjectSearch_search()
+{
+	QTemporaryDir tmpDir;
+	QVERIFY(tmpDir.isValid());
+	const QDir dir(tmpDir.path());
+
+	writeFile(dir.filePath(QStringLiteral("project/main.tex")), "\\input{chapter}\n\\include{../extra/appendix}\nneedle\n");
+	writeFile(dir.filePath(QStringLiteral("project/chapter.tex")), "no match here\r\nbut a needle and another needle\r\n");
+	writeFile(dir.filePath(QStringLiteral("project/sub/refs.bib")), "@book{needle, title={Needles}}\n");
+	writeFile(dir.filePath(QStringLiteral("project/main.log")), "needle\n");
+	writeFile(dir.filePath(QStringLiteral("extra/appendix.tex")), "needle\n");
+	writeFile(dir.filePath(QStringLiteral("extra/unrelated.tex")), "needle\n");
+
+	// The open main.tex has unsaved changes; the untitled document is only
+	// identified by its QTextDocument
+	QTextDocument mainDoc, untitledDoc;
+	QVector<Tw::Document::ProjectSearch::OpenDocument> openDocuments;
+	openDocuments.append({&mainDoc, dir.filePath(QStringLiteral("project/main.tex")), QStringLiteral("\\input{chapter}\n\\include{../extra/appendix}\nneedle needle\n")});
+	openDocuments.append({&untitledDoc, QString(), QStringLiteral("needle")});
+
+	Tw::Document::ProjectSearch search(QStringLiteral("needle"), nullptr, QTextDocument::FindWholeWords);
+	QMap<QString, QVector<Tw::Document::ProjectSearch::Hit> > results;
+	QMap<QString, QTextDocument *> documents;
+	connect(&search, &Tw::Document::ProjectSearch::resultsFound, this, [&results, &documents](const QString & fileName, QTextDocument * document, const QVector<Tw::Document::ProjectSearch::Hit> & hits) {
+		const QString key = (fileName.isEmpty() ? QStringLiteral("<untitled>") : QFileInfo(fileName).fileName());
+		QVERIFY(!results.contains(key));
+		results.insert(key, hits);
+		documents.insert(key, document);
+	});
+	// finished() is emitted from a worker thread
+	QSignalSpy spy(&search, SIGNAL(finished()));
+	search.start(dir.filePath(QStringLiteral("project/main.tex")), openDocuments, QTextCodec::codecForName("UTF-8"));
+	QTRY_VERIFY(spy.count() > 0);
+	// Process the remaining queued results
+	QCoreApplication::processEvents();
+
+	QCOMPARE(results.keys(), QStringList() << QStringLiteral("<untitled>") << QStringLiteral("appendix.tex") << QStringLiteral("chapter.tex") << QStringLiteral("main.tex") << QStringLiteral("refs.bib"));
+	QCOMPARE(results[QStringLiteral("main.tex")].size(), 2);
+	QCOMPARE(documents[QStringLiteral("main.tex")], &mainDoc);
+	QCOMPARE(documents[QStringLiteral("<untitled>")], &untitledDoc);
+	QCOMPARE(documents[QStringLiteral("chapter.tex")], static_cast<QTextDocument *>(nullptr));
+	QCOMPARE(search.numFilesSearched(), 5);
+
+	const QVector<Tw::Document::ProjectSearch::Hit> & hits = results[QStringLiteral("chapter.tex")];
+	QCOMPARE(hits.size(), 2);
+	QCOMPARE(hits[0].lineNo, 2);
+	QCOMPARE(hits[0].selStart, 6);
+	QCOMPARE(hits[0].selEnd, 12);
+	QCOMPARE(hits[1].selStart, 25);
+	QCOMPARE(hits[1].lineText, QStringLiteral("but a needle and another needle"));
+}
+
+void TestDocument::ProjectSearch_cancel()
+{
+	QTemporaryDir tmpDir;
+	QVERIFY(tmpDir.isValid());
+	const QDir dir(tmpDir.path());
+
+	for (int i = 0; i < 200; ++i)
+		writeFile(dir.filePath(QStringLiteral("dir%1/file%2.tex").arg(i % 10).arg(i)), QByteArray(10000, 'x') + "needle");
+
+	Tw::Document::ProjectSearch search(QStringLiteral("needle"), nullptr, {});
+	QSignalSpy spy(&search, SIGNAL(finished()));
+	search.start(dir.filePath(QStringLiteral("main.tex")), {}, nullptr);
+	search.cancel();
+	QVERIFY(search.wasCanceled());
+	// finished() is emitted even if the search was canceled (from a worker
+	// thread)
+	QTRY_VERIFY(spy.count() > 0);
+	QVERIFY(!search.isRunning());
+	QVERIFY(search.numFilesSearched() < 200);
+}
+
+static QStringList symbolNames(const QVector<Tw::Document::ProjectIndex::Symbol> & symbols, const Tw::Document::ProjectIndex::Symbol::Type type)
+{
+	QStringList retVal;
+	foreach (const Tw::Document::ProjectIndex::Symbol & symbol, symbols) {
+		if (symbol.type == type)
+			retVal << symbol.name;
+	}
+	return retVal;
+}
+
+void TestDocument::ProjectIndex_scanTeX()
+{
+	using Symbol = Tw::Document::ProjectIndex::Symbol;
+
+	const QString text = QStringLiteral(
+		"% !TEX bibfile = modeline.bib\n"
+		"\\newcommand{\\vect}[1]{\\mathbf{#1}}\\renewcommand*\\emph{}\n"
+		"\\DeclareMathOperator{\\Tr}{Tr} \\def\\foo{} \\let\\bar\\relax\n"
+		"\\newenvironment{myproof}{}{} \\newtheorem{lemma}{Lemma}\n"
+		"\\section{Intro}\\label{sec:intro} % \\label{commented}\n"
+		"50\\% \\label{eq:1}\n"
+		"\\input{chapters/one}\\include{two}\n"
+		"\\bibliography{refs, more}\\addbibresource[label=x]{extra.bib}\n"
+	);
+	QVector<Symbol> symbols;
+	QStringList includes, bibFiles;
+	Tw::Document::ProjectIndex::scanTeX(text, symbols, includes, bibFiles);
+
+	QCOMPARE(symbolNames(symbols, Symbol::Label), QStringList({QStringLiteral("sec:intro"), QStringLiteral("eq:1")}));
+	QCOMPARE(symbolNames(symbols, Symbol::Command), QStringList({QStringLiteral("\\vect"), QStringLiteral("\\emph"), QStringLiteral("\\Tr"), QStringLiteral("\\foo"), QStringLiteral("\\bar")}));
+	QCOMPARE(symbolNames(symbols, Symbol::Environment), QStringList({QStringLiteral("myproof"), QStringLiteral("lemma")}));
+	QCOMPARE(symbolNames(symbols, Symbol::Citation), QStringList());
+	QCOMPARE(includes, QStringList({QStringLiteral("chapters/one"), QStringLiteral("two")}));
+	QCOMPARE(bibFiles, QStringList({QStringLiteral("modeline.bib"), QStringLiteral("refs"), QStringLiteral("more"), QStringLiteral("extra.bib")}));
+}
+
+void TestDocument::ProjectIndex_update()
+{
+	using Symbol = Tw::Document::ProjectIndex::Symbol;
+
+	QTemporaryDir tmpDir;
+	QVERIFY(tmpDir.isValid());
+	const QDir dir(tmpDir.path());
+
+	writeFile(dir.filePath(QStringLiteral("project/main.tex")), "\\input{chapter}\n\\bibliography{sub/refs}\n\\label{main}\n");
+	writeFile(dir.filePath(QStringLiteral("project/chapter.tex")), "\\label{chapter}\\label{main}\\newcommand\\chapcmd{}\n\\input{chapter}\n");
+	writeFile(dir.filePath(QStringLiteral("project/sub/refs.bib")), "@book{knuth84, title={The TeXbook}}\n@comment{x}\n@article{lamport94,}\n");
+	writeFile(dir.filePath(QStringLiteral("project/unrelated.tex")), "\\label{unrelated}\n");
+
+	Tw::Document::ProjectIndex index;
+	QSignalSpy spy(&index, SIGNAL(updated()));
+	QVERIFY(spy.isValid());
+
+	const QString mainFile = dir.filePath(QStringLiteral("project/main.tex"));
+	index.update(mainFile, {});
+	QVERIFY(spy.wait());
+	QCOMPARE(index.numFilesIndexed(), 3);
+	// Duplicates are removed; the order is that of the files
+	QCOMPARE(symbolNames(index.symbols(), Symbol::Label), QStringList({QStringLiteral("main"), QStringLiteral("chapter")}));
+	QCOMPARE(symbolNames(index.symbols(), Symbol::Command), QStringList({QStringLiteral("\\chapcmd")}));
+	QCOMPARE(symbolNames(index.symbols(), Symbol::Citation), QStringList({QStringLiteral("knuth84"), QStringLiteral("lamport94")}));
+
+	// Nothing changed, so updated() is not emitted
+	index.update(mainFile, {});
+	QTRY_VERIFY(!index.isUpdating());
+	QCoreApplication::processEvents();
+	QCOMPARE(spy.count(), 1);
+
+	// Unsaved changes of open documents take precedence over the files
+	QHash<QString, QString> openDocuments;
+	openDocuments.insert(mainFile, QStringLiteral("\\input{chapter}\n\\label{edited}\n"));
+	index.update(mainFile, openDocuments);
+	QVERIFY(spy.wait());
+	QCOMPARE(index.numFilesIndexed(), 2);
+	QCOMPARE(symbolNames(index.symbols(), Symbol::Label), QStringList({QStringLiteral("edited"), QStringLiteral("chapter"), QStringLiteral("main")}));
+	QCOMPARE(symbolNames(index.symbols(), Symbol::Citation), QStringList());
+
+	// Requests while an update is running are coalesced; the last one wins
+	openDocuments.insert(mainFile, QStringLiteral("\\label{first}\n"));
+	index.update(mainFile, openDocuments);
+	openDocuments.insert(mainFile, QStringLiteral("\\label{second}\n"));
+	index.update(mainFile, openDocuments);
+	QTRY_VERIFY(!index.isUpdating());
+	QCoreApplication::processEvents();
+	QTRY_COMPARE(symbolNames(index.symbols(), Symbol::Label), QStringList({QStringLiteral("second")}));
+
+	// Untitled documents without a root file
+	openDocuments.clear();
+	openDocuments.insert(QStringLiteral("untitled-1.tex"), QStringLiteral("\\label{untitled}"));
+	index.update(QStringLiteral("untitled-1.tex"), openDocuments);
+	QVERIFY(spy.wait());
+	QCOMPARE(symbolNames(index.symbols(), Symbol::Label), QStringList({QStringLiteral("untitled")}));
+}
+
+void TestDocument::ProjectIndex_forRootFile()
+{
+	using ProjectIndex = Tw::Document::ProjectIndex;
+
+	QTemporaryDir tmpDir;
+	QVERIFY(tmpDir.isValid());
+	const QDir dir(tmpDir.path());
+
+	writeFile(dir.filePath(QStringLiteral("project/main.tex")), "\\input{chapter}\n");
+	writeFile(dir.filePath(QStringLiteral("project/chapter.tex")), "\\label{chapter}\n");
+	const QString mainFile = dir.filePath(QStringLiteral("project/main.tex"));
+
+	// Documents of the same project share the index; untitled ones don't
+	QSharedPointer<ProjectIndex> index = ProjectIndex::forRootFile(mainFile);
+	QVERIFY(index);
+	QVERIFY(ProjectIndex::forRootFile(dir.filePath(QStringLiteral("project/../project/main.tex"))) == index);
+	QVERIFY(ProjectIndex::forRootFile(QStringLiteral("untitled-1.tex")) != ProjectIndex::forRootFile(QStringLiteral("untitled-1.tex")));
+
+	QSignalSpy spy(index.data(), SIGNAL(updated()));
+	QVERIFY(spy.isValid());
+	index->update(mainFile, {});
+	QVERIFY(spy.wait());
+	QCOMPARE(symbolNames(index->symbols(), ProjectIndex::Symbol::Label), QStringList({QStringLiteral("chapter")}));
+
+	// Changes to the indexed files are picked up without an explicit update
+	QTest::qSleep(10);
+	writeFile(dir.filePath(QStringLiteral("project/chapter.tex")), "\\label{changed}\n");
+	QVERIFY(spy.wait());
+	QCOMPARE(symbolNames(index->symbols(), ProjectIndex::Symbol::Label), QStringList({QStringLiteral("changed")}));
+
+	// The index is deleted along with the last reference
+	const QPointer<ProjectIndex> guard(index.data());
+	index.clear();
+	QVERIFY(guard.isNull());
+}
+
 void TestDocument::SpellChecker_getDictionaryList()
 {
 	auto * sc = Tw::Document::SpellChecker::instance();
@@ -363,6 +965,48 @@ void TestDocument::SpellChecker_getDictionary()
 	QCOMPARE(d->suggestionsForWord(wrongWord), QList<QString>{correctWord});
 }
 
+void TestDocument::SpellChecker_requestDictionary()
+{
+	QString lang{QStringLiteral("dictionary")};
+
+	auto * sc = Tw::Document::SpellChecker::instance();
+	Q_ASSERT(sc != nullptr);
+	QSignalSpy spy(sc, SIGNAL(dictionaryLoaded(const QString &)));
+	QVERIFY(spy.isValid());
+
+	sc->clearDictionaries();
+	QVERIFY(sc->requestDictionary(QString()) == nullptr);
+	QVERIFY(sc->requestDictionary(QStringLiteral("does-not-exist")) == nullptr);
+	QCOMPARE(sc->isLoading(QStringLiteral("does-not-exist")), false);
+
+	QVERIFY(sc->requestDictionary(lang) == nullptr);
+	QCOMPARE(sc->isLoading(lang), true);
+	// Requesting the dictionary again must not start loading it again
+	QVERIFY(sc->requestDictionary(lang) == nullptr);
+
+	QVERIFY(spy.wait());
+	QCOMPARE(spy.count(), 1);
+	QCOMPARE(spy[0][0].toString(), lang);
+	QCOMPARE(sc->isLoading(lang), false);
+
+	auto * d = sc->requestDictionary(lang);
+	QVERIFY(d != nullptr);
+	QCOMPARE(sc->getDictionary(lang), d);
+	QCOMPARE(d->isWordCorrect(QStringLiteral("World")), true);
+
+	// getDictionary() waits for dictionaries that are being loaded
+	sc->clearDictionaries();
+	QVERIFY(sc->requestDictionary(lang) == nullptr);
+	d = sc->getDictionary(lang);
+	QVERIFY(d != nullptr);
+	QCOMPARE(sc->isLoading(lang), false);
+	QCOMPARE(d->isWordCorrect(QStringLiteral("Wrld")), false);
+	// The finished loading must not be reported (or applied) twice
+	QTest::qWait(50);
+	QCOMPARE(spy.count(), 2);
+	QCOMPARE(sc->getDictionary(lang), d);
+}
+
 void TestDocument::SpellChecker_ignoreWord()
 {
 	QString lang{QStringLiteral("dictionary")};
@@ -390,6 +1034,33 @@ void TestDocument::SpellChecker_ignoreWord()
 	}
 }
 
+void TestDocument::SpellChecker_isWordCorrect_concurrent()
+{
+	QString lang{QStringLiteral("dictionary")};
+	QStringList words;
+	for (int i = 0; i < 1000; ++i)
+		words << (i % 2 == 0 ? QStringLiteral("World") : QStringLiteral("Wrld"));
+
+	auto * sc = Tw::Document::SpellChecker::instance();
+	Q_ASSERT(sc != nullptr);
+	sc->clearDictionaries();
+	auto * d = sc->getDictionary(lang);
+	Q_ASSERT(d != nullptr);
+
+	// Check the words from several threads at once; all of them must get the
+	// same verdicts, whether they are cached already or not
+	auto check = [d](const QString & word) { return d->isWordCorrect(word); };
+	const QList<bool> verdicts = QtConcurrent::blockingMapped<QList<bool> >(words, std::function<bool(const QString &)>(check));
+	QCOMPARE(verdicts.size(), words.size());
+	for (int i = 0; i < verdicts.size(); ++i)
+		QCOMPARE(verdicts[i], i % 2 == 0);
+
+	d->ignoreWord(QStringLiteral("Wrld"));
+	QCOMPARE(d->isWordCorrect(QStringLiteral("Wrld")), true);
+	QCOMPARE(d->isWordCorrect(QStringLiteral("World")), true);
+	sc->clearDictionaries();
+}
+
 } // namespace UnitTest
 
 #if defined(STATIC_QT5) && defined(Q_OS_WIN)
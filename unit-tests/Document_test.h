@@ -39,15 +39,35 @@ private slots:
 	void absoluteFilePath();
 
 	void tags();
+	void replaceTags();
 
 	void getHighlighter();
+	void NonblockingSyntaxHighlighter_staleResults();
+	void NonblockingSyntaxHighlighter_stopWorker();
+	void NonblockingSyntaxHighlighter_priorityRange();
+	void NonblockingSyntaxHighlighter_scrollAndEdit();
+	void NonblockingSyntaxHighlighter_checkpoints();
+	void NonblockingSyntaxHighlighter_benchmark();
 	void modelines();
 	void findNextWord_data();
 	void findNextWord();
 
+	void TextSearch_find_data();
+	void TextSearch_find();
+	void TextSearch_replaceAll();
+	void TextSearch_benchmark_data();
+	void TextSearch_benchmark();
+	void ProjectSearch_search();
+	void ProjectSearch_cancel();
+	void ProjectIndex_scanTeX();
+	void ProjectIndex_update();
+	void ProjectIndex_forRootFile();
+
 	void SpellChecker_getDictionaryList();
 	void SpellChecker_getDictionary();
+	void SpellChecker_requestDictionary();
 	void SpellChecker_ignoreWord();
+	void SpellChecker_isWordCorrect_concurrent();
 };
 
 } // namespace UnitTest
@@ -0,0 +1,425 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#include "Synchronizer_test.h"
+
+#include "TWSynchronizer.h"
+#include "document/TeXDocument.h"
+
+#include <algorithm>
+#include <tuple>
+
+// The fine synchronization needs the text of the documents, which the tests do
+// not provide; so the TeX parsing it relies on is not needed either
+bool Tw::Document::TeXDocument::findNextWord(const QString & text, int index, int & start, int & end) { Q_UNUSED(text) start = end = index; return false; }
+
+namespace UnitTest {
+
+// Exposes the index of TWSyncTeXSynchronizer so it can be compared to the
+// queries of SyncTeX itself
+class IndexedSynchronizer : public TWSyncTeXSynchronizer
+{
+public:
+	explicit IndexedSynchronizer(const QString & filename) : TWSyncTeXSynchronizer(filename) { }
+
+	using TWSyncTeXSynchronizer::_boxes;
+	using TWSyncTeXSynchronizer::_boxesForLine;
+	using TWSyncTeXSynchronizer::_linesAt;
+	using TWSyncTeXSynchronizer::_tagForFile;
+};
+
+// Provides made-up text for the fine synchronization (the same for all lines)
+// and counts how often it is requested
+class TextSynchronizer : public IndexedSynchronizer
+{
+public:
+	explicit TextSynchronizer(const QString & filename) : IndexedSynchronizer(filename) { }
+
+	static QString text() { return QString::fromLatin1("Hello synchronized world"); }
+	// The text is laid out in the first box of a line, one unit per character
+	static QRectF charBox(const QRectF & box, const int col) { return QRectF(box.left() + col, box.top(), 1, box.height()); }
+
+	mutable int texTextCalls{0};
+	mutable int pdfTextCalls{0};
+
+protected:
+	QString _texText(const QString & filename, const int line, const bool open) const override {
+		Q_UNUSED(filename) Q_UNUSED(line) Q_UNUSED(open)
+		++texTextCalls;
+		return text();
+	}
+	QString _pdfText(const QString & filename, const int page, const QList<QRectF> & rects, QMap<int, QRectF> * wordBoxes, QMap<int, QRectF> * charBoxes) const override {
+		Q_UNUSED(filename) Q_UNUSED(page)
+		++pdfTextCalls;
+		if (rects.isEmpty())
+			return QString();
+		for (int i = 0; i < text().length(); ++i) {
+			if (wordBoxes)
+				wordBoxes->insert(i, charBox(rects.first(), i));
+			if (charBoxes)
+				charBoxes->insert(i, charBox(rects.first(), i));
+		}
+		return text();
+	}
+};
+
+// Plain SyncTeX scanner to compare the synchronizer to
+class Scanner
+{
+public:
+	explicit Scanner(const QString & filename) : _scanner(SyncTeX::synctex_scanner_new_with_output_file(filename.toLocal8Bit().data(), nullptr, 1)) { }
+	~Scanner() { if (_scanner) SyncTeX::synctex_scanner_free(_scanner); }
+	SyncTeX::synctex_scanner_p get() const { return _scanner; }
+private:
+	Q_DISABLE_COPY(Scanner)
+	SyncTeX::synctex_scanner_p _scanner;
+};
+
+// Page and enclosing box of each node found by a query
+typedef QVector< QPair<int, QRectF> > QueryResult;
+
+static QueryResult displayQuery(const Scanner & scanner, const QByteArray & name, const int line, const int pageHint)
+{
+	QueryResult retVal;
+	if (SyncTeX::synctex_display_query(scanner.get(), name.data(), line, -1, pageHint) > 0) {
+		SyncTeX::synctex_node_p node{nullptr};
+		while ((node = SyncTeX::synctex_scanner_next_result(scanner.get()))) {
+			retVal.append(qMakePair(SyncTeX::synctex_node_page(node),
+									QRectF(SyncTeX::synctex_node_box_visible_h(node),
+										   SyncTeX::synctex_node_box_visible_v(node) - SyncTeX::synctex_node_box_visible_height(node),
+										   SyncTeX::synctex_node_box_visible_width(node),
+										   SyncTeX::synctex_node_box_visible_height(node) + SyncTeX::synctex_node_box_visible_depth(node))));
+		}
+	}
+	return retVal;
+}
+
+// Sorts the rects from top to bottom and removes duplicates (the synchronizer
+// and SyncTeX may report them in different order and SyncTeX reports a box
+// for each of the nodes it contains)
+static QList<QRectF> sortedRects(QList<QRectF> rects)
+{
+	std::sort(rects.begin(), rects.end(), [](const QRectF & a, const QRectF & b) {
+		return std::make_tuple(a.top(), a.left(), a.width(), a.height()) < std::make_tuple(b.top(), b.left(), b.width(), b.height());
+	});
+	rects.erase(std::unique(rects.begin(), rects.end()), rects.end());
+	return rects;
+}
+
+static QList<QRectF> rectsOnPage(const QueryResult & result, const int page)
+{
+	QList<QRectF> retVal;
+	foreach (const auto & node, result) {
+		if (node.first == page)
+			retVal.append(node.second);
+	}
+	return sortedRects(retVal);
+}
+
+void TestSynchronizer::syncFromTeX_data()
+{
+	QTest::addColumn<QString>("pdfFile");
+	QTest::addColumn<QString>("texFile");
+
+	QTest::newRow("one page") << QString::fromLatin1("sync.pdf") << QString::fromLatin1("sync.tex");
+	QTest::newRow("two pages") << QString::fromLatin1("sync-pages.pdf") << QString::fromLatin1("sync-pages.tex");
+}
+
+void TestSynchronizer::syncFromTeX()
+{
+	QFETCH(QString, pdfFile);
+	QFETCH(QString, texFile);
+
+	IndexedSynchronizer sync(pdfFile);
+	Scanner scanner(pdfFile);
+	QVERIFY(sync.isValid());
+	QVERIFY(scanner.get() != nullptr);
+
+	const int tag = sync._tagForFile(texFile);
+	QVERIFY(tag > 0);
+	const QByteArray name(SyncTeX::synctex_scanner_get_name(scanner.get(), tag));
+
+	QFile file(texFile);
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	const int numLines = static_cast<int>(file.readAll().count('\n')) + 1;
+
+	int numIndexed{0};
+	// Also check a line past the end of the file
+	for (int line = 1; line <= numLines + 1; ++line) {
+		const QueryResult expected = displayQuery(scanner, name, line, -1);
+		const int expectedPage = (expected.isEmpty() ? -1 : expected.first().first);
+
+		const TWSynchronizer::PDFSyncPoint point = sync.syncFromTeX({texFile, line, -1, -1}, TWSynchronizer::LineResolution);
+		QCOMPARE(point.page, expectedPage);
+		QCOMPARE(sortedRects(point.rects), rectsOnPage(expected, expectedPage));
+
+		// Lines without nodes are not in the index (syncFromTeX() falls back to
+		// SyncTeX's query for them, which picks a nearby line)
+		int page = -1;
+		if (sync._boxesForLine(tag, line, page).isEmpty())
+			continue;
+		++numIndexed;
+		QCOMPARE(page, expectedPage);
+		// The index must find the same boxes on every page the line is on
+		foreach (const auto & node, expected) {
+			page = node.first;
+			QCOMPARE(sortedRects(sync._boxesForLine(tag, line, page)), rectsOnPage(expected, node.first));
+			QCOMPARE(page, node.first);
+		}
+	}
+	QVERIFY(numIndexed > 0);
+}
+
+void TestSynchronizer::syncFromTeX_multiLine()
+{
+	const QString pdfFile = QString::fromLatin1("sync-pages.pdf");
+	const QString texFile = QString::fromLatin1("sync-pages.tex");
+	IndexedSynchronizer sync(pdfFile);
+	Scanner scanner(pdfFile);
+	const QByteArray name(SyncTeX::synctex_scanner_get_name(scanner.get(), sync._tagForFile(texFile)));
+
+	// The paragraph on lines 7-9 is typeset on three lines in the PDF; lines 8
+	// and 9 each end up on two of them
+	for (const int line : {8, 9}) {
+		const TWSynchronizer::PDFSyncPoint point = sync.syncFromTeX({texFile, line, -1, -1}, TWSynchronizer::LineResolution);
+		QCOMPARE(point.page, 1);
+		QCOMPARE(point.rects.size(), 2);
+		QCOMPARE(sortedRects(point.rects), rectsOnPage(displayQuery(scanner, name, line, -1), 1));
+	}
+	// The two lines share the box in the middle
+	QCOMPARE(sync.syncFromTeX({texFile, 8, -1, -1}, TWSynchronizer::LineResolution).rects.last(),
+			 sync.syncFromTeX({texFile, 9, -1, -1}, TWSynchronizer::LineResolution).rects.first());
+}
+
+void TestSynchronizer::syncFromTeX_pageBreak()
+{
+	const QString pdfFile = QString::fromLatin1("sync-pages.pdf");
+	const QString texFile = QString::fromLatin1("sync-pages.tex");
+	IndexedSynchronizer sync(pdfFile);
+	Scanner scanner(pdfFile);
+	const int tag = sync._tagForFile(texFile);
+	const QByteArray name(SyncTeX::synctex_scanner_get_name(scanner.get(), tag));
+
+	// Line 11 is at the bottom of page 1 and continues at the top of page 2;
+	// without a hint, the first page is used
+	int page = -1;
+	QCOMPARE(sync._boxesForLine(tag, 11, page).size(), 1);
+	QCOMPARE(page, 1);
+	QCOMPARE(sync.syncFromTeX({texFile, 11, -1, -1}, TWSynchronizer::LineResolution).page, 1);
+
+	// With a hint, SyncTeX puts the boxes on the requested page first
+	const QueryResult expected = displayQuery(scanner, name, 11, 2);
+	QVERIFY(!expected.isEmpty());
+	QCOMPARE(expected.first().first, 2);
+	page = 2;
+	QCOMPARE(sortedRects(sync._boxesForLine(tag, 11, page)), rectsOnPage(expected, 2));
+	QCOMPARE(rectsOnPage(expected, 2).size(), 1);
+
+	// Line 12 is only on page 2
+	const TWSynchronizer::PDFSyncPoint point = sync.syncFromTeX({texFile, 12, -1, -1}, TWSynchronizer::LineResolution);
+	QCOMPARE(point.page, 2);
+	QCOMPARE(point.rects, rectsOnPage(displayQuery(scanner, name, 12, -1), 2));
+}
+
+void TestSynchronizer::syncFromPDF_data()
+{
+	QTest::addColumn<QString>("pdfFile");
+
+	QTest::newRow("one page") << QString::fromLatin1("sync.pdf");
+	QTest::newRow("two pages") << QString::fromLatin1("sync-pages.pdf");
+}
+
+void TestSynchronizer::syncFromPDF()
+{
+	QFETCH(QString, pdfFile);
+
+	IndexedSynchronizer sync(pdfFile);
+	Scanner scanner(pdfFile);
+	QVERIFY(!sync._boxes.isEmpty());
+
+	// Click at several points along each box; for multi-line paragraphs, this
+	// hits the parts of different input lines
+	foreach (const auto & box, sync._boxes) {
+		const QRectF rect = box.rect();
+		for (int i = 1; i < 10; i += 2) {
+			const float x = static_cast<float>(rect.left() + rect.width() * i / 10);
+			const float y = static_cast<float>(rect.center().y());
+
+			QVector< QPair<int, int> > expected;
+			if (SyncTeX::synctex_edit_query(scanner.get(), box.page, x, y) > 0) {
+				SyncTeX::synctex_node_p node{nullptr};
+				while ((node = SyncTeX::synctex_scanner_next_result(scanner.get())))
+					expected.append(qMakePair(SyncTeX::synctex_node_tag(node), SyncTeX::synctex_node_line(node)));
+			}
+			QVERIFY(!expected.isEmpty());
+
+			const QPointF pt(static_cast<qreal>(x), static_cast<qreal>(y));
+			const QVector< QPair<int, int> > lines = sync._linesAt(box.page, pt);
+			QVERIFY(!lines.isEmpty());
+			QCOMPARE(lines.first().first, expected.first().first);
+			QCOMPARE(lines.first().second, expected.first().second);
+
+			const TWSynchronizer::TeXSyncPoint point = sync.syncFromPDF({pdfFile, box.page, {QRectF(pt, QSizeF())}}, TWSynchronizer::LineResolution);
+			QCOMPARE(point.filename, QString::fromLocal8Bit(SyncTeX::synctex_scanner_get_name(scanner.get(), expected.first().first)));
+			QCOMPARE(point.line, expected.first().second);
+		}
+	}
+}
+
+void TestSynchronizer::syncLinesFromTeX()
+{
+	const QString pdfFile = QString::fromLatin1("sync-pages.pdf");
+	const QString texFile = QString::fromLatin1("sync-pages.tex");
+	IndexedSynchronizer sync(pdfFile);
+	Scanner scanner(pdfFile);
+	const QByteArray name(SyncTeX::synctex_scanner_get_name(scanner.get(), sync._tagForFile(texFile)));
+
+	// Lines 7-12 cover the paragraph typeset on three lines (whose input lines
+	// share boxes) and the one broken across the page break
+	QMap<int, QList<QRectF> > expected;
+	for (int line = 7; line <= 12; ++line) {
+		foreach (const auto & node, displayQuery(scanner, name, line, -1))
+			expected[node.first].append(node.second);
+	}
+	const QVector<TWSynchronizer::PDFSyncPoint> points = sync.syncLinesFromTeX(texFile, 7, 12);
+	// One point per page, in page order
+	QCOMPARE(points.size(), expected.size());
+	QCOMPARE(points[0].page, 1);
+	QCOMPARE(points[1].page, 2);
+	for (int i = 0; i < points.size(); ++i) {
+		QCOMPARE(points[i].filename, sync.pdfFilename());
+		// Each box is reported once, in document order (i.e., from top to
+		// bottom here)
+		QCOMPARE(points[i].rects, sortedRects(expected[points[i].page]));
+	}
+	QCOMPARE(points[0].rects.size(), 4);
+	QCOMPARE(points[1].rects.size(), 1);
+
+	// A single line gives the same boxes as syncFromTeX()
+	const QVector<TWSynchronizer::PDFSyncPoint> single = sync.syncLinesFromTeX(texFile, 8, 8);
+	QCOMPARE(single.size(), 1);
+	QCOMPARE(single[0].page, 1);
+	QCOMPARE(single[0].rects, sync.syncFromTeX({texFile, 8, -1, -1}, TWSynchronizer::LineResolution).rects);
+
+	// Lines without nodes, empty ranges, and unknown files have no boxes
+	QVERIFY(sync.syncLinesFromTeX(texFile, 1, 4).isEmpty());
+	QVERIFY(sync.syncLinesFromTeX(texFile, 12, 7).isEmpty());
+	QVERIFY(sync.syncLinesFromTeX(QString::fromLatin1("does-not-exist.tex"), 1, 20).isEmpty());
+}
+
+void TestSynchronizer::syncPoints()
+{
+	const QString pdfFile = QString::fromLatin1("sync-pages.pdf");
+	const QString texFile = QString::fromLatin1("sync-pages.tex");
+	IndexedSynchronizer sync(pdfFile);
+
+	// The batch versions must give the same results as synchronizing each
+	// point on its own (which is what the default implementations do)
+	const QVector<TWSynchronizer::TeXSyncPoint> texPoints{
+		{texFile, 8, 0, 1}, {texFile, 8, 5, 1}, {texFile, 12, -1, -1}, {texFile, 8, -1, -1},
+		{texFile, 2, -1, -1}, {QString::fromLatin1("does-not-exist.tex"), 1, -1, -1}
+	};
+	const QVector<TWSynchronizer::PDFSyncPoint> pdfResults = sync.syncPointsFromTeX(texPoints, TWSynchronizer::LineResolution);
+	const QVector<TWSynchronizer::PDFSyncPoint> expectedPdfResults = sync.TWSynchronizer::syncPointsFromTeX(texPoints, TWSynchronizer::LineResolution);
+	QCOMPARE(pdfResults.size(), texPoints.size());
+	QCOMPARE(expectedPdfResults.size(), texPoints.size());
+	for (int i = 0; i < texPoints.size(); ++i) {
+		QCOMPARE(pdfResults[i].filename, expectedPdfResults[i].filename);
+		QCOMPARE(pdfResults[i].page, expectedPdfResults[i].page);
+		QCOMPARE(pdfResults[i].rects, expectedPdfResults[i].rects);
+	}
+	QVERIFY(pdfResults[0].page > 0);
+	QCOMPARE(pdfResults[5].page, -1);
+
+	QVector<TWSynchronizer::PDFSyncPoint> pdfPoints;
+	foreach (const auto & box, sync._boxes) {
+		pdfPoints.append({pdfFile, box.page, {QRectF(box.rect().topLeft() + QPointF(1, 1), QSizeF())}});
+		pdfPoints.append({pdfFile, box.page, {QRectF(box.rect().center(), QSizeF())}});
+	}
+	// Invalid points
+	pdfPoints.append({pdfFile, 1, QList<QRectF>()});
+	pdfPoints.append({pdfFile, 3, {QRectF(100, 100, 0, 0)}});
+	const QVector<TWSynchronizer::TeXSyncPoint> texResults = sync.syncPointsFromPDF(pdfPoints, TWSynchronizer::LineResolution);
+	const QVector<TWSynchronizer::TeXSyncPoint> expectedTexResults = sync.TWSynchronizer::syncPointsFromPDF(pdfPoints, TWSynchronizer::LineResolution);
+	QCOMPARE(texResults.size(), pdfPoints.size());
+	QCOMPARE(expectedTexResults.size(), pdfPoints.size());
+	for (int i = 0; i < pdfPoints.size(); ++i) {
+		QCOMPARE(texResults[i].filename, expectedTexResults[i].filename);
+		QCOMPARE(texResults[i].line, expectedTexResults[i].line);
+		QCOMPARE(texResults[i].col, expectedTexResults[i].col);
+		QCOMPARE(texResults[i].len, expectedTexResults[i].len);
+	}
+	QVERIFY(texResults.first().line > 0);
+	QCOMPARE(texResults[texResults.size() - 2].line, -1);
+	QCOMPARE(texResults.last().line, -1);
+}
+
+void TestSynchronizer::syncPoints_fine()
+{
+	const QString pdfFile = QString::fromLatin1("sync-pages.pdf");
+	const QString texFile = QString::fromLatin1("sync-pages.tex");
+	TextSynchronizer sync(pdfFile);
+
+	// Points on the same line share the text the fine synchronization works
+	// on, so it is only requested once per line
+	const QVector<int> cols{0, 6, 13};
+	QVector<TWSynchronizer::TeXSyncPoint> texPoints;
+	foreach (const int col, cols)
+		texPoints.append({texFile, 8, col, 1});
+	texPoints.append({texFile, 12, 6, 1});
+	const QVector<TWSynchronizer::PDFSyncPoint> pdfResults = sync.syncPointsFromTeX(texPoints, TWSynchronizer::CharacterResolution);
+	QCOMPARE(sync.texTextCalls, 2);
+	QCOMPARE(sync.pdfTextCalls, 2);
+
+	QCOMPARE(pdfResults.size(), texPoints.size());
+	for (int i = 0; i < texPoints.size(); ++i) {
+		const TWSynchronizer::PDFSyncPoint line = sync.syncFromTeX({texFile, texPoints[i].line, -1, -1}, TWSynchronizer::LineResolution);
+		QCOMPARE(pdfResults[i].page, line.page);
+		QCOMPARE(pdfResults[i].rects.size(), 1);
+		QCOMPARE(pdfResults[i].rects.first(), TextSynchronizer::charBox(line.rects.first(), texPoints[i].col));
+	}
+
+	// The same holds in the other direction (for points on the same line on
+	// the same page)
+	sync.texTextCalls = 0;
+	sync.pdfTextCalls = 0;
+	const QRectF box = sync.syncFromTeX({texFile, 7, -1, -1}, TWSynchronizer::LineResolution).rects.first();
+	QVector<TWSynchronizer::PDFSyncPoint> pdfPoints;
+	foreach (const int col, cols)
+		pdfPoints.append({pdfFile, 1, {QRectF(TextSynchronizer::charBox(box, col).center(), QSizeF())}});
+	const QVector<TWSynchronizer::TeXSyncPoint> texResults = sync.syncPointsFromPDF(pdfPoints, TWSynchronizer::CharacterResolution);
+	QCOMPARE(sync.texTextCalls, 1);
+	QCOMPARE(sync.pdfTextCalls, 1);
+
+	QCOMPARE(texResults.size(), cols.size());
+	for (int i = 0; i < cols.size(); ++i) {
+		QCOMPARE(texResults[i].line, 7);
+		QCOMPARE(texResults[i].col, cols[i]);
+		QCOMPARE(texResults[i].len, 1);
+	}
+}
+
+} // namespace UnitTest
+
+#if defined(STATIC_QT5) && defined(Q_OS_WIN)
+  Q_IMPORT_PLUGIN(QWindowsIntegrationPlugin)
+#endif
+
+QTEST_MAIN(UnitTest::TestSynchronizer)
@@ -0,0 +1,40 @@
+/*
+	This is part of TeXworks, an environment for working with TeX documents
+	Copyright (C) 2026  The TeXworks developers
+
+	This program is free software; you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation; either version 2 of the License, or
+	(at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+	For links to further information, or to contact the authors,
+	see <http://www.tug.org/texworks/>.
+*/
+#include <QtTest/QtTest>
+
+namespace UnitTest {
+
+class TestSynchronizer : public QObject
+{
+	Q_OBJECT
+private slots:
+	void syncFromTeX_data();
+	void syncFromTeX();
+	void syncFromTeX_multiLine();
+	void syncFromTeX_pageBreak();
+	void syncFromPDF_data();
+	void syncFromPDF();
+	void syncLinesFromTeX();
+	void syncPoints();
+	void syncPoints_fine();
+};
+
+} // namespace UnitTest
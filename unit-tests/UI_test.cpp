@@ -20,14 +20,20 @@
 */
 #include "UI_test.h"
 
+#include "CitationSelectDialog.h"
 #include "SignalCounter.h"
 #include "ui/ClickableLabel.h"
 #include "ui/ClosableTabWidget.h"
 #include "ui/LineNumberWidget.h"
 #include "ui/ScreenCalibrationWidget.h"
+#include "ui/TagsModel.h"
 
+#include <QAbstractTextDocumentLayout>
 #include <QDoubleSpinBox>
+#include <QScrollBar>
+#include <QSignalSpy>
 #include <QTabBar>
+#include <QTemporaryDir>
 
 namespace UnitTest {
 
@@ -41,6 +47,13 @@ public:
 	QMenu & contextMenu() { return _contextMenu; }
 };
 
+class MyLineNumberWidget : public Tw::UI::LineNumberWidget
+{
+public:
+	using Tw::UI::LineNumberWidget::LineNumberWidget;
+	using Tw::UI::LineNumberWidget::blockAt;
+};
+
 class ClosableTabWidget : public Tw::UI::ClosableTabWidget
 {
 public:
@@ -121,6 +134,67 @@ void TestUI::LineNumberWidget_setParent()
 #endif
 }
 
+void TestUI::LineNumberWidget_blockAt()
+{
+	QTextEdit e;
+	MyLineNumberWidget w(&e);
+	e.resize(300, 200);
+
+	QStringList lines;
+	for (int i = 0; i < 200; ++i)
+		lines << (i % 7 == 0 ? QStringLiteral("A line that is long enough to be wrapped in a narrow editor, hopefully") : QString::number(i));
+	e.setPlainText(lines.join(QChar::fromLatin1('\n')));
+
+	QAbstractTextDocumentLayout * layout = e.document()->documentLayout();
+	const qreal height = layout->documentSize().height();
+	// Compare against walking the document from the start
+	for (qreal y = 0; y < height; y += 7) {
+		QTextBlock expected = e.document()->begin();
+		while (expected.next().isValid() && layout->blockBoundingRect(expected.next()).top() <= y)
+			expected = expected.next();
+		QCOMPARE(w.blockAt(y).blockNumber(), expected.blockNumber());
+	}
+	QCOMPARE(w.blockAt(-10).blockNumber(), 0);
+	QCOMPARE(w.blockAt(2 * height).blockNumber(), e.document()->blockCount() - 1);
+}
+
+void TestUI::LineNumberWidget_benchmark_data()
+{
+	QTest::addColumn<int>("line");
+
+	QTest::newRow("top") << 0;
+	QTest::newRow("middle") << 50000;
+	QTest::newRow("end") << 99999;
+}
+
+void TestUI::LineNumberWidget_benchmark()
+{
+	QFETCH(int, line);
+
+	QTextEdit e;
+	Tw::UI::LineNumberWidget w(&e);
+	e.resize(600, 800);
+	w.setGeometry(0, 0, w.sizeHint().width(), 800);
+
+	QStringList lines;
+	for (int i = 0; i < 100000; ++i)
+		lines << QStringLiteral("Line %1 of a long document").arg(i);
+	e.setPlainText(lines.join(QChar::fromLatin1('\n')));
+
+	// Lay out the document up to the line (which also updates the scroll bar
+	// range) so only the painting is measured
+	QAbstractTextDocumentLayout * layout = e.document()->documentLayout();
+	const qreal y = layout->blockBoundingRect(e.document()->findBlockByNumber(line)).top();
+	e.verticalScrollBar()->setValue(static_cast<int>(y));
+
+	QPixmap pm(w.size());
+	w.render(&pm);
+	// Painting should not depend on the position in the document
+	QBENCHMARK {
+		w.render(&pm);
+	}
+}
+
 void TestUI::ScreenCalibrationWidget_dpi()
 {
 	Tw::UI::ScreenCalibrationWidget w;
@@ -376,6 +450,205 @@ void TestUI::ClosableTabWidget_resizeEvent()
 	QCOMPARE(w.tabBar()->maximumWidth(), buttonLeft);
 }
 
+void TestUI::TagsModel_structure()
+{
+	Tw::Document::TextDocument doc(QStringLiteral("0123456789"));
+	Tw::UI::TagsModel model(&doc);
+
+	// Empty document
+	QCOMPARE(model.rowCount(), 1);
+	QCOMPARE(model.index(0, 0).data().toString(), QStringLiteral("No tags"));
+	QCOMPARE(model.flags(model.index(0, 0)), Qt::ItemFlags(Qt::NoItemFlags));
+	QCOMPARE(model.tagIndex(model.index(0, 0)), -1);
+
+	// Levels: bookmark, 1, 2, 2, 3, 1, bookmark
+	const QList<unsigned int> levels{0, 1, 2, 2, 3, 1, 0};
+	for (int i = 0; i < levels.size(); ++i) {
+		QTextCursor c(&doc);
+		c.setPosition(i);
+		doc.addTag(c, levels[i], QString::number(i));
+	}
+
+	QCOMPARE(model.rowCount(), 2);
+	const QModelIndex bookmarks = model.index(0, 0);
+	const QModelIndex outline = model.index(1, 0);
+	QCOMPARE(bookmarks.data().toString(), QStringLiteral("Bookmarks"));
+	QCOMPARE(outline.data().toString(), QStringLiteral("Outline"));
+	QCOMPARE(model.flags(outline), Qt::ItemFlags(Qt::ItemIsEnabled));
+
+	QCOMPARE(model.rowCount(bookmarks), 2);
+	QCOMPARE(model.tagIndex(model.index(0, 0, bookmarks)), 0);
+	QCOMPARE(model.tagIndex(model.index(1, 0, bookmarks)), 6);
+
+	QCOMPARE(model.rowCount(outline), 2);
+	const QModelIndex t1 = model.index(0, 0, outline);
+	const QModelIndex t5 = model.index(1, 0, outline);
+	QCOMPARE(model.tagIndex(t1), 1);
+	QCOMPARE(model.tagIndex(t5), 5);
+	QCOMPARE(model.rowCount(t5), 0);
+	QCOMPARE(model.rowCount(t1), 2);
+	const QModelIndex t3 = model.index(1, 0, t1);
+	QCOMPARE(model.tagIndex(model.index(0, 0, t1)), 2);
+	QCOMPARE(model.tagIndex(t3), 3);
+	QCOMPARE(model.rowCount(t3), 1);
+	QCOMPARE(model.tagIndex(model.index(0, 0, t3)), 4);
+	QCOMPARE(model.index(0, 0, t3).data().toString(), QStringLiteral("4"));
+	QCOMPARE(model.flags(t3), Qt::ItemIsEnabled | Qt::ItemIsSelectable);
+
+	// Parents
+	QCOMPARE(model.parent(model.index(0, 0, t3)), t3);
+	QCOMPARE(model.parent(t3), t1);
+	QCOMPARE(model.parent(t1), outline);
+	QCOMPARE(model.parent(model.index(1, 0, bookmarks)), bookmarks);
+	QCOMPARE(model.parent(outline), QModelIndex());
+	QCOMPARE(model.indexForTag(4), model.index(0, 0, t3));
+}
+
+void TestUI::TagsModel_update()
+{
+	Tw::Document::TextDocument doc(QStringLiteral("0123456789"));
+	auto makeTags = [&doc](const int position, const unsigned int level, const QString & text) -> QList<Tw::Document::TextDocument::Tag> {
+		QTextCursor c(&doc);
+		c.setPosition(position);
+		return {{c, level, text}};
+	};
+	doc.replaceTags(1, 1, makeTags(1, 1, QStringLiteral("a")));
+	doc.replaceTags(2, 1, makeTags(2, 2, QStringLiteral("b")));
+
+	Tw::UI::TagsModel model(&doc);
+	QSignalSpy dataSpy(&model, SIGNAL(dataChanged(QModelIndex, QModelIndex, QVector<int>)));
+	QSignalSpy resetSpy(&model, SIGNAL(modelReset()));
+	QVERIFY(dataSpy.isValid());
+	QVERIFY(resetSpy.isValid());
+
+	// Changing the text only updates the affected row
+	doc.replaceTags(2, 1, makeTags(2, 2, QStringLiteral("c")));
+	QCOMPARE(dataSpy.count(), 1);
+	QCOMPARE(resetSpy.count(), 0);
+	QCOMPARE(dataSpy[0][0].value<QModelIndex>(), model.indexForTag(1));
+	QCOMPARE(model.indexForTag(1).data().toString(), QStringLiteral("c"));
+
+	// Unchanged tags don't cause any updates
+	doc.replaceTags(2, 1, makeTags(2, 2, QStringLiteral("c")));
+	QCOMPARE(dataSpy.count(), 1);
+	QCOMPARE(resetSpy.count(), 0);
+
+	// Changing the level moves the tag to a different parent
+	QSignalSpy removeSpy(&model, SIGNAL(rowsRemoved(QModelIndex, int, int)));
+	QSignalSpy insertSpy(&model, SIGNAL(rowsInserted(QModelIndex, int, int)));
+	QVERIFY(removeSpy.isValid());
+	QVERIFY(insertSpy.isValid());
+	const QPersistentModelIndex a(model.indexForTag(0));
+	doc.replaceTags(2, 1, makeTags(2, 1, QStringLiteral("c")));
+	QCOMPARE(resetSpy.count(), 0);
+	QCOMPARE(removeSpy.count(), 1);
+	QCOMPARE(removeSpy[0][0].value<QModelIndex>(), static_cast<QModelIndex>(a));
+	QCOMPARE(insertSpy.count(), 1);
+	QCOMPARE(insertSpy[0][0].value<QModelIndex>(), model.index(0, 0));
+	QCOMPARE(insertSpy[0][1].toInt(), 1);
+	QCOMPARE(model.rowCount(model.index(0, 0)), 2);
+	QCOMPARE(model.rowCount(a), 0);
+
+	// Indexes of the tags after an insertion stay valid
+	const QPersistentModelIndex c(model.indexForTag(1));
+	QTextCursor cur(&doc);
+	doc.addTag(cur, 1, QStringLiteral("first"));
+	QCOMPARE(resetSpy.count(), 0);
+	QCOMPARE(insertSpy.count(), 2);
+	QCOMPARE(insertSpy[1][1].toInt(), 0);
+	QCOMPARE(c.row(), 2);
+	QCOMPARE(model.tagIndex(c), 2);
+	QCOMPARE(c.data().toString(), QStringLiteral("c"));
+
+	cur.setPosition(3);
+	doc.addTag(cur, 2, QStringLiteral("d"));
+	QCOMPARE(resetSpy.count(), 0);
+	QCOMPARE(insertSpy.count(), 3);
+	QCOMPARE(insertSpy[2][0].value<QModelIndex>(), static_cast<QModelIndex>(c));
+	QCOMPARE(model.index(0, 0, c).data().toString(), QStringLiteral("d"));
+
+	// A new section that takes over existing subsections restructures the tree
+	cur.setPosition(2);
+	doc.addTag(cur, 1, QStringLiteral("e"));
+	QCOMPARE(resetSpy.count(), 1);
+	QCOMPARE(model.rowCount(model.index(0, 0)), 4);
+	QCOMPARE(model.index(0, 0, model.indexForTag(3)).data().toString(), QStringLiteral("d"));
+
+	// Removing all tags removes the category
+	doc.removeTags(0, 10);
+	QCOMPARE(resetSpy.count(), 2);
+	QCOMPARE(model.rowCount(), 1);
+	QCOMPARE(model.tagIndex(model.index(0, 0)), -1);
+}
+
+
+static BibTeXFile generateBibTeXFile(const QTemporaryDir & dir, const int numEntries)
+{
+	QByteArray content;
+	for (int i = 0; i < numEntries; ++i)
+		content += "@article{e" + QByteArray::number(i) + ", title = {Entry-" + QByteArray::number(i) + "}, year = " + QByteArray::number(2000 + i % 3) + "}\n";
+	const QString path = dir.filePath(QStringLiteral("library.bib"));
+	QFile f(path);
+	if (f.open(QIODevice::WriteOnly))
+		f.write(content);
+	f.close();
+	return BibTeXFile(path);
+}
+
+void TestUI::CitationProxyModel_filter()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	CitationModel model;
+	CitationProxyModel proxy;
+	proxy.setSourceModel(&model);
+	model.addBibTeXFile(generateBibTeXFile(dir, 100));
+	QCOMPARE(model.searchStrings().size(), 100);
+	QCOMPARE(model.searchStrings()[42], QStringLiteral("e42 article  entry-42 2000 "));
+	QCOMPARE(proxy.rowCount(), 100);
+
+	// Matching is case-insensitive
+	proxy.setFilterText(QStringLiteral("ENTRY-1"));
+	QVERIFY(!proxy.isFiltering());
+	QCOMPARE(proxy.rowCount(), 11);
+	// Refining the filter
+	proxy.setFilterText(QStringLiteral("ENTRY-12"));
+	QCOMPARE(proxy.rowCount(), 1);
+	QCOMPARE(proxy.index(0, 0).data(Qt::ToolTipRole).toString(), QStringLiteral("e12"));
+	// Widening the filter again; all words must match
+	proxy.setFilterText(QStringLiteral("2001  entry"));
+	QCOMPARE(proxy.rowCount(), 33);
+	proxy.setFilterText(QString());
+	QCOMPARE(proxy.rowCount(), 100);
+
+	// The filter is kept when entries are added
+	proxy.setFilterText(QStringLiteral("entry-1"));
+	model.addBibTeXFile(generateBibTeXFile(dir, 20));
+	QCOMPARE(proxy.rowCount(), 11 + 11);
+}
+
+void TestUI::CitationProxyModel_filterAsync()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+
+	CitationModel model;
+	CitationProxyModel proxy;
+	proxy.setSourceModel(&model);
+	model.addBibTeXFile(generateBibTeXFile(dir, 20000));
+	QCOMPARE(proxy.rowCount(), 20000);
+
+	QSignalSpy spy(&proxy, SIGNAL(filteringFinished()));
+	QVERIFY(spy.isValid());
+	proxy.setFilterText(QStringLiteral("entry-1"));
+	QVERIFY(proxy.isFiltering());
+	// Requests while matching is in progress are coalesced; the last one wins
+	proxy.setFilterText(QStringLiteral("entry-12"));
+	proxy.setFilterText(QStringLiteral("entry-123"));
+	QTRY_VERIFY(!proxy.isFiltering() && spy.count() > 0);
+	QTRY_COMPARE(proxy.rowCount(), 1 + 10 + 100);
+}
 
 } // namespace UnitTest
 
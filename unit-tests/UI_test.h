@@ -30,6 +30,9 @@ private slots:
 	void LineNumberWidget_sizeHint();
 	void LineNumberWidget_paint();
 	void LineNumberWidget_setParent();
+	void LineNumberWidget_blockAt();
+	void LineNumberWidget_benchmark_data();
+	void LineNumberWidget_benchmark();
 
 	void ScreenCalibrationWidget_dpi();
 	void ScreenCalibrationWidget_drag();
@@ -44,6 +47,12 @@ private slots:
 
 	void ClosableTabWidget_signals();
 	void ClosableTabWidget_resizeEvent();
+
+	void TagsModel_structure();
+	void TagsModel_update();
+
+	void CitationProxyModel_filter();
+	void CitationProxyModel_filterAsync();
 };
 
 } // namespace UnitTest
@@ -23,17 +23,24 @@
 
 #include "SignalCounter.h"
 #include "utils/CommandlineParser.h"
+#include "utils/CompletionIndex.h"
 #include "utils/FileVersionDatabase.h"
 #include "utils/FullscreenManager.h"
+#include "utils/MultiPatternMatcher.h"
 #include "utils/SystemCommand.h"
 #include "utils/TextCodecs.h"
 
 #include <QMenuBar>
 #include <QMouseEvent>
+#include <QStandardItemModel>
 #include <QStatusBar>
 #include <QTemporaryFile>
 #include <QToolBar>
 
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif // defined(__GLIBC__)
+
 #ifdef Q_OS_DARWIN
 extern QString GetMacOSVersionString();
 #endif // defined(Q_OS_DARWIN)
@@ -530,6 +537,407 @@ void TestUtils::FullscreenManager()
 	}
 }
 
+void TestUtils::MultiPatternMatcher_canBeCombined_data()
+{
+	QTest::addColumn<QString>("pattern");
+	QTest::addColumn<bool>("expected");
+
+	QTest::newRow("plain") << QStringLiteral("%.*") << true;
+	QTest::newRow("escaped-backslash") << QStringLiteral("\\\\kern\\s*\\\\global") << true;
+	QTest::newRow("groups") << QStringLiteral("\\\\(?:begin|end)\\s*\\{([^}]*)\\}") << true;
+	QTest::newRow("lookahead") << QStringLiteral("[a-zA-Z]+(?=\\s*=)") << true;
+	QTest::newRow("lookbehind") << QStringLiteral("(?<=\\\\)[a-z]+") << true;
+	QTest::newRow("inline-option") << QStringLiteral("(?i)\\\\section") << true;
+	QTest::newRow("octal") << QStringLiteral("\\0") << true;
+	QTest::newRow("backreference") << QStringLiteral("(['\"]).*\\1") << false;
+	QTest::newRow("g-reference") << QStringLiteral("(a)\\g{1}") << false;
+	QTest::newRow("named-group") << QStringLiteral("(?<name>a)") << false;
+	QTest::newRow("python-named-group") << QStringLiteral("(?P<name>a)") << false;
+	QTest::newRow("branch-reset") << QStringLiteral("(?|(a)|(b))") << false;
+	QTest::newRow("recursion") << QStringLiteral("\\{(?:[^{}]|(?R))*\\}") << false;
+	QTest::newRow("reset-start") << QStringLiteral("\\\\label\\{\\K[^}]*") << false;
+	QTest::newRow("verb") << QStringLiteral("a(*SKIP)(*FAIL)|b") << false;
+	QTest::newRow("extended") << QStringLiteral("(?x) a # comment") << false;
+	QTest::newRow("trailing-backslash") << QStringLiteral("a\\") << false;
+}
+
+void TestUtils::MultiPatternMatcher_canBeCombined()
+{
+	QFETCH(QString, pattern);
+	QFETCH(bool, expected);
+
+	QCOMPARE(Tw::Utils::MultiPatternMatcher::canBeCombined(pattern), expected);
+}
+
+// The [LaTeX] and [LaTeX DTX] sections of the default syntax-patterns.txt and
+// the default tag-patterns.txt
+static QList<QRegularExpression> latexPatterns()
+{
+	return {
+		QRegularExpression(QStringLiteral("[$#^_{}&]")),
+		QRegularExpression(QStringLiteral("\\\\(?:begin|end)\\s*\\{[^\\}]*\\}")),
+		QRegularExpression(QStringLiteral("\\\\usepackage\\s*(?:\\[[^\\]]*\\]\\s*)?\\{[^\\}]*\\}")),
+		QRegularExpression(QStringLiteral("\\\\(?:[\\p{L}@]+|.)")),
+		QRegularExpression(QStringLiteral("%.*"))
+	};
+}
+
+static QList<QRegularExpression> dtxPatterns()
+{
+	return {
+		QRegularExpression(QStringLiteral("\\^\\^A.*")),
+		QRegularExpression(QStringLiteral("^%<@@=[^>]*>")),
+		QRegularExpression(QStringLiteral("^%<\\*[^>]*>")),
+		QRegularExpression(QStringLiteral("^%</[^>]*>")),
+		QRegularExpression(QStringLiteral("^%<<")),
+		QRegularExpression(QStringLiteral("^%<[^>]*>")),
+		QRegularExpression(QStringLiteral("\\^\\^\\^\\^\\^[0-9a-z]{5}")),
+		QRegularExpression(QStringLiteral("\\^\\^\\^\\^[0-9a-z]{4}")),
+		QRegularExpression(QStringLiteral("\\^\\^\\^[0-9a-z]{3}")),
+		QRegularExpression(QStringLiteral("\\^\\^[0-9a-z]{2}")),
+		QRegularExpression(QStringLiteral("[$#^_{}&]")),
+		QRegularExpression(QStringLiteral("^%%.*")),
+		QRegularExpression(QStringLiteral("^%")),
+		QRegularExpression(QStringLiteral("\\\\(?:begin|end)\\{macrocode\\}")),
+		QRegularExpression(QStringLiteral("\\\\(?:begin|end)\\s*\\{[^}]*\\}")),
+		QRegularExpression(QStringLiteral("\\\\(?:[\\p{L}@:_]+|.)"))
+	};
+}
+
+static QList<QRegularExpression> tagPatterns()
+{
+	return {
+		QRegularExpression(QStringLiteral("^\\s*\\\\part\\*?\\s*(?:\\[[^]]*\\]\\s*)?\\{([^}]*)\\}")),
+		QRegularExpression(QStringLiteral("^\\s*\\\\chapter\\*?\\s*(?:\\[[^]]*\\]\\s*)?\\{([^}]*)\\}")),
+		QRegularExpression(QStringLiteral("^\\s*\\\\section\\*?\\s*(?:\\[[^]]*\\]\\s*)?\\{([^}]*)\\}")),
+		QRegularExpression(QStringLiteral("^\\s*\\\\subsection\\*?\\s*(?:\\[[^]]*\\]\\s*)?\\{([^}]*)\\}")),
+		QRegularExpression(QStringLiteral("^\\s*\\\\subsubsection\\*?\\s*(?:\\[[^]]*\\]\\s*)?\\{([^}]*)\\}"))
+	};
+}
+
+// A synthetic LaTeX document of roughly `numLines` lines
+static QStringList largeLaTeXSource(const int numLines)
+{
+	const QStringList snippets{
+		QStringLiteral("\\section{Section %1}\\label{sec:%1}"),
+		QStringLiteral("Some text with \\emph{emphasis}, math $a_%1^2 + b_{%1} = c$ and a citation~\\cite{key%1}."),
+		QStringLiteral("\\begin{equation} \\int_0^\\infty e^{-x^2}\\,dx = \\frac{\\sqrt{\\pi}}{2} \\end{equation} % eq. %1"),
+		QStringLiteral("\\usepackage[utf8]{inputenc} \\newcommand{\\foo%1}[1]{\\textbf{#1}}"),
+		QStringLiteral("Plain prose without any markup whatsoever, which is quite common in long documents %1 times."),
+		QStringLiteral("  \\subsection*[short]{Subsection %1} \\subsubsection{ignored}"),
+		QStringLiteral("  \\item \\\"{U}berpr\\\"ufung der Stra\\ss{}e \\& Umlaute ^^e4 \\\\ % trailing comment")
+	};
+	QStringList lines;
+	for (int i = 0; i < numLines; ++i)
+		lines << snippets[i % snippets.size()].arg(i);
+	return lines;
+}
+
+// Tokenize `text` the way TeXHighlighter::highlightBlock() does; returns a
+// list of (start, length, pattern index) triples
+static QVector<int> tokenize(const Tw::Utils::MultiPatternMatcher & matcher, const QString & text, const bool individually)
+{
+	QVector<int> tokens;
+	int pos = 0;
+	while (pos < text.length()) {
+		const Tw::Utils::MultiPatternMatcher::Match m = (individually ? matcher.matchIndividually(text, pos) : matcher.match(text, pos));
+		if (!m.hasMatch() || m.capturedLength() <= 0)
+			break;
+		tokens << m.capturedStart() << m.capturedLength() << m.patternIndex();
+		pos = m.capturedEnd();
+	}
+	return tokens;
+}
+
+void TestUtils::MultiPatternMatcher_match()
+{
+	using Tw::Utils::MultiPatternMatcher;
+
+	const QList< QList<QRegularExpression> > patternSets{latexPatterns(), dtxPatterns(), tagPatterns()};
+	QStringList lines = largeLaTeXSource(50);
+	lines << QString() << QStringLiteral("%<*driver>") << QStringLiteral("%</driver> ^^A comment") << QStringLiteral("^^^^00e4 ^^^^^0001f ^^41");
+
+	foreach (const QList<QRegularExpression> & patterns, patternSets) {
+		MultiPatternMatcher matcher(patterns);
+		QVERIFY(matcher.isCombined());
+		QCOMPARE(matcher.size(), patterns.size());
+
+		foreach (const QString & line, lines) {
+			QCOMPARE(tokenize(matcher, line, false), tokenize(matcher, line, true));
+			for (int offset = 0; offset <= line.length(); ++offset) {
+				const MultiPatternMatcher::Match m = matcher.match(line, offset);
+				const MultiPatternMatcher::Match ref = matcher.matchIndividually(line, offset);
+				QCOMPARE(m.patternIndex(), ref.patternIndex());
+				QCOMPARE(m.capturedStart(), ref.capturedStart());
+				QCOMPARE(m.capturedLength(), ref.capturedLength());
+				QCOMPARE(m.captured(0), ref.captured(0));
+				QCOMPARE(m.captured(1), ref.captured(1));
+				QCOMPARE(m.captured(2), ref.captured(2));
+			}
+		}
+	}
+
+	MultiPatternMatcher tagMatcher(tagPatterns());
+	const MultiPatternMatcher::Match m = tagMatcher.match(QStringLiteral("  \\subsection[short]{Long title}"));
+	QCOMPARE(m.patternIndex(), 3);
+	QCOMPARE(m.captured(1), QStringLiteral("Long title"));
+
+	// Patterns that cannot be combined fall back to individual matching
+	MultiPatternMatcher fallback({QRegularExpression(QStringLiteral("x")), QRegularExpression(QStringLiteral("(['\"]).*?\\1"))});
+	QVERIFY(!fallback.isCombined());
+	const MultiPatternMatcher::Match m2 = fallback.match(QStringLiteral("a 'quoted' x"));
+	QCOMPARE(m2.patternIndex(), 1);
+	QCOMPARE(m2.captured(0), QStringLiteral("'quoted'"));
+	QCOMPARE(m2.captured(1), QStringLiteral("'"));
+
+	QVERIFY(!MultiPatternMatcher().match(QStringLiteral("abc")).hasMatch());
+}
+
+void TestUtils::MultiPatternMatcher_benchmark_data()
+{
+	QTest::addColumn<bool>("individually");
+
+	QTest::newRow("individual-patterns") << true;
+	QTest::newRow("combined") << false;
+}
+
+void TestUtils::MultiPatternMatcher_benchmark()
+{
+	QFETCH(bool, individually);
+
+	// Highlighting a large document as TeXHighlighter does (syntax rules and
+	// tag patterns for every line)
+	const Tw::Utils::MultiPatternMatcher syntaxMatcher(latexPatterns());
+	const Tw::Utils::MultiPatternMatcher tagMatcher(tagPatterns());
+	const QStringList lines = largeLaTeXSource(20000);
+
+	int numTokens{0};
+	QBENCHMARK {
+		numTokens = 0;
+		foreach (const QString & line, lines) {
+			numTokens += tokenize(syntaxMatcher, line, individually).size();
+			numTokens += tokenize(tagMatcher, line, individually).size();
+		}
+	}
+	QVERIFY(numTokens > 0);
+}
+
+static QStringList abbreviations(const Tw::Utils::CompletionIndex & index, const QVector<int> & entries)
+{
+	QStringList retVal;
+	foreach (const int entry, entries)
+		retVal << index.abbreviation(entry);
+	return retVal;
+}
+
+void TestUtils::CompletionIndex_find()
+{
+	Tw::Utils::CompletionIndex index;
+	index.addEntry(QStringLiteral("sec"), QStringLiteral("\\section{#INS#}"));
+	index.addEntry(QStringLiteral("\\section"), QStringLiteral("\\section{#INS#}"));
+	index.addEntry(QStringLiteral("--"), QStringLiteral("\\textendash"));
+	index.addEntry(QStringLiteral("Sub"), QStringLiteral("\\subsection{#INS#}"));
+	index.addEntry(QStringLiteral("--"), QStringLiteral("\\hyphenation"));
+	index.addEntry(QStringLiteral("se"), QStringLiteral("\\setlength"));
+	index.addEntry(QStringLiteral("sub"), QStringLiteral("\\subset"));
+	index.finalize();
+
+	QCOMPARE(index.size(), 7);
+	QCOMPARE(index.abbreviation(3), QStringLiteral("Sub"));
+	QCOMPARE(index.expansion(6), QStringLiteral("\\subset"));
+	QCOMPARE(index.abbreviation(-1), QString());
+	QCOMPARE(index.expansion(7), QString());
+
+	// Results are in the order in which the entries were added
+	QCOMPARE(index.find(QStringLiteral("se")), QVector<int>({0, 5}));
+	QCOMPARE(index.find(QStringLiteral("sec")), QVector<int>({0}));
+	QCOMPARE(index.find(QStringLiteral("s")), QVector<int>({0, 3, 5, 6}));
+	QCOMPARE(index.find(QStringLiteral("\\")), QVector<int>({1}));
+	QCOMPARE(index.find(QStringLiteral("x")), QVector<int>());
+	QCOMPARE(index.find(QStringLiteral("section")), QVector<int>());
+	// Duplicate abbreviations are separate entries
+	QCOMPARE(index.find(QStringLiteral("--")), QVector<int>({2, 4}));
+	QCOMPARE(index.expansion(index.find(QStringLiteral("--"))[1]), QStringLiteral("\\hyphenation"));
+	// Case-insensitive
+	QCOMPARE(index.find(QStringLiteral("SUB")), QVector<int>({3, 6}));
+	QCOMPARE(abbreviations(index, index.find(QStringLiteral("sU"))), QStringList({QStringLiteral("Sub"), QStringLiteral("sub")}));
+	// The empty prefix matches everything
+	QCOMPARE(index.find(QString()).size(), 7);
+
+	QCOMPARE(Tw::Utils::CompletionIndex().find(QStringLiteral("a")), QVector<int>());
+}
+
+void TestUtils::CompletionIndex_findFuzzy()
+{
+	Tw::Utils::CompletionIndex index;
+	index.addEntry(QStringLiteral("\\subsection"), QStringLiteral("\\subsection{#INS#}"));
+	index.addEntry(QStringLiteral("\\section"), QStringLiteral("\\section{#INS#}"));
+	index.addEntry(QStringLiteral("\\setlength"), QStringLiteral("\\setlength{#INS#}{}"));
+	index.addEntry(QStringLiteral("\\textsc"), QStringLiteral("\\textsc{#INS#}"));
+	index.finalize();
+
+	// Consecutive matches rank higher than scattered ones
+	const QVector<int> sec = index.findFuzzy(QStringLiteral("sec"));
+	QCOMPARE(abbreviations(index, sec), QStringList({QStringLiteral("\\section"), QStringLiteral("\\subsection")}));
+
+	QCOMPARE(abbreviations(index, index.findFuzzy(QStringLiteral("SBSC"))), QStringList({QStringLiteral("\\subsection")}));
+	// Poor matches can be left out
+	QCOMPARE(abbreviations(index, index.findFuzzy(QStringLiteral("sec"), 50, 0)), QStringList({QStringLiteral("\\section")}));
+	QCOMPARE(index.findFuzzy(QStringLiteral("SBSC"), 50, 0), QVector<int>());
+	QCOMPARE(index.findFuzzy(QStringLiteral("zz")), QVector<int>());
+	QCOMPARE(index.findFuzzy(QString()), QVector<int>());
+	QCOMPARE(index.findFuzzy(QStringLiteral("s"), 2).size(), 2);
+}
+
+void TestUtils::CompletionIndex_load()
+{
+	const QStringList files = completionFiles();
+	QVERIFY(!files.isEmpty());
+
+	Tw::Utils::CompletionIndex index;
+	QVERIFY(!index.addFile(QStringLiteral("does-not-exist.txt")));
+	QCOMPARE(index.size(), 0);
+
+	index = Tw::Utils::CompletionIndex::load(files);
+	QVERIFY(index.size() > 1000);
+
+	// tw-latex.txt: bite:=\begin{itemize}#RET#\item#RET##INS##RET#\end{itemize}
+	const QVector<int> itemize = index.find(QStringLiteral("bite"));
+	QVERIFY(!itemize.isEmpty());
+	QCOMPARE(index.abbreviation(itemize.first()), QStringLiteral("bite"));
+	QVERIFY(index.expansion(itemize.first()).startsWith(QStringLiteral("\\begin{itemize}\n")));
+	QVERIFY(index.expansion(itemize.first()).contains(QStringLiteral("#INS#")));
+	foreach (const int entry, index.find(QStringLiteral("\\sec")))
+		QVERIFY(index.abbreviation(entry).startsWith(QStringLiteral("\\sec"), Qt::CaseInsensitive));
+}
+
+static QStringList completionFiles()
+{
+	const QDir completionDir(QStringLiteral("../res/resfiles/completion"));
+	QStringList files;
+	foreach (const QFileInfo & fileInfo, completionDir.entryInfoList(QDir::Files | QDir::Readable, QDir::Name))
+		files << fileInfo.absoluteFilePath();
+	return files;
+}
+
+// Same as the former CompletingEdit::loadCompletionsFromFile()
+static bool loadCompletionModel(QStandardItemModel & model, const QStringList & files)
+{
+	foreach (const QString & path, files) {
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+			return false;
+		QTextStream in(&file);
+		in.setCodec("UTF-8");
+		while (!in.atEnd()) {
+			QString line = in.readLine();
+			if (line.isEmpty() || line.startsWith(QChar::fromLatin1('%')))
+				continue;
+			line.replace(QLatin1String("#RET#"), QLatin1String("\n"));
+			QStringList parts = line.split(QString::fromLatin1(":="));
+			if (parts.count() > 2)
+				continue;
+			if (parts.count() == 1)
+				parts.append(parts[0]);
+			parts[0].replace(QLatin1String("#INS#"), QLatin1String(""));
+			model.appendRow({new QStandardItem(parts[0]), new QStandardItem(parts[1])});
+		}
+	}
+	return true;
+}
+
+// Returns the number of bytes currently allocated on the heap, or -1 if this
+// cannot be determined on the current platform
+static qint64 heapUsage()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	const struct mallinfo2 info = mallinfo2();
+	return static_cast<qint64>(info.uordblks + info.hblkhd);
+#elif defined(__GLIBC__)
+	const struct mallinfo info = mallinfo();
+	return static_cast<qint64>(info.uordblks) + static_cast<qint64>(info.hblkhd);
+#else
+	return -1;
+#endif
+}
+
+void TestUtils::CompletionIndex_benchmark_data()
+{
+	QTest::addColumn<bool>("useModel");
+
+	QTest::newRow("QStandardItemModel") << true;
+	QTest::newRow("CompletionIndex") << false;
+}
+
+void TestUtils::CompletionIndex_benchmark()
+{
+	QFETCH(bool, useModel);
+
+	// Loading all completion files as CompletingEdit does at startup, and
+	// looking up a few prefixes
+	const QStringList files = completionFiles();
+	const QStringList prefixes{QStringLiteral("\\sec"), QStringLiteral("\\b"), QStringLiteral("bf"), QStringLiteral("--"), QStringLiteral("\\begin{ta")};
+
+	int numFound{0};
+	if (useModel) {
+		QBENCHMARK {
+			QStandardItemModel model(0, 2);
+			QVERIFY(loadCompletionModel(model, files));
+			numFound = 0;
+			foreach (const QString & prefix, prefixes)
+				numFound += model.match(model.index(0, 0), Qt::DisplayRole, prefix, -1, Qt::MatchStartsWith).size();
+		}
+	}
+	else {
+		QBENCHMARK {
+			const Tw::Utils::CompletionIndex index = Tw::Utils::CompletionIndex::load(files);
+			numFound = 0;
+			foreach (const QString & prefix, prefixes)
+				numFound += index.find(prefix).size();
+		}
+	}
+	QVERIFY(numFound > 0);
+}
+
+void TestUtils::CompletionIndex_memoryUsage_data()
+{
+	QTest::addColumn<bool>("useModel");
+
+	QTest::newRow("model") << true;
+	QTest::newRow("index") << false;
+}
+
+void TestUtils::CompletionIndex_memoryUsage()
+{
+	QFETCH(bool, useModel);
+
+	if (heapUsage() < 0)
+		QSKIP("Measuring the heap usage is not supported on this platform");
+
+	// Both structures are measured the same way: by the growth of the heap
+	// while all completion files are loaded (temporaries used for reading the
+	// files are freed again before the second measurement)
+	const QStringList files = completionFiles();
+	qint64 bytes{0};
+	if (useModel) {
+		const qint64 before = heapUsage();
+		QStandardItemModel model(0, 2);
+		QVERIFY(loadCompletionModel(model, files));
+		bytes = heapUsage() - before;
+		QVERIFY(model.rowCount() > 1000);
+	}
+	else {
+		const qint64 before = heapUsage();
+		const Tw::Utils::CompletionIndex index = Tw::Utils::CompletionIndex::load(files);
+		bytes = heapUsage() - before;
+		QVERIFY(index.size() > 1000);
+		// The index' own estimate only covers its arrays, not allocator overhead
+		QVERIFY(index.memoryUsage() <= bytes + static_cast<qint64>(sizeof(index)));
+	}
+	QVERIFY(bytes > 0);
+	QTest::setBenchmarkResult(static_cast<qreal>(bytes), QTest::BytesAllocated);
+}
+
 #ifdef Q_OS_DARWIN
 void TestUtils::OSVersionString()
 {
@@ -43,6 +43,20 @@ private slots:
 
 	void FullscreenManager();
 
+	void MultiPatternMatcher_canBeCombined_data();
+	void MultiPatternMatcher_canBeCombined();
+	void MultiPatternMatcher_match();
+	void MultiPatternMatcher_benchmark_data();
+	void MultiPatternMatcher_benchmark();
+
+	void CompletionIndex_find();
+	void CompletionIndex_findFuzzy();
+	void CompletionIndex_load();
+	void CompletionIndex_benchmark_data();
+	void CompletionIndex_benchmark();
+	void CompletionIndex_memoryUsage_data();
+	void CompletionIndex_memoryUsage();
+
 #ifdef Q_OS_DARWIN
 	void OSVersionString();
 #endif // defined(Q_OS_DARWIN)